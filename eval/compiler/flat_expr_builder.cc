@@ -1,6 +1,8 @@
 #include "eval/compiler/flat_expr_builder.h"
 
+#include "set"
 #include "stack"
+#include "unordered_set"
 
 #include "eval/eval/comprehension_step.h"
 #include "eval/eval/const_value_step.h"
@@ -9,13 +11,24 @@
 #include "eval/eval/evaluator_core.h"
 #include "eval/eval/function_step.h"
 #include "eval/eval/ident_step.h"
+#include "eval/eval/in_list_step.h"
+#include "eval/eval/instruction_engine.h"
 #include "eval/eval/jump_step.h"
+#include "eval/eval/list_index.h"
 #include "eval/eval/logic_step.h"
+#include "eval/eval/regex_match_step.h"
 #include "eval/eval/select_step.h"
+#include "eval/eval/timestamp_accessor_step.h"
 #include "eval/public/ast_traverse.h"
 #include "eval/public/ast_visitor.h"
 #include "eval/public/cel_builtins.h"
+#include "eval/public/list_membership.h"
+#include "eval/public/referenced_paths.h"
+#include "eval/public/regex_match.h"
+#include "eval/public/timestamp_accessor.h"
+#include "google/protobuf/message.h"
 #include "google/rpc/code.pb.h"
+#include "absl/strings/match.h"
 
 namespace google {
 namespace api {
@@ -24,9 +37,12 @@ namespace runtime {
 
 namespace {
 
+using google::api::expr::v1alpha1::CheckedExpr;
 using google::api::expr::v1alpha1::Constant;
 using google::api::expr::v1alpha1::Expr;
+using google::api::expr::v1alpha1::Reference;
 using google::api::expr::v1alpha1::SourceInfo;
+using google::api::expr::v1alpha1::Type;
 using Ident = google::api::expr::v1alpha1::Expr::Ident;
 using Select = google::api::expr::v1alpha1::Expr::Select;
 using Call = google::api::expr::v1alpha1::Expr::Call;
@@ -36,16 +52,153 @@ using Comprehension = google::api::expr::v1alpha1::Expr::Comprehension;
 
 class FlatExprVisitor;
 
+// Returns the runtime type of values of the checked type, or kAny if values
+// of different runtime types may have it.
+CelValue::Type ToRuntimeType(const Type& type) {
+  switch (type.type_kind_case()) {
+    case Type::kPrimitive:
+      switch (type.primitive()) {
+        case Type::BOOL:
+          return CelValue::Type::kBool;
+        case Type::INT64:
+          return CelValue::Type::kInt64;
+        case Type::UINT64:
+          return CelValue::Type::kUint64;
+        case Type::DOUBLE:
+          return CelValue::Type::kDouble;
+        case Type::STRING:
+          return CelValue::Type::kString;
+        case Type::BYTES:
+          return CelValue::Type::kBytes;
+        default:
+          return CelValue::Type::kAny;
+      }
+    case Type::kWellKnown:
+      switch (type.well_known()) {
+        case Type::TIMESTAMP:
+          return CelValue::Type::kTimestamp;
+        case Type::DURATION:
+          return CelValue::Type::kDuration;
+        default:
+          return CelValue::Type::kAny;
+      }
+    case Type::kListType:
+      return CelValue::Type::kList;
+    case Type::kMapType:
+      return CelValue::Type::kMap;
+    case Type::kMessageType:
+      // Well-known protobuf messages, such as wrappers or Struct, are
+      // converted to other types.
+      if (absl::StartsWith(type.message_type(), "google.protobuf.")) {
+        return CelValue::Type::kAny;
+      }
+      return CelValue::Type::kMessage;
+    default:
+      // Wrappers may be null, dyn and type parameters may be anything.
+      return CelValue::Type::kAny;
+  }
+}
+
+// Returns the prototype of generated messages of the type, or nullptr if the
+// type is not in the generated pool.
+const google::protobuf::Message* GetGeneratedPrototype(
+    const google::protobuf::Descriptor* descriptor) {
+  if (descriptor == nullptr ||
+      descriptor->file()->pool() !=
+          google::protobuf::DescriptorPool::generated_pool()) {
+    return nullptr;
+  }
+  return google::protobuf::MessageFactory::generated_factory()->GetPrototype(
+      descriptor);
+}
+
+// Returns true if the variable with the name is referenced in the expression.
+// Shadowing by comprehension variables is taken into account.
+bool ReferencesVariable(const Expr& expr, const std::string& name) {
+  switch (expr.expr_kind_case()) {
+    case Expr::kIdentExpr:
+      return expr.ident_expr().name() == name;
+    case Expr::kSelectExpr:
+      return ReferencesVariable(expr.select_expr().operand(), name);
+    case Expr::kCallExpr: {
+      const Call& call_expr = expr.call_expr();
+      if (call_expr.has_target() &&
+          ReferencesVariable(call_expr.target(), name)) {
+        return true;
+      }
+      for (const auto& arg : call_expr.args()) {
+        if (ReferencesVariable(arg, name)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case Expr::kListExpr:
+      for (const auto& element : expr.list_expr().elements()) {
+        if (ReferencesVariable(element, name)) {
+          return true;
+        }
+      }
+      return false;
+    case Expr::kStructExpr:
+      for (const auto& entry : expr.struct_expr().entries()) {
+        if ((entry.has_map_key() && ReferencesVariable(entry.map_key(), name)) ||
+            ReferencesVariable(entry.value(), name)) {
+          return true;
+        }
+      }
+      return false;
+    case Expr::kComprehensionExpr: {
+      const Comprehension& comprehension = expr.comprehension_expr();
+      if (ReferencesVariable(comprehension.iter_range(), name) ||
+          ReferencesVariable(comprehension.accu_init(), name)) {
+        return true;
+      }
+      if (comprehension.accu_var() == name ||
+          comprehension.iter_var() == name) {
+        return false;
+      }
+      return ReferencesVariable(comprehension.loop_condition(), name) ||
+             ReferencesVariable(comprehension.loop_step(), name) ||
+             ReferencesVariable(comprehension.result(), name);
+    }
+    default:
+      return false;
+  }
+}
+
 class FlatExprVisitor : public AstVisitor {
  public:
+  // constant_arena holds the results of constant folding. If null, constant
+  // subexpressions are not folded.
   FlatExprVisitor(const CelFunctionRegistry* function_registry,
                   ExecutionPath* path, bool shortcircuiting,
-                  const std::set<const google::protobuf::EnumDescriptor*>& enums)
+                  bool fused_comprehensions, bool fused_selects,
+                  const std::set<const google::protobuf::EnumDescriptor*>& enums,
+                  google::protobuf::Arena* constant_arena,
+                  const google::protobuf::Map<int64_t, Reference>* reference_map,
+                  const google::protobuf::Map<int64_t, Type>* type_map,
+                  const std::map<std::string, const google::protobuf::Descriptor*>&
+                      variable_types,
+                  int parallel_min_range_size)
       : flattened_path_(path),
         progress_status_(util::OkStatus()),
         resolved_select_expr_(nullptr),
         function_registry_(function_registry),
-        shortcircuiting_(shortcircuiting) {
+        shortcircuiting_(shortcircuiting),
+        fused_comprehensions_(fused_comprehensions),
+        fused_selects_(fused_selects),
+        comprehension_depth_(0),
+        iter_var_slots_(0),
+        stack_depth_(0),
+        max_stack_depth_(0),
+        constant_arena_(constant_arena),
+        reference_map_(reference_map),
+        type_map_(type_map),
+        select_chain_expr_(nullptr),
+        select_chain_step_index_(-1),
+        variable_types_(variable_types),
+        parallel_min_range_size_(parallel_min_range_size) {
     // TODO(issues/21) current enum value resolution does not work with
     // expressions that specify a container. In other words, only
     // fully-qualified enum values are resolved.
@@ -84,6 +237,8 @@ class FlatExprVisitor : public AstVisitor {
     }
 
     AddStep(CreateConstValueStep(const_expr, expr));
+    AdjustStackDepth(1);
+    MarkConstant(expr);
   }
 
   // Ident node handler.
@@ -122,9 +277,33 @@ class FlatExprVisitor : public AstVisitor {
         return;
       }
       AddStep(CreateConstValueStep(value_desc, resolved_select_expr_));
+      AdjustStackDepth(1);
+      MarkConstant(resolved_select_expr_);
       return;
     }
-    AddStep(CreateIdentStep(ident_expr, expr));
+
+    // Comprehension variables are resolved to frame slots.
+    int slot = FindIterVarSlot(ident_expr->name());
+    if (slot >= 0) {
+      AddStep(CreateIterVarIdentStep(ident_expr, slot, expr));
+      AdjustStackDepth(1);
+      return;
+    }
+
+    // Free variables are assigned dense slots, so that their values can be
+    // bound by index.
+    AddStep(
+        CreateIdentStep(ident_expr, expr, GetVariableSlot(ident_expr->name())));
+    AdjustStackDepth(1);
+
+    auto type = variable_types_.find(ident_expr->name());
+    if (type != variable_types_.end()) {
+      const google::protobuf::Message* prototype =
+          GetGeneratedPrototype(type->second);
+      if (prototype != nullptr) {
+        message_prototypes_[expr] = prototype;
+      }
+    }
   }
 
   void PreVisitSelect(const Select* select_expr, const Expr* expr,
@@ -170,7 +349,27 @@ class FlatExprVisitor : public AstVisitor {
       select_path = it->second;
     }
 
-    AddStep(CreateSelectStep(select_expr, expr, select_path));
+    const google::protobuf::Message* prototype =
+        FindMessagePrototype(&select_expr->operand());
+    if (prototype == nullptr) {
+      AddSelectStep(select_expr, expr, select_path);
+      return;
+    }
+    AddStep(CreateTypedSelectStep(select_expr, expr, select_path, prototype));
+
+    // The type of singular submessages is known from the field.
+    const google::protobuf::FieldDescriptor* field_desc =
+        prototype->GetDescriptor()->FindFieldByName(select_expr->field());
+    if (!select_expr->test_only() && field_desc != nullptr &&
+        !field_desc->is_repeated() &&
+        field_desc->cpp_type() ==
+            google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      const google::protobuf::Message* field_prototype =
+          GetGeneratedPrototype(field_desc->message_type());
+      if (field_prototype != nullptr) {
+        message_prototypes_[expr] = field_prototype;
+      }
+    }
   }
 
   // Call node handler group.
@@ -212,9 +411,39 @@ class FlatExprVisitor : public AstVisitor {
     if (cond_visitor) {
       cond_visitor->PostVisit(expr);
       cond_visitor_stack_.pop();
+    } else if (IsListAccumulatorExpr(expr, ListAccumulatorRole::kAppend)) {
+      // Elements of the appended list are on the stack, above the
+      // accumulator.
+      int num_elements = call_expr->args(1).list_expr().elements_size();
+      AddStep(CreateListAppendStep(num_elements, expr));
+      AdjustStackDepth(-num_elements);
     } else {
       // For regular functions, just create one based on registry.
-      AddStep(CreateFunctionStep(call_expr, expr, *function_registry_));
+      std::shared_ptr<const RE2> re2 = PrecompiledRegex(call_expr);
+      std::shared_ptr<const CelListIndex> list_index =
+          ConstantListIndex(call_expr);
+      absl::TimeZone time_zone;
+      const TimestampAccessorFunction* timestamp_accessor =
+          ConstantTimeZoneAccessor(call_expr, &time_zone);
+      if (re2 != nullptr) {
+        AddStep(CreateRegexMatchStep(std::move(re2), expr));
+      } else if (list_index != nullptr) {
+        AddStep(CreateInConstantListStep(std::move(list_index), expr));
+      } else if (timestamp_accessor != nullptr) {
+        AddStep(
+            CreateTimestampAccessorStep(timestamp_accessor, time_zone, expr));
+      } else if (type_map_ != nullptr) {
+        AddStep(CreateFunctionStep(call_expr, expr, *function_registry_,
+                                   CheckedArgumentTypes(call_expr, expr)));
+      } else {
+        AddStep(CreateFunctionStep(call_expr, expr, *function_registry_));
+      }
+      // Arguments are replaced with the result.
+      int num_args = call_expr->args_size() + (call_expr->has_target() ? 1 : 0);
+      AdjustStackDepth(1 - num_args);
+      if (IsFoldable(call_expr)) {
+        FoldConstant(expr, num_args);
+      }
     }
   }
 
@@ -262,7 +491,26 @@ class FlatExprVisitor : public AstVisitor {
       return;
     }
 
+    if (IsListAccumulatorExpr(expr, ListAccumulatorRole::kInit)) {
+      AddStep(CreateListAccumulatorStep(expr));
+      AdjustStackDepth(1);
+      return;
+    }
+    if (IsListAccumulatorExpr(expr, ListAccumulatorRole::kElements)) {
+      // Elements are left on the stack for the append step.
+      return;
+    }
+
     AddStep(CreateCreateListStep(list_expr, expr));
+    AdjustStackDepth(1 - list_expr->elements_size());
+
+    bool foldable = true;
+    for (const auto& element : list_expr->elements()) {
+      foldable = foldable && IsConstant(&element);
+    }
+    if (foldable) {
+      FoldConstant(expr, list_expr->elements_size());
+    }
   }
 
   // CreateStruct node handler.
@@ -274,10 +522,38 @@ class FlatExprVisitor : public AstVisitor {
     }
 
     AddStep(CreateCreateStructStep(struct_expr, expr));
+    // Map entries take key and value from the stack, message fields only
+    // the value.
+    int values_per_entry = struct_expr->message_name().empty() ? 2 : 1;
+    AdjustStackDepth(1 - values_per_entry * struct_expr->entries_size());
+
+    // Only maps are folded; messages are mutable and created per evaluation.
+    if (!struct_expr->message_name().empty()) {
+      return;
+    }
+    bool foldable = true;
+    for (const auto& entry : struct_expr->entries()) {
+      foldable = foldable && IsConstant(&entry.map_key()) &&
+                 IsConstant(&entry.value());
+    }
+    if (foldable) {
+      FoldConstant(expr, 2 * struct_expr->entries_size());
+    }
   }
 
   util::Status progress_status() const { return progress_status_; }
 
+  // Number of frame slots required for comprehension variables.
+  int iter_var_slots() const { return iter_var_slots_; }
+
+  // Names of free variables, indexed by the slots assigned to them.
+  const std::vector<std::string>& variable_slots() const {
+    return variable_slots_;
+  }
+
+  // Maximum depth of the value stack reached by the flattened path.
+  int max_stack_depth() const { return max_stack_depth_; }
+
  private:
   class CondVisitor {
    public:
@@ -330,6 +606,10 @@ class FlatExprVisitor : public AstVisitor {
         : CondVisitor(visitor)
         , next_step_(nullptr)
         , cond_step_(nullptr)
+        , list_accumulator_(false)
+        , parallel_list_step_(nullptr)
+        , quantifier_(false)
+        , quantifier_start_step_(nullptr)
     {}
 
     void PreVisit(const Expr* expr) override;
@@ -337,15 +617,251 @@ class FlatExprVisitor : public AstVisitor {
     void PostVisit(const Expr* expr) override;
 
    private:
+    void PostVisitQuantifierArg(int arg_num, const Expr* expr);
+
     ComprehensionNextStep* next_step_;
     ComprehensionCondStep* cond_step_;
     int next_step_pos_;
     int cond_step_pos_;
+    int iter_slot_;
+    int accu_slot_;
+    bool list_accumulator_;
+    ParallelListLoopStep* parallel_list_step_;
+    int parallel_list_step_pos_;
+    // Set for comprehensions evaluated by fused quantifier loop steps.
+    bool quantifier_;
+    QuantifierKind quantifier_kind_;
+    QuantifierStartStep* quantifier_start_step_;
+    int quantifier_start_pos_;
+    int loop_condition_pos_;
+    int result_pos_;
   };
 
+  // Returns true if the expression is the identifier of the variable.
+  static bool IsIdent(const Expr& expr, const std::string& name) {
+    return expr.has_ident_expr() && expr.ident_expr().name() == name;
+  }
+
+  // Returns true if the expression is a global call of the function with
+  // num_args arguments.
+  static bool IsCall(const Expr& expr, const std::string& function,
+                     int num_args) {
+    return expr.has_call_expr() && !expr.call_expr().has_target() &&
+           expr.call_expr().function() == function &&
+           expr.call_expr().args_size() == num_args;
+  }
+
+  static bool IsNotStrictlyFalse(const Expr& expr) {
+    return IsCall(expr, builtin::kNotStrictlyFalse, 1) ||
+           IsCall(expr, builtin::kNotStrictlyFalseDeprecated, 1);
+  }
+
+  // Recognizes comprehensions expanded from all, exists and exists_one
+  // macros, as listed in QuantifierKind. The fused loop steps short-circuit
+  // natively, so shortcircuiting is required.
+  bool MatchQuantifier(const Comprehension* comprehension,
+                       QuantifierKind* kind) const {
+    const std::string& accu_var = comprehension->accu_var();
+    if (!fused_comprehensions_ || !shortcircuiting_ ||
+        accu_var == comprehension->iter_var()) {
+      return false;
+    }
+    const Expr& accu_init = comprehension->accu_init();
+    const Expr& loop_condition = comprehension->loop_condition();
+    const Expr& loop_step = comprehension->loop_step();
+    const Expr& result = comprehension->result();
+
+    const Expr* predicate = nullptr;
+    if (accu_init.has_const_expr() &&
+        accu_init.const_expr().has_bool_value() &&
+        IsNotStrictlyFalse(loop_condition) && IsIdent(result, accu_var)) {
+      bool all = accu_init.const_expr().bool_value();
+      const Expr& condition = loop_condition.call_expr().args(0);
+      if (all && IsIdent(condition, accu_var) &&
+          IsCall(loop_step, builtin::kAnd, 2) &&
+          IsIdent(loop_step.call_expr().args(0), accu_var)) {
+        *kind = QuantifierKind::kAll;
+        predicate = &loop_step.call_expr().args(1);
+      } else if (!all && IsCall(condition, builtin::kNot, 1) &&
+                 IsIdent(condition.call_expr().args(0), accu_var) &&
+                 IsCall(loop_step, builtin::kOr, 2) &&
+                 IsIdent(loop_step.call_expr().args(0), accu_var)) {
+        *kind = QuantifierKind::kExists;
+        predicate = &loop_step.call_expr().args(1);
+      }
+    } else if (accu_init.has_const_expr() &&
+               accu_init.const_expr().has_int64_value() &&
+               accu_init.const_expr().int64_value() == 0 &&
+               loop_condition.has_const_expr() &&
+               loop_condition.const_expr().has_bool_value() &&
+               loop_condition.const_expr().bool_value() &&
+               IsCall(loop_step, builtin::kTernary, 3) &&
+               IsCall(result, builtin::kEqual, 2) &&
+               IsIdent(result.call_expr().args(0), accu_var) &&
+               result.call_expr().args(1).const_expr().int64_value() == 1) {
+      const Call& ternary = loop_step.call_expr();
+      const Expr& increment = ternary.args(1);
+      if (IsCall(increment, builtin::kAdd, 2) &&
+          IsIdent(increment.call_expr().args(0), accu_var) &&
+          increment.call_expr().args(1).const_expr().int64_value() == 1 &&
+          IsIdent(ternary.args(2), accu_var)) {
+        *kind = QuantifierKind::kExistsOne;
+        predicate = &ternary.args(0);
+      }
+    }
+    return predicate != nullptr && !ReferencesVariable(*predicate, accu_var);
+  }
+
+  // Roles of subexpressions of comprehensions accumulating lists in place.
+  enum class ListAccumulatorRole {
+    // Empty list the accumulator is initialized with.
+    kInit,
+    // "accu + [elements]" call.
+    kAppend,
+    // "[elements]" list of the call.
+    kElements,
+  };
+
+  // Recognizes comprehensions that accumulate a list by appending to it,
+  // as expanded from map and filter macros:
+  //   accu_init: []
+  //   loop_step: accu + [elements]
+  //              or, with shortcircuiting, cond ? accu + [elements] : accu
+  //   result: accu
+  // The accumulator is not referenced otherwise, so it can be modified in
+  // place instead of being copied on each iteration.
+  // Records the roles of the subexpressions and returns true on match.
+  bool MatchListAccumulator(const Comprehension* comprehension) {
+    const std::string& accu_var = comprehension->accu_var();
+    if (!fused_comprehensions_ || accu_var == comprehension->iter_var() ||
+        !comprehension->accu_init().has_list_expr() ||
+        comprehension->accu_init().list_expr().elements_size() != 0 ||
+        !comprehension->result().has_ident_expr() ||
+        comprehension->result().ident_expr().name() != accu_var ||
+        ReferencesVariable(comprehension->loop_condition(), accu_var)) {
+      return false;
+    }
+
+    const Expr* append = &comprehension->loop_step();
+    if (shortcircuiting_ && append->has_call_expr() &&
+        append->call_expr().function() == builtin::kTernary) {
+      const Call& ternary = append->call_expr();
+      if (ternary.has_target() || ternary.args_size() != 3 ||
+          ReferencesVariable(ternary.args(0), accu_var) ||
+          !ternary.args(2).has_ident_expr() ||
+          ternary.args(2).ident_expr().name() != accu_var) {
+        return false;
+      }
+      append = &ternary.args(1);
+    }
+    if (!append->has_call_expr() ||
+        append->call_expr().function() != builtin::kAdd ||
+        append->call_expr().has_target() ||
+        append->call_expr().args_size() != 2) {
+      return false;
+    }
+    const Expr& accu = append->call_expr().args(0);
+    const Expr& elements = append->call_expr().args(1);
+    if (!accu.has_ident_expr() || accu.ident_expr().name() != accu_var ||
+        !elements.has_list_expr() || ReferencesVariable(elements, accu_var)) {
+      return false;
+    }
+
+    list_accumulator_exprs_[&comprehension->accu_init()] =
+        ListAccumulatorRole::kInit;
+    list_accumulator_exprs_[append] = ListAccumulatorRole::kAppend;
+    list_accumulator_exprs_[&elements] = ListAccumulatorRole::kElements;
+    return true;
+  }
+
+  // Returns the description of the parallel evaluation of the comprehension
+  // body, or null if it is disabled or the body may have side effects, i.e.
+  // calls functions other than pure builtins.
+  std::unique_ptr<ParallelLoop> MakeParallelLoop(const Expr& body) const {
+    std::set<std::string> variables;
+    if (parallel_min_range_size_ <= 0 ||
+        !CollectParallelLoopVariables(body, &variables)) {
+      return nullptr;
+    }
+    auto loop = absl::make_unique<ParallelLoop>();
+    loop->min_range_size = parallel_min_range_size_;
+    loop->variables.assign(variables.begin(), variables.end());
+    return loop;
+  }
+
+  // Collects names of identifiers referenced by the expression. Returns
+  // false if it calls functions with possible side effects.
+  bool CollectParallelLoopVariables(const Expr& expr,
+                                    std::set<std::string>* variables) const {
+    switch (expr.expr_kind_case()) {
+      case Expr::kConstExpr:
+        return true;
+      case Expr::kIdentExpr:
+        variables->insert(expr.ident_expr().name());
+        return true;
+      case Expr::kSelectExpr:
+        return CollectParallelLoopVariables(expr.select_expr().operand(),
+                                            variables);
+      case Expr::kCallExpr: {
+        const Call& call_expr = expr.call_expr();
+        if (call_expr.function() != builtin::kTernary &&
+            (FoldableFunctions().count(call_expr.function()) == 0 ||
+             !HasPureOverloads(call_expr))) {
+          return false;
+        }
+        if (call_expr.has_target() &&
+            !CollectParallelLoopVariables(call_expr.target(), variables)) {
+          return false;
+        }
+        for (const auto& arg : call_expr.args()) {
+          if (!CollectParallelLoopVariables(arg, variables)) {
+            return false;
+          }
+        }
+        return true;
+      }
+      case Expr::kListExpr:
+        for (const auto& element : expr.list_expr().elements()) {
+          if (!CollectParallelLoopVariables(element, variables)) {
+            return false;
+          }
+        }
+        return true;
+      case Expr::kStructExpr:
+        for (const auto& entry : expr.struct_expr().entries()) {
+          if ((entry.has_map_key() &&
+               !CollectParallelLoopVariables(entry.map_key(), variables)) ||
+              !CollectParallelLoopVariables(entry.value(), variables)) {
+            return false;
+          }
+        }
+        return true;
+      case Expr::kComprehensionExpr: {
+        const Comprehension& comprehension = expr.comprehension_expr();
+        for (const Expr* part :
+             {&comprehension.iter_range(), &comprehension.accu_init(),
+              &comprehension.loop_condition(), &comprehension.loop_step(),
+              &comprehension.result()}) {
+          if (!CollectParallelLoopVariables(*part, variables)) {
+            return false;
+          }
+        }
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  bool IsListAccumulatorExpr(const Expr* expr, ListAccumulatorRole role) const {
+    auto it = list_accumulator_exprs_.find(expr);
+    return it != list_accumulator_exprs_.end() && it->second == role;
+  }
+
   template <typename T>
   void AddStep(util::StatusOr<std::unique_ptr<T>> step_status) {
     if (util::IsOk(step_status) && util::IsOk(progress_status_)) {
+      RecordMaxStackDepth();
       flattened_path_->push_back(std::move(step_status.ValueOrDie()));
     } else {
       SetProgressStatusError(step_status.status());
@@ -355,10 +871,18 @@ class FlatExprVisitor : public AstVisitor {
   template <typename T>
   void AddStep(std::unique_ptr<T> step) {
     if (util::IsOk(progress_status_)) {
+      RecordMaxStackDepth();
       flattened_path_->push_back(std::move(step));
     }
   }
 
+  // Records the maximum stack depth before the step at the current index is
+  // added, so that it is restored when the step is folded away.
+  void RecordMaxStackDepth() {
+    max_stack_depth_before_step_.resize(GetCurrentIndex());
+    max_stack_depth_before_step_.push_back(max_stack_depth_);
+  }
+
   void SetProgressStatusError(const util::Status& status) {
     if (util::IsOk(progress_status_) && !util::IsOk(status)) {
       progress_status_ = status;
@@ -367,6 +891,356 @@ class FlatExprVisitor : public AstVisitor {
 
   int GetCurrentIndex() const { return flattened_path_->size(); }
 
+  // Removes the steps in [begin, end) from the path, with their recorded
+  // maximum stack depths.
+  void RemoveSteps(int begin, int end) {
+    flattened_path_->erase(flattened_path_->begin() + begin,
+                           flattened_path_->begin() + end);
+    if (begin < static_cast<int>(max_stack_depth_before_step_.size())) {
+      int recorded_end = std::min(
+          end, static_cast<int>(max_stack_depth_before_step_.size()));
+      max_stack_depth_before_step_.erase(
+          max_stack_depth_before_step_.begin() + begin,
+          max_stack_depth_before_step_.begin() + recorded_end);
+    }
+  }
+
+  // Accounts for the change of the value stack depth by the steps just
+  // added. Steps are added in the order of the path without jumps taken.
+  // Where that order does not match the control flow (e.g. after
+  // an unconditional jump), callers restore the depth at the jump target.
+  void AdjustStackDepth(int delta) {
+    stack_depth_ += delta;
+    max_stack_depth_ = std::max(max_stack_depth_, stack_depth_);
+  }
+
+  // Returns runtime types of the call arguments (the target first), as
+  // inferred by the checker. Types are only used if the checker resolved
+  // the call to a single overload; kAny is returned otherwise.
+  std::vector<CelValue::Type> CheckedArgumentTypes(const Call* call_expr,
+                                                   const Expr* expr) const {
+    std::vector<const Expr*> args;
+    if (call_expr->has_target()) {
+      args.push_back(&call_expr->target());
+    }
+    for (const auto& arg : call_expr->args()) {
+      args.push_back(&arg);
+    }
+
+    std::vector<CelValue::Type> arg_types(args.size(), CelValue::Type::kAny);
+    auto reference = reference_map_->find(expr->id());
+    if (reference == reference_map_->end() ||
+        reference->second.overload_id_size() != 1) {
+      return arg_types;
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+      auto type = type_map_->find(args[i]->id());
+      if (type != type_map_->end()) {
+        arg_types[i] = ToRuntimeType(type->second);
+      }
+    }
+    return arg_types;
+  }
+
+  // Records that the value of the subexpression is known at build time.
+  // Its steps are then a single step pushing the value.
+  void MarkConstant(const Expr* expr) {
+    if (constant_arena_ != nullptr) {
+      constant_exprs_.insert(expr);
+    }
+  }
+
+  // Returns the pattern of a call to the builtin matches() function compiled
+  // in advance, or null if the pattern is not a constant string, or is not
+  // valid (the error is then reported at evaluation time).
+  std::shared_ptr<const RE2> PrecompiledRegex(const Call* call_expr) const {
+    bool receiver_style = call_expr->has_target();
+    if (call_expr->function() != builtin::kRegexMatch ||
+        call_expr->args_size() + (receiver_style ? 1 : 0) != 2) {
+      return nullptr;
+    }
+    const Expr& pattern = call_expr->args(call_expr->args_size() - 1);
+    if (pattern.const_expr().constant_kind_case() !=
+        google::api::expr::v1alpha1::Constant::kStringValue) {
+      return nullptr;
+    }
+    // Only the builtin function is replaced, other overloads may be
+    // registered for the name.
+    auto overloads = function_registry_->FindOverloads(
+        builtin::kRegexMatch, receiver_style,
+        {CelValue::Type::kAny, CelValue::Type::kAny});
+    if (overloads.size() != 1 ||
+        dynamic_cast<const RegexMatchFunction*>(overloads[0]) == nullptr) {
+      return nullptr;
+    }
+    auto re2 = std::make_shared<const RE2>(pattern.const_expr().string_value(),
+                                           RE2::Quiet);
+    if (!re2->ok()) {
+      return nullptr;
+    }
+    return re2;
+  }
+
+  // Returns the index of the constant list operand of a call to the builtin
+  // in operator, or null if the list is not a constant.
+  std::shared_ptr<const CelListIndex> ConstantListIndex(
+      const Call* call_expr) const {
+    const std::string& function = call_expr->function();
+    if ((function != builtin::kIn && function != builtin::kInDeprecated &&
+         function != builtin::kInFunction) ||
+        call_expr->has_target() || call_expr->args_size() != 2 ||
+        !IsConstant(&call_expr->args(1))) {
+      return nullptr;
+    }
+    // Only the builtin function is replaced, other overloads may be
+    // registered for the name.
+    auto overloads = function_registry_->FindOverloads(
+        function, false, {CelValue::Type::kAny, CelValue::Type::kList});
+    if (overloads.empty()) {
+      return nullptr;
+    }
+    for (const CelFunction* overload : overloads) {
+      if (dynamic_cast<const ListMembershipFunction*>(overload) == nullptr) {
+        return nullptr;
+      }
+    }
+
+    // The constant list is pushed by the last step. Its value is owned by
+    // the expression, as the index is.
+    CelExpressionFlatEvaluationState state(1, 0, constant_arena_);
+    Activation activation;
+    ExecutionFrame frame(flattened_path_, activation, &state);
+    if (!util::IsOk(flattened_path_->back()->Evaluate(&frame)) ||
+        !frame.value_stack().Peek().IsList()) {
+      return nullptr;
+    }
+    return std::make_shared<const CelListIndex>(
+        *frame.value_stack().Peek().ListOrDie());
+  }
+
+  // Returns the builtin timestamp accessor called with a constant time zone,
+  // and resolves the time zone. Returns null if the time zone is not a
+  // constant string, or is not valid (the error is then reported at
+  // evaluation time).
+  const TimestampAccessorFunction* ConstantTimeZoneAccessor(
+      const Call* call_expr, absl::TimeZone* time_zone) const {
+    if (!call_expr->has_target() || call_expr->args_size() != 1 ||
+        call_expr->args(0).const_expr().constant_kind_case() !=
+            google::api::expr::v1alpha1::Constant::kStringValue) {
+      return nullptr;
+    }
+    auto overloads = function_registry_->FindOverloads(
+        call_expr->function(), true,
+        {CelValue::Type::kAny, CelValue::Type::kAny});
+    if (overloads.size() != 1) {
+      return nullptr;
+    }
+    auto accessor =
+        dynamic_cast<const TimestampAccessorFunction*>(overloads[0]);
+    if (accessor == nullptr ||
+        !FindTimeZone(call_expr->args(0).const_expr().string_value(),
+                      time_zone)) {
+      return nullptr;
+    }
+    return accessor;
+  }
+
+  bool IsConstant(const Expr* expr) const {
+    return constant_exprs_.find(expr) != constant_exprs_.end();
+  }
+
+  // Returns true if the call is to a builtin function, and all of its
+  // arguments are constant.
+  bool IsFoldable(const Call* call_expr) const {
+    if (constant_arena_ == nullptr ||
+        FoldableFunctions().count(call_expr->function()) == 0 ||
+        !HasPureOverloads(*call_expr)) {
+      return false;
+    }
+    if (call_expr->has_target() && !IsConstant(&call_expr->target())) {
+      return false;
+    }
+    for (const auto& arg : call_expr->args()) {
+      if (!IsConstant(&arg)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Returns true if all the overloads the call may resolve to are pure, i.e.
+  // builtin functions or functions registered as such. Other functions may
+  // be registered under the names of builtin functions.
+  bool HasPureOverloads(const Call& call_expr) const {
+    int num_args = call_expr.args_size() + (call_expr.has_target() ? 1 : 0);
+    auto overloads = function_registry_->FindOverloads(
+        call_expr.function(), call_expr.has_target(),
+        std::vector<CelValue::Type>(num_args, CelValue::Type::kAny));
+    for (const CelFunction* overload : overloads) {
+      if (!overload->pure()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Evaluates the last added step over its num_args constant arguments
+  // and replaces them all with a single step producing the result.
+  // If the evaluation fails or produces an error, the steps are kept and
+  // the error is reported at evaluation time as usual.
+  void FoldConstant(const Expr* expr, int num_args) {
+    if (!util::IsOk(progress_status_)) {
+      return;
+    }
+
+    // Arguments are single steps, each pushing one value.
+    int first_index = GetCurrentIndex() - num_args - 1;
+    CelExpressionFlatEvaluationState state(std::max(num_args, 1), 0,
+                                           constant_arena_);
+    Activation activation;
+    ExecutionFrame frame(flattened_path_, activation, &state);
+    for (int i = first_index; i < GetCurrentIndex(); i++) {
+      if (!util::IsOk((*flattened_path_)[i]->Evaluate(&frame))) {
+        return;
+      }
+    }
+    CelValue value = frame.value_stack().Peek();
+    if (value.IsError()) {
+      return;
+    }
+
+    flattened_path_->resize(first_index);
+    // Stack depth reached by the arguments is not needed anymore.
+    max_stack_depth_ =
+        std::max(max_stack_depth_before_step_[first_index], stack_depth_);
+    AddStep(CreateConstValueStep(value, expr));
+    MarkConstant(expr);
+  }
+
+  // Builtin functions have no side effects and their results depend only on
+  // their arguments, so calls with constant arguments can be folded, as long
+  // as all their overloads are builtin.
+  static const std::unordered_set<std::string>& FoldableFunctions() {
+    static const std::unordered_set<std::string>* functions =
+        new std::unordered_set<std::string>({
+            builtin::kEqual,
+            builtin::kInequal,
+            builtin::kLess,
+            builtin::kLessOrEqual,
+            builtin::kGreater,
+            builtin::kGreaterOrEqual,
+            builtin::kAnd,
+            builtin::kOr,
+            builtin::kNot,
+            builtin::kNotStrictlyFalse,
+            builtin::kNotStrictlyFalseDeprecated,
+            builtin::kAdd,
+            builtin::kSubtract,
+            builtin::kNeg,
+            builtin::kMultiply,
+            builtin::kDivide,
+            builtin::kModulo,
+            builtin::kRegexMatch,
+            builtin::kStringContains,
+            builtin::kStringEndsWith,
+            builtin::kStringStartsWith,
+            builtin::kIn,
+            builtin::kInDeprecated,
+            builtin::kInFunction,
+            builtin::kIndex,
+            builtin::kSize,
+            builtin::kDuration,
+            builtin::kTimestamp,
+            builtin::kFullYear,
+            builtin::kMonth,
+            builtin::kDayOfYear,
+            builtin::kDayOfMonth,
+            builtin::kDate,
+            builtin::kDayOfWeek,
+            builtin::kHours,
+            builtin::kMinutes,
+            builtin::kSeconds,
+            builtin::kMilliseconds,
+            builtin::kInt,
+            builtin::kString,
+        });
+    return *functions;
+  }
+
+  // Returns the frame slot of the innermost comprehension variable visible
+  // with the name, or -1 if there is none.
+  int FindIterVarSlot(const std::string& name) const {
+    for (auto it = iter_var_scope_.rbegin(); it != iter_var_scope_.rend();
+         ++it) {
+      if (it->first == name) {
+        return it->second;
+      }
+    }
+    return -1;
+  }
+
+  // Returns the slot assigned to the free variable, assigning the next
+  // available one on first reference.
+  int GetVariableSlot(const std::string& name) {
+    auto it = variable_slot_index_.find(name);
+    if (it != variable_slot_index_.end()) {
+      return it->second;
+    }
+    int slot = variable_slots_.size();
+    variable_slots_.push_back(name);
+    variable_slot_index_[name] = slot;
+    return slot;
+  }
+
+  // Adds the step for the select of a message of unknown type. Chains of
+  // such selects, e.g. a.b.c, are evaluated by one step if select fusion is
+  // enabled: if the operand is the select evaluated by the last step, that
+  // step is replaced.
+  void AddSelectStep(const Select* select_expr, const Expr* expr,
+                     const std::string& select_path) {
+    if (!util::IsOk(progress_status_)) {
+      return;
+    }
+    if (fused_selects_ && select_chain_expr_ == &select_expr->operand() &&
+        select_chain_step_index_ == GetCurrentIndex() - 1 &&
+        !select_chain_.back().first->test_only()) {
+      select_chain_.emplace_back(select_expr, select_path);
+      auto step_status = CreateSelectPathStep(select_chain_, expr);
+      if (!util::IsOk(step_status)) {
+        SetProgressStatusError(step_status.status());
+        return;
+      }
+      flattened_path_->back() = std::move(step_status.ValueOrDie());
+    } else {
+      select_chain_.clear();
+      select_chain_.emplace_back(select_expr, select_path);
+      AddStep(CreateSelectStep(select_expr, expr, select_path));
+    }
+    select_chain_expr_ = expr;
+    select_chain_step_index_ = GetCurrentIndex() - 1;
+  }
+
+  // Returns the prototype of the messages the expression evaluates to, if
+  // their type is known at build time from declared variable types or the
+  // checker, or nullptr.
+  const google::protobuf::Message* FindMessagePrototype(const Expr* expr) const {
+    auto it = message_prototypes_.find(expr);
+    if (it != message_prototypes_.end()) {
+      return it->second;
+    }
+    if (type_map_ == nullptr) {
+      return nullptr;
+    }
+    auto type = type_map_->find(expr->id());
+    if (type == type_map_->end() ||
+        ToRuntimeType(type->second) != CelValue::Type::kMessage) {
+      return nullptr;
+    }
+    return GetGeneratedPrototype(
+        google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(
+            type->second.message_type()));
+  }
+
   CondVisitor* FindCondVisitor(const Expr* expr) const {
     if (cond_visitor_stack_.empty()) {
       return nullptr;
@@ -399,6 +1273,62 @@ class FlatExprVisitor : public AstVisitor {
   const CelFunctionRegistry* function_registry_;
 
   bool shortcircuiting_;
+
+  // Set if steps of comprehensions expanded from macros are fused.
+  bool fused_comprehensions_;
+
+  // Set if chains of selects are evaluated by single steps.
+  bool fused_selects_;
+
+  // Comprehension variables in scope, paired with their frame slots.
+  // Innermost variables are at the back.
+  std::vector<std::pair<std::string, int>> iter_var_scope_;
+
+  // Nesting depth of comprehension currently being visited.
+  int comprehension_depth_;
+
+  // Number of frame slots assigned to comprehension variables.
+  int iter_var_slots_;
+
+  // Free variable names, indexed by slot, and the reverse mapping.
+  std::vector<std::string> variable_slots_;
+  std::unordered_map<std::string, int> variable_slot_index_;
+
+  // Value stack depth after the steps added so far, and its maximum.
+  int stack_depth_;
+  int max_stack_depth_;
+  // Indexed by the step, see RecordMaxStackDepth().
+  std::vector<int> max_stack_depth_before_step_;
+
+  // Storage for the results of constant folding, null if disabled.
+  google::protobuf::Arena* constant_arena_;
+  // Subexpressions with values known at build time.
+  std::unordered_set<const Expr*> constant_exprs_;
+
+  // Subexpressions of comprehensions accumulating lists in place.
+  std::unordered_map<const Expr*, ListAccumulatorRole> list_accumulator_exprs_;
+
+  // References and types inferred by the checker, null if the expression
+  // is not checked.
+  const google::protobuf::Map<int64_t, Reference>* reference_map_;
+  const google::protobuf::Map<int64_t, Type>* type_map_;
+
+  // Selects evaluated by the last select step, innermost first, with their
+  // select paths, the outermost of them and the index of the step.
+  std::vector<std::pair<const Select*, std::string>> select_chain_;
+  const Expr* select_chain_expr_;
+  int select_chain_step_index_;
+
+  // Message types of free variables declared with the builder.
+  const std::map<std::string, const google::protobuf::Descriptor*>& variable_types_;
+  // Prototypes of the messages subexpressions evaluate to, where known at
+  // build time from declared variable types and the types of their fields.
+  std::unordered_map<const Expr*, const google::protobuf::Message*>
+      message_prototypes_;
+
+  // Minimum size of ranges of comprehensions evaluated in parallel, 0 if
+  // parallel evaluation is disabled.
+  int parallel_min_range_size_;
 };
 
 void FlatExprVisitor::BinaryCondVisitor::PreVisit(const Expr* expr) {}
@@ -418,6 +1348,7 @@ void FlatExprVisitor::BinaryCondVisitor::PostVisitArg(int arg_num,
 }
 void FlatExprVisitor::BinaryCondVisitor::PostVisit(const Expr* expr) {
   visitor_->AddStep((cond_value_) ? CreateOrStep(expr) : CreateAndStep(expr));
+  visitor_->AdjustStackDepth(-1);
   jump_step_.set_target(visitor_->GetCurrentIndex());
 }
 
@@ -454,6 +1385,7 @@ void FlatExprVisitor::TernaryCondVisitor::PostVisitArg(int arg_num,
                              jump_to_second_status.ValueOrDie().get());
     }
     visitor_->AddStep(std::move(jump_to_second_status));
+    visitor_->AdjustStackDepth(-1);
   } else if (arg_num == 1) {
     // Jump after the first and over the second branch of execution.
     // Value is to be removed from the stack.
@@ -463,6 +1395,8 @@ void FlatExprVisitor::TernaryCondVisitor::PostVisitArg(int arg_num,
                                jump_after_first_status.ValueOrDie().get());
     }
     visitor_->AddStep(std::move(jump_after_first_status));
+    // The second branch starts without the result of the first one.
+    visitor_->AdjustStackDepth(-1);
 
     if (jump_to_second_.exists()) {
       jump_to_second_.set_target(visitor_->GetCurrentIndex());
@@ -518,8 +1452,26 @@ const Expr* CurrentValueDummy() {
 }
 
 void FlatExprVisitor::ComprehensionVisitor::PreVisit(const Expr* expr) {
+  // Comprehensions at the same nesting depth are never active at the same
+  // time, so they can share slots. Fused quantifier loops use all four
+  // slots of their depth, other comprehensions only the first two.
+  int depth = visitor_->comprehension_depth_++;
+  iter_slot_ = 4 * depth;
+  accu_slot_ = 4 * depth + 1;
+  visitor_->iter_var_slots_ =
+      std::max(visitor_->iter_var_slots_, iter_slot_ + 4);
+
+  quantifier_ = visitor_->MatchQuantifier(&expr->comprehension_expr(),
+                                          &quantifier_kind_);
+  if (quantifier_) {
+    return;
+  }
+  list_accumulator_ =
+      visitor_->MatchListAccumulator(&expr->comprehension_expr());
+
   const Expr* dummy = LoopStepDummy();
   visitor_->AddStep(CreateConstValueStep(&dummy->const_expr(), dummy, false));
+  visitor_->AdjustStackDepth(1);
 }
 
 void FlatExprVisitor::ComprehensionVisitor::PostVisitArg(int arg_num,
@@ -527,6 +1479,10 @@ void FlatExprVisitor::ComprehensionVisitor::PostVisitArg(int arg_num,
   const Comprehension* comprehension = &expr->comprehension_expr();
   auto accu_var = comprehension->accu_var();
   auto iter_var = comprehension->iter_var();
+  if (quantifier_) {
+    PostVisitQuantifierArg(arg_num, expr);
+    return;
+  }
   // TODO(issues/20): Consider refactoring the comprehension prologue step.
   switch (arg_num) {
     case ITER_RANGE: {
@@ -538,19 +1494,40 @@ void FlatExprVisitor::ComprehensionVisitor::PostVisitArg(int arg_num,
       const Expr* dummy = CurrentValueDummy();
       visitor_->AddStep(
           CreateConstValueStep(&dummy->const_expr(), dummy, false));
+      visitor_->AdjustStackDepth(2);
       break;
     }
     case ACCU_INIT: {
+      // Loops accumulating lists are evaluated in parallel if the loop
+      // condition is always true.
+      parallel_list_step_ = nullptr;
+      if (list_accumulator_ &&
+          comprehension->loop_condition().const_expr().bool_value()) {
+        auto parallel_loop =
+            visitor_->MakeParallelLoop(comprehension->loop_step());
+        if (parallel_loop) {
+          parallel_list_step_pos_ = visitor_->GetCurrentIndex();
+          parallel_list_step_ = new ParallelListLoopStep(
+              std::move(*parallel_loop), iter_slot_, accu_slot_, expr);
+          visitor_->AddStep(
+              std::unique_ptr<ExpressionStep>(parallel_list_step_));
+        }
+      }
       next_step_pos_ = visitor_->GetCurrentIndex();
-      next_step_ = new ComprehensionNextStep(accu_var, iter_var, expr);
+      next_step_ = new ComprehensionNextStep(iter_slot_, accu_slot_, expr);
       visitor_->AddStep(std::unique_ptr<ExpressionStep>(next_step_));
+      visitor_->AdjustStackDepth(-1);
+      // accu_var and iter_var are visible in loop_condition and loop_step.
+      visitor_->iter_var_scope_.emplace_back(accu_var, accu_slot_);
+      visitor_->iter_var_scope_.emplace_back(iter_var, iter_slot_);
       break;
     }
     case LOOP_CONDITION: {
       cond_step_pos_ = visitor_->GetCurrentIndex();
-      cond_step_ = new ComprehensionCondStep(accu_var, iter_var,
-                                             visitor_->shortcircuiting_, expr);
+      cond_step_ =
+          new ComprehensionCondStep(visitor_->shortcircuiting_, expr);
       visitor_->AddStep(std::unique_ptr<ExpressionStep>(cond_step_));
+      visitor_->AdjustStackDepth(-1);
       break;
     }
     case LOOP_STEP: {
@@ -567,30 +1544,146 @@ void FlatExprVisitor::ComprehensionVisitor::PostVisitArg(int arg_num,
       next_step_->set_jump_offset(
           visitor_->GetCurrentIndex() - next_step_pos_ - 1
       );
+      if (parallel_list_step_ != nullptr) {
+        // The body is the loop step, without the jump back to the next step.
+        ParallelLoop* loop = parallel_list_step_->mutable_loop();
+        loop->body_offset = cond_step_pos_ - parallel_list_step_pos_;
+        loop->body_size = visitor_->GetCurrentIndex() - 1 - cond_step_pos_ - 1;
+        parallel_list_step_->set_jump_offset(visitor_->GetCurrentIndex() -
+                                             parallel_list_step_pos_ - 1);
+      }
+      // The loop exits with only the accumulator left on the stack.
+      visitor_->AdjustStackDepth(-4);
+      // Only accu_var remains visible in result.
+      visitor_->iter_var_scope_.pop_back();
       break;
     }
     case RESULT: {
       visitor_->AddStep(std::unique_ptr<ExpressionStep>(
-          new ComprehensionFinish(accu_var, iter_var, expr)
+          new ComprehensionFinish(expr, list_accumulator_)
       ));
+      visitor_->AdjustStackDepth(-1);
       next_step_->set_error_jump_offset(visitor_->GetCurrentIndex() -
                                         next_step_pos_ - 1);
+      visitor_->iter_var_scope_.pop_back();
+      break;
+    }
+  }
+}
+
+// Steps of the accumulator plumbing of quantifier comprehensions are removed
+// as they are added, leaving only the predicate between the fused loop steps.
+void FlatExprVisitor::ComprehensionVisitor::PostVisitQuantifierArg(
+    int arg_num, const Expr* expr) {
+  const Comprehension* comprehension = &expr->comprehension_expr();
+  int end = visitor_->GetCurrentIndex();
+  switch (arg_num) {
+    case ITER_RANGE: {
+      quantifier_start_pos_ = visitor_->GetCurrentIndex();
+      quantifier_start_step_ =
+          new QuantifierStartStep(quantifier_kind_, iter_slot_, expr);
+      visitor_->AddStep(std::unique_ptr<ExpressionStep>(quantifier_start_step_));
+      visitor_->AdjustStackDepth(-1);
+      break;
+    }
+    case ACCU_INIT: {
+      // Constant initial value, set by QuantifierStartStep.
+      visitor_->RemoveSteps(end - 1, end);
+      visitor_->AdjustStackDepth(-1);
+      loop_condition_pos_ = visitor_->GetCurrentIndex();
+      visitor_->iter_var_scope_.emplace_back(comprehension->accu_var(),
+                                             accu_slot_);
+      visitor_->iter_var_scope_.emplace_back(comprehension->iter_var(),
+                                             iter_slot_);
+      break;
+    }
+    case LOOP_CONDITION: {
+      visitor_->RemoveSteps(loop_condition_pos_, end);
+      visitor_->AdjustStackDepth(-1);
+      break;
+    }
+    case LOOP_STEP: {
+      // With shortcircuiting, loop steps are flattened to:
+      //  accu && pred:            accu, cond jump, pred, and
+      //  accu || pred:            accu, cond jump, pred, or
+      //  pred ? accu + 1 : accu:  pred, error jump, cond jump, accu, 1, add,
+      //                           jump, accu
+      // The accumulator is not constant, so none of these is folded.
+      if (quantifier_kind_ == QuantifierKind::kExistsOne) {
+        visitor_->RemoveSteps(end - 7, end);
+      } else {
+        visitor_->RemoveSteps(end - 1, end);
+        visitor_->RemoveSteps(loop_condition_pos_, loop_condition_pos_ + 2);
+      }
+
+      int next_pos = visitor_->GetCurrentIndex();
+      auto next_step =
+          absl::make_unique<QuantifierNextStep>(quantifier_kind_, iter_slot_,
+                                                expr);
+      next_step->set_jump_offset(loop_condition_pos_ - next_pos - 1);
+      visitor_->AddStep(std::move(next_step));
+
+      const Call& loop_step = comprehension->loop_step().call_expr();
+      auto parallel_loop = visitor_->MakeParallelLoop(
+          quantifier_kind_ == QuantifierKind::kExistsOne ? loop_step.args(0)
+                                                         : loop_step.args(1));
+      if (parallel_loop) {
+        parallel_loop->body_size = next_pos - loop_condition_pos_;
+        quantifier_start_step_->set_parallel_loop(std::move(*parallel_loop));
+      }
+      quantifier_start_step_->set_jump_offset(visitor_->GetCurrentIndex() -
+                                              quantifier_start_pos_ - 1);
+      // The predicate value is replaced with the result.
+      result_pos_ = visitor_->GetCurrentIndex();
+      visitor_->iter_var_scope_.pop_back();
+      break;
+    }
+    case RESULT: {
+      // The result is pushed by the loop steps.
+      visitor_->RemoveSteps(result_pos_, end);
+      visitor_->AdjustStackDepth(-1);
+      visitor_->iter_var_scope_.pop_back();
       break;
     }
   }
 }
 
-void FlatExprVisitor::ComprehensionVisitor::PostVisit(const Expr* expr) {}
+void FlatExprVisitor::ComprehensionVisitor::PostVisit(const Expr* expr) {
+  visitor_->comprehension_depth_--;
+}
 
 }  // namespace
 
 util::StatusOr<std::unique_ptr<CelExpression>>
 FlatExprBuilder::CreateExpression(const Expr* expr,
                                   const SourceInfo* source_info) const {
+  return CreateExpressionImpl(expr, source_info, nullptr, nullptr);
+}
+
+util::StatusOr<std::unique_ptr<CelExpression>>
+FlatExprBuilder::CreateExpression(const CheckedExpr* checked_expr) const {
+  return CreateExpressionImpl(
+      &checked_expr->expr(), &checked_expr->source_info(),
+      &checked_expr->reference_map(), &checked_expr->type_map());
+}
+
+util::StatusOr<std::unique_ptr<CelExpression>>
+FlatExprBuilder::CreateExpressionImpl(
+    const Expr* expr, const SourceInfo* source_info,
+    const google::protobuf::Map<int64_t, Reference>* reference_map,
+    const google::protobuf::Map<int64_t, Type>* type_map) const {
   ExecutionPath execution_path;
+  std::unique_ptr<google::protobuf::Arena> constant_arena;
+  if (constant_folding_) {
+    constant_arena = absl::make_unique<google::protobuf::Arena>();
+  }
 
   FlatExprVisitor visitor(this->GetRegistry(), &execution_path,
-                          shortcircuiting_, resolvable_enums());
+                          shortcircuiting_, fused_comprehensions_,
+                          fused_selects_, resolvable_enums(),
+                          constant_arena.get(), reference_map, type_map,
+                          variable_types_,
+                          executor_ != nullptr ? parallel_min_range_size_ : 0);
 
   AstTraverse(expr, source_info, &visitor);
 
@@ -598,8 +1691,24 @@ FlatExprBuilder::CreateExpression(const Expr* expr,
     return visitor.progress_status();
   }
 
-  std::unique_ptr<CelExpression> expression_impl =
-      absl::make_unique<CelExpressionFlatImpl>(expr, std::move(execution_path));
+  std::unique_ptr<const google::protobuf::FieldMask> referenced_paths;
+  if (referenced_paths_) {
+    referenced_paths =
+        absl::make_unique<google::protobuf::FieldMask>(FindReferencedPaths(*expr));
+  }
+
+  std::unique_ptr<CelExpression> expression_impl;
+  if (instruction_engine_) {
+    expression_impl = absl::make_unique<CelExpressionInstructionImpl>(
+        expr, std::move(execution_path), visitor.iter_var_slots(),
+        visitor.variable_slots(), visitor.max_stack_depth(),
+        std::move(constant_arena), executor_, std::move(referenced_paths));
+  } else {
+    expression_impl = absl::make_unique<CelExpressionFlatImpl>(
+        expr, std::move(execution_path), visitor.iter_var_slots(),
+        visitor.variable_slots(), visitor.max_stack_depth(),
+        std::move(constant_arena), executor_, std::move(referenced_paths));
+  }
 
   return std::move(expression_impl);
 }
@@ -1,6 +1,11 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_COMPILER_FLAT_EXPR_BUILDER_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_COMPILER_FLAT_EXPR_BUILDER_H_
 
+#include <map>
+#include <string>
+
+#include "google/protobuf/descriptor.h"
+#include "eval/public/cel_executor.h"
 #include "eval/public/cel_expression.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 
@@ -13,18 +18,125 @@ namespace runtime {
 // Builds instances of CelExpressionFlatImpl.
 class FlatExprBuilder : public CelExpressionBuilder {
  public:
-  FlatExprBuilder() : shortcircuiting_(true) {}
+  FlatExprBuilder()
+      : shortcircuiting_(true),
+        instruction_engine_(false),
+        constant_folding_(true),
+        fused_comprehensions_(true),
+        fused_selects_(true),
+        referenced_paths_(false),
+        executor_(nullptr),
+        parallel_min_range_size_(0) {}
 
   // set_shortcircuiting regulates shortcircuiting of some expressions.
   // Be default shortcircuiting is enabled.
   void set_shortcircuiting(bool enabled) { shortcircuiting_ = enabled; }
 
+  // set_constant_folding regulates evaluation of subexpressions over
+  // constants at build time, e.g. 60 * 60 * 24 or duration("1h"). Only
+  // calls to builtin functions are folded, and only if all the overloads
+  // registered under their names are pure (see
+  // CelFunctionRegistry::set_register_pure).
+  // Folded subexpressions are evaluated once, so CelExpression::Trace
+  // reports them as single nodes with their values, without their
+  // subexpressions. Disable folding to trace every node.
+  // By default constant folding is enabled.
+  void set_constant_folding(bool enabled) { constant_folding_ = enabled; }
+
+  // set_fused_comprehensions regulates fusion of steps of comprehensions
+  // expanded from macros. The lists built by map and filter are appended to
+  // in place, without evaluating the list of elements of the loop step.
+  // all, exists and exists_one are evaluated by loop steps folding the
+  // predicate into the accumulator, without evaluating the other parts of
+  // the comprehension.
+  // CelExpression::Trace reports the accumulated lists as copies made when
+  // they are traced, and doesn't report the lists of elements. Of fused
+  // quantifiers, only iter_range, the predicate and the comprehension are
+  // reported: accu_init, loop_condition, loop_step, result and the
+  // accumulator identifiers are not. Disable fusion to trace every node.
+  // Parallel comprehensions require fusion.
+  // By default fusion is enabled.
+  void set_fused_comprehensions(bool enabled) {
+    fused_comprehensions_ = enabled;
+  }
+
+  // set_fused_selects regulates evaluation of chains of selects of messages
+  // of types unknown at build time, e.g. a.b.c, by single steps.
+  // CelExpression::Trace reports only the outermost select of fused chains,
+  // not the intermediate ones (a.b). Disable fusion to trace every node.
+  // By default fusion is enabled.
+  void set_fused_selects(bool enabled) { fused_selects_ = enabled; }
+
+  // set_referenced_paths makes the builder find the paths of the variables
+  // and fields referenced by the expressions built, returned by
+  // CelExpression::referenced_paths() (see FindReferencedPaths()).
+  // By default the paths are not found, and referenced_paths() is null.
+  void set_referenced_paths(bool enabled) { referenced_paths_ = enabled; }
+
+  // set_instruction_engine makes the builder create expressions evaluated
+  // by the experimental instruction engine (CelExpressionInstructionImpl).
+  // It saves the dispatch of the steps only: expressions dominated by
+  // function calls or selects, e.g. BM_Eval and BM_SelectSum in
+  // eval/tests/benchmark_test.cc, run at most about 1.6 times faster.
+  // Parallel comprehensions run their chunks through ExpressionStep::Evaluate
+  // with either engine.
+  // By default the engine is disabled.
+  void set_instruction_engine(bool enabled) { instruction_engine_ = enabled; }
+
+  // set_parallel_comprehensions enables evaluation of comprehensions over
+  // lists of at least min_range_size elements in parallel chunks, run on the
+  // executor. The executor must outlive the expressions built.
+  // Only comprehensions expanded from all, exists, exists_one, map and filter
+  // macros are evaluated in parallel, if their bodies call builtin functions
+  // only, and all the overloads registered under their names are pure (see
+  // CelFunctionRegistry::set_register_pure).
+  // By default parallel evaluation is disabled.
+  void set_parallel_comprehensions(CelExecutor* executor, int min_range_size) {
+    executor_ = executor;
+    parallel_min_range_size_ = min_range_size;
+  }
+
+  // DeclareVariableType declares the message type of the free variable.
+  // Selects of fields of the variable and of its singular submessages are
+  // compiled into steps reading the fields of that type directly, as are
+  // selects from values of message types inferred by the checker. Values of
+  // other types bound to the variable are still supported by the generic
+  // field access. Only types of the generated pool are supported.
+  void DeclareVariableType(const std::string& name,
+                           const google::protobuf::Descriptor* descriptor) {
+    variable_types_[name] = descriptor;
+  }
+
   util::StatusOr<std::unique_ptr<CelExpression>> CreateExpression(
       const google::api::expr::v1alpha1::Expr* expr,
       const google::api::expr::v1alpha1::SourceInfo* source_info) const override;
 
+  // Resolves each call to a single overload at build time where argument
+  // types inferred by the checker allow it.
+  util::StatusOr<std::unique_ptr<CelExpression>> CreateExpression(
+      const google::api::expr::v1alpha1::CheckedExpr* checked_expr)
+      const override;
+
  private:
+  // Builds the expression. reference_map and type_map come from the checked
+  // expression and are null for unchecked one.
+  util::StatusOr<std::unique_ptr<CelExpression>> CreateExpressionImpl(
+      const google::api::expr::v1alpha1::Expr* expr,
+      const google::api::expr::v1alpha1::SourceInfo* source_info,
+      const google::protobuf::Map<int64_t, google::api::expr::v1alpha1::Reference>*
+          reference_map,
+      const google::protobuf::Map<int64_t, google::api::expr::v1alpha1::Type>*
+          type_map) const;
+
   bool shortcircuiting_;
+  bool instruction_engine_;
+  bool constant_folding_;
+  bool fused_comprehensions_;
+  bool fused_selects_;
+  bool referenced_paths_;
+  CelExecutor* executor_;
+  int parallel_min_range_size_;
+  std::map<std::string, const google::protobuf::Descriptor*> variable_types_;
 };
 
 }  // namespace runtime
@@ -1,13 +1,30 @@
 #include "eval/compiler/flat_expr_builder.h"
 
+#include <set>
+#include <thread>
+
+#include "google/api/expr/v1alpha1/checked.pb.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
+#include "google/protobuf/dynamic_message.h"
 #include "google/protobuf/field_mask.pb.h"
 #include "google/protobuf/text_format.h"
+#include "google/protobuf/util/field_mask_util.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/container_backed_map_impl.h"
+#include "eval/eval/evaluator_core.h"
 #include "eval/proto/cel_error.pb.h"
+#include "eval/public/activation_bind_helper.h"
 #include "eval/public/builtin_func_registrar.h"
+#include "eval/public/cel_builtins.h"
+#include "eval/public/referenced_paths.h"
+#include "eval/public/regex_match.h"
 #include "eval/testutil/test_message.pb.h"
 namespace google {
 namespace api {
@@ -16,6 +33,7 @@ namespace runtime {
 
 namespace {
 
+using google::api::expr::v1alpha1::CheckedExpr;
 using google::api::expr::v1alpha1::Expr;
 using google::api::expr::v1alpha1::SourceInfo;
 
@@ -281,6 +299,68 @@ TEST(FlatExprBuilderTest, MapComprehension) {
   EXPECT_TRUE(result.BoolOrDie());
 }
 
+TEST(FlatExprBuilderTest, MessageMapComprehension) {
+  Expr expr;
+  // message.string_int32_map.all(k, k != key)
+  google::protobuf::TextFormat::ParseFromString(R"(
+    comprehension_expr {
+      iter_var: "k"
+      accu_var: "accu"
+      accu_init {
+        const_expr { bool_value: true }
+      }
+      loop_condition { ident_expr { name: "accu" } }
+      result { ident_expr { name: "accu" } }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args {
+            ident_expr { name: "accu" }
+          }
+          args {
+            call_expr {
+              function: "_!=_"
+              args { ident_expr { name: "k" } }
+              args { ident_expr { name: "key" } }
+            }
+          }
+        }
+      }
+      iter_range {
+        select_expr {
+          operand { ident_expr { name: "message" } }
+          field: "string_int32_map"
+        }
+      }
+    })",
+                                      &expr);
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  TestMessage message;
+  for (int i = 0; i < 10; i++) {
+    (*message.mutable_string_int32_map())[absl::StrCat("key", i)] = i;
+  }
+  google::protobuf::Arena arena;
+  for (const std::string key : {"key3", "key10"}) {
+    Activation activation;
+    activation.InsertValue("message",
+                           CelValue::CreateMessage(&message, &arena));
+    activation.InsertValue("key", CelValue::CreateString(&key));
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    CelValue result = result_or.ValueOrDie();
+    ASSERT_TRUE(result.IsBool());
+    EXPECT_THAT(result.BoolOrDie(), Eq(key == "key10")) << key;
+  }
+}
+
 TEST(FlatExprBuilderTest, ComprehensionWorksForError) {
   Expr expr;
   // {}[0].all(x, x) should evaluate OK but return an error value
@@ -443,98 +523,2153 @@ TEST(FlatExprBuilderTest, ComprehensionWorksForNonContainer) {
   EXPECT_THAT(result.ErrorOrDie()->message(), Eq("no_matching_overload"));
 }
 
-TEST(FlatExprBuilderTest, UnknownSupportTest) {
-  TestMessage message;
-
+TEST(FlatExprBuilderTest, NestedComprehensionShadowsIterVar) {
   Expr expr;
-  SourceInfo source_info;
-
-  auto select_expr = expr.mutable_select_expr();
-  select_expr->set_field("int32_value");
-
-  auto operand1 = select_expr->mutable_operand();
-  auto select_expr1 = operand1->mutable_select_expr();
-
-  select_expr1->set_field("message_value");
-  auto operand2 = select_expr1->mutable_operand();
-
-  operand2->mutable_ident_expr()->set_name("message");
+  // [1, 2].all(x, [3].exists(x, x == 3) && x < 3)
+  // Inner comprehension shadows both iter_var and accu_var of the outer one.
+  google::protobuf::TextFormat::ParseFromString(R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        list_expr {
+          elements { const_expr { int64_value: 1 } }
+          elements { const_expr { int64_value: 2 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: true } }
+      loop_condition { ident_expr { name: "__result__" } }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_&&_"
+              args {
+                comprehension_expr {
+                  iter_var: "x"
+                  iter_range {
+                    list_expr {
+                      elements { const_expr { int64_value: 3 } }
+                    }
+                  }
+                  accu_var: "__result__"
+                  accu_init { const_expr { bool_value: false } }
+                  loop_condition { const_expr { bool_value: true } }
+                  loop_step {
+                    call_expr {
+                      function: "_||_"
+                      args { ident_expr { name: "__result__" } }
+                      args {
+                        call_expr {
+                          function: "_==_"
+                          args { ident_expr { name: "x" } }
+                          args { const_expr { int64_value: 3 } }
+                        }
+                      }
+                    }
+                  }
+                  result { ident_expr { name: "__result__" } }
+                }
+              }
+              args {
+                call_expr {
+                  function: "_<_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 3 } }
+                }
+              }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })",
+                                      &expr);
 
   FlatExprBuilder builder;
-
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
   auto build_status = builder.CreateExpression(&expr, &source_info);
   ASSERT_TRUE(util::IsOk(build_status));
 
   auto cel_expr = std::move(build_status.ValueOrDie());
 
-  message.mutable_message_value()->set_int32_value(1);
-
-  google::protobuf::Arena arena;
   Activation activation;
-  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
-
-  auto eval_status = cel_expr->Evaluate(activation, &arena);
-
-  ASSERT_TRUE(util::IsOk(eval_status));
-  CelValue result = eval_status.ValueOrDie();
-
-  ASSERT_TRUE(result.IsInt64());
-  EXPECT_THAT(result.Int64OrDie(), Eq(1));
-
-  FieldMask mask;
-  mask.add_paths("message.message_value.int32_value");
-  activation.set_unknown_paths(mask);
-  eval_status = cel_expr->Evaluate(activation, &arena);
-  ASSERT_TRUE(util::IsOk(eval_status));
-  result = eval_status.ValueOrDie();
-  ASSERT_TRUE(result.IsError());
-
-  mask.clear_paths();
-  mask.add_paths("message.message_value");
-  activation.set_unknown_paths(mask);
-  eval_status = cel_expr->Evaluate(activation, &arena);
-  ASSERT_TRUE(util::IsOk(eval_status));
-  result = eval_status.ValueOrDie();
-  ASSERT_TRUE(result.IsError());
+  google::protobuf::Arena arena;
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  CelValue result = result_or.ValueOrDie();
+  ASSERT_TRUE(result.IsBool());
+  EXPECT_TRUE(result.BoolOrDie());
 }
 
-TEST(FlatExprBuilderTest, SimpleEnumTest) {
-  TestMessage message;
-
+// Builds and evaluates the expression, the result is allocated on the arena.
+CelValue BuildAndEvaluate(const std::string& expr_text, bool shortcircuiting,
+                          google::protobuf::Arena* arena) {
   Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+  FlatExprBuilder builder;
+  builder.set_shortcircuiting(shortcircuiting);
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
   SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(build_status));
 
-  constexpr char enum_name[] =
-      "google.api.expr.runtime.TestMessage.TestEnum.TEST_ENUM_1";
+  Activation activation;
+  auto result_or = build_status.ValueOrDie()->Evaluate(activation, arena);
+  GOOGLE_CHECK(util::IsOk(result_or));
+  return result_or.ValueOrDie();
+}
 
-  std::vector<std::string> enum_name_parts = absl::StrSplit(enum_name, '.');
-  Expr* cur_expr = &expr;
+std::vector<int64_t> ToInt64Vector(const CelList* list) {
+  std::vector<int64_t> values;
+  for (int i = 0; i < list->size(); i++) {
+    values.push_back((*list)[i].Int64OrDie());
+  }
+  return values;
+}
 
-  for (int i = enum_name_parts.size() - 1; i > 0; i--) {
-    auto select_expr = cur_expr->mutable_select_expr();
-    select_expr->set_field(enum_name_parts[i]);
-    cur_expr = select_expr->mutable_operand();
+TEST(FlatExprBuilderTest, ListAccumulatorComprehension) {
+  // [1, 2].map(x, [10, 20].map(y, x * y))
+  // Inner accumulator is created anew on each iteration of the outer one.
+  const std::string expr_text = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        list_expr {
+          elements { const_expr { int64_value: 1 } }
+          elements { const_expr { int64_value: 2 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_+_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            list_expr {
+              elements {
+                comprehension_expr {
+                  iter_var: "y"
+                  iter_range {
+                    list_expr {
+                      elements { const_expr { int64_value: 10 } }
+                      elements { const_expr { int64_value: 20 } }
+                    }
+                  }
+                  accu_var: "__result__"
+                  accu_init { list_expr {} }
+                  loop_condition { const_expr { bool_value: true } }
+                  loop_step {
+                    call_expr {
+                      function: "_+_"
+                      args { ident_expr { name: "__result__" } }
+                      args {
+                        list_expr {
+                          elements {
+                            call_expr {
+                              function: "_*_"
+                              args { ident_expr { name: "x" } }
+                              args { ident_expr { name: "y" } }
+                            }
+                          }
+                        }
+                      }
+                    }
+                  }
+                  result { ident_expr { name: "__result__" } }
+                }
+              }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+  for (bool shortcircuiting : {true, false}) {
+    google::protobuf::Arena arena;
+    CelValue result = BuildAndEvaluate(expr_text, shortcircuiting, &arena);
+    ASSERT_TRUE(result.IsList());
+    const CelList* list = result.ListOrDie();
+    ASSERT_THAT(list->size(), Eq(2));
+    EXPECT_THAT(ToInt64Vector((*list)[0].ListOrDie()),
+                testing::ElementsAre(10, 20));
+    EXPECT_THAT(ToInt64Vector((*list)[1].ListOrDie()),
+                testing::ElementsAre(20, 40));
   }
+}
 
-  cur_expr->mutable_ident_expr()->set_name(enum_name_parts[0]);
+TEST(FlatExprBuilderTest, ListAccumulatorFilter) {
+  // [1, 2, 3, 4].filter(x, x % 2 == 0)
+  const std::string expr_text = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        list_expr {
+          elements { const_expr { int64_value: 1 } }
+          elements { const_expr { int64_value: 2 } }
+          elements { const_expr { int64_value: 3 } }
+          elements { const_expr { int64_value: 4 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_?_:_"
+          args {
+            call_expr {
+              function: "_==_"
+              args {
+                call_expr {
+                  function: "_%_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 2 } }
+                }
+              }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args { list_expr { elements { ident_expr { name: "x" } } } }
+            }
+          }
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+  for (bool shortcircuiting : {true, false}) {
+    google::protobuf::Arena arena;
+    CelValue result = BuildAndEvaluate(expr_text, shortcircuiting, &arena);
+    ASSERT_TRUE(result.IsList());
+    EXPECT_THAT(ToInt64Vector(result.ListOrDie()), testing::ElementsAre(2, 4));
+  }
+}
 
-  FlatExprBuilder builder;
-  builder.addResolvableEnum(TestMessage::TestEnum_descriptor());
+TEST(FlatExprBuilderTest, ListAccumulatorPropagatesError) {
+  // [1, 0, 2].filter(x, 2 / x == 1)
+  const std::string expr_text = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        list_expr {
+          elements { const_expr { int64_value: 1 } }
+          elements { const_expr { int64_value: 0 } }
+          elements { const_expr { int64_value: 2 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_?_:_"
+          args {
+            call_expr {
+              function: "_==_"
+              args {
+                call_expr {
+                  function: "_/_"
+                  args { const_expr { int64_value: 2 } }
+                  args { ident_expr { name: "x" } }
+                }
+              }
+              args { const_expr { int64_value: 1 } }
+            }
+          }
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args { list_expr { elements { ident_expr { name: "x" } } } }
+            }
+          }
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
 
-  auto build_status = builder.CreateExpression(&expr, &source_info);
-  ASSERT_TRUE(util::IsOk(build_status));
+  for (bool shortcircuiting : {true, false}) {
+    google::protobuf::Arena arena;
+    CelValue result = BuildAndEvaluate(expr_text, shortcircuiting, &arena);
+    EXPECT_TRUE(result.IsError());
+  }
+}
 
-  auto cel_expr = std::move(build_status.ValueOrDie());
+TEST(FlatExprBuilderTest, ListAccumulatorTrace) {
+  // [1, 2].map(x, x)
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    id: 1
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        id: 2
+        list_expr {
+          elements { id: 3 const_expr { int64_value: 1 } }
+          elements { id: 4 const_expr { int64_value: 2 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { id: 5 list_expr {} }
+      loop_condition { id: 6 const_expr { bool_value: true } }
+      loop_step {
+        id: 7
+        call_expr {
+          function: "_+_"
+          args { id: 8 ident_expr { name: "__result__" } }
+          args {
+            id: 9
+            list_expr { elements { id: 10 ident_expr { name: "x" } } }
+          }
+        }
+      }
+      result { id: 11 ident_expr { name: "__result__" } }
+    })", &expr));
+
+  for (bool fused_comprehensions : {true, false}) {
+    SCOPED_TRACE(fused_comprehensions);
+    FlatExprBuilder builder;
+    builder.set_fused_comprehensions(fused_comprehensions);
+    ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+    SourceInfo source_info;
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    ASSERT_TRUE(util::IsOk(build_status));
+    auto cel_expr = std::move(build_status.ValueOrDie());
+
+    // Traced values are checked after the evaluation.
+    std::vector<std::pair<int64_t, CelValue>> traced;
+    google::protobuf::Arena arena;
+    Activation activation;
+    auto result_or = cel_expr->Trace(
+        activation, &arena,
+        [&traced](const Expr* expr, const CelValue& value,
+                  google::protobuf::Arena*) {
+          traced.emplace_back(expr->id(), value);
+          return util::OkStatus();
+        });
+    ASSERT_TRUE(util::IsOk(result_or));
+    EXPECT_THAT(ToInt64Vector(result_or.ValueOrDie().ListOrDie()),
+                testing::ElementsAre(1, 2));
+
+    std::vector<std::pair<int64_t, int>> list_sizes;
+    for (const auto& node : traced) {
+      if (node.second.IsList()) {
+        list_sizes.emplace_back(node.first, node.second.ListOrDie()->size());
+      }
+    }
+    if (fused_comprehensions) {
+      // The lists of elements are not evaluated.
+      EXPECT_THAT(list_sizes,
+                  testing::ElementsAre(testing::Pair(2, 2), testing::Pair(5, 0),
+                                       testing::Pair(8, 0), testing::Pair(7, 1),
+                                       testing::Pair(8, 1), testing::Pair(7, 2),
+                                       testing::Pair(11, 2), testing::Pair(1, 2)));
+    } else {
+      EXPECT_THAT(list_sizes,
+                  testing::ElementsAre(testing::Pair(2, 2), testing::Pair(5, 0),
+                                       testing::Pair(8, 0), testing::Pair(9, 1),
+                                       testing::Pair(7, 1), testing::Pair(8, 1),
+                                       testing::Pair(9, 1), testing::Pair(7, 2),
+                                       testing::Pair(11, 2), testing::Pair(1, 2)));
+    }
+  }
+}
+
+TEST(FlatExprBuilderTest, AccumulatorReferencedInElements) {
+  // Accumulator is read by the loop step, so it is not built in place.
+  // [5, 6, 7] accumulated as __result__ + [size(__result__)]
+  const std::string expr_text = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range {
+        list_expr {
+          elements { const_expr { int64_value: 5 } }
+          elements { const_expr { int64_value: 6 } }
+          elements { const_expr { int64_value: 7 } }
+        }
+      }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_+_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            list_expr {
+              elements {
+                call_expr {
+                  function: "size"
+                  args { ident_expr { name: "__result__" } }
+                }
+              }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
 
   google::protobuf::Arena arena;
-  Activation activation;
-  auto eval_status = cel_expr->Evaluate(activation, &arena);
+  CelValue result = BuildAndEvaluate(expr_text, true, &arena);
+  ASSERT_TRUE(result.IsList());
+  EXPECT_THAT(ToInt64Vector(result.ListOrDie()), testing::ElementsAre(0, 1, 2));
+}
 
-  ASSERT_TRUE(util::IsOk(eval_status));
-  CelValue result = eval_status.ValueOrDie();
+// Macro expansions of quantifiers, with $0 standing for the iteration range
+// and $1 for the predicate over x.
+constexpr char kAllMacro[] = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { $0 }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: true } }
+      loop_condition {
+        call_expr {
+          function: "@not_strictly_false"
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args { ident_expr { name: "__result__" } }
+          args { $1 }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
 
-  ASSERT_TRUE(result.IsInt64());
-  EXPECT_THAT(result.Int64OrDie(), Eq(TestMessage::TEST_ENUM_1));
+constexpr char kExistsMacro[] = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { $0 }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: false } }
+      loop_condition {
+        call_expr {
+          function: "@not_strictly_false"
+          args {
+            call_expr {
+              function: "!_"
+              args { ident_expr { name: "__result__" } }
+            }
+          }
+        }
+      }
+      loop_step {
+        call_expr {
+          function: "_||_"
+          args { ident_expr { name: "__result__" } }
+          args { $1 }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+constexpr char kExistsOneMacro[] = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { $0 }
+      accu_var: "__result__"
+      accu_init { const_expr { int64_value: 0 } }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_?_:_"
+          args { $1 }
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args { const_expr { int64_value: 1 } }
+            }
+          }
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      result {
+        call_expr {
+          function: "_==_"
+          args { ident_expr { name: "__result__" } }
+          args { const_expr { int64_value: 1 } }
+        }
+      }
+    })";
+
+// Quantifiers are evaluated by fused loop steps with shortcircuiting, and
+// by generic comprehension steps without it. Results must be the same.
+TEST(FlatExprBuilderTest, QuantifierComprehension) {
+  const std::vector<std::string> ranges = {
+      "list_expr {}",
+      R"(list_expr {
+        elements { const_expr { int64_value: 1 } }
+        elements { const_expr { int64_value: 2 } }
+      })",
+      R"(list_expr {
+        elements { const_expr { int64_value: 2 } }
+        elements { const_expr { int64_value: 0 } }
+        elements { const_expr { int64_value: 1 } }
+      })",
+      R"(list_expr {
+        elements { const_expr { int64_value: 0 } }
+        elements { const_expr { int64_value: 4 } }
+      })",
+      R"(struct_expr {
+        entries {
+          map_key { const_expr { int64_value: 1 } }
+          value { const_expr { string_value: "" } }
+        }
+      })",
+      "const_expr { int64_value: 1 }",
+  };
+  // 2 / x == 1, an error for x == 0.
+  const std::string predicate = R"(
+      call_expr {
+        function: "_==_"
+        args {
+          call_expr {
+            function: "_/_"
+            args { const_expr { int64_value: 2 } }
+            args { ident_expr { name: "x" } }
+          }
+        }
+        args { const_expr { int64_value: 1 } }
+      })";
+
+  for (const char* macro : {kAllMacro, kExistsMacro, kExistsOneMacro}) {
+    for (const auto& range : ranges) {
+      std::string expr_text = absl::Substitute(macro, range, predicate);
+      SCOPED_TRACE(expr_text);
+
+      google::protobuf::Arena arena;
+      CelValue expected = BuildAndEvaluate(expr_text, false, &arena);
+      CelValue actual = BuildAndEvaluate(expr_text, true, &arena);
+      ASSERT_THAT(actual.type(), Eq(expected.type()));
+      if (expected.IsBool()) {
+        EXPECT_THAT(actual.BoolOrDie(), Eq(expected.BoolOrDie()));
+      } else {
+        ASSERT_TRUE(expected.IsError());
+        EXPECT_THAT(actual.ErrorOrDie()->message(),
+                    Eq(expected.ErrorOrDie()->message()));
+      }
+    }
+  }
+}
+
+constexpr char kMapMacro[] = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { $0 }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_+_"
+          args { ident_expr { name: "__result__" } }
+          args { list_expr { elements { $1 } } }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+constexpr char kFilterMacro[] = R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { $0 }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_?_:_"
+          args { $1 }
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args { list_expr { elements { ident_expr { name: "x" } } } }
+            }
+          }
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+// Runs each task on its own thread.
+class ThreadExecutor : public CelExecutor {
+ public:
+  ~ThreadExecutor() override {
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void Schedule(std::function<void()> task) override {
+    absl::MutexLock lock(&mutex_);
+    threads_.emplace_back(std::move(task));
+  }
+
+  int concurrency() const override { return 4; }
+
+ private:
+  absl::Mutex mutex_;
+  std::vector<std::thread> threads_;
+};
+
+// Evaluates the expression with range bound to the list, in parallel if the
+// executor is not null.
+CelValue EvaluateOverRange(const std::string& expr_text,
+                           const std::vector<CelValue>& values,
+                           CelExecutor* executor, google::protobuf::Arena* arena) {
+  Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+  FlatExprBuilder builder;
+  if (executor != nullptr) {
+    builder.set_parallel_comprehensions(executor, 2);
+  }
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(build_status));
+
+  ContainerBackedListImpl range(values);
+  Activation activation;
+  activation.InsertValue("range", CelValue::CreateList(&range));
+  auto result_or = build_status.ValueOrDie()->Evaluate(activation, arena);
+  if (!util::IsOk(result_or)) {
+    return CreateErrorValue(arena, result_or.status().message());
+  }
+  return result_or.ValueOrDie();
+}
+
+void ExpectSameValue(const CelValue& expected, const CelValue& actual) {
+  ASSERT_THAT(actual.type(), Eq(expected.type()));
+  switch (expected.type()) {
+    case CelValue::Type::kBool:
+      EXPECT_THAT(actual.BoolOrDie(), Eq(expected.BoolOrDie()));
+      break;
+    case CelValue::Type::kInt64:
+      EXPECT_THAT(actual.Int64OrDie(), Eq(expected.Int64OrDie()));
+      break;
+    case CelValue::Type::kList: {
+      const CelList* expected_list = expected.ListOrDie();
+      const CelList* actual_list = actual.ListOrDie();
+      ASSERT_THAT(actual_list->size(), Eq(expected_list->size()));
+      for (int i = 0; i < expected_list->size(); i++) {
+        ExpectSameValue((*expected_list)[i], (*actual_list)[i]);
+      }
+      break;
+    }
+    case CelValue::Type::kError:
+      EXPECT_THAT(actual.ErrorOrDie()->message(),
+                  Eq(expected.ErrorOrDie()->message()));
+      break;
+    default:
+      FAIL() << "Unexpected result type";
+  }
+}
+
+// Comprehensions are evaluated in parallel chunks with the executor, results
+// and errors must be the same as of the sequential evaluation.
+TEST(FlatExprBuilderTest, ParallelComprehension) {
+  std::vector<std::vector<CelValue>> ranges;
+  // Without errors, with errors of the predicate at various positions.
+  for (int64_t zero_index : {-1, 0, 7, 30, 63}) {
+    std::vector<CelValue> values;
+    for (int64_t i = 0; i < 64; i++) {
+      values.push_back(CelValue::CreateInt64(i == zero_index ? 0 : i % 3 + 1));
+    }
+    ranges.push_back(values);
+  }
+  // Several errors, and a single match of the predicate.
+  std::vector<CelValue> values(64, CelValue::CreateInt64(1));
+  values[5] = CelValue::CreateInt64(0);
+  values[50] = CelValue::CreateBool(true);
+  ranges.push_back(values);
+  values[20] = CelValue::CreateInt64(2);
+  ranges.push_back(values);
+  values.assign(64, CelValue::CreateInt64(1));
+  values[33] = CelValue::CreateInt64(2);
+  ranges.push_back(values);
+  // Too short to be evaluated in parallel.
+  ranges.push_back({CelValue::CreateInt64(2)});
+
+  // Predicates: 2 / x == 1, which fails for 0 and for non-int values, and
+  // x == 2 || x, which is not a bool for most ints.
+  const std::vector<std::string> predicates = {
+      R"(call_expr {
+        function: "_==_"
+        args {
+          call_expr {
+            function: "_/_"
+            args { const_expr { int64_value: 2 } }
+            args { ident_expr { name: "x" } }
+          }
+        }
+        args { const_expr { int64_value: 1 } }
+      })",
+      R"(call_expr {
+        function: "_?_:_"
+        args {
+          call_expr {
+            function: "_==_"
+            args { ident_expr { name: "x" } }
+            args { const_expr { int64_value: 2 } }
+          }
+        }
+        args { const_expr { bool_value: true } }
+        args { ident_expr { name: "x" } }
+      })",
+  };
+
+  ThreadExecutor executor;
+  for (const char* macro :
+       {kAllMacro, kExistsMacro, kExistsOneMacro, kMapMacro, kFilterMacro}) {
+    for (const auto& predicate : predicates) {
+      std::string expr_text = absl::Substitute(
+          macro, R"(ident_expr { name: "range" })", predicate);
+      SCOPED_TRACE(expr_text);
+      for (size_t i = 0; i < ranges.size(); i++) {
+        SCOPED_TRACE(i);
+        google::protobuf::Arena arena;
+        CelValue expected =
+            EvaluateOverRange(expr_text, ranges[i], nullptr, &arena);
+        CelValue actual =
+            EvaluateOverRange(expr_text, ranges[i], &executor, &arena);
+        ExpectSameValue(expected, actual);
+      }
+    }
+  }
+}
+
+// Adds bools, recording the threads it is called on.
+class ThreadRecordingAddFunction : public CelFunction {
+ public:
+  ThreadRecordingAddFunction(absl::Mutex* mutex,
+                             std::set<std::thread::id>* threads)
+      : CelFunction(Descriptor{builtin::kAdd,
+                               false,
+                               {CelValue::Type::kBool, CelValue::Type::kBool}}),
+        mutex_(mutex),
+        threads_(threads) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    absl::MutexLock lock(mutex_);
+    threads_->insert(std::this_thread::get_id());
+    *result = CelValue::CreateInt64(args[0].BoolOrDie() + args[1].BoolOrDie());
+    return util::OkStatus();
+  }
+
+ private:
+  absl::Mutex* mutex_;
+  std::set<std::thread::id>* threads_;
+};
+
+// Functions not registered as pure are never called concurrently, even if
+// they are registered under the names of builtin functions.
+TEST(FlatExprBuilderTest, ParallelComprehensionSkipsOverloadedBuiltins) {
+  // range.all(x, x + x == 2)
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      absl::Substitute(kAllMacro, R"(ident_expr { name: "range" })", R"(
+        call_expr {
+          function: "_==_"
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "x" } }
+              args { ident_expr { name: "x" } }
+            }
+          }
+          args { const_expr { int64_value: 2 } }
+        })"),
+      &expr));
+
+  absl::Mutex mutex;
+  std::set<std::thread::id> threads;
+  ThreadExecutor executor;
+  FlatExprBuilder builder;
+  builder.set_parallel_comprehensions(&executor, 2);
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<ThreadRecordingAddFunction>(&mutex, &threads))));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  std::vector<CelValue> values(64, CelValue::CreateBool(true));
+  ContainerBackedListImpl range(values);
+  Activation activation;
+  activation.InsertValue("range", CelValue::CreateList(&range));
+  google::protobuf::Arena arena;
+  auto result_or = build_status.ValueOrDie()->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  EXPECT_TRUE(result_or.ValueOrDie().BoolOrDie());
+  EXPECT_THAT(threads, testing::ElementsAre(std::this_thread::get_id()));
+}
+
+TEST(FlatExprBuilderTest, IterVarOutOfScopeResolvesToActivation) {
+  Expr expr;
+  // [1].all(x, true) ? x : 0, with "x" bound in activation.
+  google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_?_:_"
+      args {
+        comprehension_expr {
+          iter_var: "x"
+          iter_range {
+            list_expr { elements { const_expr { int64_value: 1 } } }
+          }
+          accu_var: "__result__"
+          accu_init { const_expr { bool_value: true } }
+          loop_condition { const_expr { bool_value: true } }
+          loop_step { const_expr { bool_value: true } }
+          result { ident_expr { name: "__result__" } }
+        }
+      }
+      args { ident_expr { name: "x" } }
+      args { const_expr { int64_value: 0 } }
+    })",
+                                      &expr);
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  Activation activation;
+  activation.InsertValue("x", CelValue::CreateInt64(42));
+  google::protobuf::Arena arena;
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  CelValue result = result_or.ValueOrDie();
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(42));
+}
+
+TEST(FlatExprBuilderTest, VariableSlots) {
+  Expr expr;
+  // (a - <fold x over [1] with step x + b>) + (a + c).
+  // Comprehension variables do not get slots.
+  google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_+_"
+      args {
+        call_expr {
+          function: "_-_"
+          args { ident_expr { name: "a" } }
+          args {
+            comprehension_expr {
+              iter_var: "x"
+              iter_range {
+                list_expr { elements { const_expr { int64_value: 1 } } }
+              }
+              accu_var: "__result__"
+              accu_init { const_expr { int64_value: 0 } }
+              loop_condition { const_expr { bool_value: true } }
+              loop_step {
+                call_expr {
+                  function: "_+_"
+                  args { ident_expr { name: "x" } }
+                  args { ident_expr { name: "b" } }
+                }
+              }
+              result { ident_expr { name: "__result__" } }
+            }
+          }
+        }
+      }
+      args {
+        call_expr {
+          function: "_+_"
+          args { ident_expr { name: "a" } }
+          args { ident_expr { name: "c" } }
+        }
+      }
+    })",
+                                      &expr);
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  // Slots are assigned in order of first reference.
+  EXPECT_THAT(cel_expr->variable_slots(),
+              testing::ElementsAre("a", "b", "c"));
+
+  // (10 - (1 + 2)) + (10 + 3)
+  google::protobuf::Arena arena;
+  SlotActivation activation(&cel_expr->variable_slots());
+  activation.SetSlotValue(0, CelValue::CreateInt64(10));
+  activation.SetSlotValue(1, CelValue::CreateInt64(2));
+  // Slot "c" is not set; name-based binding is used as a fallback.
+  activation.InsertValue("c", CelValue::CreateInt64(3));
+
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  CelValue result = result_or.ValueOrDie();
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(20));
+
+  // Unknown paths mask values bound to slots.
+  FieldMask mask;
+  mask.add_paths("b");
+  activation.set_unknown_paths(mask);
+  result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsError());
+}
+
+TEST(FlatExprBuilderTest, SlotActivationOfOtherExpression) {
+  Expr expr1;
+  expr1.mutable_ident_expr()->set_name("a");
+  Expr expr2;
+  auto call = expr2.mutable_call_expr();
+  call->set_function("_+_");
+  call->add_args()->mutable_ident_expr()->set_name("b");
+  call->add_args()->mutable_ident_expr()->set_name("a");
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status1 = builder.CreateExpression(&expr1, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status1));
+  auto cel_expr1 = std::move(build_status1.ValueOrDie());
+  auto build_status2 = builder.CreateExpression(&expr2, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status2));
+  auto cel_expr2 = std::move(build_status2.ValueOrDie());
+
+  // Slot layouts of the expressions differ; activation created for the first
+  // one falls back to name lookup when used with the second one.
+  google::protobuf::Arena arena;
+  SlotActivation activation(&cel_expr1->variable_slots());
+  activation.SetSlotValue(0, CelValue::CreateInt64(1));
+  activation.InsertValue("b", CelValue::CreateInt64(2));
+
+  auto result_or = cel_expr2->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  CelValue result = result_or.ValueOrDie();
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(3));
+}
+
+TEST(FlatExprBuilderTest, SlotActivationPrecedence) {
+  Expr expr;
+  expr.mutable_ident_expr()->set_name("a");
+
+  FlatExprBuilder builder;
+  SourceInfo source_info;
+  auto build_status1 = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status1));
+  auto cel_expr1 = std::move(build_status1.ValueOrDie());
+  auto build_status2 = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status2));
+  auto cel_expr2 = std::move(build_status2.ValueOrDie());
+
+  // "a" has both bindings. The first expression resolves it by slot, the
+  // second one, with another slot layout, by name lookup; both use the value
+  // bound to the slot.
+  google::protobuf::Arena arena;
+  SlotActivation activation(&cel_expr1->variable_slots());
+  activation.SetSlotValue(0, CelValue::CreateInt64(1));
+  activation.InsertValue("a", CelValue::CreateInt64(2));
+
+  for (const auto* cel_expr : {cel_expr1.get(), cel_expr2.get()}) {
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    CelValue result = result_or.ValueOrDie();
+    ASSERT_TRUE(result.IsInt64());
+    EXPECT_THAT(result.Int64OrDie(), Eq(1));
+  }
+
+  // Name-based binding is used while the slot is not bound.
+  activation.ClearSlotValue(0);
+  for (const auto* cel_expr : {cel_expr1.get(), cel_expr2.get()}) {
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    CelValue result = result_or.ValueOrDie();
+    ASSERT_TRUE(result.IsInt64());
+    EXPECT_THAT(result.Int64OrDie(), Eq(2));
+  }
+}
+
+TEST(FlatExprBuilderTest, MaxStackDepth) {
+  struct TestCase {
+    std::string expr_text;
+    bool shortcircuiting;
+    int max_stack_depth;
+  };
+  std::vector<TestCase> test_cases = {
+      // 1 + 2 * 3
+      {R"(
+        call_expr {
+          function: "_+_"
+          args { const_expr { int64_value: 1 } }
+          args {
+            call_expr {
+              function: "_*_"
+              args { const_expr { int64_value: 2 } }
+              args { const_expr { int64_value: 3 } }
+            }
+          }
+        })",
+       true, 3},
+      // {"a": 1, "b": [2, 3]}
+      {R"(
+        struct_expr {
+          entries {
+            map_key { const_expr { string_value: "a" } }
+            value { const_expr { int64_value: 1 } }
+          }
+          entries {
+            map_key { const_expr { string_value: "b" } }
+            value {
+              list_expr {
+                elements { const_expr { int64_value: 2 } }
+                elements { const_expr { int64_value: 3 } }
+              }
+            }
+          }
+        })",
+       true, 5},
+      // true ? 1 : 2, branches are evaluated on the same stack position
+      // unless all arguments are evaluated.
+      {R"(
+        call_expr {
+          function: "_?_:_"
+          args { const_expr { bool_value: true } }
+          args { const_expr { int64_value: 1 } }
+          args { const_expr { int64_value: 2 } }
+        })",
+       true, 1},
+      {R"(
+        call_expr {
+          function: "_?_:_"
+          args { const_expr { bool_value: true } }
+          args { const_expr { int64_value: 1 } }
+          args { const_expr { int64_value: 2 } }
+        })",
+       false, 3},
+      // 1 + [1].fold(x, 0, x + 2)
+      {R"(
+        call_expr {
+          function: "_+_"
+          args { const_expr { int64_value: 1 } }
+          args {
+            comprehension_expr {
+              iter_var: "x"
+              iter_range {
+                list_expr { elements { const_expr { int64_value: 1 } } }
+              }
+              accu_var: "__result__"
+              accu_init { const_expr { int64_value: 0 } }
+              loop_condition { const_expr { bool_value: true } }
+              loop_step {
+                call_expr {
+                  function: "_+_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 2 } }
+                }
+              }
+              result { ident_expr { name: "__result__" } }
+            }
+          }
+        })",
+       true, 7},
+  };
+
+  for (const auto& test_case : test_cases) {
+    SCOPED_TRACE(test_case.expr_text);
+    Expr expr;
+    ASSERT_TRUE(
+        google::protobuf::TextFormat::ParseFromString(test_case.expr_text, &expr));
+
+    FlatExprBuilder builder;
+    builder.set_shortcircuiting(test_case.shortcircuiting);
+    // Folded subexpressions are covered by MaxStackDepthOfFoldedExpression.
+    builder.set_constant_folding(false);
+    ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+    SourceInfo source_info;
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    ASSERT_TRUE(util::IsOk(build_status));
+    auto cel_expr = std::move(build_status.ValueOrDie());
+
+    auto flat_expr = dynamic_cast<const CelExpressionFlatImpl*>(cel_expr.get());
+    ASSERT_TRUE(flat_expr != nullptr);
+    EXPECT_THAT(flat_expr->max_stack_depth(), Eq(test_case.max_stack_depth));
+
+    // Evaluation fits into the stack of the computed depth.
+    google::protobuf::Arena arena;
+    Activation activation;
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    EXPECT_FALSE(result_or.ValueOrDie().IsError());
+  }
+}
+
+// Stack depth reached by arguments of folded calls is reclaimed.
+TEST(FlatExprBuilderTest, MaxStackDepthOfFoldedExpression) {
+  // x + size([1, 2, 3])
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_+_"
+      args { ident_expr { name: "x" } }
+      args {
+        call_expr {
+          function: "size"
+          args {
+            list_expr {
+              elements { const_expr { int64_value: 1 } }
+              elements { const_expr { int64_value: 2 } }
+              elements { const_expr { int64_value: 3 } }
+            }
+          }
+        }
+      }
+    })",
+                                                  &expr));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  auto flat_expr = dynamic_cast<const CelExpressionFlatImpl*>(cel_expr.get());
+  ASSERT_TRUE(flat_expr != nullptr);
+  EXPECT_THAT(flat_expr->max_stack_depth(), Eq(2));
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("x", CelValue::CreateInt64(1));
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  EXPECT_THAT(result_or.ValueOrDie().Int64OrDie(), Eq(4));
+}
+
+TEST(FlatExprBuilderTest, ConstantFolding) {
+  struct TestCase {
+    std::string expr_text;
+    // Number of AST nodes evaluated, as reported by Trace.
+    int traced_nodes;
+  };
+  std::vector<TestCase> test_cases = {
+      // 60 * 60 * 24
+      {R"(
+        call_expr {
+          function: "_*_"
+          args {
+            call_expr {
+              function: "_*_"
+              args { const_expr { int64_value: 60 } }
+              args { const_expr { int64_value: 60 } }
+            }
+          }
+          args { const_expr { int64_value: 24 } }
+        })",
+       1},
+      // size([1, 2, 3] + [4]) + x, only the variable part is evaluated.
+      {R"(
+        call_expr {
+          function: "_+_"
+          args {
+            call_expr {
+              function: "size"
+              args {
+                call_expr {
+                  function: "_+_"
+                  args {
+                    list_expr {
+                      elements { const_expr { int64_value: 1 } }
+                      elements { const_expr { int64_value: 2 } }
+                      elements { const_expr { int64_value: 3 } }
+                    }
+                  }
+                  args {
+                    list_expr { elements { const_expr { int64_value: 4 } } }
+                  }
+                }
+              }
+            }
+          }
+          args { ident_expr { name: "x" } }
+        })",
+       3},
+      // {"a": "b" + "c"}["a"]
+      {R"(
+        call_expr {
+          function: "_[_]"
+          args {
+            struct_expr {
+              entries {
+                map_key { const_expr { string_value: "a" } }
+                value {
+                  call_expr {
+                    function: "_+_"
+                    args { const_expr { string_value: "b" } }
+                    args { const_expr { string_value: "c" } }
+                  }
+                }
+              }
+            }
+          }
+          args { const_expr { string_value: "a" } }
+        })",
+       1},
+      // Errors are not folded: 1 / 0
+      {R"(
+        call_expr {
+          function: "_/_"
+          args { const_expr { int64_value: 1 } }
+          args { const_expr { int64_value: 0 } }
+        })",
+       3},
+      // Functions other than builtins are not folded.
+      {R"(
+        call_expr {
+          function: "concat"
+          args { const_expr { string_value: "a" } }
+          args { const_expr { string_value: "b" } }
+        })",
+       3},
+  };
+
+  for (const auto& test_case : test_cases) {
+    SCOPED_TRACE(test_case.expr_text);
+    Expr expr;
+    ASSERT_TRUE(
+        google::protobuf::TextFormat::ParseFromString(test_case.expr_text, &expr));
+
+    Activation activation;
+    activation.InsertValue("x", CelValue::CreateInt64(10));
+
+    std::vector<CelValue> results;
+    for (bool constant_folding : {false, true}) {
+      FlatExprBuilder builder;
+      builder.set_constant_folding(constant_folding);
+      ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+      ASSERT_TRUE(util::IsOk(
+          builder.GetRegistry()->Register(absl::make_unique<ConcatFunction>())));
+      SourceInfo source_info;
+      auto build_status = builder.CreateExpression(&expr, &source_info);
+      ASSERT_TRUE(util::IsOk(build_status));
+      auto cel_expr = std::move(build_status.ValueOrDie());
+
+      int traced_nodes = 0;
+      google::protobuf::Arena arena;
+      auto result_or = cel_expr->Trace(
+          activation, &arena,
+          [&traced_nodes](const Expr*, const CelValue&, google::protobuf::Arena*) {
+            traced_nodes++;
+            return util::OkStatus();
+          });
+      ASSERT_TRUE(util::IsOk(result_or));
+      if (constant_folding) {
+        EXPECT_THAT(traced_nodes, Eq(test_case.traced_nodes));
+      }
+      results.push_back(result_or.ValueOrDie());
+    }
+
+    // Folded expression evaluates to the same value.
+    ASSERT_THAT(results[1].type(), Eq(results[0].type()));
+    switch (results[0].type()) {
+      case CelValue::Type::kInt64:
+        EXPECT_THAT(results[1].Int64OrDie(), Eq(results[0].Int64OrDie()));
+        break;
+      case CelValue::Type::kString:
+        EXPECT_THAT(results[1].StringOrDie().value(),
+                    Eq(results[0].StringOrDie().value()));
+        break;
+      case CelValue::Type::kError:
+        EXPECT_THAT(results[1].ErrorOrDie()->message(),
+                    Eq(results[0].ErrorOrDie()->message()));
+        break;
+      default:
+        FAIL() << "Unexpected result type";
+    }
+  }
+}
+
+// Adds bools, counting the calls.
+class CountingAddFunction : public CelFunction {
+ public:
+  explicit CountingAddFunction(int* calls)
+      : CelFunction(Descriptor{builtin::kAdd,
+                               false,
+                               {CelValue::Type::kBool, CelValue::Type::kBool}}),
+        calls_(calls) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    (*calls_)++;
+    *result = CelValue::CreateInt64(args[0].BoolOrDie() + args[1].BoolOrDie());
+    return util::OkStatus();
+  }
+
+ private:
+  int* calls_;
+};
+
+TEST(FlatExprBuilderTest, ConstantFoldingSkipsOverloadedBuiltins) {
+  // true + true
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_+_"
+      args { const_expr { bool_value: true } }
+      args { const_expr { bool_value: true } }
+    })",
+                                                  &expr));
+
+  int calls = 0;
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<CountingAddFunction>(&calls))));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+  EXPECT_THAT(calls, Eq(0));
+
+  Activation activation;
+  google::protobuf::Arena arena;
+  for (int i = 1; i <= 2; i++) {
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    EXPECT_THAT(result_or.ValueOrDie().Int64OrDie(), Eq(2));
+    EXPECT_THAT(calls, Eq(i));
+  }
+
+  // Functions registered as pure are folded.
+  FlatExprBuilder pure_builder;
+  pure_builder.GetRegistry()->set_register_pure(true);
+  ASSERT_TRUE(util::IsOk(pure_builder.GetRegistry()->Register(
+      absl::make_unique<CountingAddFunction>(&calls))));
+  build_status = pure_builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  EXPECT_THAT(calls, Eq(3));
+  ASSERT_TRUE(util::IsOk(
+      build_status.ValueOrDie()->Evaluate(activation, &arena)));
+  EXPECT_THAT(calls, Eq(3));
+}
+
+// Constant patterns of matches() are compiled when the expression is built,
+// instead of being looked up in the regex cache on each call.
+TEST(FlatExprBuilderTest, ConstantRegexPattern) {
+  struct TestCase {
+    std::string pattern;
+    CelValue target;
+    // Expected result, null for an error.
+    absl::optional<bool> matches;
+  };
+  std::string matching = "aab";
+  std::string not_matching = "abc";
+  const std::vector<TestCase> test_cases = {
+      {"a+b", CelValue::CreateString(&matching), true},
+      {"a+b", CelValue::CreateString(&not_matching), false},
+      {"a+b", CelValue::CreateInt64(1), absl::nullopt},
+      {"(", CelValue::CreateString(&matching), absl::nullopt},
+  };
+
+  for (const auto& test_case : test_cases) {
+    for (bool receiver_style : {false, true}) {
+      SCOPED_TRACE(absl::StrCat(test_case.pattern, " ", receiver_style));
+      Expr expr;
+      auto call = expr.mutable_call_expr();
+      call->set_function(builtin::kRegexMatch);
+      auto target = receiver_style ? call->mutable_target() : call->add_args();
+      target->mutable_ident_expr()->set_name("target");
+      call->add_args()->mutable_const_expr()->set_string_value(
+          test_case.pattern);
+
+      FlatExprBuilder builder;
+      ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+      SourceInfo source_info;
+      auto build_status = builder.CreateExpression(&expr, &source_info);
+      ASSERT_TRUE(util::IsOk(build_status));
+      auto cel_expr = std::move(build_status.ValueOrDie());
+
+      Activation activation;
+      activation.InsertValue("target", test_case.target);
+      google::protobuf::Arena arena;
+      int64_t misses = RegexCache::Global()->misses();
+      int64_t hits = RegexCache::Global()->hits();
+      auto result_or = cel_expr->Evaluate(activation, &arena);
+      ASSERT_TRUE(util::IsOk(result_or));
+      CelValue result = result_or.ValueOrDie();
+      if (test_case.matches.has_value()) {
+        ASSERT_TRUE(result.IsBool());
+        EXPECT_THAT(result.BoolOrDie(), Eq(*test_case.matches));
+      } else {
+        EXPECT_TRUE(result.IsError());
+      }
+      // Only invalid patterns are left to the function.
+      int64_t lookups = test_case.pattern == "(" ? 1 : 0;
+      EXPECT_THAT(RegexCache::Global()->misses() + RegexCache::Global()->hits(),
+                  Eq(misses + hits + lookups));
+    }
+  }
+}
+
+// The in operator with a constant list looks values up in an index built
+// with the expression. Results must be the same as of the function.
+TEST(FlatExprBuilderTest, InConstantList) {
+  // x in [1, "a", 2u, 3.5, [1]]
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "@in"
+      args { ident_expr { name: "x" } }
+      args {
+        list_expr {
+          elements { const_expr { int64_value: 1 } }
+          elements { const_expr { string_value: "a" } }
+          elements { const_expr { uint64_value: 2 } }
+          elements { const_expr { double_value: 3.5 } }
+          elements { list_expr { elements { const_expr { int64_value: 1 } } } }
+        }
+      }
+    })",
+                                                  &expr));
+
+  std::string string_a = "a";
+  std::string string_b = "b";
+  const std::vector<CelValue> values = {
+      CelValue::CreateInt64(1),      CelValue::CreateInt64(2),
+      CelValue::CreateUint64(2),     CelValue::CreateDouble(3.5),
+      CelValue::CreateDouble(1),     CelValue::CreateString(&string_a),
+      CelValue::CreateString(&string_b), CelValue::CreateBytes(&string_a),
+      CelValue::CreateBool(true),    CelValue::CreateNull(),
+  };
+
+  google::protobuf::Arena arena;
+  for (const auto& value : values) {
+    SCOPED_TRACE(CelValue::TypeName(value.type()));
+    std::vector<CelValue> results;
+    for (bool constant_folding : {false, true}) {
+      FlatExprBuilder builder;
+      builder.set_constant_folding(constant_folding);
+      ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+      SourceInfo source_info;
+      auto build_status = builder.CreateExpression(&expr, &source_info);
+      ASSERT_TRUE(util::IsOk(build_status));
+
+      Activation activation;
+      activation.InsertValue("x", value);
+      auto result_or = build_status.ValueOrDie()->Evaluate(activation, &arena);
+      ASSERT_TRUE(util::IsOk(result_or));
+      results.push_back(result_or.ValueOrDie());
+    }
+    ASSERT_THAT(results[1].type(), Eq(results[0].type()));
+    if (results[0].IsBool()) {
+      EXPECT_THAT(results[1].BoolOrDie(), Eq(results[0].BoolOrDie()));
+    } else {
+      ASSERT_TRUE(results[0].IsError());
+      EXPECT_THAT(results[1].ErrorOrDie()->message(),
+                  Eq(results[0].ErrorOrDie()->message()));
+    }
+  }
+}
+
+// Timestamp accessors with a constant time zone resolve it when the
+// expression is built. Results must be the same as with the time zone
+// passed in a variable.
+TEST(FlatExprBuilderTest, ConstantTimeZone) {
+  google::protobuf::Timestamp timestamp;
+  // 2020-01-01T12:00:00Z
+  timestamp.set_seconds(1577880000);
+  std::string string_value = "x";
+  const std::vector<CelValue> targets = {
+      CelValue::CreateTimestamp(&timestamp),
+      CelValue::CreateString(&string_value),
+      CelValue::CreateInt64(1),
+  };
+
+  google::protobuf::Arena arena;
+  for (const char* function : {"getHours", "getDayOfWeek"}) {
+    for (const char* time_zone :
+         {"", "UTC", "+05:30", "America/New_York", "Nowhere/Nope"}) {
+      for (const auto& target : targets) {
+        SCOPED_TRACE(absl::StrCat(function, " ", time_zone, " ",
+                                  CelValue::TypeName(target.type())));
+        std::vector<CelValue> results;
+        for (bool constant : {false, true}) {
+          // target.function(time_zone)
+          Expr expr;
+          auto call = expr.mutable_call_expr();
+          call->set_function(function);
+          call->mutable_target()->mutable_ident_expr()->set_name("target");
+          if (constant) {
+            call->add_args()->mutable_const_expr()->set_string_value(
+                time_zone);
+          } else {
+            call->add_args()->mutable_ident_expr()->set_name("time_zone");
+          }
+
+          FlatExprBuilder builder;
+          ASSERT_TRUE(
+              util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+          SourceInfo source_info;
+          auto build_status = builder.CreateExpression(&expr, &source_info);
+          ASSERT_TRUE(util::IsOk(build_status));
+
+          Activation activation;
+          activation.InsertValue("target", target);
+          activation.InsertValue("time_zone",
+                                 CelValue::CreateStringView(time_zone));
+          auto result_or =
+              build_status.ValueOrDie()->Evaluate(activation, &arena);
+          ASSERT_TRUE(util::IsOk(result_or));
+          results.push_back(result_or.ValueOrDie());
+        }
+        ASSERT_THAT(results[1].type(), Eq(results[0].type()));
+        if (results[0].IsInt64()) {
+          EXPECT_THAT(results[1].Int64OrDie(), Eq(results[0].Int64OrDie()));
+        } else {
+          ASSERT_TRUE(results[0].IsError());
+          EXPECT_THAT(results[1].ErrorOrDie()->message(),
+                      Eq(results[0].ErrorOrDie()->message()));
+        }
+      }
+    }
+  }
+}
+
+TEST(FlatExprBuilderTest, FoldedValuesOwnedByExpression) {
+  Expr expr;
+  // ["a" + "b", "c"]
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    list_expr {
+      elements {
+        call_expr {
+          function: "_+_"
+          args { const_expr { string_value: "a" } }
+          args { const_expr { string_value: "b" } }
+        }
+      }
+      elements { const_expr { string_value: "c" } }
+    })",
+                                                  &expr));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  // Results of evaluation in different arenas refer to the same list,
+  // which outlives the arenas.
+  const CelList* first_list = nullptr;
+  for (int i = 0; i < 2; i++) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    ASSERT_TRUE(result_or.ValueOrDie().IsList());
+    const CelList* list = result_or.ValueOrDie().ListOrDie();
+    ASSERT_THAT(list->size(), Eq(2));
+    EXPECT_THAT((*list)[0].StringOrDie().value(), Eq("ab"));
+    if (first_list == nullptr) {
+      first_list = list;
+    } else {
+      EXPECT_THAT(list, Eq(first_list));
+    }
+  }
+}
+
+// Function with overloads for int64 and string, returning the name of the
+// overload invoked.
+class TypeNameFunction : public CelFunction {
+ public:
+  explicit TypeNameFunction(CelValue::Type type)
+      : CelFunction(Descriptor{"type_name", false, {type}}) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    static const std::string* kInt = new std::string("int");
+    static const std::string* kString = new std::string("string");
+    *result = CelValue::CreateString(args[0].IsInt64() ? kInt : kString);
+    return util::OkStatus();
+  }
+};
+
+TEST(FlatExprBuilderTest, CheckedExprOverloadResolution) {
+  CheckedExpr checked_expr;
+  // type_name(x), x declared as int.
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    reference_map {
+      key: 1
+      value { overload_id: "type_name_int64" }
+    }
+    type_map {
+      key: 1
+      value { primitive: STRING }
+    }
+    type_map {
+      key: 2
+      value { primitive: INT64 }
+    }
+    expr {
+      id: 1
+      call_expr {
+        function: "type_name"
+        args {
+          id: 2
+          ident_expr { name: "x" }
+        }
+      }
+    })",
+                                                  &checked_expr));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<TypeNameFunction>(CelValue::Type::kInt64))));
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<TypeNameFunction>(CelValue::Type::kString))));
+
+  auto checked_status = builder.CreateExpression(&checked_expr);
+  ASSERT_TRUE(util::IsOk(checked_status));
+  auto checked_cel_expr = std::move(checked_status.ValueOrDie());
+
+  auto unchecked_status = builder.CreateExpression(
+      &checked_expr.expr(), &checked_expr.source_info());
+  ASSERT_TRUE(util::IsOk(unchecked_status));
+  auto unchecked_cel_expr = std::move(unchecked_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("x", CelValue::CreateInt64(1));
+  for (const auto* cel_expr : {checked_cel_expr.get(),
+                               unchecked_cel_expr.get()}) {
+    auto result_or = cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    ASSERT_TRUE(result_or.ValueOrDie().IsString());
+    EXPECT_THAT(result_or.ValueOrDie().StringOrDie().value(), Eq("int"));
+  }
+
+  // Only the overload resolved at build time is matched.
+  const std::string value = "a";
+  activation.RemoveValueEntry("x");
+  activation.InsertValue("x", CelValue::CreateString(&value));
+
+  auto result_or = unchecked_cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsString());
+  EXPECT_THAT(result_or.ValueOrDie().StringOrDie().value(), Eq("string"));
+
+  result_or = checked_cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  EXPECT_TRUE(result_or.ValueOrDie().IsError());
+
+  // Errors in arguments are propagated as usual.
+  activation.RemoveValueEntry("x");
+  result_or = checked_cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsError());
+}
+
+TEST(FlatExprBuilderTest, CheckedExprDynamicCall) {
+  CheckedExpr checked_expr;
+  // type_name(x), x declared as dyn, several overloads are possible.
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    reference_map {
+      key: 1
+      value {
+        overload_id: "type_name_int64"
+        overload_id: "type_name_string"
+      }
+    }
+    type_map {
+      key: 2
+      value { dyn {} }
+    }
+    expr {
+      id: 1
+      call_expr {
+        function: "type_name"
+        args {
+          id: 2
+          ident_expr { name: "x" }
+        }
+      }
+    })",
+                                                  &checked_expr));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<TypeNameFunction>(CelValue::Type::kInt64))));
+  ASSERT_TRUE(util::IsOk(builder.GetRegistry()->Register(
+      absl::make_unique<TypeNameFunction>(CelValue::Type::kString))));
+
+  auto build_status = builder.CreateExpression(&checked_expr);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  const std::string value = "a";
+  Activation activation;
+  activation.InsertValue("x", CelValue::CreateString(&value));
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsString());
+  EXPECT_THAT(result_or.ValueOrDie().StringOrDie().value(), Eq("string"));
+}
+
+TEST(FlatExprBuilderTest, TypedSelectOfDeclaredVariable) {
+  // message.message_value.string_value and has(message.message_value)
+  Expr select_expr;
+  Expr has_expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    select_expr {
+      operand {
+        select_expr {
+          operand { ident_expr { name: "message" } }
+          field: "message_value"
+        }
+      }
+      field: "string_value"
+    })",
+                                                  &select_expr));
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    select_expr {
+      operand { ident_expr { name: "message" } }
+      field: "message_value"
+      test_only: true
+    })",
+                                                  &has_expr));
+
+  FlatExprBuilder builder;
+  builder.DeclareVariableType("message", TestMessage::descriptor());
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&select_expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto select_cel_expr = std::move(build_status.ValueOrDie());
+  build_status = builder.CreateExpression(&has_expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto has_cel_expr = std::move(build_status.ValueOrDie());
+
+  TestMessage message;
+  message.mutable_message_value()->set_string_value("a");
+  // Messages of the declared type with another implementation are read by
+  // the generic field access.
+  google::protobuf::DynamicMessageFactory factory;
+  std::unique_ptr<google::protobuf::Message> dynamic_message(
+      factory.GetPrototype(TestMessage::descriptor())->New());
+  dynamic_message->CopyFrom(message);
+
+  google::protobuf::Arena arena;
+  for (const google::protobuf::Message* value :
+       {static_cast<const google::protobuf::Message*>(&message),
+        static_cast<const google::protobuf::Message*>(
+            dynamic_message.get())}) {
+    Activation activation;
+    activation.InsertValue("message", CelValue::CreateMessage(value, &arena));
+
+    auto result_or = select_cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    ASSERT_TRUE(result_or.ValueOrDie().IsString());
+    EXPECT_THAT(result_or.ValueOrDie().StringOrDie().value(), Eq("a"));
+
+    result_or = has_cel_expr->Evaluate(activation, &arena);
+    ASSERT_TRUE(util::IsOk(result_or));
+    ASSERT_TRUE(result_or.ValueOrDie().IsBool());
+    EXPECT_TRUE(result_or.ValueOrDie().BoolOrDie());
+  }
+
+  Activation activation;
+  TestMessage empty_message;
+  activation.InsertValue("message",
+                         CelValue::CreateMessage(&empty_message, &arena));
+  auto result_or = has_cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsBool());
+  EXPECT_FALSE(result_or.ValueOrDie().BoolOrDie());
+
+  // Unknown paths are still checked.
+  activation.RemoveValueEntry("message");
+  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+  FieldMask mask;
+  mask.add_paths("message.message_value");
+  activation.set_unknown_paths(mask);
+  result_or = select_cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  EXPECT_TRUE(result_or.ValueOrDie().IsError());
+
+  // Values of other types are supported by the generic field access.
+  Activation other_activation;
+  Expr other_message;
+  other_activation.InsertValue("message",
+                               CelValue::CreateMessage(&other_message, &arena));
+  result_or = select_cel_expr->Evaluate(other_activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsError());
+  EXPECT_THAT(result_or.ValueOrDie().ErrorOrDie()->code(),
+              Eq(CelError::Code::CelError_Code_NO_SUCH_FIELD));
+}
+
+TEST(FlatExprBuilderTest, CheckedExprTypedSelect) {
+  CheckedExpr checked_expr;
+  // x.int64_value, x declared as TestMessage.
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    type_map {
+      key: 1
+      value { primitive: INT64 }
+    }
+    type_map {
+      key: 2
+      value { message_type: "google.api.expr.runtime.TestMessage" }
+    }
+    expr {
+      id: 1
+      select_expr {
+        operand {
+          id: 2
+          ident_expr { name: "x" }
+        }
+        field: "int64_value"
+      }
+    })",
+                                                  &checked_expr));
+
+  FlatExprBuilder builder;
+  auto build_status = builder.CreateExpression(&checked_expr);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  TestMessage message;
+  message.set_int64_value(1);
+  Activation activation;
+  activation.InsertValue("x", CelValue::CreateMessage(&message, &arena));
+  auto result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsInt64());
+  EXPECT_THAT(result_or.ValueOrDie().Int64OrDie(), Eq(1));
+
+  // Selects from maps do not depend on the checked type.
+  std::string key = "int64_value";
+  std::vector<std::pair<CelValue, CelValue>> entries = {
+      {CelValue::CreateString(&key), CelValue::CreateInt64(2)}};
+  auto map = CreateContainerBackedMap(absl::MakeSpan(entries));
+  activation.RemoveValueEntry("x");
+  activation.InsertValue("x", CelValue::CreateMap(map.get()));
+  result_or = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(result_or));
+  ASSERT_TRUE(result_or.ValueOrDie().IsInt64());
+  EXPECT_THAT(result_or.ValueOrDie().Int64OrDie(), Eq(2));
+}
+
+TEST(FlatExprBuilderTest, FusedSelectsTrace) {
+  // message.message_value.int64_value
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    id: 3
+    select_expr {
+      operand {
+        id: 2
+        select_expr {
+          operand { id: 1 ident_expr { name: "message" } }
+          field: "message_value"
+        }
+      }
+      field: "int64_value"
+    })", &expr));
+
+  TestMessage message;
+  message.mutable_message_value()->set_int64_value(10);
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+
+  for (bool fused_selects : {true, false}) {
+    SCOPED_TRACE(fused_selects);
+    FlatExprBuilder builder;
+    builder.set_fused_selects(fused_selects);
+    SourceInfo source_info;
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    ASSERT_TRUE(util::IsOk(build_status));
+    auto cel_expr = std::move(build_status.ValueOrDie());
+
+    std::vector<int64_t> traced_ids;
+    auto result_or = cel_expr->Trace(
+        activation, &arena,
+        [&traced_ids](const Expr* expr, const CelValue&,
+                      google::protobuf::Arena*) {
+          traced_ids.push_back(expr->id());
+          return util::OkStatus();
+        });
+    ASSERT_TRUE(util::IsOk(result_or));
+    ASSERT_TRUE(result_or.ValueOrDie().IsInt64());
+    EXPECT_THAT(result_or.ValueOrDie().Int64OrDie(), Eq(10));
+    if (fused_selects) {
+      EXPECT_THAT(traced_ids, testing::ElementsAre(1, 3));
+    } else {
+      EXPECT_THAT(traced_ids, testing::ElementsAre(1, 2, 3));
+    }
+  }
+}
+
+TEST(FlatExprBuilderTest, UnknownSupportTest) {
+  TestMessage message;
+
+  Expr expr;
+  SourceInfo source_info;
+
+  auto select_expr = expr.mutable_select_expr();
+  select_expr->set_field("int32_value");
+
+  auto operand1 = select_expr->mutable_operand();
+  auto select_expr1 = operand1->mutable_select_expr();
+
+  select_expr1->set_field("message_value");
+  auto operand2 = select_expr1->mutable_operand();
+
+  operand2->mutable_ident_expr()->set_name("message");
+
+  FlatExprBuilder builder;
+
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  message.mutable_message_value()->set_int32_value(1);
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+
+  auto eval_status = cel_expr->Evaluate(activation, &arena);
+
+  ASSERT_TRUE(util::IsOk(eval_status));
+  CelValue result = eval_status.ValueOrDie();
+
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(1));
+
+  FieldMask mask;
+  mask.add_paths("message.message_value.int32_value");
+  activation.set_unknown_paths(mask);
+  eval_status = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(eval_status));
+  result = eval_status.ValueOrDie();
+  ASSERT_TRUE(result.IsError());
+
+  mask.clear_paths();
+  mask.add_paths("message.message_value");
+  activation.set_unknown_paths(mask);
+  eval_status = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(eval_status));
+  result = eval_status.ValueOrDie();
+  ASSERT_TRUE(result.IsError());
+}
+
+TEST(FlatExprBuilderTest, SimpleEnumTest) {
+  TestMessage message;
+
+  Expr expr;
+  SourceInfo source_info;
+
+  constexpr char enum_name[] =
+      "google.api.expr.runtime.TestMessage.TestEnum.TEST_ENUM_1";
+
+  std::vector<std::string> enum_name_parts = absl::StrSplit(enum_name, '.');
+  Expr* cur_expr = &expr;
+
+  for (int i = enum_name_parts.size() - 1; i > 0; i--) {
+    auto select_expr = cur_expr->mutable_select_expr();
+    select_expr->set_field(enum_name_parts[i]);
+    cur_expr = select_expr->mutable_operand();
+  }
+
+  cur_expr->mutable_ident_expr()->set_name(enum_name_parts[0]);
+
+  FlatExprBuilder builder;
+  builder.addResolvableEnum(TestMessage::TestEnum_descriptor());
+
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  auto eval_status = cel_expr->Evaluate(activation, &arena);
+
+  ASSERT_TRUE(util::IsOk(eval_status));
+  CelValue result = eval_status.ValueOrDie();
+
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(TestMessage::TEST_ENUM_1));
+}
+
+TEST(FlatExprBuilderTest, ReferencedPaths) {
+  // message.message_value.string_value + message.string_value
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_+_"
+      args {
+        select_expr {
+          operand {
+            select_expr {
+              operand { ident_expr { name: "message" } }
+              field: "message_value"
+            }
+          }
+          field: "string_value"
+        }
+      }
+      args {
+        select_expr {
+          operand { ident_expr { name: "message" } }
+          field: "string_value"
+        }
+      }
+    })",
+                                                  &expr));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  SourceInfo source_info;
+
+  // Paths are found only on request.
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  EXPECT_THAT(build_status.ValueOrDie()->referenced_paths(), testing::IsNull());
+
+  builder.set_referenced_paths(true);
+  build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  const google::protobuf::FieldMask* paths = cel_expr->referenced_paths();
+  ASSERT_THAT(paths, testing::NotNull());
+  EXPECT_THAT(paths->paths(),
+              testing::ElementsAre("message.message_value.string_value",
+                                   "message.string_value"));
+
+  // Messages pruned to the referenced fields evaluate to the same values.
+  TestMessage message;
+  message.set_string_value("a");
+  message.set_int64_value(1);
+  message.mutable_message_value()->set_string_value("b");
+  message.mutable_message_value()->add_string_list("c");
+  google::protobuf::util::FieldMaskUtil::TrimMessage(
+      FindMessageFieldMask(*paths, "message", TestMessage::descriptor()),
+      &message);
+  EXPECT_THAT(message.int64_value(), Eq(0));
+  EXPECT_THAT(message.message_value().string_list_size(), Eq(0));
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+  auto eval_status = cel_expr->Evaluate(activation, &arena);
+  ASSERT_TRUE(util::IsOk(eval_status));
+  EXPECT_THAT(eval_status.ValueOrDie().StringOrDie().value(), Eq("ba"));
+}
+
+TEST(FlatExprBuilderTest, WireMessageSubmessages) {
+  TestMessage message;
+  message.mutable_message_value()->set_int32_value(1);
+  std::string serialized = message.SerializeAsString();
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  ASSERT_TRUE(util::IsOk(BindWireMessageToActivation(
+      serialized, message.GetDescriptor(), &arena, &activation)));
+
+  FlatExprBuilder builder;
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  auto evaluate = [&](const std::string& expr_text) {
+    Expr expr;
+    EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+    SourceInfo source_info;
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    EXPECT_TRUE(util::IsOk(build_status));
+    auto result_or = build_status.ValueOrDie()->Evaluate(activation, &arena);
+    EXPECT_TRUE(util::IsOk(result_or));
+    return result_or.ValueOrDie();
+  };
+
+  // Submessages are maps.
+  EXPECT_TRUE(evaluate(R"(ident_expr { name: "message_value" })").IsMap());
+
+  // Selects of fields not set have default values.
+  CelValue result = evaluate(R"(
+    select_expr {
+      operand { ident_expr { name: "message_value" } }
+      field: "int64_value"
+    })");
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(0));
+
+  // "in" and size only see the fields present, as has() does.
+  for (const char* field : {"int32_value", "int64_value"}) {
+    SCOPED_TRACE(field);
+    result = evaluate(absl::Substitute(R"(
+      call_expr {
+        function: "@in"
+        args { const_expr { string_value: "$0" } }
+        args { ident_expr { name: "message_value" } }
+      })",
+                                       field));
+    ASSERT_TRUE(result.IsBool());
+    bool in = result.BoolOrDie();
+    result = evaluate(absl::Substitute(R"(
+      select_expr {
+        operand { ident_expr { name: "message_value" } }
+        field: "$0"
+        test_only: true
+      })",
+                                       field));
+    ASSERT_TRUE(result.IsBool());
+    EXPECT_THAT(in, Eq(result.BoolOrDie()));
+  }
+  result = evaluate(R"(
+    call_expr {
+      function: "size"
+      args { ident_expr { name: "message_value" } }
+    })");
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(1));
+
+  // Fields not declared are missing keys rather than missing fields.
+  result = evaluate(R"(
+    select_expr {
+      operand { ident_expr { name: "message_value" } }
+      field: "unknown"
+    })");
+  ASSERT_TRUE(result.IsError());
+  EXPECT_THAT(result.ErrorOrDie()->message(), Eq("Key not found in map"));
 }
 
 }  // namespace
@@ -1,5 +1,12 @@
 #include "eval/eval/comprehension_step.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+#include "eval/eval/container_backed_list_impl.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
 
 namespace google {
 namespace api {
@@ -27,12 +34,52 @@ namespace runtime {
 // 10. result                  (dep) 2
 // 11. ComprehensionFinish           1
 
+namespace {
+
+// Sets the element of the list at the index, or returns false past the end of
+// the list. Lists with contiguous storage take a single virtual call.
+bool ElementAt(const CelList* list, int64_t index, CelValue* element) {
+  auto span = list->AsSpan();
+  if (span.has_value()) {
+    if (index >= static_cast<int64_t>(span->size())) {
+      return false;
+    }
+    *element = (*span)[index];
+    return true;
+  }
+  if (index >= list->size()) {
+    return false;
+  }
+  *element = (*list)[index];
+  return true;
+}
+
+// Returns the keys of the map to iterate. Key lists without contiguous
+// storage are copied to the arena in a single pass, so that the loop does not
+// access them by index.
+const CelList* IterationKeys(const CelMap* cel_map,
+                             google::protobuf::Arena* arena) {
+  const CelList* keys = cel_map->ListKeys();
+  if (keys->AsSpan().has_value()) {
+    return keys;
+  }
+  std::vector<CelValue> values;
+  values.reserve(keys->size());
+  keys->ForEach([&values](const CelValue& key) {
+    values.push_back(key);
+    return true;
+  });
+  return google::protobuf::Arena::Create<ContainerBackedListImpl>(
+      arena, std::move(values));
+}
+
+}  // namespace
+
 ComprehensionNextStep::ComprehensionNextStep(
-    const std::string& accu_var, const std::string& iter_var,
-    const google::api::expr::v1alpha1::Expr* expr)
+    int iter_slot, int accu_slot, const google::api::expr::v1alpha1::Expr* expr)
     : ExpressionStepBase(expr, false),
-      accu_var_(accu_var),
-      iter_var_(iter_var) {}
+      iter_slot_(iter_slot),
+      accu_slot_(accu_slot) {}
 
 void ComprehensionNextStep::set_jump_offset(int offset) {
   jump_offset_ = offset;
@@ -74,9 +121,6 @@ util::Status ComprehensionNextStep::Evaluate(ExecutionFrame* frame) const {
     POS_CURRENT_VALUE,
     POS_LOOP_STEP,
   };
-  if (!frame->value_stack().HasEnough(5)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
   auto state = frame->value_stack().GetSpan(5);
   CelValue iter_range = state[POS_ITER_RANGE];
   if (!iter_range.IsList()) {
@@ -103,26 +147,22 @@ util::Status ComprehensionNextStep::Evaluate(ExecutionFrame* frame) const {
   CelValue loop_step = state[POS_LOOP_STEP];
   frame->value_stack().Pop(5);
   frame->value_stack().Push(loop_step);
-  frame->iter_vars()[accu_var_] = loop_step;
-  if (current_index >= cel_list->size() - 1) {
-    frame->iter_vars().erase(iter_var_);
+  frame->iter_var(accu_slot_) = loop_step;
+  current_index += 1;
+  CelValue current_value;
+  if (!ElementAt(cel_list, current_index, &current_value)) {
     return frame->JumpTo(jump_offset_);
   }
   frame->value_stack().Push(iter_range);
-  current_index += 1;
-  CelValue current_value = (*cel_list)[current_index];
   frame->value_stack().Push(CelValue::CreateInt64(current_index));
   frame->value_stack().Push(current_value);
-  frame->iter_vars()[iter_var_] = current_value;
+  frame->iter_var(iter_slot_) = current_value;
   return util::OkStatus();
 }
 
 ComprehensionCondStep::ComprehensionCondStep(
-    const std::string& accu_var, const std::string& iter_var, bool shortcircuiting,
-    const google::api::expr::v1alpha1::Expr* expr)
-    : ExpressionStepBase(expr, false),
-      iter_var_(iter_var),
-      shortcircuiting_(shortcircuiting) {}
+    bool shortcircuiting, const google::api::expr::v1alpha1::Expr* expr)
+    : ExpressionStepBase(expr, false), shortcircuiting_(shortcircuiting) {}
 
 void ComprehensionCondStep::set_jump_offset(int offset) {
   jump_offset_ = offset;
@@ -134,9 +174,6 @@ void ComprehensionCondStep::set_jump_offset(int offset) {
 // Stack size after: 4.
 // Stack size on break: 1.
 util::Status ComprehensionCondStep::Evaluate(ExecutionFrame* frame) const {
-  if (!frame->value_stack().HasEnough(5)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
   CelValue loop_condition_value = frame->value_stack().Peek();
   if (!loop_condition_value.IsBool()) {
     auto message = absl::StrCat(
@@ -149,29 +186,29 @@ util::Status ComprehensionCondStep::Evaluate(ExecutionFrame* frame) const {
   frame->value_stack().Pop(1);  // loop_condition
   if (!loop_condition && shortcircuiting_) {
     frame->value_stack().Pop(3);  // current_value, current_index, iter_range
-    frame->iter_vars().erase(iter_var_);
     return frame->JumpTo(jump_offset_);
   }
   return util::OkStatus();
 }
 
-ComprehensionFinish::ComprehensionFinish(const std::string& accu_var,
-                                         const std::string& iter_var,
-                                         const google::api::expr::v1alpha1::Expr* expr)
-    : ExpressionStepBase(expr), accu_var_(accu_var) {}
+ComprehensionFinish::ComprehensionFinish(
+    const google::api::expr::v1alpha1::Expr* expr, bool list_accumulator)
+    : ExpressionStepBase(expr), list_accumulator_(list_accumulator) {}
 
 // Stack changes of ComprehensionFinish.
 //
 // Stack size before: 2.
 // Stack size after: 1.
 util::Status ComprehensionFinish::Evaluate(ExecutionFrame* frame) const {
-  if (!frame->value_stack().HasEnough(2)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
   CelValue result = frame->value_stack().Peek();
   frame->value_stack().Pop(1);  // result
+  if (list_accumulator_ && result.IsList()) {
+    // The result is bound to the accumulator created by ListAccumulatorStep.
+    auto* accumulator = static_cast<MutableListImpl*>(
+        const_cast<CelList*>(result.ListOrDie()));
+    result = CelValue::CreateList(accumulator->Freeze(frame->arena()));
+  }
   frame->value_stack().PopAndPush(result);
-  frame->iter_vars().erase(accu_var_);
   return util::OkStatus();
 }
 
@@ -188,18 +225,508 @@ std::unique_ptr<ExpressionStep> CreateListKeysStep(
 }
 
 util::Status ListKeysStep::Evaluate(ExecutionFrame* frame) const {
-  if (!frame->value_stack().HasEnough(1)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
   CelValue map_value = frame->value_stack().Peek();
   if (map_value.IsMap()) {
     const CelMap* cel_map = map_value.MapOrDie();
-    frame->value_stack().PopAndPush(CelValue::CreateList(cel_map->ListKeys()));
+    frame->value_stack().PopAndPush(
+        CelValue::CreateList(IterationKeys(cel_map, frame->arena())));
     return util::OkStatus();
   }
   return util::OkStatus();
 }
 
+namespace {
+
+// Outcome of folding a predicate value into a quantifier accumulator.
+enum class FoldResult {
+  kContinue,
+  // The accumulator is set to the result of the comprehension.
+  kDecided,
+  // The predicate is not a bool and the accumulator is not an error, which
+  // the logical operators reject.
+  kUnsupported,
+};
+
+FoldResult FoldPredicate(QuantifierKind kind, const CelValue& predicate,
+                         CelValue* accu) {
+  bool value;
+  bool has_value = predicate.GetValue(&value);
+  switch (kind) {
+    case QuantifierKind::kAll:
+    case QuantifierKind::kExists: {
+      // Same as the logical operator step applied to accu and predicate,
+      // where accu is either an error, or the bool not deciding the result.
+      bool decisive = kind == QuantifierKind::kExists;
+      if (has_value && value == decisive) {
+        *accu = CelValue::CreateBool(decisive);
+        return FoldResult::kDecided;
+      }
+      if (has_value || accu->IsError()) {
+        return FoldResult::kContinue;
+      }
+      if (!predicate.IsError()) {
+        return FoldResult::kUnsupported;
+      }
+      *accu = predicate;
+      return FoldResult::kContinue;
+    }
+    case QuantifierKind::kExistsOne:
+      // Same as the conditional operator: errors replace the accumulator,
+      // and values other than false count.
+      if (predicate.IsError()) {
+        *accu = predicate;
+      } else if ((!has_value || value) && accu->IsInt64()) {
+        *accu = CelValue::CreateInt64(accu->Int64OrDie() + 1);
+      }
+      return FoldResult::kContinue;
+  }
+  return FoldResult::kContinue;
+}
+
+util::Status UnsupportedTypeError() {
+  return util::MakeStatus(google::rpc::Code::INTERNAL,
+                          "Unsupported type supplied for logical operation");
+}
+
+// Number of chunks per concurrently running task, so that the load stays
+// balanced when chunks take different time, e.g. due to early exit.
+constexpr int kChunksPerTask = 4;
+
+// Splits [0, size) into chunks and runs run_chunk for each of them on the
+// executor of the frame, including the calling thread. Returns once all
+// chunks are done.
+// Chunks are run on frames with their own state and arena, owned by the
+// arena of the frame. Comprehension variables of the frame are visible in
+// chunk frames.
+void RunChunks(ExecutionFrame* frame, const ParallelLoop& loop, int64_t size,
+               int num_chunks,
+               const std::function<void(int chunk, ExecutionFrame* chunk_frame,
+                                        int64_t begin, int64_t end)>&
+                   run_chunk) {
+  // Values of free variables are cached by activation on first lookup, so
+  // that the chunks only read them.
+  for (const auto& name : loop.variables) {
+    frame->activation().FindValue(name, frame->arena());
+  }
+
+  std::vector<google::protobuf::Arena*> arenas(num_chunks);
+  for (auto& arena : arenas) {
+    arena = new google::protobuf::Arena();
+    frame->arena()->Own(arena);
+  }
+
+  auto run = [&](int chunk) {
+    CelExpressionFlatEvaluationState state(frame->value_stack().max_size(),
+                                           frame->iter_vars().size(),
+                                           arenas[chunk]);
+    state.iter_vars() = frame->iter_vars();
+    ExecutionFrame chunk_frame(*frame, &state);
+    run_chunk(chunk, &chunk_frame, size * chunk / num_chunks,
+              size * (chunk + 1) / num_chunks);
+  };
+
+  absl::BlockingCounter pending(num_chunks - 1);
+  for (int chunk = 1; chunk < num_chunks; chunk++) {
+    frame->executor()->Schedule([&run, &pending, chunk]() {
+      run(chunk);
+      pending.DecrementCount();
+    });
+  }
+  run(0);
+  pending.Wait();
+}
+
+int NumChunks(const ExecutionFrame* frame, int64_t size) {
+  return static_cast<int>(std::min<int64_t>(
+      size, std::max(frame->executor()->concurrency(), 1) * kChunksPerTask));
+}
+
+// Evaluates the loop body for the element of the range, and pops its value.
+util::Status EvaluateBody(ExecutionFrame* frame, const CelList* range,
+                          int64_t index, int iter_slot, int body_begin,
+                          int body_end, CelValue* value) {
+  frame->iter_var(iter_slot) = (*range)[index];
+  frame->set_pc(body_begin);
+  util::Status status = frame->EvaluateUntil(body_end);
+  if (!util::IsOk(status)) {
+    return status;
+  }
+  *value = frame->value_stack().Peek();
+  frame->value_stack().Pop(1);
+  return util::OkStatus();
+}
+
+// Lowers the index the loop is stopped at, if it is lower than the current.
+void StopAt(std::atomic<int64_t>* stop_index, int64_t index) {
+  int64_t current = stop_index->load(std::memory_order_relaxed);
+  while (index < current &&
+         !stop_index->compare_exchange_weak(current, index,
+                                            std::memory_order_relaxed)) {
+  }
+}
+
+bool IsParallel(const ExecutionFrame* frame, const ParallelLoop* loop,
+                const CelList* range) {
+  return loop != nullptr && frame->executor() != nullptr &&
+         range->size() >= loop->min_range_size;
+}
+
+}  // namespace
+
+QuantifierStepBase::QuantifierStepBase(
+    QuantifierKind kind, int first_slot,
+    const google::api::expr::v1alpha1::Expr* expr)
+    : ExpressionStepBase(expr),
+      kind_(kind),
+      iter_slot_(first_slot),
+      accu_slot_(first_slot + 1),
+      range_slot_(first_slot + 2),
+      index_slot_(first_slot + 3),
+      jump_offset_(0) {}
+
+bool QuantifierStepBase::Advance(ExecutionFrame* frame) const {
+  const CelList* cel_list = frame->iter_var(range_slot_).ListOrDie();
+  int64_t index = frame->iter_var(index_slot_).Int64OrDie() + 1;
+  if (!ElementAt(cel_list, index, &frame->iter_var(iter_slot_))) {
+    return false;
+  }
+  frame->iter_var(index_slot_) = CelValue::CreateInt64(index);
+  return true;
+}
+
+void QuantifierStepBase::PushResult(ExecutionFrame* frame) const {
+  const CelValue& accu = frame->iter_var(accu_slot_);
+  if (kind_ == QuantifierKind::kExistsOne && accu.IsInt64()) {
+    frame->value_stack().Push(CelValue::CreateBool(accu.Int64OrDie() == 1));
+    return;
+  }
+  frame->value_stack().Push(accu);
+}
+
+CelValue QuantifierStepBase::InitialAccumulator() const {
+  return kind_ == QuantifierKind::kExistsOne
+             ? CelValue::CreateInt64(0)
+             : CelValue::CreateBool(kind_ == QuantifierKind::kAll);
+}
+
+// Stack changes of QuantifierStartStep.
+//
+// Stack size before: 1.
+// Stack size after: 0.
+// Stack size on exit: 1.
+util::Status QuantifierStartStep::Evaluate(ExecutionFrame* frame) const {
+  CelValue iter_range = frame->value_stack().Peek();
+  frame->value_stack().Pop(1);
+  if (iter_range.IsMap()) {
+    iter_range = CelValue::CreateList(
+        IterationKeys(iter_range.MapOrDie(), frame->arena()));
+  }
+  if (!iter_range.IsList()) {
+    if (iter_range.IsError()) {
+      frame->value_stack().Push(iter_range);
+      return frame->JumpTo(jump_offset_);
+    }
+    auto* error = google::protobuf::Arena::Create<CelError>(frame->arena());
+    error->set_message("no_matching_overload");
+    frame->value_stack().Push(CelValue::CreateError(error));
+    return frame->JumpTo(jump_offset_);
+  }
+
+  frame->iter_var(range_slot_) = iter_range;
+  frame->iter_var(index_slot_) = CelValue::CreateInt64(-1);
+  frame->iter_var(accu_slot_) = InitialAccumulator();
+  if (IsParallel(frame, parallel_loop_.get(), iter_range.ListOrDie())) {
+    util::Status status = EvaluateParallel(frame);
+    if (!util::IsOk(status)) {
+      return status;
+    }
+    PushResult(frame);
+    return frame->JumpTo(jump_offset_);
+  }
+  if (!Advance(frame)) {
+    PushResult(frame);
+    return frame->JumpTo(jump_offset_);
+  }
+  return util::OkStatus();
+}
+
+namespace {
+
+// Summary of the predicate values over a chunk of the range, in the order of
+// the range. The chunk is folded until the result is decided or evaluation
+// fails.
+struct QuantifierChunk {
+  // Accumulator folded over the chunk, starting from the initial value.
+  CelValue accu;
+  // First unsupported predicate value, reported only if there was no error
+  // before it.
+  bool unsupported = false;
+  // Whether the fold was stopped by the result being decided or by the
+  // failure.
+  bool decided = false;
+  util::Status status;
+};
+
+}  // namespace
+
+util::Status QuantifierStartStep::EvaluateParallel(
+    ExecutionFrame* frame) const {
+  const CelList* range = frame->iter_var(range_slot_).ListOrDie();
+  int64_t size = range->size();
+  int num_chunks = NumChunks(frame, size);
+  int body_begin = frame->pc();
+  int body_end = body_begin + parallel_loop_->body_size;
+
+  std::vector<QuantifierChunk> chunks(num_chunks);
+  // Predicate values after a decided result or a failure are not needed.
+  std::atomic<int64_t> stop_index(size);
+
+  RunChunks(frame, *parallel_loop_, size, num_chunks,
+            [&](int chunk, ExecutionFrame* chunk_frame, int64_t begin,
+                int64_t end) {
+              QuantifierChunk& result = chunks[chunk];
+              result.accu = InitialAccumulator();
+              for (int64_t index = begin; index < end; index++) {
+                if (index > stop_index.load(std::memory_order_relaxed)) {
+                  return;
+                }
+                CelValue predicate;
+                result.status =
+                    EvaluateBody(chunk_frame, range, index, iter_slot_,
+                                 body_begin, body_end, &predicate);
+                if (!util::IsOk(result.status)) {
+                  StopAt(&stop_index, index);
+                  return;
+                }
+                switch (FoldPredicate(kind_, predicate, &result.accu)) {
+                  case FoldResult::kContinue:
+                    break;
+                  case FoldResult::kDecided:
+                    result.decided = true;
+                    StopAt(&stop_index, index);
+                    return;
+                  case FoldResult::kUnsupported:
+                    // Whether it is an error depends on the previous chunks.
+                    result.unsupported = true;
+                    break;
+                }
+              }
+            });
+
+  // Chunk summaries are folded in the order of the range, as the sequential
+  // evaluation would.
+  CelValue& accu = frame->iter_var(accu_slot_);
+  for (const auto& chunk : chunks) {
+    if (kind_ == QuantifierKind::kExistsOne) {
+      if (!util::IsOk(chunk.status)) {
+        return chunk.status;
+      }
+      if (chunk.accu.IsError()) {
+        accu = chunk.accu;
+      } else if (accu.IsInt64()) {
+        accu = CelValue::CreateInt64(accu.Int64OrDie() +
+                                     chunk.accu.Int64OrDie());
+      }
+      continue;
+    }
+    // Unsupported values are reported only before the first error, and
+    // they are never preceded by an error within the chunk.
+    if (!accu.IsError() && chunk.unsupported) {
+      return UnsupportedTypeError();
+    }
+    if (!util::IsOk(chunk.status)) {
+      return chunk.status;
+    }
+    if (chunk.decided) {
+      accu = chunk.accu;
+      return util::OkStatus();
+    }
+    if (!accu.IsError() && chunk.accu.IsError()) {
+      accu = chunk.accu;
+    }
+  }
+  return util::OkStatus();
+}
+
+// Stack changes of QuantifierNextStep.
+//
+// Stack size before: 1.
+// Stack size after: 0.
+// Stack size on exit: 1.
+util::Status QuantifierNextStep::Evaluate(ExecutionFrame* frame) const {
+  CelValue predicate = frame->value_stack().Peek();
+  frame->value_stack().Pop(1);
+
+  switch (FoldPredicate(kind_, predicate, &frame->iter_var(accu_slot_))) {
+    case FoldResult::kContinue:
+      break;
+    case FoldResult::kDecided:
+      PushResult(frame);
+      return util::OkStatus();
+    case FoldResult::kUnsupported:
+      return UnsupportedTypeError();
+  }
+
+  if (!Advance(frame)) {
+    PushResult(frame);
+    return util::OkStatus();
+  }
+  return frame->JumpTo(jump_offset_);
+}
+
+ParallelListLoopStep::ParallelListLoopStep(
+    ParallelLoop loop, int iter_slot, int accu_slot,
+    const google::api::expr::v1alpha1::Expr* expr)
+    : ExpressionStepBase(expr, false),
+      loop_(std::move(loop)),
+      iter_slot_(iter_slot),
+      accu_slot_(accu_slot),
+      jump_offset_(0) {}
+
+// Stack changes of ParallelListLoopStep.
+//
+// Stack before, as prepared for ComprehensionNextStep:
+// 0. (dummy)
+// 1. iter_range
+// 2. -1
+// 3. (dummy)
+// 4. accu_init (list accumulator)
+//
+// Stack after: unchanged, if the loop is not evaluated in parallel.
+// Stack on exit:
+// 0. result
+util::Status ParallelListLoopStep::Evaluate(ExecutionFrame* frame) const {
+  CelValue iter_range = frame->value_stack().GetSpan(5)[1];
+  if (!iter_range.IsList() ||
+      !IsParallel(frame, &loop_, iter_range.ListOrDie())) {
+    return util::OkStatus();
+  }
+  const CelList* range = iter_range.ListOrDie();
+  int64_t size = range->size();
+  int num_chunks = NumChunks(frame, size);
+  int body_begin = frame->pc() + loop_.body_offset;
+  int body_end = body_begin + loop_.body_size;
+
+  // Accumulators of the chunks, or the failures.
+  std::vector<CelValue> accus(num_chunks);
+  std::vector<util::Status> statuses(num_chunks, util::OkStatus());
+  std::atomic<int64_t> stop_index(size);
+
+  RunChunks(frame, loop_, size, num_chunks,
+            [&](int chunk, ExecutionFrame* chunk_frame, int64_t begin,
+                int64_t end) {
+              CelValue& accu = chunk_frame->iter_var(accu_slot_);
+              accu = CelValue::CreateList(
+                  google::protobuf::Arena::Create<MutableListImpl>(
+                      chunk_frame->arena()));
+              for (int64_t index = begin; index < end; index++) {
+                if (index > stop_index.load(std::memory_order_relaxed)) {
+                  return;
+                }
+                CelValue loop_step;
+                statuses[chunk] =
+                    EvaluateBody(chunk_frame, range, index, iter_slot_,
+                                 body_begin, body_end, &loop_step);
+                if (!util::IsOk(statuses[chunk])) {
+                  StopAt(&stop_index, index);
+                  return;
+                }
+                accu = loop_step;
+              }
+              accus[chunk] = accu;
+            });
+
+  // The last error replaces the accumulator, as the conditional operator of
+  // filter does in the sequential evaluation.
+  CelValue result;
+  for (int chunk = 0; chunk < num_chunks; chunk++) {
+    if (!util::IsOk(statuses[chunk])) {
+      return statuses[chunk];
+    }
+    if (accus[chunk].IsError()) {
+      result = accus[chunk];
+    }
+  }
+  if (!result.IsError()) {
+    auto* accumulator =
+        google::protobuf::Arena::Create<MutableListImpl>(frame->arena());
+    for (const auto& accu : accus) {
+      accu.ListOrDie()->ForEach([accumulator](const CelValue& element) {
+        accumulator->Append(element);
+        return true;
+      });
+    }
+    result = CelValue::CreateList(accumulator);
+  }
+
+  frame->value_stack().Pop(5);
+  frame->value_stack().Push(result);
+  frame->iter_var(accu_slot_) = result;
+  return frame->JumpTo(jump_offset_);
+}
+
+class ListAccumulatorStep : public ExpressionStepBase {
+ public:
+  explicit ListAccumulatorStep(const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override {
+    // The accumulator is owned by the arena of the evaluation, and is only
+    // modified until the comprehension finishes.
+    auto* accumulator =
+        google::protobuf::Arena::Create<MutableListImpl>(frame->arena());
+    frame->value_stack().Push(CelValue::CreateList(accumulator));
+    return util::OkStatus();
+  }
+};
+
+std::unique_ptr<ExpressionStep> CreateListAccumulatorStep(
+    const google::api::expr::v1alpha1::Expr* expr) {
+  return absl::make_unique<ListAccumulatorStep>(expr);
+}
+
+class ListAppendStep : public ExpressionStepBase {
+ public:
+  ListAppendStep(int num_elements,
+                 const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), num_elements_(num_elements) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  int num_elements_;
+};
+
+std::unique_ptr<ExpressionStep> CreateListAppendStep(
+    int num_elements, const google::api::expr::v1alpha1::Expr* expr) {
+  return absl::make_unique<ListAppendStep>(num_elements, expr);
+}
+
+// Stack changes of ListAppendStep.
+//
+// Stack size before: num_elements + 1.
+// Stack size after: 1.
+util::Status ListAppendStep::Evaluate(ExecutionFrame* frame) const {
+  auto args = frame->value_stack().GetSpan(num_elements_ + 1);
+  const CelValue& accumulator_value = args[0];
+  if (accumulator_value.IsList()) {
+    // The accumulator variable is only ever bound to the list created by
+    // ListAccumulatorStep, or to an error.
+    auto* accumulator = static_cast<MutableListImpl*>(
+        const_cast<CelList*>(accumulator_value.ListOrDie()));
+    for (int i = 1; i <= num_elements_; i++) {
+      accumulator->Append(args[i]);
+    }
+  } else if (!accumulator_value.IsError()) {
+    auto message =
+        absl::StrCat("ListAppendStep: want list, got ",
+                     CelValue::TypeName(accumulator_value.type()));
+    return util::MakeStatus(google::rpc::Code::INTERNAL, message);
+  }
+  frame->value_stack().Pop(num_elements_);
+  return util::OkStatus();
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
@@ -1,11 +1,15 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_COMPREHENSION_STEP_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_EVAL_COMPREHENSION_STEP_H_
 
+#include <string>
+#include <vector>
+
 #include "eval/eval/evaluator_core.h"
 #include "eval/eval/expression_step_base.h"
 #include "eval/public/activation.h"
 #include "eval/public/cel_function.h"
 #include "eval/public/cel_value.h"
+#include "absl/memory/memory.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 
 namespace google {
@@ -13,9 +17,11 @@ namespace api {
 namespace expr {
 namespace runtime {
 
+// Comprehension variables are stored in frame slots, assigned at build time.
+// iter_slot holds iter_var value, accu_slot holds accu_var value.
 class ComprehensionNextStep : public ExpressionStepBase {
  public:
-  ComprehensionNextStep(const std::string& accu_var, const std::string& iter_var,
+  ComprehensionNextStep(int iter_slot, int accu_slot,
                         const google::api::expr::v1alpha1::Expr* expr);
 
   void set_jump_offset(int offset);
@@ -24,16 +30,15 @@ class ComprehensionNextStep : public ExpressionStepBase {
   util::Status Evaluate(ExecutionFrame* frame) const override;
 
  private:
-  std::string accu_var_;
-  std::string iter_var_;
+  int iter_slot_;
+  int accu_slot_;
   int jump_offset_;
   int error_jump_offset_;
 };
 
 class ComprehensionCondStep : public ExpressionStepBase {
  public:
-  ComprehensionCondStep(const std::string& accu_var, const std::string& iter_var,
-                        bool shortcircuiting,
+  ComprehensionCondStep(bool shortcircuiting,
                         const google::api::expr::v1alpha1::Expr* expr);
 
   void set_jump_offset(int offset);
@@ -41,20 +46,25 @@ class ComprehensionCondStep : public ExpressionStepBase {
   util::Status Evaluate(ExecutionFrame* frame) const override;
 
  private:
-  std::string iter_var_;
   int jump_offset_;
   bool shortcircuiting_;
 };
 
+// If list_accumulator is set, the result of the comprehension is its list
+// accumulator, which is frozen into an immutable list.
 class ComprehensionFinish : public ExpressionStepBase {
  public:
-  ComprehensionFinish(const std::string& accu_var, const std::string& iter_var,
-                      const google::api::expr::v1alpha1::Expr* expr);
+  explicit ComprehensionFinish(const google::api::expr::v1alpha1::Expr* expr,
+                               bool list_accumulator = false);
 
   util::Status Evaluate(ExecutionFrame* frame) const override;
 
+  bool IsComprehensionExit(int stack_size_change) const override {
+    return true;
+  }
+
  private:
-  std::string accu_var_;
+  bool list_accumulator_;
 };
 
 // Creates a step that lists the map keys if the top of the stack is a map,
@@ -62,6 +72,150 @@ class ComprehensionFinish : public ExpressionStepBase {
 std::unique_ptr<ExpressionStep> CreateListKeysStep(
     const google::api::expr::v1alpha1::Expr* expr);
 
+// Kinds of comprehensions expanded from quantifier macros, evaluated by
+// fused loop steps.
+enum class QuantifierKind {
+  // all(x, pred): accu && pred, while accu is not false.
+  kAll,
+  // exists(x, pred): accu || pred, while accu is not true.
+  kExists,
+  // exists_one(x, pred): pred ? accu + 1 : accu, then accu == 1.
+  kExistsOne,
+};
+
+// Parallel evaluation of a comprehension loop. When the frame has an
+// executor and the range has at least min_range_size elements, the range is
+// split into chunks, evaluated on separate frames, and the results of the
+// chunks are merged as the sequential evaluation would do.
+// Only loops with bodies free of side effects are evaluated in parallel.
+struct ParallelLoop {
+  int min_range_size = 0;
+  // Position of the loop body on the path, relative to the step following
+  // the one evaluating the loop, and the number of steps in it.
+  int body_offset = 0;
+  int body_size = 0;
+  // Free variables referenced by the body. Their values are looked up
+  // before the parallel evaluation, so that value producers are not invoked
+  // concurrently.
+  std::vector<std::string> variables;
+};
+
+// Fused loop of quantifier comprehensions. Only the predicate is evaluated
+// on the value stack, the loop state is kept in four consecutive frame
+// slots starting at first_slot: the current element (iter_var), the
+// accumulator, iter_range and the current index in it.
+//
+// What to put on ExecutionPath:     stack size
+//  0. iter_range              (dep) 1
+//  1. QuantifierStartStep           0, or 1 on exit (result)
+//  2. predicate               (dep) 1
+//  3. QuantifierNextStep            0 and goto 2., or 1 on exit (result)
+//
+// The steps come from the AST: the result they push on exit is traced as the
+// value of the comprehension.
+class QuantifierStepBase : public ExpressionStepBase {
+ public:
+  QuantifierStepBase(QuantifierKind kind, int first_slot,
+                     const google::api::expr::v1alpha1::Expr* expr);
+
+  void set_jump_offset(int offset) { jump_offset_ = offset; }
+
+  // The steps pop the top of the stack while the loop goes on, and replace
+  // it with the result when the loop exits.
+  bool IsComprehensionExit(int stack_size_change) const override {
+    return stack_size_change == 0;
+  }
+
+ protected:
+  // Moves to the next element of iter_range, returns false if there is none.
+  bool Advance(ExecutionFrame* frame) const;
+
+  // Pushes the result of the comprehension.
+  void PushResult(ExecutionFrame* frame) const;
+
+  CelValue InitialAccumulator() const;
+
+  QuantifierKind kind_;
+  int iter_slot_;
+  int accu_slot_;
+  int range_slot_;
+  int index_slot_;
+  int jump_offset_;
+};
+
+// Initializes the loop with iter_range from the top of the stack, and moves
+// to the first element. Jumps past QuantifierNextStep when the range is
+// empty or not a container.
+// The predicate directly follows the step; ParallelLoop::body_offset is
+// ignored.
+class QuantifierStartStep : public QuantifierStepBase {
+ public:
+  QuantifierStartStep(QuantifierKind kind, int first_slot,
+                      const google::api::expr::v1alpha1::Expr* expr)
+      : QuantifierStepBase(kind, first_slot, expr) {}
+
+  void set_parallel_loop(ParallelLoop loop) {
+    parallel_loop_ = absl::make_unique<ParallelLoop>(std::move(loop));
+  }
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  // Evaluates all the predicates, leaving the result in the accumulator
+  // slot.
+  util::Status EvaluateParallel(ExecutionFrame* frame) const;
+
+  std::unique_ptr<const ParallelLoop> parallel_loop_;
+};
+
+// Folds the predicate value from the top of the stack into the accumulator,
+// and moves to the next element, jumping back to the predicate. Falls
+// through with the result on the stack once the loop is done.
+class QuantifierNextStep : public QuantifierStepBase {
+ public:
+  QuantifierNextStep(QuantifierKind kind, int first_slot,
+                     const google::api::expr::v1alpha1::Expr* expr)
+      : QuantifierStepBase(kind, first_slot, expr) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+};
+
+// List accumulators replace the "accu + [elements]" pattern of comprehensions
+// expanded from map and filter macros, which would otherwise copy the
+// accumulated list on each iteration.
+//
+// Creates a step that pushes a new empty list accumulator.
+std::unique_ptr<ExpressionStep> CreateListAccumulatorStep(
+    const google::api::expr::v1alpha1::Expr* expr);
+
+// Evaluates a comprehension with the list accumulator in parallel, then
+// jumps to its result. The step is placed before ComprehensionNextStep,
+// and falls through to the sequential evaluation if the loop is not
+// evaluated in parallel. Requires a loop condition that is always true.
+class ParallelListLoopStep : public ExpressionStepBase {
+ public:
+  ParallelListLoopStep(ParallelLoop loop, int iter_slot, int accu_slot,
+                       const google::api::expr::v1alpha1::Expr* expr);
+
+  void set_jump_offset(int offset) { jump_offset_ = offset; }
+
+  ParallelLoop* mutable_loop() { return &loop_; }
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  ParallelLoop loop_;
+  int iter_slot_;
+  int accu_slot_;
+  int jump_offset_;
+};
+
+// Creates a step that appends num_elements values from the top of the stack
+// to the list accumulator below them, leaving the accumulator on the stack.
+// Errors in place of the accumulator are propagated.
+std::unique_ptr<ExpressionStep> CreateListAppendStep(
+    int num_elements, const google::api::expr::v1alpha1::Expr* expr);
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
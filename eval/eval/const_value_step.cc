@@ -20,6 +20,12 @@ class ConstValueStep : public ExpressionStepBase {
 
   util::Status Evaluate(ExecutionFrame* context) const override;
 
+  bool Lower(Instruction* instruction) const override {
+    instruction->opcode = Opcode::kConst;
+    instruction->value = value_;
+    return true;
+  }
+
  private:
   CelValue value_;
 };
@@ -74,6 +80,13 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
   return std::move(step);
 }
 
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
+    const CelValue& value, const Expr* expr, bool comes_from_ast) {
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<ConstValueStep>(expr, value, comes_from_ast);
+  return std::move(step);
+}
+
 // Factory method for Constant(Enum value) - based Execution step
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
     const google::protobuf::EnumValueDescriptor* value_descriptor, const Expr* expr) {
@@ -15,6 +15,12 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
     const google::api::expr::v1alpha1::Constant* const_expr,
     const google::api::expr::v1alpha1::Expr* expr, bool comes_from_ast = true);
 
+// Factory method for Execution step producing a value computed in advance,
+// e.g. by constant folding.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
+    const CelValue& value, const google::api::expr::v1alpha1::Expr* expr,
+    bool comes_from_ast = true);
+
 // Factory method for Constant(Enum value) - based Execution step
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateConstValueStep(
     const google::protobuf::EnumValueDescriptor* value_descriptor,
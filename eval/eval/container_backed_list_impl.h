@@ -1,6 +1,9 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_CONTAINER_BACKED_LIST_IMPL_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_EVAL_CONTAINER_BACKED_LIST_IMPL_H_
 
+#include <atomic>
+
+#include "eval/eval/list_index.h"
 #include "eval/public/cel_value.h"
 #include "absl/types/span.h"
 
@@ -16,7 +19,9 @@ class ContainerBackedListImpl : public CelList {
   // message contains the "repeated" field
   // descriptor FieldDescriptor for the field
   explicit ContainerBackedListImpl(std::vector<CelValue> values)
-      : values_(std::move(values)) {}
+      : values_(std::move(values)), lookups_(0), index_(nullptr) {}
+
+  ~ContainerBackedListImpl() override { delete index_.load(); }
 
   // List size.
   int size() const override { return values_.size(); }
@@ -24,6 +29,73 @@ class ContainerBackedListImpl : public CelList {
   // List element access operator.
   CelValue operator[](int index) const override { return values_[index]; }
 
+  absl::optional<absl::Span<const CelValue>> AsSpan() const override {
+    return absl::MakeConstSpan(values_);
+  }
+
+  // Membership checks scan the list until kIndexedLookups of them are made,
+  // then the elements are indexed. Lists checked repeatedly, e.g. bound in
+  // the activation shared by evaluations, are then checked in constant time.
+  bool Contains(const CelValue& value) const override {
+    const CelListIndex* index = index_.load(std::memory_order_acquire);
+    if (index == nullptr) {
+      if (values_.size() < kMinIndexedSize ||
+          lookups_.fetch_add(1, std::memory_order_relaxed) < kIndexedLookups) {
+        return CelList::Contains(value);
+      }
+      index = BuildIndex();
+    }
+    return index->Contains(value);
+  }
+
+ private:
+  static constexpr int kIndexedLookups = 8;
+  static constexpr size_t kMinIndexedSize = 16;
+
+  // Builds the index, unless another thread built it concurrently.
+  const CelListIndex* BuildIndex() const {
+    auto index = new CelListIndex(*this);
+    const CelListIndex* expected = nullptr;
+    if (!index_.compare_exchange_strong(expected, index,
+                                        std::memory_order_acq_rel)) {
+      delete index;
+      return expected;
+    }
+    return index;
+  }
+
+  std::vector<CelValue> values_;
+  mutable std::atomic<int> lookups_;
+  mutable std::atomic<const CelListIndex*> index_;
+};
+
+// Append-only CelList used to accumulate list results of comprehensions
+// in place. Once the accumulation is complete, the list is frozen into
+// an immutable ContainerBackedListImpl.
+class MutableListImpl : public CelList {
+ public:
+  MutableListImpl() {}
+
+  // List size.
+  int size() const override { return values_.size(); }
+
+  // List element access operator.
+  CelValue operator[](int index) const override { return values_[index]; }
+
+  // The span is invalidated by Append.
+  absl::optional<absl::Span<const CelValue>> AsSpan() const override {
+    return absl::MakeConstSpan(values_);
+  }
+
+  void Append(const CelValue& value) { values_.push_back(value); }
+
+  // Moves the elements to a new immutable list allocated on the arena.
+  // The builder is left empty.
+  const CelList* Freeze(google::protobuf::Arena* arena) {
+    return google::protobuf::Arena::Create<ContainerBackedListImpl>(
+        arena, std::move(values_));
+  }
+
  private:
   std::vector<CelValue> values_;
 };
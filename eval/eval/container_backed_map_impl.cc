@@ -30,6 +30,14 @@ class HasherOp {
     return absl::Hash<absl::string_view>()(arg.value());
   }
 
+  size_t operator()(const absl::Duration& arg) {
+    return absl::Hash<absl::Duration>()(arg);
+  }
+
+  size_t operator()(const absl::Time& arg) {
+    return absl::Hash<absl::Time>()(arg);
+  }
+
   // Needed for successful compilation resolution.
   size_t operator()(const std::nullptr_t& arg) { return 0; }
 };
@@ -100,19 +108,30 @@ class ContainerBackedMapImpl : public CelMap {
   }
 
   // Map size.
-  int size() const override { return values_map_.size(); }
+  int size() const override { return values_.size(); }
 
   // Map element access operator.
   absl::optional<CelValue> operator[](CelValue cel_key) const override {
-    auto item = values_map_.find(cel_key);
-    if (item == values_map_.end()) {
+    auto item = index_.find(cel_key);
+    if (item == index_.end()) {
       return {};
     }
-    return item->second;
+    return values_[item->second];
   }
 
   const CelList* ListKeys() const override { return &key_list_; }
 
+  // Entries are iterated in the insertion order without lookups.
+  bool ForEach(absl::FunctionRef<bool(const CelValue& key,
+                                      const CelValue& value)>
+                   visitor) const override {
+    absl::Span<const CelValue> keys = key_list_.keys();
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (!visitor(keys[i], values_[i])) return false;
+    }
+    return true;
+  }
+
  private:
   class KeyList : public CelList {
    public:
@@ -120,6 +139,14 @@ class ContainerBackedMapImpl : public CelMap {
 
     CelValue operator[](int index) const override { return keys_[index]; }
 
+    absl::optional<absl::Span<const CelValue>> AsSpan() const override {
+      return keys();
+    }
+
+    absl::Span<const CelValue> keys() const {
+      return absl::MakeConstSpan(keys_);
+    }
+
     void Add(const CelValue& key) { keys_.push_back(key); }
 
    private:
@@ -130,19 +157,22 @@ class ContainerBackedMapImpl : public CelMap {
 
   bool AddItems(absl::Span<std::pair<CelValue, CelValue>> key_values) {
     for (const auto& item : key_values) {
-      auto result = values_map_.emplace(item.first, item.second);
+      auto result = index_.emplace(item.first, values_.size());
 
       // Failed to insert pair into map - addition failed.
       if (!result.second) {
         return false;
       }
       key_list_.Add(item.first);
+      values_.push_back(item.second);
     }
     return true;
   }
 
-  absl::node_hash_map<CelValue, CelValue, Hasher, Equal> values_map_;
+  // Positions of the entries in the key list and in values_.
+  absl::node_hash_map<CelValue, size_t, Hasher, Equal> index_;
   KeyList key_list_;
+  std::vector<CelValue> values_;
 };
 
 }  // namespace
@@ -120,6 +120,37 @@ TEST(ContainerBackedMapImplTest, TestMapString) {
   ASSERT_FALSE(lookup3);
 }
 
+TEST(ContainerBackedMapImplTest, TestForEach) {
+  std::vector<std::pair<CelValue, CelValue>> args = {
+      {CelValue::CreateInt64(3), CelValue::CreateInt64(30)},
+      {CelValue::CreateInt64(1), CelValue::CreateInt64(10)},
+      {CelValue::CreateInt64(2), CelValue::CreateInt64(20)}};
+  auto cel_map = CreateContainerBackedMap(
+      absl::Span<std::pair<CelValue, CelValue>>(args.data(), args.size()));
+  ASSERT_THAT(cel_map, Not(IsNull()));
+
+  // Entries are visited in the order of the key list.
+  auto keys = cel_map->ListKeys()->AsSpan();
+  ASSERT_TRUE(keys.has_value());
+  ASSERT_THAT(keys->size(), Eq(3));
+  std::vector<int64_t> visited;
+  EXPECT_TRUE(cel_map->ForEach([&](const CelValue& key, const CelValue& value) {
+    EXPECT_THAT(key.Int64OrDie(), Eq((*keys)[visited.size()].Int64OrDie()));
+    EXPECT_THAT(value.Int64OrDie(), Eq(key.Int64OrDie() * 10));
+    visited.push_back(key.Int64OrDie());
+    return true;
+  }));
+  EXPECT_THAT(visited, testing::ElementsAre(3, 1, 2));
+
+  // The iteration stops when the visitor returns false.
+  visited.clear();
+  EXPECT_FALSE(cel_map->ForEach([&](const CelValue& key, const CelValue&) {
+    visited.push_back(key.Int64OrDie());
+    return visited.size() < 2;
+  }));
+  EXPECT_THAT(visited, testing::ElementsAre(3, 1));
+}
+
 }  // namespace
 
 }  // namespace runtime
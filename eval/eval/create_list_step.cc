@@ -25,11 +25,6 @@ util::Status CreateListStep::Evaluate(ExecutionFrame* frame) const {
                         "CreateListStep: list size is <0");
   }
 
-  if (!frame->value_stack().HasEnough(list_size_)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL,
-                        "CreateListStep: stack undeflow");
-  }
-
   auto args = frame->value_stack().GetSpan(list_size_);
 
   CelList* cel_list = google::protobuf::Arena::Create<ContainerBackedListImpl>(
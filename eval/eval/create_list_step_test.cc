@@ -47,31 +47,6 @@ util::StatusOr<CelValue> RunExpression(const std::vector<int64_t>& values,
   return cel_expr.Evaluate(activation, arena);
 }
 
-// Tests error when not enough list elements are on the stack during list
-// creation.
-TEST(CreateListStepTest, TestCreateListStackUndeflow) {
-  ExecutionPath path;
-  Expr dummy_expr;
-
-  auto create_list = dummy_expr.mutable_list_expr();
-  auto expr0 = create_list->add_elements();
-  expr0->mutable_const_expr()->set_int64_value(1);
-
-  auto step0_status = CreateCreateListStep(create_list, &dummy_expr);
-
-  ASSERT_TRUE(util::IsOk(step0_status));
-
-  path.push_back(std::move(step0_status.ValueOrDie()));
-
-  CelExpressionFlatImpl cel_expr(&dummy_expr, std::move(path));
-  Activation activation;
-
-  google::protobuf::Arena arena;
-
-  auto status = cel_expr.Evaluate(activation, &arena);
-  ASSERT_FALSE(util::IsOk(status));
-}
-
 TEST(CreateListStepTest, CreateListEmpty) {
   google::protobuf::Arena arena;
   auto eval_result = RunExpression({}, &arena);
@@ -310,6 +310,34 @@ TEST(CreateCreateStructStepTest, TestSetMessageField) {
   EXPECT_THAT(test_msg.message_value(), EqualsProto(orig_msg));
 }
 
+// Test that inline durations and timestamps are set to message fields.
+TEST(CreateCreateStructStepTest, TestSetDurationAndTimestampFields) {
+  Arena arena;
+  TestMessage test_msg;
+
+  ASSERT_NO_FATAL_FAILURE(RunExpressionAndGetMessage(
+      "duration_value",
+      CelValue::CreateDuration(absl::Seconds(-2) - absl::Nanoseconds(3)),
+      &arena, &test_msg));
+  EXPECT_EQ(test_msg.duration_value().seconds(), -2);
+  EXPECT_EQ(test_msg.duration_value().nanos(), -3);
+
+  ASSERT_NO_FATAL_FAILURE(RunExpressionAndGetMessage(
+      "timestamp_value",
+      CelValue::CreateTimestamp(absl::FromUnixSeconds(100) +
+                                absl::Nanoseconds(5)),
+      &arena, &test_msg));
+  EXPECT_EQ(test_msg.timestamp_value().seconds(), 100);
+  EXPECT_EQ(test_msg.timestamp_value().nanos(), 5);
+
+  // Out of the range of google.protobuf.Timestamp.
+  auto status = RunExpression(
+      "timestamp_value", CelValue::CreateTimestamp(absl::InfiniteFuture()),
+      &arena);
+  ASSERT_TRUE(util::IsOk(status));
+  EXPECT_TRUE(status.ValueOrDie().IsError());
+}
+
 // Test that fields of type Message are set correctly.
 TEST(CreateCreateStructStepTest, TestSetEnumField) {
   Arena arena;
@@ -1,5 +1,10 @@
 #include "eval/eval/evaluator_core.h"
 
+#include <algorithm>
+
+#include "eval/eval/container_backed_list_impl.h"
+#include "absl/memory/memory.h"
+
 namespace google {
 namespace api {
 namespace expr {
@@ -7,6 +12,31 @@ namespace runtime {
 
 using google::api::expr::v1alpha1::Expr;
 
+namespace {
+
+// Lists accumulated in place by map and filter comprehensions are modified
+// after they are traced, and emptied when the comprehension finishes.
+// The listener is passed copies of them.
+CelValue TracedValue(const CelValue& value, google::protobuf::Arena* arena) {
+  if (!value.IsList()) {
+    return value;
+  }
+  auto accumulator = dynamic_cast<const MutableListImpl*>(value.ListOrDie());
+  if (accumulator == nullptr) {
+    return value;
+  }
+  std::vector<CelValue> values;
+  values.reserve(accumulator->size());
+  for (int i = 0; i < accumulator->size(); i++) {
+    values.push_back((*accumulator)[i]);
+  }
+  return CelValue::CreateList(
+      google::protobuf::Arena::Create<ContainerBackedListImpl>(arena,
+                                                     std::move(values)));
+}
+
+}  // namespace
+
 const ExpressionStep* ExecutionFrame::Next() {
   size_t end_pos = execution_path_->size();
 
@@ -17,29 +47,102 @@ const ExpressionStep* ExecutionFrame::Next() {
   return nullptr;
 }
 
+util::Status ExecutionFrame::EvaluateUntil(int end) {
+  while (pc_ < end) {
+    const ExpressionStep* step = (*execution_path_)[pc_++].get();
+    util::Status status = step->Evaluate(this);
+    if (!util::IsOk(status)) {
+      return status;
+    }
+  }
+  return util::OkStatus();
+}
+
+CelExpressionFlatEvaluationState::CelExpressionFlatEvaluationState(
+    int value_stack_size, int iter_var_slots, google::protobuf::Arena* arena)
+    : value_stack_(value_stack_size),
+      iter_vars_(iter_var_slots),
+      arena_(arena) {}
+
+void CelExpressionFlatEvaluationState::Reset() {
+  value_stack_.Clear();
+  // Release references to values of the previous evaluation.
+  std::fill(iter_vars_.begin(), iter_vars_.end(), CelValue());
+}
+
 util::StatusOr<CelValue> CelExpressionFlatImpl::Evaluate(
     const Activation& activation, google::protobuf::Arena* arena) const {
-  return Trace(activation, arena, CelEvaluationListener());
+  CelExpressionFlatEvaluationState state(max_stack_depth_, iter_var_slots_,
+                                         arena);
+  return Evaluate(activation, &state);
 }
 
 util::StatusOr<CelValue> CelExpressionFlatImpl::Trace(
     const Activation& activation, google::protobuf::Arena* arena,
     CelEvaluationListener callback) const {
-  ExecutionFrame frame(&path_, activation, arena);
+  CelExpressionFlatEvaluationState state(max_stack_depth_, iter_var_slots_,
+                                         arena);
+  return Trace(activation, &state, callback);
+}
+
+std::unique_ptr<CelEvaluationState> CelExpressionFlatImpl::InitializeState(
+    google::protobuf::Arena* arena) const {
+  return absl::make_unique<CelExpressionFlatEvaluationState>(
+      max_stack_depth_, iter_var_slots_, arena);
+}
+
+util::Status CelExpressionFlatImpl::PrepareState(
+    CelExpressionFlatEvaluationState* state) const {
+  if (state == nullptr || state->value_stack().max_size() < max_stack_depth_ ||
+      state->iter_vars().size() < iter_var_slots_) {
+    return InvalidStateError();
+  }
+  state->Reset();
+  return util::OkStatus();
+}
+
+util::StatusOr<CelValue> CelExpressionFlatImpl::Evaluate(
+    const Activation& activation, CelEvaluationState* state) const {
+  return EvaluateImpl<false>(
+      activation, dynamic_cast<CelExpressionFlatEvaluationState*>(state),
+      nullptr);
+}
+
+util::StatusOr<CelValue> CelExpressionFlatImpl::Trace(
+    const Activation& activation, CelEvaluationState* state,
+    CelEvaluationListener callback) const {
+  auto flat_state = dynamic_cast<CelExpressionFlatEvaluationState*>(state);
+  if (!callback) {
+    return EvaluateImpl<false>(activation, flat_state, nullptr);
+  }
+  return EvaluateImpl<true>(activation, flat_state, &callback);
+}
+
+template <bool kTrace>
+util::StatusOr<CelValue> CelExpressionFlatImpl::EvaluateImpl(
+    const Activation& activation, CelExpressionFlatEvaluationState* state,
+    const CelEvaluationListener* callback) const {
+  util::Status status = PrepareState(state);
+  if (!util::IsOk(status)) {
+    return status;
+  }
+
+  ExecutionFrame frame(&path_, activation, state, &variable_slots_, executor_);
 
   ValueStack* stack = &frame.value_stack();
   size_t initial_stack_size = stack->size();
   const ExpressionStep* expr;
-  const Expr* current;
+  const Expr* current = nullptr;
   while ((expr = frame.Next()) != nullptr) {
-    auto status = expr->Evaluate(&frame);
+    int stack_size_before = kTrace ? stack->size() : 0;
+    status = expr->Evaluate(&frame);
     if (!util::IsOk(status)) {
       return status;
     }
-    if (!callback) {
+    // Resolved at compile time: untraced instantiation stops here.
+    if (!kTrace) {
       continue;
     }
-    auto previous = current;
     current = expr->expr();
     if (!expr->ComesFromAst()) {
       // This step was added during compilation (e.g. Int64ConstImpl).
@@ -49,11 +152,12 @@ util::StatusOr<CelValue> CelExpressionFlatImpl::Trace(
       continue;
     }
     if (current->expr_kind_case() == Expr::kComprehensionExpr &&
-        previous != &current->comprehension_expr().result()) {
+        !expr->IsComprehensionExit(stack->size() - stack_size_before)) {
       // Callback is called with kComprehensionExpr multiple times
       // by ComprehensionNextStep, ComprehensionCondStep and
       // ComprehensionFinish. We should produce a value in trace only after
-      // the final case, i.e. after ComprehensionFinish.
+      // the final case, i.e. after ComprehensionFinish, or the exit of a
+      // fused quantifier loop.
       continue;
     }
     if (stack->size() == 0) {
@@ -61,7 +165,8 @@ util::StatusOr<CelValue> CelExpressionFlatImpl::Trace(
                     "Try to disable short-circuiting.";
       continue;
     }
-    auto status2 = callback(current, stack->Peek(), arena);
+    CelValue value = TracedValue(stack->Peek(), frame.arena());
+    auto status2 = (*callback)(current, value, frame.arena());
     if (!util::IsOk(status2)) {
       return status2;
     }
@@ -1,9 +1,13 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_EVALUATOR_CORE_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_EVAL_EVALUATOR_CORE_H_
 
+#include "google/protobuf/field_mask.pb.h"
 #include "eval/public/activation.h"
+#include "eval/public/cel_executor.h"
 #include "eval/public/cel_expression.h"
+#include "eval/public/cel_function.h"
 #include "eval/public/cel_value.h"
+#include "absl/types/span.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 
 namespace google {
@@ -14,6 +18,59 @@ namespace runtime {
 // Forward declaration of ExecutionFrame, to resolve circular dependency.
 class ExecutionFrame;
 
+class ExpressionStep;
+
+// Operation codes of the instruction engine (see instruction_engine.h).
+enum class Opcode {
+  // Evaluates the step with ExpressionStep::Evaluate.
+  kStep,
+  // Pushes constant value.
+  kConst,
+  // Pushes value bound to the free variable slot. Falls back to the step if
+  // the slot is not bound.
+  kIdent,
+  // Pushes comprehension variable stored in the slot.
+  kIterVar,
+  // Invokes function overload matching the arguments on top of the stack.
+  kCall,
+  // Selects singular message field. Falls back to the step for other
+  // operands.
+  kSelect,
+  // Unconditional jump.
+  kJump,
+  // Jumps if the top of the stack is bool equal to the condition.
+  kCondJump,
+  // Jumps if the top of the stack is an error.
+  kErrorJump,
+};
+
+// Instruction is the representation of ExpressionStep with operands stored
+// inline, executed by the experimental instruction engine.
+class OverloadCache;
+class FieldLookupCache;
+
+struct Instruction {
+  Opcode opcode = Opcode::kStep;
+  // kCondJump: value the top of the stack is compared to.
+  bool condition = false;
+  // kCondJump: whether the compared value is kept on the stack.
+  bool leave_on_stack = false;
+  // Jump offset, slot index or number of function arguments.
+  int operand = 0;
+  // kConst: value to push.
+  CelValue value;
+  // kCall: overloads to choose from.
+  absl::Span<const CelFunction* const> overloads;
+  // kCall: cache of the overloads matched at the call site.
+  OverloadCache* overload_cache = nullptr;
+  // kSelect: name of the field.
+  const std::string* field = nullptr;
+  // kSelect: cache of the fields found at the select site.
+  FieldLookupCache* field_cache = nullptr;
+  // Step the instruction was lowered from.
+  const ExpressionStep* step = nullptr;
+};
+
 // Class Expression represents single execution step.
 class ExpressionStep {
  public:
@@ -35,6 +92,18 @@ class ExpressionStep {
 
   // Returns if the execution step comes from AST.
   virtual bool ComesFromAst() const = 0;
+
+  // Returns if the step finished the evaluation of a comprehension, leaving
+  // its result on top of the stack, given the change of the stack size by
+  // the step. Other steps of comprehensions are not traced.
+  virtual bool IsComprehensionExit(int stack_size_change) const {
+    return false;
+  }
+
+  // Describes the step as an instruction of the instruction engine.
+  // Returns false if there is no dedicated opcode for the step, in which
+  // case the engine evaluates it with Evaluate.
+  virtual bool Lower(Instruction* instruction) const { return false; }
 };
 
 // CelValue stack.
@@ -43,46 +112,114 @@ class ExpressionStep {
 using ExecutionPath = std::vector<std::unique_ptr<const ExpressionStep>>;
 
 // CelValue stack.
-// Implementation is based on vector to allow passing parameters from
+// Capacity is fixed to the maximum stack depth computed at build time, so
+// pushes need no growth checks. Small stacks are stored inline, larger ones
+// use a single allocation.
+// Values are stored contiguously to allow passing parameters from
 // stack as Span<>.
+// Underflow and overflow are programming errors of the execution path.
+// Pushes are checked in all builds, so that a miscount can not write past
+// the storage; other operations are only checked in debug builds.
 class ValueStack {
  public:
-  ValueStack() = default;
+  // max_size is the maximum number of values on the stack.
+  explicit ValueStack(int max_size)
+      : heap_storage_(max_size > kInlineSize ? new CelValue[max_size]
+                                             : nullptr),
+        data_(heap_storage_ ? heap_storage_.get() : inline_storage_),
+        size_(0),
+        max_size_(max_size) {}
+
+  // Non-copyable
+  ValueStack(const ValueStack&) = delete;
+  ValueStack& operator=(const ValueStack&) = delete;
 
   // Stack size.
-  int size() const { return stack_.size(); }
+  int size() const { return size_; }
+
+  // Maximum stack size.
+  int max_size() const { return max_size_; }
 
   // Check that stack has enough elements.
-  bool HasEnough(int size) const { return stack_.size() >= size; }
+  bool HasEnough(int size) const { return size_ >= size; }
 
   // Gets the last size elements of the stack.
   // Checking that stack has enough elements is caller's responsibility.
-  // Please note that calls to Push may invalidate returned Span object.
+  // Please note that calls to Push may overwrite values in returned Span
+  // object.
   absl::Span<const CelValue> GetSpan(int size) const {
-    return absl::Span<const CelValue>(stack_.data() + stack_.size() - size,
-                                      size);
+    GOOGLE_DCHECK(HasEnough(size)) << "Value stack underflow";
+    return absl::Span<const CelValue>(data_ + size_ - size, size);
   }
 
   // Peeks the last element of the stack.
   // Checking that stack is not empty is caller's responsibility.
-  const CelValue& Peek() const { return stack_.back(); }
+  const CelValue& Peek() const {
+    GOOGLE_DCHECK(HasEnough(1)) << "Value stack underflow";
+    return data_[size_ - 1];
+  }
 
   // Clears the last size elements of the stack.
   // Checking that stack has enough elements is caller's responsibility.
-  void Pop(int size) { stack_.resize(stack_.size() - size); }
+  void Pop(int size) {
+    GOOGLE_DCHECK(HasEnough(size)) << "Value stack underflow";
+    size_ -= size;
+  }
 
   // Put element on the top of the stack.
-  void Push(const CelValue& value) { stack_.push_back(value); }
+  void Push(const CelValue& value) {
+    // Also catches a negative size left by an underflow.
+    GOOGLE_CHECK(static_cast<unsigned>(size_) < static_cast<unsigned>(max_size_))
+        << "Value stack overflow";
+    data_[size_++] = value;
+  }
 
   // Replace element on the top of the stack.
   // Checking that stack is not empty is caller's responsibility.
-  void PopAndPush(const CelValue& value) { stack_.back() = value; }
+  void PopAndPush(const CelValue& value) {
+    GOOGLE_DCHECK(HasEnough(1)) << "Value stack underflow";
+    data_[size_ - 1] = value;
+  }
 
-  // Preallocate stack.
-  void Reserve(int size) { stack_.reserve(size); }
+  // Removes all elements.
+  void Clear() { size_ = 0; }
 
  private:
-  std::vector<CelValue> stack_;
+  // Largest stack stored inline.
+  static constexpr int kInlineSize = 16;
+
+  std::unique_ptr<CelValue[]> heap_storage_;
+  CelValue inline_storage_[kInlineSize];
+  CelValue* data_;
+  int size_;
+  const int max_size_;
+};
+
+// Evaluation state of CelExpressionFlatImpl.
+// Owns the buffers used by ExecutionFrame, so that they can be allocated once
+// and reused across evaluations of the expression.
+class CelExpressionFlatEvaluationState : public CelEvaluationState {
+ public:
+  // value_stack_size is the maximum size of the value stack.
+  // iter_var_slots is the number of comprehension variable slots.
+  // arena serves as allocation manager during the expression evaluation.
+  CelExpressionFlatEvaluationState(int value_stack_size, int iter_var_slots,
+                                   google::protobuf::Arena* arena);
+
+  // Prepares the state for the next evaluation. Drops values left over from
+  // the previous evaluation without releasing the allocated storage.
+  void Reset();
+
+  ValueStack& value_stack() { return value_stack_; }
+
+  std::vector<CelValue>& iter_vars() { return iter_vars_; }
+
+  google::protobuf::Arena* arena() { return arena_; }
+
+ private:
+  ValueStack value_stack_;
+  std::vector<CelValue> iter_vars_;
+  google::protobuf::Arena* arena_;
 };
 
 // ExecutionFrame provides context for expression evaluation.
@@ -91,18 +228,46 @@ class ExecutionFrame {
  public:
   // flat is the flattened sequence of execution steps that will be evaluated.
   // activation provides bindings between parameter names and values.
-  // arena serves as allocation manager during the expression evaluation.
+  // state provides the value stack, comprehension variable slots and arena
+  // used during the evaluation.
+  // variable_slots is the layout of free variable slots assigned to the
+  // execution path at build time, if any.
+  // executor runs parts of the evaluation in parallel, if not null.
   ExecutionFrame(const ExecutionPath* flat, const Activation& activation,
-                 google::protobuf::Arena* arena)
-      : pc_(0), execution_path_(flat), activation_(activation), arena_(arena) {
-    // Reserve space on stack to minimize reallocations
-    // on stack resize.
-    value_stack_.Reserve(flat->size());
-  }
+                 CelExpressionFlatEvaluationState* state,
+                 const std::vector<std::string>* variable_slots = nullptr,
+                 CelExecutor* executor = nullptr)
+      : pc_(0),
+        execution_path_(flat),
+        activation_(activation),
+        slot_values_(activation.FindSlotValues(variable_slots)),
+        value_stack_(state->value_stack()),
+        arena_(state->arena()),
+        iter_vars_(state->iter_vars()),
+        executor_(executor) {}
+
+  // Constructs frame evaluating a part of the path of the parent frame,
+  // with the same activation and its own state. Used for parallel
+  // evaluation, which is not nested: the frame has no executor.
+  ExecutionFrame(const ExecutionFrame& parent,
+                 CelExpressionFlatEvaluationState* state)
+      : pc_(0),
+        execution_path_(parent.execution_path_),
+        activation_(parent.activation_),
+        slot_values_(parent.slot_values_),
+        value_stack_(state->value_stack()),
+        arena_(state->arena()),
+        iter_vars_(state->iter_vars()),
+        executor_(nullptr) {}
 
   // Returns next expression to evaluate.
   const ExpressionStep* Next();
 
+  // Program counter accessors, for engines that keep the program counter
+  // outside of the frame while running the path.
+  int pc() const { return pc_; }
+  void set_pc(int pc) { pc_ = pc; }
+
   // Intended for use only in conditionals.
   util::Status JumpTo(int offset) {
     int new_pc = pc_ + offset;
@@ -123,16 +288,39 @@ class ExecutionFrame {
   // Returns reference to Activation
   const Activation& activation() const { return activation_; }
 
-  // Returns reference to iter_vars
-  std::map<std::string, CelValue>& iter_vars() { return iter_vars_; }
+  // Returns value bound to the variable slot by activation, or nullptr if
+  // the slot is not bound.
+  const CelValue* FindSlotValue(int slot) const {
+    if (slot_values_ == nullptr || slot < 0) {
+      return nullptr;
+    }
+    const auto& value = (*slot_values_)[slot];
+    return value.has_value() ? &value.value() : nullptr;
+  }
+
+  // Returns reference to the comprehension variable stored in the slot.
+  // Slots are assigned by the builder at compile time.
+  // Checking that slot is in range is caller's responsibility.
+  CelValue& iter_var(int slot) { return iter_vars_[slot]; }
+
+  // All comprehension variable slots.
+  const std::vector<CelValue>& iter_vars() const { return iter_vars_; }
+
+  // Executor for parallel evaluation, or nullptr if it is disabled.
+  CelExecutor* executor() const { return executor_; }
+
+  // Runs the steps of the path from the current position up to end.
+  util::Status EvaluateUntil(int end);
 
  private:
   int pc_;  // pc_ - Program Counter. Current position on execution path.
   const ExecutionPath* execution_path_;
   const Activation& activation_;
-  ValueStack value_stack_;
+  const std::vector<absl::optional<CelValue>>* slot_values_;
+  ValueStack& value_stack_;
   google::protobuf::Arena* arena_;
-  std::map<std::string, CelValue> iter_vars_;  // variables declared in the frame.
+  std::vector<CelValue>& iter_vars_;  // variables declared in the frame.
+  CelExecutor* executor_;
 };
 
 // Implementation of the CelExpression that utilizes flattening
@@ -143,9 +331,36 @@ class CelExpressionFlatImpl : public CelExpression {
   // root_expr represents the root of AST tree;
   // path is flat execution path that is based upon
   // flattened AST tree.
-  CelExpressionFlatImpl(const google::api::expr::v1alpha1::Expr* root_expr,
-                        ExecutionPath path)
-      : root_(root_expr), path_(std::move(path)) {}
+  // iter_var_slots is the number of frame slots reserved for comprehension
+  // variables referenced by the steps of the path.
+  // variable_slots lists names of free variables, indexed by the slots
+  // assigned to them.
+  // max_stack_depth is the maximum depth of the value stack reached by the
+  // path, computed at build time. If negative, the size of the path is used,
+  // as no step grows the stack by more than one value.
+  // constant_arena owns values referenced by the steps of the path, such as
+  // results of constant folding. May be null.
+  // executor enables parallel evaluation of the steps supporting it, such as
+  // comprehensions over large lists. May be null.
+  // referenced_paths are the paths referenced by the expression, see
+  // FindReferencedPaths(). May be null, if the builder didn't find them.
+  CelExpressionFlatImpl(
+      const google::api::expr::v1alpha1::Expr* root_expr, ExecutionPath path,
+      int iter_var_slots = 0, std::vector<std::string> variable_slots = {},
+      int max_stack_depth = -1,
+      std::unique_ptr<google::protobuf::Arena> constant_arena = nullptr,
+      CelExecutor* executor = nullptr,
+      std::unique_ptr<const google::protobuf::FieldMask> referenced_paths =
+          nullptr)
+      : root_(root_expr),
+        constant_arena_(std::move(constant_arena)),
+        path_(std::move(path)),
+        iter_var_slots_(iter_var_slots),
+        variable_slots_(std::move(variable_slots)),
+        referenced_paths_(std::move(referenced_paths)),
+        max_stack_depth_(max_stack_depth < 0 ? path_.size()
+                                             : max_stack_depth),
+        executor_(executor) {}
 
   // Implementation of CelExpression evaluate method.
   util::StatusOr<CelValue> Evaluate(const Activation& activation,
@@ -156,9 +371,59 @@ class CelExpressionFlatImpl : public CelExpression {
                                  google::protobuf::Arena* arena,
                                  CelEvaluationListener callback) const override;
 
+  // Implementation of CelExpression InitializeState method.
+  std::unique_ptr<CelEvaluationState> InitializeState(
+      google::protobuf::Arena* arena) const override;
+
+  // Implementation of CelExpression evaluate method with reusable state.
+  util::StatusOr<CelValue> Evaluate(const Activation& activation,
+                                    CelEvaluationState* state) const override;
+
+  // Implementation of CelExpression trace method with reusable state.
+  util::StatusOr<CelValue> Trace(const Activation& activation,
+                                 CelEvaluationState* state,
+                                 CelEvaluationListener callback) const override;
+
+  // Implementation of CelExpression variable_slots method.
+  const std::vector<std::string>& variable_slots() const override {
+    return variable_slots_;
+  }
+
+  // Implementation of CelExpression referenced_paths method.
+  const google::protobuf::FieldMask* referenced_paths() const override {
+    return referenced_paths_.get();
+  }
+
+  // Maximum depth of the value stack during evaluation.
+  int max_stack_depth() const { return max_stack_depth_; }
+
+ protected:
+  const ExecutionPath& path() const { return path_; }
+
+  CelExecutor* executor() const { return executor_; }
+
+  // Checks that the state was created for this expression and resets it
+  // for the next evaluation. state is null if it has another type.
+  util::Status PrepareState(CelExpressionFlatEvaluationState* state) const;
+
  private:
+  // Runs the execution path. Tracing variant invokes callback after each
+  // step originating from AST, untraced variant has no listener overhead.
+  template <bool kTrace>
+  util::StatusOr<CelValue> EvaluateImpl(
+      const Activation& activation, CelExpressionFlatEvaluationState* state,
+      const CelEvaluationListener* callback) const;
+
   const google::api::expr::v1alpha1::Expr* root_;
+  // Declared before path_, so that steps never outlive the values they
+  // refer to.
+  const std::unique_ptr<google::protobuf::Arena> constant_arena_;
   const ExecutionPath path_;
+  const int iter_var_slots_;
+  const std::vector<std::string> variable_slots_;
+  const std::unique_ptr<const google::protobuf::FieldMask> referenced_paths_;
+  const int max_stack_depth_;
+  CelExecutor* const executor_;
 };
 
 }  // namespace runtime
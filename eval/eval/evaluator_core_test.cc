@@ -1,6 +1,7 @@
 #include "eval/eval/evaluator_core.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 #include "eval/compiler/flat_expr_builder.h"
+#include "eval/eval/container_backed_list_impl.h"
 #include "eval/public/builtin_func_registrar.h"
 
 #include "gmock/gmock.h"
@@ -14,6 +15,7 @@ namespace runtime {
 using ::google::api::expr::runtime::RegisterBuiltinFunctions;
 using testing::_;
 using testing::Eq;  // Optional ::testing aliases. Remove if unused.
+using testing::Truly;
 
 // Fake expression implementation
 // Pushes int64_t(0) on top of value stack.
@@ -60,7 +62,8 @@ TEST(EvaluatorCoreTest, ExecutionFrameNext) {
   auto dummy_expr = absl::make_unique<google::api::expr::v1alpha1::Expr>();
 
   Activation activation;
-  ExecutionFrame frame(&path, activation, nullptr);
+  CelExpressionFlatEvaluationState state(path.size(), 0, nullptr);
+  ExecutionFrame frame(&path, activation, &state);
 
   EXPECT_THAT(frame.Next(), Eq(path[0].get()));
   EXPECT_THAT(frame.Next(), Eq(path[1].get()));
@@ -93,6 +96,78 @@ TEST(EvaluatorCoreTest, SimpleEvaluatorTest) {
   EXPECT_THAT(value.Int64OrDie(), Eq(2));
 }
 
+TEST(EvaluatorCoreTest, ReusableStateEvaluatorTest) {
+  ExecutionPath path;
+  path.push_back(absl::make_unique<FakeConstExpressionStep>());
+  path.push_back(absl::make_unique<FakeIncrementExpressionStep>());
+
+  auto dummy_expr = absl::make_unique<google::api::expr::v1alpha1::Expr>();
+
+  CelExpressionFlatImpl impl(dummy_expr.get(), std::move(path));
+
+  Activation activation;
+  google::protobuf::Arena arena;
+
+  auto state = impl.InitializeState(&arena);
+
+  // State is reset between evaluations, so each run yields the same result.
+  for (int i = 0; i < 3; i++) {
+    auto status = impl.Evaluate(activation, state.get());
+    ASSERT_TRUE(util::IsOk(status)) << " for pass " << i;
+
+    auto value = status.ValueOrDie();
+    ASSERT_TRUE(value.IsInt64());
+    EXPECT_THAT(value.Int64OrDie(), Eq(1)) << " for pass " << i;
+  }
+}
+
+// Expression relying on the default evaluation state.
+class ArenaOnlyExpression : public CelExpression {
+ public:
+  using CelExpression::Evaluate;
+  using CelExpression::Trace;
+
+  util::StatusOr<CelValue> Evaluate(
+      const Activation& activation,
+      google::protobuf::Arena* arena) const override {
+    return CelValue::CreateInt64(1);
+  }
+
+  util::StatusOr<CelValue> Trace(
+      const Activation& activation, google::protobuf::Arena* arena,
+      CelEvaluationListener callback) const override {
+    return Evaluate(activation, arena);
+  }
+};
+
+TEST(EvaluatorCoreTest, StateOfAnotherExpressionTest) {
+  ExecutionPath path;
+  path.push_back(absl::make_unique<FakeConstExpressionStep>());
+  auto dummy_expr = absl::make_unique<google::api::expr::v1alpha1::Expr>();
+  CelExpressionFlatImpl impl(dummy_expr.get(), std::move(path));
+  ArenaOnlyExpression arena_only;
+
+  Activation activation;
+  google::protobuf::Arena arena;
+  auto flat_state = impl.InitializeState(&arena);
+  auto arena_state = arena_only.InitializeState(&arena);
+  auto callback = [](const google::api::expr::v1alpha1::Expr*, const CelValue&,
+                     google::protobuf::Arena*) { return util::OkStatus(); };
+
+  EXPECT_TRUE(util::IsOk(arena_only.Evaluate(activation, arena_state.get())));
+  EXPECT_TRUE(
+      util::IsOk(arena_only.Trace(activation, arena_state.get(), callback)));
+
+  for (const util::StatusOr<CelValue>& result :
+       {arena_only.Evaluate(activation, flat_state.get()),
+        arena_only.Trace(activation, flat_state.get(), callback),
+        impl.Evaluate(activation, arena_state.get()),
+        impl.Trace(activation, arena_state.get(), callback)}) {
+    EXPECT_THAT(result.status().code(),
+                Eq(google::rpc::Code::INVALID_ARGUMENT));
+  }
+}
+
 class MockTraceCallback {
  public:
   MOCK_METHOD3(Call, void(const google::api::expr::v1alpha1::Expr* expr,
@@ -160,6 +235,8 @@ TEST(EvaluatorCoreTest, TraceTest) {
   auto builtin_status = RegisterBuiltinFunctions(builder.GetRegistry());
   ASSERT_TRUE(util::IsOk(builtin_status));
   builder.set_shortcircuiting(false);
+  // Constant subexpressions are traced as single nodes when folded.
+  builder.set_constant_folding(false);
   auto build_status = builder.CreateExpression(&expr, &source_info);
   ASSERT_TRUE(util::IsOk(build_status));
 
@@ -197,6 +274,148 @@ TEST(EvaluatorCoreTest, TraceTest) {
   ASSERT_TRUE(util::IsOk(eval_status));
 }
 
+TEST(EvaluatorCoreTest, QuantifierTraceTest) {
+  google::api::expr::v1alpha1::Expr expr;
+  google::api::expr::v1alpha1::SourceInfo source_info;
+
+  // lst.all(x, x > 0), fused into quantifier loop steps.
+
+  expr.set_id(1);
+  auto comp = expr.mutable_comprehension_expr();
+  comp->set_iter_var("x");
+  comp->set_accu_var("__result__");
+
+  auto list_expr = comp->mutable_iter_range();
+  list_expr->set_id(2);
+  list_expr->mutable_ident_expr()->set_name("lst");
+
+  auto accu_init_expr = comp->mutable_accu_init();
+  accu_init_expr->set_id(3);
+  accu_init_expr->mutable_const_expr()->set_bool_value(true);
+
+  auto loop_cond_expr = comp->mutable_loop_condition();
+  loop_cond_expr->set_id(4);
+  loop_cond_expr->mutable_call_expr()->set_function("@not_strictly_false");
+  auto cond_accu_expr = loop_cond_expr->mutable_call_expr()->add_args();
+  cond_accu_expr->set_id(5);
+  cond_accu_expr->mutable_ident_expr()->set_name("__result__");
+
+  auto loop_step_expr = comp->mutable_loop_step();
+  loop_step_expr->set_id(6);
+  loop_step_expr->mutable_call_expr()->set_function("_&&_");
+  auto step_accu_expr = loop_step_expr->mutable_call_expr()->add_args();
+  step_accu_expr->set_id(7);
+  step_accu_expr->mutable_ident_expr()->set_name("__result__");
+
+  auto predicate_expr = loop_step_expr->mutable_call_expr()->add_args();
+  predicate_expr->set_id(8);
+  auto condition = predicate_expr->mutable_call_expr();
+  condition->set_function("_>_");
+
+  auto iter_expr = condition->add_args();
+  iter_expr->set_id(9);
+  iter_expr->mutable_ident_expr()->set_name("x");
+
+  auto zero_expr = condition->add_args();
+  zero_expr->set_id(10);
+  zero_expr->mutable_const_expr()->set_int64_value(0);
+
+  auto result_expr = comp->mutable_result();
+  result_expr->set_id(11);
+  result_expr->mutable_ident_expr()->set_name("__result__");
+
+  FlatExprBuilder builder;
+  auto builtin_status = RegisterBuiltinFunctions(builder.GetRegistry());
+  ASSERT_TRUE(util::IsOk(builtin_status));
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status));
+
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  auto trace = [&](const Activation& activation, MockTraceCallback* callback) {
+    return cel_expr->Trace(
+        activation, &arena,
+        [&](const google::api::expr::v1alpha1::Expr* expr1,
+            const CelValue& value, google::protobuf::Arena* arena) {
+          callback->Call(expr1, value, arena);
+          return util::OkStatus();
+        });
+  };
+
+  {
+    std::vector<CelValue> elements = {CelValue::CreateInt64(1),
+                                      CelValue::CreateInt64(2),
+                                      CelValue::CreateInt64(3)};
+    ContainerBackedListImpl list(elements);
+    Activation activation;
+    activation.InsertValue("lst", CelValue::CreateList(&list));
+
+    MockTraceCallback callback;
+    EXPECT_CALL(callback, Call(list_expr, _, &arena));
+    EXPECT_CALL(callback, Call(iter_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(zero_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(predicate_expr, _, &arena)).Times(3);
+    // The comprehension is traced once, with its result.
+    EXPECT_CALL(callback, Call(&expr, Truly([](const CelValue& value) {
+                                 return value.IsBool() && value.BoolOrDie();
+                               }),
+                               &arena));
+
+    auto eval_status = trace(activation, &callback);
+    ASSERT_TRUE(util::IsOk(eval_status));
+  }
+
+  {
+    // The loop exits in QuantifierStartStep on empty ranges.
+    ContainerBackedListImpl list({});
+    Activation activation;
+    activation.InsertValue("lst", CelValue::CreateList(&list));
+
+    MockTraceCallback callback;
+    EXPECT_CALL(callback, Call(list_expr, _, &arena));
+    EXPECT_CALL(callback, Call(&expr, _, &arena));
+
+    auto eval_status = trace(activation, &callback);
+    ASSERT_TRUE(util::IsOk(eval_status));
+  }
+
+  {
+    // Without fusion, every node is traced.
+    builder.set_fused_comprehensions(false);
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    ASSERT_TRUE(util::IsOk(build_status));
+    cel_expr = std::move(build_status.ValueOrDie());
+
+    std::vector<CelValue> elements = {CelValue::CreateInt64(1),
+                                      CelValue::CreateInt64(2),
+                                      CelValue::CreateInt64(3)};
+    ContainerBackedListImpl list(elements);
+    Activation activation;
+    activation.InsertValue("lst", CelValue::CreateList(&list));
+
+    MockTraceCallback callback;
+    EXPECT_CALL(callback, Call(list_expr, _, &arena));
+    EXPECT_CALL(callback, Call(accu_init_expr, _, &arena));
+    EXPECT_CALL(callback, Call(cond_accu_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(loop_cond_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(step_accu_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(iter_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(zero_expr, _, &arena)).Times(3);
+    EXPECT_CALL(callback, Call(predicate_expr, _, &arena)).Times(3);
+    // Once by the short-circuiting jump, once by the call.
+    EXPECT_CALL(callback, Call(loop_step_expr, _, &arena)).Times(6);
+    EXPECT_CALL(callback, Call(result_expr, _, &arena));
+    EXPECT_CALL(callback, Call(&expr, Truly([](const CelValue& value) {
+                                 return value.IsBool() && value.BoolOrDie();
+                               }),
+                               &arena));
+
+    auto eval_status = trace(activation, &callback);
+    ASSERT_TRUE(util::IsOk(eval_status));
+  }
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
@@ -2,9 +2,12 @@
 
 #include <type_traits>
 
+#include "google/protobuf/duration.pb.h"
 #include "google/protobuf/map_field.h"
+#include "google/protobuf/timestamp.pb.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
+#include "internal/proto_util.h"
 #include "google/rpc/code.pb.h"
 
 namespace google {
@@ -286,6 +289,66 @@ class MapValueAccessor : public FieldAccessor<MapValueAccessor> {
   const MapValueRef* value_ref_;
 };
 
+// Readers of singular fields, one per field type, returned by
+// GetSingleFieldReader.
+CelValue ReadBool(const Message& msg, const Reflection* reflection,
+                  const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateBool(reflection->GetBool(msg, desc));
+}
+
+CelValue ReadInt32(const Message& msg, const Reflection* reflection,
+                   const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateInt64(reflection->GetInt32(msg, desc));
+}
+
+CelValue ReadInt64(const Message& msg, const Reflection* reflection,
+                   const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateInt64(reflection->GetInt64(msg, desc));
+}
+
+CelValue ReadUInt32(const Message& msg, const Reflection* reflection,
+                    const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateUint64(reflection->GetUInt32(msg, desc));
+}
+
+CelValue ReadUInt64(const Message& msg, const Reflection* reflection,
+                    const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateUint64(reflection->GetUInt64(msg, desc));
+}
+
+CelValue ReadFloat(const Message& msg, const Reflection* reflection,
+                   const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateDouble(reflection->GetFloat(msg, desc));
+}
+
+CelValue ReadDouble(const Message& msg, const Reflection* reflection,
+                    const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateDouble(reflection->GetDouble(msg, desc));
+}
+
+CelValue ReadEnum(const Message& msg, const Reflection* reflection,
+                  const FieldDescriptor* desc, Arena*) {
+  return CelValue::CreateInt64(reflection->GetEnumValue(msg, desc));
+}
+
+CelValue ReadMessage(const Message& msg, const Reflection* reflection,
+                     const FieldDescriptor* desc, Arena* arena) {
+  return CelValue::CreateMessage(&reflection->GetMessage(msg, desc), arena);
+}
+
+// Strings not stored as std::string, e.g. cords, are copied to the arena.
+template <CelValue (*Create)(const std::string*)>
+CelValue ReadString(const Message& msg, const Reflection* reflection,
+                    const FieldDescriptor* desc, Arena* arena) {
+  std::string buffer;
+  const std::string* value =
+      &reflection->GetStringReference(msg, desc, &buffer);
+  if (value == &buffer) {
+    value = Arena::Create<std::string>(arena, std::move(buffer));
+  }
+  return Create(value);
+}
+
 // Helper classes that should retrieve values from CelValue,
 // when CelValue content inherits from Message.
 template <class T, bool ZZ>
@@ -341,6 +404,43 @@ util::Status CreateValueFromMapValue(const google::protobuf::Message* msg,
   return accessor.CreateValueFromFieldAccessor(arena, result);
 }
 
+SingleFieldReader GetSingleFieldReader(const FieldDescriptor* desc) {
+  if (desc->is_repeated()) {
+    return nullptr;
+  }
+  switch (desc->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return ReadBool;
+    case FieldDescriptor::CPPTYPE_INT32:
+      return ReadInt32;
+    case FieldDescriptor::CPPTYPE_INT64:
+      return ReadInt64;
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return ReadUInt32;
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return ReadUInt64;
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      return ReadFloat;
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return ReadDouble;
+    case FieldDescriptor::CPPTYPE_STRING:
+      switch (desc->type()) {
+        case FieldDescriptor::TYPE_STRING:
+          return ReadString<CelValue::CreateString>;
+        case FieldDescriptor::TYPE_BYTES:
+          return ReadString<CelValue::CreateBytes>;
+        default:
+          return nullptr;
+      }
+    case FieldDescriptor::CPPTYPE_MESSAGE:
+      return ReadMessage;
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return ReadEnum;
+    default:
+      return nullptr;
+  }
+}
+
 // Singular message fields and repeated message fields have similar access model
 // To provide common approach, we implement field setter classes, based on CRTP.
 // FieldAccessor is CRTP base class, specifying Get.. method family.
@@ -439,6 +539,35 @@ class FieldSetter {
   }
 
   bool AssignMessage(const CelValue& cel_value) const {
+    // Durations and timestamps held by value are only converted to messages
+    // here.
+    if (cel_value.HasTimeMessage()) {
+      static_cast<const Derived*>(this)->SetMessage(
+          cel_value.IsDuration()
+              ? static_cast<const google::protobuf::Message*>(
+                    cel_value.DurationOrDie())
+              : cel_value.TimestampOrDie());
+      return true;
+    }
+    if (cel_value.IsDuration()) {
+      google::protobuf::Duration duration;
+      if (!util::IsOk(expr::internal::EncodeDuration(cel_value.AbslDurationOrDie(),
+                                                     &duration))) {
+        return false;
+      }
+      static_cast<const Derived*>(this)->SetMessage(&duration);
+      return true;
+    }
+    if (cel_value.IsTimestamp()) {
+      google::protobuf::Timestamp timestamp;
+      if (!util::IsOk(expr::internal::EncodeTime(cel_value.AbslTimestampOrDie(),
+                                                 &timestamp))) {
+        return false;
+      }
+      static_cast<const Derived*>(this)->SetMessage(&timestamp);
+      return true;
+    }
+
     // We attempt to retrieve value if it derives from google::protobuf::Message.
     // That includes both generic Protobuf message types and specific
     // message types stored in CelValue as separate entities.
@@ -18,6 +18,20 @@ util::Status CreateValueFromSingleField(const google::protobuf::Message* msg,
                                         const google::protobuf::FieldDescriptor* desc,
                                         google::protobuf::Arena* arena, CelValue* result);
 
+// Reads the singular field desc of msg, which has the reflection, as a
+// CelValue. Readers are selected for the field once, e.g. at build time, so
+// that reading does not dispatch on the field type.
+// arena Arena object to allocate result on, if needed.
+using SingleFieldReader = CelValue (*)(
+    const google::protobuf::Message& msg,
+    const google::protobuf::Reflection* reflection,
+    const google::protobuf::FieldDescriptor* desc, google::protobuf::Arena* arena);
+
+// Returns the reader of the singular field, or nullptr if the field is
+// repeated or has an unsupported type.
+SingleFieldReader GetSingleFieldReader(
+    const google::protobuf::FieldDescriptor* desc);
+
 // Creates CelValue from repeated message field.
 // Returns status of the operation.
 // msg Message containing the field.
@@ -1,6 +1,7 @@
 
 #include "eval/eval/field_backed_list_impl.h"
 #include "eval/eval/field_access.h"
+#include "eval/eval/typed_list_impl.h"
 #include "eval/public/cel_value.h"
 
 namespace google {
@@ -26,6 +27,44 @@ CelValue FieldBackedListImpl::operator[](int index) const {
   return result;
 }
 
+namespace {
+
+template <class T>
+const CelList* CreateTypedList(const google::protobuf::Message* message,
+                               const google::protobuf::FieldDescriptor* descriptor,
+                               google::protobuf::Arena* arena) {
+  const auto& field =
+      message->GetReflection()->GetRepeatedField<T>(*message, descriptor);
+  return google::protobuf::Arena::Create<TypedListImpl<T>>(
+      arena, absl::MakeConstSpan(field.data(), field.size()));
+}
+
+}  // namespace
+
+const CelList* CreateFieldBackedList(const google::protobuf::Message* message,
+                                     const google::protobuf::FieldDescriptor* descriptor,
+                                     google::protobuf::Arena* arena) {
+  switch (descriptor->cpp_type()) {
+    case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
+      return CreateTypedList<bool>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
+      return CreateTypedList<int32_t>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
+      return CreateTypedList<int64_t>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
+      return CreateTypedList<uint32_t>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
+      return CreateTypedList<uint64_t>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
+      return CreateTypedList<float>(message, descriptor, arena);
+    case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
+      return CreateTypedList<double>(message, descriptor, arena);
+    default:
+      return google::protobuf::Arena::Create<FieldBackedListImpl>(
+          arena, message, descriptor, arena);
+  }
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
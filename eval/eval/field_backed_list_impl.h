@@ -35,6 +35,13 @@ class FieldBackedListImpl : public CelList {
   google::protobuf::Arena* arena_;
 };
 
+// Creates the list of the elements of the repeated field on the arena.
+// Fields of numeric and bool types are exposed as typed lists over the
+// storage of the field, without copying.
+const CelList* CreateFieldBackedList(const google::protobuf::Message* message,
+                                     const google::protobuf::FieldDescriptor* descriptor,
+                                     google::protobuf::Arena* arena);
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
@@ -94,6 +94,26 @@ class KeyList : public CelList {
     return key;
   }
 
+  // Iterates the entries with the key field looked up once.
+  bool ForEach(
+      absl::FunctionRef<bool(const CelValue& element)> visitor) const override {
+    const FieldDescriptor* key_desc =
+        descriptor_->message_type()->FindFieldByNumber(kKeyTag);
+    int list_size = size();
+    for (int i = 0; i < list_size; i++) {
+      const Message& entry =
+          reflection_->GetRepeatedMessage(*message_, descriptor_, i);
+      CelValue key = CelValue::CreateNull();
+      auto status = CreateValueFromSingleField(&entry, key_desc, arena_, &key);
+      if (!util::IsOk(status)) {
+        key = CreateErrorValue(arena_, status.message(),
+                               CelError::Code::CelError_Code_UNKNOWN);
+      }
+      if (!visitor(key)) return false;
+    }
+    return true;
+  }
+
  private:
   const google::protobuf::Message* message_;
   const google::protobuf::FieldDescriptor* descriptor_;
@@ -118,6 +138,33 @@ int FieldBackedMapImpl::size() const {
 
 const CelList* FieldBackedMapImpl::ListKeys() const { return key_list_.get(); }
 
+bool FieldBackedMapImpl::ForEach(
+    absl::FunctionRef<bool(const CelValue& key, const CelValue& value)> visitor)
+    const {
+  const Descriptor* entry_descriptor = descriptor_->message_type();
+  const FieldDescriptor* key_desc =
+      entry_descriptor->FindFieldByNumber(kKeyTag);
+  const FieldDescriptor* value_desc =
+      entry_descriptor->FindFieldByNumber(kValueTag);
+  int map_size = size();
+  for (int i = 0; i < map_size; i++) {
+    const Message& entry =
+        reflection_->GetRepeatedMessage(*message_, descriptor_, i);
+    CelValue key = CelValue::CreateNull();
+    CelValue value = CelValue::CreateNull();
+    auto status = CreateValueFromSingleField(&entry, key_desc, arena_, &key);
+    if (util::IsOk(status)) {
+      status = CreateValueFromSingleField(&entry, value_desc, arena_, &value);
+    }
+    if (!util::IsOk(status)) {
+      value = CreateErrorValue(arena_, status.message(),
+                               CelError::Code::CelError_Code_UNKNOWN);
+    }
+    if (!visitor(key, value)) return false;
+  }
+  return true;
+}
+
 absl::optional<CelValue> FieldBackedMapImpl::operator[](CelValue key) const {
 #ifdef GOOGLE_PROTOBUF_HAS_CEL_MAP_REFLECTION_FRIEND
   // Fast implementation.
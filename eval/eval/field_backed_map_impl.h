@@ -28,6 +28,11 @@ class FieldBackedMapImpl : public CelMap {
 
   const CelList* ListKeys() const override;
 
+  // Iterates the map entries of the field, without looking the keys up.
+  bool ForEach(absl::FunctionRef<bool(const CelValue& key,
+                                      const CelValue& value)>
+                   visitor) const override;
+
  private:
   const google::protobuf::Message* message_;
   const google::protobuf::FieldDescriptor* descriptor_;
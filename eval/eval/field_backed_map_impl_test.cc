@@ -130,6 +130,42 @@ TEST(FieldBackedMapImplTest, KeyListTest) {
   EXPECT_THAT(keys, UnorderedPointwise(Eq(), keys1));
 }
 
+TEST(FieldBackedMapImplTest, ForEachTest) {
+  TestMessage message;
+  auto field_map = message.mutable_string_int32_map();
+  for (int i = 0; i < 100; i++) {
+    (*field_map)[absl::StrCat("test", i)] = i;
+  }
+
+  google::protobuf::Arena arena;
+
+  auto cel_map = CreateMap(&message, "string_int32_map", &arena);
+
+  // Entries are visited in the order of the key list, with the values the
+  // lookups return.
+  std::vector<std::string> keys;
+  std::vector<std::string> keys1;
+  EXPECT_TRUE(cel_map->ListKeys()->ForEach([&](const CelValue& key) {
+    keys.push_back(std::string(key.StringOrDie().value()));
+    return true;
+  }));
+  EXPECT_TRUE(cel_map->ForEach([&](const CelValue& key, const CelValue& value) {
+    keys1.push_back(std::string(key.StringOrDie().value()));
+    auto lookup = (*cel_map)[key];
+    EXPECT_TRUE(lookup.has_value());
+    EXPECT_EQ(value.Int64OrDie(), lookup->Int64OrDie());
+    return true;
+  }));
+  EXPECT_EQ(keys.size(), 100);
+  EXPECT_THAT(keys, testing::ElementsAreArray(keys1));
+
+  int visited = 0;
+  EXPECT_FALSE(cel_map->ForEach([&](const CelValue&, const CelValue&) {
+    return ++visited < 10;
+  }));
+  EXPECT_EQ(visited, 10);
+}
+
 }  // namespace
 }  // namespace runtime
 }  // namespace expr
@@ -26,22 +26,42 @@ class FunctionStep : public ExpressionStepBase {
 
   util::Status Evaluate(ExecutionFrame* frame) const override;
 
+  bool Lower(Instruction* instruction) const override {
+    instruction->opcode = Opcode::kCall;
+    instruction->operand = num_arguments_;
+    instruction->overloads = overloads_;
+    instruction->overload_cache = &overload_cache_;
+    return true;
+  }
+
  private:
   std::vector<const CelFunction*> overloads_;
   int num_arguments_;
+  // Shared by all evaluations of the step.
+  mutable OverloadCache overload_cache_;
 };
 
 util::Status FunctionStep::Evaluate(ExecutionFrame* frame) const {
-  if (!frame->value_stack().HasEnough(num_arguments_)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
+  return InvokeMatchingOverload(overloads_, num_arguments_, frame,
+                                &overload_cache_);
+}
 
-  // Create Span object that contains input arguments to the function.
-  auto input_args = frame->value_stack().GetSpan(num_arguments_);
+}  // namespace
+
+namespace {
+
+// Returns the only overload matching the arguments, or nullptr if none does.
+// Returns index of the overload in *index.
+util::StatusOr<const CelFunction*> MatchOverload(
+    absl::Span<const CelFunction* const> overloads,
+    absl::Span<const CelValue> input_args, bool packed, uint64_t packed_types,
+    int* index) {
   const CelFunction* matched_function = nullptr;
 
-  for (auto overload : overloads_) {
-    if (overload->MatchArguments(input_args)) {
+  for (size_t i = 0; i < overloads.size(); i++) {
+    const CelFunction* overload = overloads[i];
+    if (packed ? overload->MatchPackedTypes(packed_types)
+               : overload->MatchArguments(input_args)) {
       // More than one overload matches our arguments.
       if (matched_function != nullptr) {
         return util::MakeStatus(google::rpc::Code::INTERNAL,
@@ -49,6 +69,38 @@ util::Status FunctionStep::Evaluate(ExecutionFrame* frame) const {
       }
 
       matched_function = overload;
+      *index = i;
+    }
+  }
+
+  return matched_function;
+}
+
+}  // namespace
+
+util::Status InvokeMatchingOverload(
+    absl::Span<const CelFunction* const> overloads, int num_arguments,
+    ExecutionFrame* frame, OverloadCache* cache) {
+  // Create Span object that contains input arguments to the function.
+  auto input_args = frame->value_stack().GetSpan(num_arguments);
+  const CelFunction* matched_function = nullptr;
+
+  // Argument types are packed once and compared with each overload.
+  bool packed = num_arguments <= CelFunction::kMaxPackedArguments;
+  uint64_t packed_types = packed ? CelFunction::PackTypes(input_args) : 0;
+
+  int index = (packed && cache != nullptr) ? cache->Find(packed_types) : -1;
+  if (index >= 0) {
+    matched_function = overloads[index];
+  } else {
+    auto match_status =
+        MatchOverload(overloads, input_args, packed, packed_types, &index);
+    if (!util::IsOk(match_status)) {
+      return match_status.status();
+    }
+    matched_function = match_status.ValueOrDie();
+    if (matched_function != nullptr && packed && cache != nullptr) {
+      cache->Store(packed_types, index);
     }
   }
 
@@ -80,14 +132,12 @@ util::Status FunctionStep::Evaluate(ExecutionFrame* frame) const {
     }
   }
 
-  frame->value_stack().Pop(num_arguments_);
+  frame->value_stack().Pop(num_arguments);
   frame->value_stack().Push(result);
 
   return util::OkStatus();
 }
 
-}  // namespace
-
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
     const google::api::expr::v1alpha1::Expr::Call* call_expr,
     const google::api::expr::v1alpha1::Expr* expr,
@@ -103,6 +153,20 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
   return CreateFunctionStep(expr, overloads);
 }
 
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
+    const google::api::expr::v1alpha1::Expr::Call* call_expr,
+    const google::api::expr::v1alpha1::Expr* expr,
+    const CelFunctionRegistry& function_registry,
+    const std::vector<CelValue::Type>& arg_types) {
+  auto overloads = function_registry.FindOverloads(
+      call_expr->function(), call_expr->has_target(), arg_types);
+  if (overloads.size() != 1) {
+    return CreateFunctionStep(call_expr, expr, function_registry);
+  }
+
+  return CreateFunctionStep(expr, overloads);
+}
+
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
     const google::api::expr::v1alpha1::Expr* expr,
     std::vector<const CelFunction*> overloads) {
@@ -1,16 +1,83 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_FUNCTION_STEP_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_EVAL_FUNCTION_STEP_H_
 
+#include <atomic>
+
 #include "eval/eval/evaluator_core.h"
 #include "eval/public/activation.h"
 #include "eval/public/cel_function.h"
 #include "eval/public/cel_value.h"
+#include "absl/types/span.h"
 
 namespace google {
 namespace api {
 namespace expr {
 namespace runtime {
 
+// Inline cache of a call site: remembers the overloads matched for the last
+// few argument type combinations, so that they are not matched against all
+// overloads again.
+// Safe for concurrent evaluations: each entry is a single atomic word
+// holding packed argument types and the overload index. Racing updates may
+// only cause cache misses.
+class OverloadCache {
+ public:
+  static constexpr int kEntries = 2;
+
+  OverloadCache() {
+    for (auto& entry : entries_) {
+      entry.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns index of the overload cached for the packed argument types
+  // (see CelFunction::PackTypes), or -1.
+  int Find(uint64_t packed_types) const {
+    for (const auto& entry : entries_) {
+      uint64_t value = entry.load(std::memory_order_relaxed);
+      if (value != 0 && (value & kTypesMask) == (packed_types & kTypesMask)) {
+        return (value >> kIndexShift) - 1;
+      }
+    }
+    return -1;
+  }
+
+  // Caches the overload index for the packed argument types, evicting the
+  // least recently stored entry.
+  void Store(uint64_t packed_types, int index) {
+    if (index + 1 > kMaxIndex) {
+      return;
+    }
+    for (int i = kEntries - 1; i > 0; i--) {
+      entries_[i].store(entries_[i - 1].load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    }
+    entries_[0].store((packed_types & kTypesMask) |
+                          (static_cast<uint64_t>(index + 1) << kIndexShift),
+                      std::memory_order_relaxed);
+  }
+
+ private:
+  // Number of arguments is the same for all calls at the call site, so
+  // the bits of packed types holding it store the overload index instead.
+  static constexpr int kIndexShift =
+      CelFunction::kTypeBits * CelFunction::kMaxPackedArguments;
+  static constexpr uint64_t kTypesMask = (uint64_t{1} << kIndexShift) - 1;
+  static constexpr int kMaxIndex = (1 << (64 - kIndexShift)) - 1;
+
+  std::atomic<uint64_t> entries_[kEntries];
+};
+
+// Invokes the overload matching the last num_arguments values on the value
+// stack and replaces them with the result.
+// If no overload matches, the result is the first error among the arguments,
+// or a new error if there is none.
+// cache, if not null, is checked before the overloads are matched, and
+// updated with the overload matched.
+util::Status InvokeMatchingOverload(
+    absl::Span<const CelFunction* const> overloads, int num_arguments,
+    ExecutionFrame* frame, OverloadCache* cache = nullptr);
+
 // Factory method for Call - based Execution step
 // Looks up function registry using data provided through Call parameter.
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
@@ -18,6 +85,17 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
     const google::api::expr::v1alpha1::Expr* expr,
     const CelFunctionRegistry& function_registry);
 
+// Factory method for Call - based Execution step
+// Overloads are looked up for arguments of the types specified, e.g. inferred
+// by the type checker (kAny stands for any type). If that resolves the call
+// to a single overload, the step only matches arguments against it;
+// otherwise it falls back to all overloads of the function.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
+    const google::api::expr::v1alpha1::Expr::Call* call,
+    const google::api::expr::v1alpha1::Expr* expr,
+    const CelFunctionRegistry& function_registry,
+    const std::vector<CelValue::Type>& arg_types);
+
 // Factory method for Call - based Execution step
 // Creates execution step that wraps around the subset of overloads.
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateFunctionStep(
@@ -1,5 +1,9 @@
 #include "eval/eval/function_step.h"
+
+#include <thread>
+
 #include "eval/eval/evaluator_core.h"
+#include "eval/eval/ident_step.h"
 #include "eval/public/cel_function_adapter.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 
@@ -106,36 +110,6 @@ TEST(FunctionStepTest, SimpleFunctionTest) {
   EXPECT_THAT(value.Int64OrDie(), Eq(5));
 }
 
-TEST(FunctionStepTest, TestStackUnderflow) {
-  ExecutionPath path;
-
-  ConstFunction const_func0(CelValue::CreateInt64(3), CelValue::Type::kInt64);
-
-  AddFunction add_func;
-
-  Expr dummy_expr0;
-  Expr dummy_expr2;
-
-  auto step0_status = CreateFunctionStep(&dummy_expr0, {&const_func0});
-  auto step2_status = CreateFunctionStep(&dummy_expr2, {&add_func});
-
-  ASSERT_TRUE(util::IsOk(step0_status));
-  ASSERT_TRUE(util::IsOk(step2_status));
-
-  path.push_back(std::move(step0_status.ValueOrDie()));
-  path.push_back(std::move(step2_status.ValueOrDie()));
-
-  auto dummy_expr = absl::make_unique<google::api::expr::v1alpha1::Expr>();
-
-  CelExpressionFlatImpl impl(dummy_expr.get(), std::move(path));
-
-  Activation activation;
-  google::protobuf::Arena arena;
-
-  auto status = impl.Evaluate(activation, &arena);
-  EXPECT_FALSE(util::IsOk(status));
-}
-
 // Test factory method when empty overload set is provided.
 TEST(FunctionStepTest, TestNoOverloadsOnCreation) {
   Expr dummy_expr0;
@@ -261,6 +235,169 @@ TEST(FunctionStepTest, TestNoMatchingOverloadsDuringEvaluationErrorForwarding) {
   EXPECT_THAT(value.ErrorOrDie(), Eq(&error0));
 }
 
+// Returns the number of its arguments of the type in descriptor.
+class CountArgumentsFunction : public CelFunction {
+ public:
+  explicit CountArgumentsFunction(CelValue::Type type)
+      : CelFunction(Descriptor{"count", false, {type, type}}) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    int64_t count = 0;
+    for (const auto& arg : args) {
+      if (arg.type() == descriptor().types[0]) {
+        count++;
+      }
+    }
+    *result = CelValue::CreateInt64(
+        count + 10 * static_cast<int64_t>(descriptor().types[0]));
+    return util::OkStatus();
+  }
+};
+
+TEST(OverloadCacheTest, FindAndStore) {
+  std::string str = "a";
+  std::vector<CelValue> int_args = {CelValue::CreateInt64(1),
+                                    CelValue::CreateInt64(2)};
+  std::vector<CelValue> string_args = {CelValue::CreateString(&str),
+                                       CelValue::CreateString(&str)};
+  std::vector<CelValue> mixed_args = {CelValue::CreateInt64(1),
+                                      CelValue::CreateString(&str)};
+  uint64_t int_types = CelFunction::PackTypes(int_args);
+  uint64_t string_types = CelFunction::PackTypes(string_args);
+  uint64_t mixed_types = CelFunction::PackTypes(mixed_args);
+
+  OverloadCache cache;
+  EXPECT_THAT(cache.Find(int_types), Eq(-1));
+
+  cache.Store(int_types, 0);
+  EXPECT_THAT(cache.Find(int_types), Eq(0));
+  EXPECT_THAT(cache.Find(string_types), Eq(-1));
+
+  // Cache keeps the most recently stored entries.
+  cache.Store(string_types, 1);
+  EXPECT_THAT(cache.Find(int_types), Eq(0));
+  EXPECT_THAT(cache.Find(string_types), Eq(1));
+
+  cache.Store(mixed_types, 2);
+  EXPECT_THAT(cache.Find(int_types), Eq(-1));
+  EXPECT_THAT(cache.Find(string_types), Eq(1));
+  EXPECT_THAT(cache.Find(mixed_types), Eq(2));
+}
+
+// Builds expression count(a, b) with overloads for int64, string and double.
+class CachedOverloadsTest : public testing::Test {
+ protected:
+  CachedOverloadsTest()
+      : int_func_(CelValue::Type::kInt64),
+        string_func_(CelValue::Type::kString),
+        double_func_(CelValue::Type::kDouble) {
+    ident_a_.mutable_ident_expr()->set_name("a");
+    ident_b_.mutable_ident_expr()->set_name("b");
+
+    ExecutionPath path;
+    path.push_back(std::move(
+        CreateIdentStep(&ident_a_.ident_expr(), &ident_a_).ValueOrDie()));
+    path.push_back(std::move(
+        CreateIdentStep(&ident_b_.ident_expr(), &ident_b_).ValueOrDie()));
+    path.push_back(std::move(
+        CreateFunctionStep(&call_expr_,
+                           {&int_func_, &string_func_, &double_func_})
+            .ValueOrDie()));
+    impl_ = absl::make_unique<CelExpressionFlatImpl>(&call_expr_,
+                                                     std::move(path));
+  }
+
+  // Evaluates the expression, returning -1 on failure.
+  int64_t Evaluate(const CelValue& a, const CelValue& b) {
+    Activation activation;
+    activation.InsertValue("a", a);
+    activation.InsertValue("b", b);
+    google::protobuf::Arena arena;
+    auto status = impl_->Evaluate(activation, &arena);
+    if (!util::IsOk(status) || !status.ValueOrDie().IsInt64()) {
+      return -1;
+    }
+    return status.ValueOrDie().Int64OrDie();
+  }
+
+  Expr ident_a_;
+  Expr ident_b_;
+  Expr call_expr_;
+  CountArgumentsFunction int_func_;
+  CountArgumentsFunction string_func_;
+  CountArgumentsFunction double_func_;
+  std::unique_ptr<CelExpressionFlatImpl> impl_;
+};
+
+TEST_F(CachedOverloadsTest, ChangingArgumentTypes) {
+  std::string str = "a";
+  int64_t int_result = 2 + 10 * static_cast<int64_t>(CelValue::Type::kInt64);
+  int64_t string_result =
+      2 + 10 * static_cast<int64_t>(CelValue::Type::kString);
+  int64_t double_result =
+      2 + 10 * static_cast<int64_t>(CelValue::Type::kDouble);
+
+  // More type combinations than cache entries, in changing order.
+  for (int i = 0; i < 3; i++) {
+    EXPECT_THAT(Evaluate(CelValue::CreateInt64(1), CelValue::CreateInt64(2)),
+                Eq(int_result));
+    EXPECT_THAT(Evaluate(CelValue::CreateString(&str),
+                         CelValue::CreateString(&str)),
+                Eq(string_result));
+    EXPECT_THAT(
+        Evaluate(CelValue::CreateDouble(1), CelValue::CreateDouble(2)),
+        Eq(double_result));
+    // Types without matching overload are never cached.
+    EXPECT_THAT(Evaluate(CelValue::CreateInt64(1), CelValue::CreateDouble(2)),
+                Eq(-1));
+    EXPECT_THAT(Evaluate(CelValue::CreateInt64(1), CelValue::CreateInt64(2)),
+                Eq(int_result));
+  }
+}
+
+TEST_F(CachedOverloadsTest, ConcurrentEvaluation) {
+  std::string str = "a";
+  int64_t int_result = 2 + 10 * static_cast<int64_t>(CelValue::Type::kInt64);
+  int64_t string_result =
+      2 + 10 * static_cast<int64_t>(CelValue::Type::kString);
+  int64_t double_result =
+      2 + 10 * static_cast<int64_t>(CelValue::Type::kDouble);
+
+  // Threads evaluate with different argument types, competing for cache
+  // entries.
+  std::vector<std::thread> threads;
+  std::vector<int> failures(3, 0);
+  for (int t = 0; t < 3; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 1000; i++) {
+        bool ok;
+        switch (t) {
+          case 0:
+            ok = Evaluate(CelValue::CreateInt64(1),
+                          CelValue::CreateInt64(2)) == int_result;
+            break;
+          case 1:
+            ok = Evaluate(CelValue::CreateString(&str),
+                          CelValue::CreateString(&str)) == string_result;
+            break;
+          default:
+            ok = Evaluate(CelValue::CreateDouble(1),
+                          CelValue::CreateDouble(2)) == double_result;
+            break;
+        }
+        if (!ok) {
+          failures[t]++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(failures, testing::ElementsAre(0, 0, 0));
+}
+
 }  // namespace
 
 }  // namespace runtime
@@ -10,43 +10,56 @@ namespace runtime {
 namespace {
 class IdentStep : public ExpressionStepBase {
  public:
-  IdentStep(absl::string_view name, const google::api::expr::v1alpha1::Expr* expr)
-      : ExpressionStepBase(expr), name_(name) {}
+  IdentStep(absl::string_view name, int slot,
+            const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), name_(name), slot_(slot) {}
 
   util::Status Evaluate(ExecutionFrame* frame) const override;
 
+  bool Lower(Instruction* instruction) const override {
+    if (slot_ < 0) {
+      return false;
+    }
+    instruction->opcode = Opcode::kIdent;
+    instruction->operand = slot_;
+    return true;
+  }
+
  private:
   std::string name_;
+  int slot_;
 };
 
 util::Status IdentStep::Evaluate(ExecutionFrame* frame) const {
+  // We handle masked unknown paths for the sake of uniformity, although it is
+  // better not to bind unknown values to activation in first place.
+  bool unknown_value = frame->activation().has_unknown_paths() &&
+                       frame->activation().IsPathUnknown(name_);
+
+  // Fast path: value bound to the slot.
+  const CelValue* slot_value = frame->FindSlotValue(slot_);
+  if (slot_value != nullptr && !unknown_value) {
+    frame->value_stack().Push(*slot_value);
+    return util::OkStatus();
+  }
+
   CelValue result;
-  auto it = frame->iter_vars().find(name_);
-  if (it != frame->iter_vars().end()) {
-    result = it->second;
-  } else {
+  if (!unknown_value) {
     auto value = frame->activation().FindValue(name_, frame->arena());
-
-    // We handle masked unknown paths for the sake of uniformity, although it is
-    // better not to bind unknown values to activation in first place.
-    bool unknown_value = frame->activation().IsPathUnknown(name_);
-
-    if (!unknown_value) {
-      if (value.has_value()) {
-        result = value.value();
-      } else {
-        result = CreateErrorValue(
-            frame->arena(),
-            absl::Substitute("No value with name \"$0\" found in Activation",
-                             name_),
-            CelError::UNKNOWN);
-      }
+    if (value.has_value()) {
+      result = value.value();
     } else {
       result = CreateErrorValue(
           frame->arena(),
-          absl::Substitute("Value with name \"$0\" is unknown", name_),
+          absl::Substitute("No value with name \"$0\" found in Activation",
+                           name_),
           CelError::UNKNOWN);
     }
+  } else {
+    result = CreateErrorValue(
+        frame->arena(),
+        absl::Substitute("Value with name \"$0\" is unknown", name_),
+        CelError::UNKNOWN);
   }
 
   frame->value_stack().Push(result);
@@ -54,13 +67,49 @@ util::Status IdentStep::Evaluate(ExecutionFrame* frame) const {
   return util::OkStatus();
 }
 
+// IterVarIdentStep reads comprehension variable by the frame slot index
+// resolved at build time, instead of looking it up by name.
+class IterVarIdentStep : public ExpressionStepBase {
+ public:
+  IterVarIdentStep(int slot, const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), slot_(slot) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override {
+    frame->value_stack().Push(frame->iter_var(slot_));
+    return util::OkStatus();
+  }
+
+  bool Lower(Instruction* instruction) const override {
+    instruction->opcode = Opcode::kIterVar;
+    instruction->operand = slot_;
+    return true;
+  }
+
+ private:
+  int slot_;
+};
+
 }  // namespace
 
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateIdentStep(
     const google::api::expr::v1alpha1::Expr::Ident* ident_expr,
+    const google::api::expr::v1alpha1::Expr* expr, int variable_slot) {
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<IdentStep>(ident_expr->name(), variable_slot, expr);
+  return std::move(step);
+}
+
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateIterVarIdentStep(
+    const google::api::expr::v1alpha1::Expr::Ident* ident_expr, int slot,
     const google::api::expr::v1alpha1::Expr* expr) {
+  if (slot < 0) {
+    return util::MakeStatus(
+        google::rpc::Code::INVALID_ARGUMENT,
+        absl::Substitute("Invalid slot for comprehension variable \"$0\"",
+                         ident_expr->name()));
+  }
   std::unique_ptr<ExpressionStep> step =
-      absl::make_unique<IdentStep>(ident_expr->name(), expr);
+      absl::make_unique<IterVarIdentStep>(slot, expr);
   return std::move(step);
 }
 
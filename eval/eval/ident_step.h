@@ -11,8 +11,16 @@ namespace expr {
 namespace runtime {
 
 // Factory method for Ident - based Execution step
+// variable_slot is the slot assigned to the variable at build time. When the
+// activation binds a value to the slot, it is used instead of name lookup.
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateIdentStep(
     const google::api::expr::v1alpha1::Expr::Ident* ident,
+    const google::api::expr::v1alpha1::Expr* expr, int variable_slot = -1);
+
+// Factory method for Ident - based Execution step, that reads comprehension
+// variable from the frame slot assigned to it at build time.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateIterVarIdentStep(
+    const google::api::expr::v1alpha1::Expr::Ident* ident, int slot,
     const google::api::expr::v1alpha1::Expr* expr);
 
 }  // namespace runtime
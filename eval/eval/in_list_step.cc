@@ -0,0 +1,67 @@
+#include "eval/eval/in_list_step.h"
+
+#include "absl/memory/memory.h"
+#include "eval/eval/expression_step_base.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+class InConstantListStep : public ExpressionStepBase {
+ public:
+  InConstantListStep(std::shared_ptr<const CelListIndex> index,
+                     const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), index_(std::move(index)) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  std::shared_ptr<const CelListIndex> index_;
+};
+
+// Stack changes of InConstantListStep.
+//
+// Stack size before: 2.
+// Stack size after: 1.
+util::Status InConstantListStep::Evaluate(ExecutionFrame* frame) const {
+  const CelValue& value = frame->value_stack().GetSpan(2)[0];
+  CelValue result;
+  switch (value.type()) {
+    case CelValue::Type::kBool:
+    case CelValue::Type::kInt64:
+    case CelValue::Type::kUint64:
+    case CelValue::Type::kDouble:
+    case CelValue::Type::kString:
+    case CelValue::Type::kBytes:
+      result = CelValue::CreateBool(index_->Contains(value));
+      break;
+    case CelValue::Type::kError:
+      result = value;
+      break;
+    default:
+      // Same as the function step when no overload matches.
+      result = CreateErrorValue(frame->arena(), "No matching overloads found",
+                                CelError::Code::CelError_Code_UNKNOWN);
+  }
+  frame->value_stack().Pop(2);
+  frame->value_stack().Push(result);
+  return util::OkStatus();
+}
+
+}  // namespace
+
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateInConstantListStep(
+    std::shared_ptr<const CelListIndex> index,
+    const google::api::expr::v1alpha1::Expr* expr) {
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<InConstantListStep>(std::move(index), expr);
+  return std::move(step);
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,26 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_IN_LIST_STEP_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_IN_LIST_STEP_H_
+
+#include <memory>
+
+#include "eval/eval/evaluator_core.h"
+#include "eval/eval/list_index.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Factory method for the step of in operator calls with a constant list,
+// indexed in advance. Takes the value and the list from the stack, as the
+// function step does, but looks the value up in the index.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateInConstantListStep(
+    std::shared_ptr<const CelListIndex> index,
+    const google::api::expr::v1alpha1::Expr* expr);
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_IN_LIST_STEP_H_
@@ -0,0 +1,174 @@
+#include "eval/eval/instruction_engine.h"
+
+#include "eval/eval/field_access.h"
+#include "eval/eval/function_step.h"
+#include "eval/eval/select_step.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::protobuf::FieldDescriptor;
+
+bool IsJump(Opcode opcode) {
+  return opcode == Opcode::kJump || opcode == Opcode::kCondJump ||
+         opcode == Opcode::kErrorJump;
+}
+
+// Evaluates the step the instruction was lowered from.
+// Steps may perform jumps, so the program counter of the engine is passed
+// through the frame.
+util::Status EvaluateStep(const Instruction& instruction, ExecutionFrame* frame,
+                          int* pc) {
+  frame->set_pc(*pc);
+  util::Status status = instruction.step->Evaluate(frame);
+  *pc = frame->pc();
+  return status;
+}
+
+}  // namespace
+
+CelExpressionInstructionImpl::CelExpressionInstructionImpl(
+    const google::api::expr::v1alpha1::Expr* root_expr, ExecutionPath path,
+    int iter_var_slots, std::vector<std::string> variable_slots,
+    int max_stack_depth, std::unique_ptr<google::protobuf::Arena> constant_arena,
+    CelExecutor* executor,
+    std::unique_ptr<const google::protobuf::FieldMask> referenced_paths)
+    : CelExpressionFlatImpl(root_expr, std::move(path), iter_var_slots,
+                            std::move(variable_slots), max_stack_depth,
+                            std::move(constant_arena), executor,
+                            std::move(referenced_paths)) {
+  int code_size = this->path().size();
+  code_.reserve(code_size);
+  for (int i = 0; i < code_size; i++) {
+    const ExpressionStep* step = this->path()[i].get();
+    Instruction instruction;
+    if (!step->Lower(&instruction)) {
+      instruction = Instruction();
+    }
+    // Jumps out of range are left to the step, to report the error
+    // in the same way as the reference implementation.
+    if (IsJump(instruction.opcode)) {
+      int target = i + 1 + instruction.operand;
+      if (target < 0 || target > code_size) {
+        instruction = Instruction();
+      }
+    }
+    instruction.step = step;
+    code_.push_back(instruction);
+  }
+}
+
+util::StatusOr<CelValue> CelExpressionInstructionImpl::Evaluate(
+    const Activation& activation, CelEvaluationState* state) const {
+  auto flat_state = dynamic_cast<CelExpressionFlatEvaluationState*>(state);
+  // Only the steps evaluated through ExpressionStep::Evaluate and function
+  // overloads report errors with status. Failing status stops evaluation.
+  util::Status status = PrepareState(flat_state);
+  if (!util::IsOk(status)) {
+    return status;
+  }
+
+  ExecutionFrame frame(&path(), activation, flat_state, &variable_slots(),
+                       executor());
+  ValueStack& stack = frame.value_stack();
+  const bool has_unknown_paths = activation.has_unknown_paths();
+
+  const Instruction* code = code_.data();
+  const int code_size = code_.size();
+  int pc = 0;
+  while (pc < code_size) {
+    const Instruction& instruction = code[pc++];
+    switch (instruction.opcode) {
+      case Opcode::kConst:
+        stack.Push(instruction.value);
+        continue;
+      case Opcode::kIdent: {
+        const CelValue* value = frame.FindSlotValue(instruction.operand);
+        if (value != nullptr && !has_unknown_paths) {
+          stack.Push(*value);
+          continue;
+        }
+        break;
+      }
+      case Opcode::kIterVar:
+        stack.Push(frame.iter_var(instruction.operand));
+        continue;
+      case Opcode::kCall:
+        status = InvokeMatchingOverload(instruction.overloads,
+                                        instruction.operand, &frame,
+                                        instruction.overload_cache);
+        if (!util::IsOk(status)) {
+          return status;
+        }
+        continue;
+      case Opcode::kSelect: {
+        if (has_unknown_paths || !stack.Peek().IsMessage()) {
+          break;
+        }
+        const google::protobuf::Message* msg = stack.Peek().MessageOrDie();
+        if (msg == nullptr) {
+          break;
+        }
+        const FieldDescriptor* field_desc = instruction.field_cache->FindField(
+            msg->GetDescriptor(), *instruction.field);
+        if (field_desc == nullptr || field_desc->is_repeated()) {
+          break;
+        }
+        CelValue result;
+        status = CreateValueFromSingleField(msg, field_desc, frame.arena(),
+                                            &result);
+        if (!util::IsOk(status)) {
+          return status;
+        }
+        stack.PopAndPush(result);
+        continue;
+      }
+      case Opcode::kJump:
+        pc += instruction.operand;
+        continue;
+      case Opcode::kCondJump: {
+        const CelValue& value = stack.Peek();
+        bool jump =
+            value.IsBool() && value.BoolOrDie() == instruction.condition;
+        if (!instruction.leave_on_stack) {
+          stack.Pop(1);
+        }
+        if (jump) {
+          pc += instruction.operand;
+        }
+        continue;
+      }
+      case Opcode::kErrorJump:
+        if (stack.Peek().IsError()) {
+          pc += instruction.operand;
+        }
+        continue;
+      case Opcode::kStep:
+        break;
+    }
+
+    // Instructions without the inline implementation for the operands
+    // get here, as well as the generic steps.
+    status = EvaluateStep(instruction, &frame, &pc);
+    if (!util::IsOk(status)) {
+      return status;
+    }
+  }
+
+  if (stack.size() != 1) {
+    return util::MakeStatus(google::rpc::Code::INTERNAL,
+                        "Stack error during evaluation");
+  }
+  CelValue value = stack.Peek();
+  stack.Pop(1);
+  return value;
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
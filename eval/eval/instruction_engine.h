@@ -0,0 +1,48 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_INSTRUCTION_ENGINE_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_INSTRUCTION_ENGINE_H_
+
+#include "eval/eval/evaluator_core.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Experimental implementation of the CelExpression that lowers the flat
+// execution path to an array of instructions and runs it with opcode
+// dispatch.
+// Constants, identifiers, selects of message fields and jumps are executed
+// inline, without virtual calls. Function calls still go through the
+// overloads, which report errors with status; remaining steps are evaluated
+// with ExpressionStep::Evaluate.
+// Evaluation results are identical to CelExpressionFlatImpl, which remains
+// the reference implementation and is used for tracing.
+class CelExpressionInstructionImpl : public CelExpressionFlatImpl {
+ public:
+  // Constructs CelExpressionInstructionImpl instance.
+  // Parameters are the same as for CelExpressionFlatImpl.
+  CelExpressionInstructionImpl(
+      const google::api::expr::v1alpha1::Expr* root_expr, ExecutionPath path,
+      int iter_var_slots = 0, std::vector<std::string> variable_slots = {},
+      int max_stack_depth = -1,
+      std::unique_ptr<google::protobuf::Arena> constant_arena = nullptr,
+      CelExecutor* executor = nullptr,
+      std::unique_ptr<const google::protobuf::FieldMask> referenced_paths =
+          nullptr);
+
+  using CelExpressionFlatImpl::Evaluate;
+
+  // Implementation of CelExpression evaluate method with reusable state.
+  util::StatusOr<CelValue> Evaluate(const Activation& activation,
+                                    CelEvaluationState* state) const override;
+
+ private:
+  std::vector<Instruction> code_;
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_INSTRUCTION_ENGINE_H_
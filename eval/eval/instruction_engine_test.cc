@@ -0,0 +1,414 @@
+#include "eval/eval/instruction_engine.h"
+
+#include "google/protobuf/field_mask.pb.h"
+#include "google/protobuf/text_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "eval/compiler/flat_expr_builder.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/public/activation.h"
+#include "eval/public/builtin_func_registrar.h"
+#include "eval/public/cel_executor.h"
+#include "eval/public/cel_value.h"
+#include "eval/testutil/test_message.pb.h"
+#include "absl/strings/str_cat.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::api::expr::v1alpha1::Expr;
+using google::api::expr::v1alpha1::SourceInfo;
+using testing::Eq;
+
+// Differential tests: expressions are evaluated by the reference
+// CelExpressionFlatImpl and by CelExpressionInstructionImpl, results
+// must be the same.
+class InstructionEngineTest : public testing::Test {
+ protected:
+  InstructionEngineTest()
+      : list_({CelValue::CreateInt64(1), CelValue::CreateInt64(2),
+               CelValue::CreateInt64(3)}) {
+    message_.set_int64_value(42);
+    message_.set_string_value("test");
+    message_.mutable_message_value()->set_int64_value(7);
+    message_.add_int64_list(1);
+    message_.add_int64_list(2);
+    (*message_.mutable_string_int32_map())["key"] = 3;
+
+    activation_.InsertValue("x", CelValue::CreateInt64(5));
+    activation_.InsertValue("y", CelValue::CreateInt64(-2));
+    activation_.InsertValue("list", CelValue::CreateList(&list_));
+    activation_.InsertValue("msg", CelValue::CreateMessage(&message_, &arena_));
+  }
+
+  // Builds the expression with both implementations and checks that
+  // evaluation results match.
+  void ExpectSameResult(const std::string& expr_text) {
+    Expr expr;
+    ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+
+    for (bool shortcircuiting : {true, false}) {
+      SCOPED_TRACE(shortcircuiting ? "shortcircuiting" : "no shortcircuiting");
+
+      CelValue expected;
+      ASSERT_NO_FATAL_FAILURE(Evaluate(expr, shortcircuiting,
+                                       /*instruction_engine=*/false,
+                                       &expected));
+      CelValue actual;
+      ASSERT_NO_FATAL_FAILURE(Evaluate(expr, shortcircuiting,
+                                       /*instruction_engine=*/true, &actual));
+      ExpectSameValue(expected, actual);
+    }
+  }
+
+  void Evaluate(const Expr& expr, bool shortcircuiting, bool instruction_engine,
+                CelValue* result) {
+    FlatExprBuilder builder;
+    builder.set_shortcircuiting(shortcircuiting);
+    builder.set_instruction_engine(instruction_engine);
+    if (executor_ != nullptr) {
+      builder.set_parallel_comprehensions(executor_, 2);
+    }
+    ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+
+    SourceInfo source_info;
+    auto build_status = builder.CreateExpression(&expr, &source_info);
+    ASSERT_TRUE(util::IsOk(build_status.status()));
+    auto cel_expr = std::move(build_status.ValueOrDie());
+
+    auto eval_status = cel_expr->Evaluate(activation_, &arena_);
+    ASSERT_TRUE(util::IsOk(eval_status.status()));
+    *result = eval_status.ValueOrDie();
+  }
+
+  void ExpectSameValue(const CelValue& expected, const CelValue& actual) {
+    ASSERT_THAT(actual.type(), Eq(expected.type()));
+    switch (expected.type()) {
+      case CelValue::Type::kBool:
+        EXPECT_THAT(actual.BoolOrDie(), Eq(expected.BoolOrDie()));
+        break;
+      case CelValue::Type::kInt64:
+        EXPECT_THAT(actual.Int64OrDie(), Eq(expected.Int64OrDie()));
+        break;
+      case CelValue::Type::kString:
+        EXPECT_THAT(actual.StringOrDie().value(),
+                    Eq(expected.StringOrDie().value()));
+        break;
+      case CelValue::Type::kMessage:
+        EXPECT_THAT(actual.MessageOrDie(), Eq(expected.MessageOrDie()));
+        break;
+      case CelValue::Type::kList:
+        EXPECT_THAT(actual.ListOrDie()->size(),
+                    Eq(expected.ListOrDie()->size()));
+        break;
+      case CelValue::Type::kMap:
+        EXPECT_THAT(actual.MapOrDie()->size(), Eq(expected.MapOrDie()->size()));
+        break;
+      case CelValue::Type::kError:
+        EXPECT_THAT(actual.ErrorOrDie()->code(),
+                    Eq(expected.ErrorOrDie()->code()));
+        EXPECT_THAT(actual.ErrorOrDie()->message(),
+                    Eq(expected.ErrorOrDie()->message()));
+        break;
+      default:
+        FAIL() << "Unexpected result type";
+    }
+  }
+
+  google::protobuf::Arena arena_;
+  TestMessage message_;
+  ContainerBackedListImpl list_;
+  Activation activation_;
+  // Evaluates comprehensions in parallel, if not null.
+  CelExecutor* executor_ = nullptr;
+};
+
+TEST_F(InstructionEngineTest, Arithmetic) {
+  // 1 + 2 * 3 - x
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_-_"
+      args {
+        call_expr {
+          function: "_+_"
+          args { const_expr { int64_value: 1 } }
+          args {
+            call_expr {
+              function: "_*_"
+              args { const_expr { int64_value: 2 } }
+              args { const_expr { int64_value: 3 } }
+            }
+          }
+        }
+      }
+      args { ident_expr { name: "x" } }
+    })");
+}
+
+TEST_F(InstructionEngineTest, Logic) {
+  // x > 0 && y > 0 || x == 5
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_||_"
+      args {
+        call_expr {
+          function: "_&&_"
+          args {
+            call_expr {
+              function: "_>_"
+              args { ident_expr { name: "x" } }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+          args {
+            call_expr {
+              function: "_>_"
+              args { ident_expr { name: "y" } }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+        }
+      }
+      args {
+        call_expr {
+          function: "_==_"
+          args { ident_expr { name: "x" } }
+          args { const_expr { int64_value: 5 } }
+        }
+      }
+    })");
+}
+
+TEST_F(InstructionEngineTest, TernaryWithSelect) {
+  for (int64_t threshold : {0, 10}) {
+    // x > threshold ? msg.int64_value : msg.message_value.int64_value
+    ExpectSameResult(absl::StrCat(R"(
+      call_expr {
+        function: "_?_:_"
+        args {
+          call_expr {
+            function: "_>_"
+            args { ident_expr { name: "x" } }
+            args { const_expr { int64_value: )",
+                                  threshold, R"( } }
+          }
+        }
+        args {
+          select_expr {
+            operand { ident_expr { name: "msg" } }
+            field: "int64_value"
+          }
+        }
+        args {
+          select_expr {
+            operand {
+              select_expr {
+                operand { ident_expr { name: "msg" } }
+                field: "message_value"
+              }
+            }
+            field: "int64_value"
+          }
+        }
+      })"));
+  }
+}
+
+TEST_F(InstructionEngineTest, Select) {
+  for (const std::string field :
+       {"string_value", "message_value", "int64_list", "string_int32_map",
+        "no_such_field"}) {
+    SCOPED_TRACE(field);
+    ExpectSameResult(absl::StrCat(R"(
+      select_expr {
+        operand { ident_expr { name: "msg" } }
+        field: ")",
+                                  field, R"("
+      })"));
+    // has(msg.<field>)
+    ExpectSameResult(absl::StrCat(R"(
+      select_expr {
+        operand { ident_expr { name: "msg" } }
+        field: ")",
+                                  field, R"("
+        test_only: true
+      })"));
+  }
+}
+
+TEST_F(InstructionEngineTest, SelectFromUnknownPath) {
+  google::protobuf::FieldMask mask;
+  mask.add_paths("msg.int64_value");
+  activation_.set_unknown_paths(mask);
+
+  ExpectSameResult(R"(
+    select_expr {
+      operand { ident_expr { name: "msg" } }
+      field: "int64_value"
+    })");
+}
+
+// list.exists(e, e == x - 3)
+const char kExistsExpr[] = R"(
+    comprehension_expr {
+      iter_var: "e"
+      iter_range { ident_expr { name: "list" } }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: false } }
+      loop_condition {
+        call_expr {
+          function: "@not_strictly_false"
+          args {
+            call_expr {
+              function: "!_"
+              args { ident_expr { name: "__result__" } }
+            }
+          }
+        }
+      }
+      loop_step {
+        call_expr {
+          function: "_||_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_==_"
+              args { ident_expr { name: "e" } }
+              args {
+                call_expr {
+                  function: "_-_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 3 } }
+                }
+              }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })";
+
+TEST_F(InstructionEngineTest, Comprehension) {
+  ExpectSameResult(kExistsExpr);
+}
+
+// Executor running the tasks on the calling thread, counting them.
+class CountingExecutor : public CelExecutor {
+ public:
+  void Schedule(std::function<void()> task) override {
+    scheduled_++;
+    task();
+  }
+
+  int concurrency() const override { return 1; }
+
+  int scheduled() const { return scheduled_; }
+
+ private:
+  int scheduled_ = 0;
+};
+
+// The instruction engine evaluates loops in parallel with the executor, as
+// the reference implementation does.
+TEST_F(InstructionEngineTest, ParallelComprehension) {
+  Expr expr;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kExistsExpr, &expr));
+  CountingExecutor executor;
+  executor_ = &executor;
+
+  CelValue expected;
+  ASSERT_NO_FATAL_FAILURE(Evaluate(expr, /*shortcircuiting=*/true,
+                                   /*instruction_engine=*/false, &expected));
+  int reference_tasks = executor.scheduled();
+  ASSERT_THAT(reference_tasks, testing::Gt(0));
+
+  CelValue actual;
+  ASSERT_NO_FATAL_FAILURE(Evaluate(expr, /*shortcircuiting=*/true,
+                                   /*instruction_engine=*/true, &actual));
+  EXPECT_THAT(executor.scheduled(), Eq(2 * reference_tasks));
+  ExpectSameValue(expected, actual);
+}
+
+TEST_F(InstructionEngineTest, Errors) {
+  // missing + 1
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_+_"
+      args { ident_expr { name: "missing" } }
+      args { const_expr { int64_value: 1 } }
+    })");
+  // "a" + 1
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_+_"
+      args { const_expr { string_value: "a" } }
+      args { const_expr { int64_value: 1 } }
+    })");
+  // x / 0
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_/_"
+      args { ident_expr { name: "x" } }
+      args { const_expr { int64_value: 0 } }
+    })");
+  // missing || x > 0
+  ExpectSameResult(R"(
+    call_expr {
+      function: "_||_"
+      args { ident_expr { name: "missing" } }
+      args {
+        call_expr {
+          function: "_>_"
+          args { ident_expr { name: "x" } }
+          args { const_expr { int64_value: 0 } }
+        }
+      }
+    })");
+}
+
+TEST_F(InstructionEngineTest, SlotActivationAndReusedState) {
+  Expr expr;
+  // x + y
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_+_"
+      args { ident_expr { name: "x" } }
+      args { ident_expr { name: "y" } }
+    })",
+                                                  &expr));
+
+  FlatExprBuilder builder;
+  builder.set_instruction_engine(true);
+  ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+
+  SourceInfo source_info;
+  auto build_status = builder.CreateExpression(&expr, &source_info);
+  ASSERT_TRUE(util::IsOk(build_status.status()));
+  auto cel_expr = std::move(build_status.ValueOrDie());
+
+  SlotActivation activation(&cel_expr->variable_slots());
+  auto state = cel_expr->InitializeState(&arena_);
+
+  for (int64_t i = 0; i < 3; i++) {
+    activation.SetSlotValue(0, CelValue::CreateInt64(i));
+    // Variable bound by name is found through the step.
+    activation.InsertValue("y", CelValue::CreateInt64(1));
+
+    auto eval_status = cel_expr->Evaluate(activation, state.get());
+    ASSERT_TRUE(util::IsOk(eval_status.status()));
+    ASSERT_TRUE(eval_status.ValueOrDie().IsInt64());
+    EXPECT_THAT(eval_status.ValueOrDie().Int64OrDie(), Eq(i + 1));
+    activation.RemoveValueEntry("y");
+  }
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
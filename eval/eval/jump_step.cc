@@ -17,6 +17,10 @@ class JumpStep : public JumpStepBase {
   util::Status Evaluate(ExecutionFrame* frame) const override {
     return Jump(frame);
   }
+
+  bool Lower(Instruction* instruction) const override {
+    return LowerJump(Opcode::kJump, instruction);
+  }
 };
 
 class CondJumpStep : public JumpStepBase {
@@ -31,10 +35,6 @@ class CondJumpStep : public JumpStepBase {
 
   util::Status Evaluate(ExecutionFrame* frame) const override {
     // Peek the top value
-    if (!frame->value_stack().HasEnough(1)) {
-      return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-    }
-
     CelValue value = frame->value_stack().Peek();
 
     if (!leave_on_stack_) {
@@ -48,6 +48,12 @@ class CondJumpStep : public JumpStepBase {
     return util::OkStatus();
   }
 
+  bool Lower(Instruction* instruction) const override {
+    instruction->condition = jump_condition_;
+    instruction->leave_on_stack = leave_on_stack_;
+    return LowerJump(Opcode::kCondJump, instruction);
+  }
+
  private:
   const bool jump_condition_;
   const bool leave_on_stack_;
@@ -63,10 +69,6 @@ class ErrorJumpStep : public JumpStepBase {
 
   util::Status Evaluate(ExecutionFrame* frame) const override {
     // Peek the top value
-    if (!frame->value_stack().HasEnough(1)) {
-      return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-    }
-
     CelValue value = frame->value_stack().Peek();
 
     if (value.IsError()) {
@@ -75,6 +77,10 @@ class ErrorJumpStep : public JumpStepBase {
 
     return util::OkStatus();
   }
+
+  bool Lower(Instruction* instruction) const override {
+    return LowerJump(Opcode::kErrorJump, instruction);
+  }
 };
 
 }  // namespace
@@ -27,6 +27,17 @@ class JumpStepBase : public ExpressionStepBase {
     return frame->JumpTo(jump_offset_.value());
   }
 
+ protected:
+  // Lowers the step to the jump instruction with the offset operand.
+  bool LowerJump(Opcode opcode, Instruction* instruction) const {
+    if (!jump_offset_.has_value()) {
+      return false;
+    }
+    instruction->opcode = opcode;
+    instruction->operand = jump_offset_.value();
+    return true;
+  }
+
  private:
   absl::optional<int> jump_offset_;
 };
@@ -0,0 +1,75 @@
+#include "eval/eval/list_index.h"
+
+#include <cmath>
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+CelListIndex::CelListIndex(const CelList& list)
+    : has_true_(false), has_false_(false) {
+  list.ForEach([this](const CelValue& element) {
+    switch (element.type()) {
+      case CelValue::Type::kBool:
+        (element.BoolOrDie() ? has_true_ : has_false_) = true;
+        break;
+      case CelValue::Type::kInt64:
+        ints_.Insert(element.Int64OrDie());
+        break;
+      case CelValue::Type::kUint64:
+        uints_.Insert(element.Uint64OrDie());
+        break;
+      case CelValue::Type::kDouble: {
+        double value = element.DoubleOrDie();
+        // NaN is not equal to anything, and -0.0 is equal to 0.0.
+        if (!std::isnan(value)) {
+          doubles_.Insert(value == 0 ? 0.0 : value);
+        }
+        break;
+      }
+      case CelValue::Type::kString:
+        strings_.insert(element.StringOrDie().value());
+        break;
+      case CelValue::Type::kBytes:
+        bytes_.insert(element.BytesOrDie().value());
+        break;
+      default:
+        // Values of other types are never equal to elements.
+        break;
+    }
+    return true;
+  });
+  ints_.Build();
+  uints_.Build();
+  doubles_.Build();
+}
+
+bool CelListIndex::Contains(const CelValue& value) const {
+  switch (value.type()) {
+    case CelValue::Type::kBool:
+      return value.BoolOrDie() ? has_true_ : has_false_;
+    case CelValue::Type::kInt64:
+      return ints_.Contains(value.Int64OrDie());
+    case CelValue::Type::kUint64:
+      return uints_.Contains(value.Uint64OrDie());
+    case CelValue::Type::kDouble: {
+      double number = value.DoubleOrDie();
+      if (std::isnan(number)) {
+        return false;
+      }
+      return doubles_.Contains(number == 0 ? 0.0 : number);
+    }
+    case CelValue::Type::kString:
+      return strings_.contains(value.StringOrDie().value());
+    case CelValue::Type::kBytes:
+      return bytes_.contains(value.BytesOrDie().value());
+    default:
+      return false;
+  }
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,77 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_LIST_INDEX_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_LIST_INDEX_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/string_view.h"
+#include "eval/public/cel_value.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Lookup index of list elements, implementing CelList::Contains in constant
+// time. String and bytes elements are referenced, not copied, so the index
+// must not outlive them.
+class CelListIndex {
+ public:
+  explicit CelListIndex(const CelList& list);
+
+  // Same as CelList::Contains of the indexed list.
+  bool Contains(const CelValue& value) const;
+
+ private:
+  // Set of numbers. Small sets are kept in a sorted array, which is faster to
+  // search than to hash the value.
+  template <typename T>
+  class NumberSet {
+   public:
+    void Insert(T value) { values_.push_back(value); }
+
+    // Must be called once all values are inserted.
+    void Build();
+
+    bool Contains(T value) const {
+      if (!set_.empty()) {
+        return set_.contains(value);
+      }
+      return std::binary_search(values_.begin(), values_.end(), value);
+    }
+
+   private:
+    std::vector<T> values_;
+    absl::flat_hash_set<T> set_;
+  };
+
+  // Maximum size of sets kept in a sorted array.
+  static constexpr size_t kMaxSortedSize = 16;
+
+  bool has_true_;
+  bool has_false_;
+  NumberSet<int64_t> ints_;
+  NumberSet<uint64_t> uints_;
+  NumberSet<double> doubles_;
+  absl::flat_hash_set<absl::string_view> strings_;
+  absl::flat_hash_set<absl::string_view> bytes_;
+};
+
+template <typename T>
+void CelListIndex::NumberSet<T>::Build() {
+  if (values_.size() > kMaxSortedSize) {
+    set_.insert(values_.begin(), values_.end());
+    values_.clear();
+    values_.shrink_to_fit();
+  } else {
+    std::sort(values_.begin(), values_.end());
+  }
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_LIST_INDEX_H_
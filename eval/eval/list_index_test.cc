@@ -0,0 +1,110 @@
+#include "eval/eval/list_index.h"
+
+#include <cmath>
+#include <limits>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "eval/eval/container_backed_list_impl.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+class CelListIndexTest : public testing::Test {
+ protected:
+  CelListIndexTest()
+      : string_a_("a"),
+        string_b_("b"),
+        list_({
+            CelValue::CreateBool(true),
+            CelValue::CreateInt64(-1),
+            CelValue::CreateInt64(7),
+            CelValue::CreateUint64(7),
+            CelValue::CreateDouble(-0.0),
+            CelValue::CreateDouble(std::numeric_limits<double>::quiet_NaN()),
+            CelValue::CreateString(&string_a_),
+            CelValue::CreateBytes(&string_b_),
+            CelValue::CreateNull(),
+        }) {}
+
+  // Expects the index and the default implementation to agree.
+  void ExpectContains(const CelListIndex& index, const CelValue& value,
+                      bool expected) {
+    EXPECT_EQ(index.Contains(value), expected);
+    EXPECT_EQ(list_.CelList::Contains(value), expected);
+  }
+
+  std::string string_a_;
+  std::string string_b_;
+  ContainerBackedListImpl list_;
+};
+
+TEST_F(CelListIndexTest, ComparesValuesOfSameType) {
+  CelListIndex index(list_);
+  std::string string_c = "c";
+
+  ExpectContains(index, CelValue::CreateBool(true), true);
+  ExpectContains(index, CelValue::CreateBool(false), false);
+  ExpectContains(index, CelValue::CreateInt64(7), true);
+  ExpectContains(index, CelValue::CreateInt64(-1), true);
+  ExpectContains(index, CelValue::CreateInt64(0), false);
+  ExpectContains(index, CelValue::CreateUint64(7), true);
+  ExpectContains(index, CelValue::CreateUint64(1), false);
+  ExpectContains(index, CelValue::CreateDouble(7), false);
+  // -0.0 == 0.0, NaN is not equal to itself.
+  ExpectContains(index, CelValue::CreateDouble(0.0), true);
+  ExpectContains(index,
+                 CelValue::CreateDouble(std::numeric_limits<double>::quiet_NaN()),
+                 false);
+  ExpectContains(index, CelValue::CreateString(&string_a_), true);
+  ExpectContains(index, CelValue::CreateString(&string_b_), false);
+  ExpectContains(index, CelValue::CreateString(&string_c), false);
+  ExpectContains(index, CelValue::CreateBytes(&string_b_), true);
+  ExpectContains(index, CelValue::CreateBytes(&string_a_), false);
+  ExpectContains(index, CelValue::CreateNull(), false);
+}
+
+TEST(CelListIndexLargeTest, HashedNumbers) {
+  std::vector<CelValue> values;
+  for (int64_t i = 0; i < 100; i++) {
+    values.push_back(CelValue::CreateInt64(i * 3));
+  }
+  ContainerBackedListImpl list(values);
+  CelListIndex index(list);
+  for (int64_t i = -10; i < 310; i++) {
+    EXPECT_EQ(index.Contains(CelValue::CreateInt64(i)),
+              i >= 0 && i < 300 && i % 3 == 0)
+        << i;
+  }
+}
+
+TEST(ContainerBackedListImplTest, LazyIndex) {
+  std::vector<std::string> strings;
+  for (int i = 0; i < 100; i++) {
+    strings.push_back(std::to_string(i));
+  }
+  std::vector<CelValue> values;
+  for (const auto& value : strings) {
+    values.push_back(CelValue::CreateString(&value));
+  }
+  ContainerBackedListImpl list(values);
+
+  // Results are the same before and after the list is indexed.
+  std::string missing = "missing";
+  for (int i = 0; i < 20; i++) {
+    EXPECT_TRUE(list.Contains(CelValue::CreateString(&strings[i * 5])));
+    EXPECT_FALSE(list.Contains(CelValue::CreateString(&missing)));
+    EXPECT_FALSE(list.Contains(CelValue::CreateInt64(i)));
+  }
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
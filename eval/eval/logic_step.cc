@@ -66,11 +66,6 @@ class LogicalOpStep : public ExpressionStepBase {
 };
 
 util::Status LogicalOpStep::Evaluate(ExecutionFrame* frame) const {
-  // Must have 2 or more values on the stack.
-  if (!frame->value_stack().HasEnough(2)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL, "Value stack underflow");
-  }
-
   // Create Span object that contains input arguments to the function.
   auto args = frame->value_stack().GetSpan(2);
 
@@ -0,0 +1,61 @@
+#include "eval/eval/regex_match_step.h"
+
+#include "absl/memory/memory.h"
+#include "eval/eval/expression_step_base.h"
+#include "eval/public/regex_match.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+class RegexMatchStep : public ExpressionStepBase {
+ public:
+  RegexMatchStep(std::shared_ptr<const RE2> re2,
+                 const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), re2_(std::move(re2)) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  std::shared_ptr<const RE2> re2_;
+};
+
+// Stack changes of RegexMatchStep.
+//
+// Stack size before: 2.
+// Stack size after: 1.
+util::Status RegexMatchStep::Evaluate(ExecutionFrame* frame) const {
+  const CelValue& target = frame->value_stack().GetSpan(2)[0];
+  CelValue result;
+  if (target.IsString()) {
+    result = RegexMatchResult(frame->arena(), target.StringOrDie().value(),
+                              *re2_);
+  } else if (target.IsError()) {
+    result = target;
+  } else {
+    // Same as the function step when no overload matches.
+    result = CreateErrorValue(frame->arena(), "No matching overloads found",
+                              CelError::Code::CelError_Code_UNKNOWN);
+  }
+  frame->value_stack().Pop(2);
+  frame->value_stack().Push(result);
+  return util::OkStatus();
+}
+
+}  // namespace
+
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateRegexMatchStep(
+    std::shared_ptr<const RE2> re2,
+    const google::api::expr::v1alpha1::Expr* expr) {
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<RegexMatchStep>(std::move(re2), expr);
+  return std::move(step);
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
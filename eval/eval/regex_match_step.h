@@ -0,0 +1,26 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_REGEX_MATCH_STEP_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_REGEX_MATCH_STEP_H_
+
+#include <memory>
+
+#include "eval/eval/evaluator_core.h"
+#include "re2/re2.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Factory method for the step of matches() calls with a constant pattern,
+// compiled in advance. Takes the target and the pattern from the stack, as
+// the function step does, but matches the target against re2.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateRegexMatchStep(
+    std::shared_ptr<const RE2> re2,
+    const google::api::expr::v1alpha1::Expr* expr);
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_REGEX_MATCH_STEP_H_
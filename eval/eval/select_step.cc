@@ -15,19 +15,26 @@ namespace {
 using google::protobuf::Reflection;
 using google::protobuf::Descriptor;
 using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
 
-// SelectStep performs message field access specified by Expr::Select
-// message.
-class SelectStep : public ExpressionStepBase {
+// FieldSelector performs message field access specified by Expr::Select
+// message, for the steps evaluating one or several selects.
+class FieldSelector {
  public:
-  SelectStep(absl::string_view field, bool test_field_presence,
-             const google::api::expr::v1alpha1::Expr* expr, absl::string_view select_path)
-      : ExpressionStepBase(expr),
-        field_(field),
+  FieldSelector(absl::string_view field, bool test_field_presence,
+                absl::string_view select_path)
+      : field_(field),
         test_field_presence_(test_field_presence),
         select_path_(select_path) {}
 
-  util::Status Evaluate(ExecutionFrame* frame) const override;
+  // Selects the field of arg. Errors are propagated as the result.
+  util::Status Select(const CelValue& arg, ExecutionFrame* frame,
+                      CelValue* result) const;
+
+  const std::string& field() const { return field_; }
+  bool test_field_presence() const { return test_field_presence_; }
+  const std::string& select_path() const { return select_path_; }
+  FieldLookupCache* field_cache() const { return &field_cache_; }
 
  private:
   util::Status CreateValueFromField(const google::protobuf::Message* message,
@@ -37,14 +44,15 @@ class SelectStep : public ExpressionStepBase {
   std::string field_;
   bool test_field_presence_;
   std::string select_path_;
+  mutable FieldLookupCache field_cache_;
 };
 
-util::Status SelectStep::CreateValueFromField(const google::protobuf::Message* msg,
-                                              google::protobuf::Arena* arena,
-                                              CelValue* result) const {
+util::Status FieldSelector::CreateValueFromField(
+    const google::protobuf::Message* msg, google::protobuf::Arena* arena,
+    CelValue* result) const {
   const Reflection* reflection = msg->GetReflection();
   const Descriptor* desc = msg->GetDescriptor();
-  const FieldDescriptor* field_desc = desc->FindFieldByName(field_);
+  const FieldDescriptor* field_desc = field_cache_.FindField(desc, field_);
 
   if (field_desc == nullptr) {
     CelError* error = google::protobuf::Arena::Create<CelError>(arena);
@@ -60,8 +68,8 @@ util::Status SelectStep::CreateValueFromField(const google::protobuf::Message* m
     return util::OkStatus();
   }
   if (field_desc->is_repeated()) {
-    *result = CelValue::CreateList(google::protobuf::Arena::Create<FieldBackedListImpl>(
-        arena, msg, field_desc, arena));
+    *result =
+        CelValue::CreateList(CreateFieldBackedList(msg, field_desc, arena));
     return util::OkStatus();
   }
   if (test_field_presence_) {
@@ -71,14 +79,8 @@ util::Status SelectStep::CreateValueFromField(const google::protobuf::Message* m
   return CreateValueFromSingleField(msg, field_desc, arena, result);
 }
 
-util::Status SelectStep::Evaluate(ExecutionFrame* frame) const {
-  if (!frame->value_stack().HasEnough(1)) {
-    return util::MakeStatus(google::rpc::Code::INTERNAL,
-                        "No arguments supplied for Select-type expression");
-  }
-
-  CelValue arg = frame->value_stack().Peek();
-
+util::Status FieldSelector::Select(const CelValue& arg, ExecutionFrame* frame,
+                                   CelValue* result) const {
   // Non-empty select path - check if value mapped to unknown.
   bool unknown_value = false;
   if (!select_path_.empty()) {
@@ -91,69 +93,57 @@ util::Status SelectStep::Evaluate(ExecutionFrame* frame) const {
       const google::protobuf::Message* msg = arg.MessageOrDie();
 
       if (msg == nullptr) {
-        CelValue error_value =
-            CreateErrorValue(frame->arena(), "Message is NULL");
-        frame->value_stack().PopAndPush(error_value);
+        *result = CreateErrorValue(frame->arena(), "Message is NULL");
         return util::OkStatus();
       }
 
       if (unknown_value) {
-        CelValue error_value = CreateErrorValue(
+        *result = CreateErrorValue(
             frame->arena(), absl::StrCat("Unknown value ", select_path_));
-        frame->value_stack().PopAndPush(error_value);
         return util::OkStatus();
       }
 
-      util::Status status = CreateValueFromField(msg, frame->arena(), &arg);
-
-      if (util::IsOk(status)) {
-        frame->value_stack().PopAndPush(arg);
-      }
-
-      return status;
+      return CreateValueFromField(msg, frame->arena(), result);
     }
     case CelValue::Type::kMap: {
       const CelMap* cel_map = arg.MapOrDie();
 
       if (cel_map == nullptr) {
-        CelValue error_value = CreateErrorValue(frame->arena(), "Map is NULL");
-        frame->value_stack().PopAndPush(error_value);
+        *result = CreateErrorValue(frame->arena(), "Map is NULL");
         return util::OkStatus();
       }
 
       if (unknown_value) {
-        CelValue error_value = CreateErrorValue(
+        *result = CreateErrorValue(
             frame->arena(), absl::StrCat("Unknown value ", select_path_));
-        frame->value_stack().PopAndPush(error_value);
         return util::OkStatus();
       }
 
-      auto lookup_result = (*cel_map)[CelValue::CreateString(&field_)];
+      CelValue key = CelValue::CreateString(&field_);
 
       // Test only Select expression.
       if (test_field_presence_) {
-        arg = CelValue::CreateBool(lookup_result.has_value());
-        frame->value_stack().PopAndPush(arg);
+        *result = CelValue::CreateBool(cel_map->Has(key));
         return util::OkStatus();
       }
 
+      auto lookup_result = cel_map->SelectField(key);
+
       // If object is not found, we return Error, per CEL specification.
       if (lookup_result) {
-        arg = lookup_result.value();
+        *result = lookup_result.value();
       } else {
         CelError* error = google::protobuf::Arena::Create<CelError>(frame->arena());
         error->set_message("Key not found in map");
         // Consider replacing Code_UNKNOWN with no_such_key.
         error->set_code(CelError::Code::CelError_Code_UNKNOWN);
-        arg = CelValue::CreateError(error);
+        *result = CelValue::CreateError(error);
       }
-      frame->value_stack().PopAndPush(arg);
-
       return util::OkStatus();
     }
     case CelValue::Type::kError: {
       // If argument is CelError, we propagate it forward.
-      // It is already on the top of the stack.
+      *result = arg;
       return util::OkStatus();
     }
     default:
@@ -162,8 +152,174 @@ util::Status SelectStep::Evaluate(ExecutionFrame* frame) const {
   }
 }
 
+// SelectStep performs message field access specified by Expr::Select
+// message.
+class SelectStep : public ExpressionStepBase {
+ public:
+  SelectStep(absl::string_view field, bool test_field_presence,
+             const google::api::expr::v1alpha1::Expr* expr, absl::string_view select_path)
+      : ExpressionStepBase(expr),
+        selector_(field, test_field_presence, select_path) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+  bool Lower(Instruction* instruction) const override {
+    if (selector_.test_field_presence()) {
+      return false;
+    }
+    instruction->opcode = Opcode::kSelect;
+    instruction->field = &selector_.field();
+    instruction->field_cache = selector_.field_cache();
+    return true;
+  }
+
+ private:
+  FieldSelector selector_;
+};
+
+util::Status SelectStep::Evaluate(ExecutionFrame* frame) const {
+  const CelValue& arg = frame->value_stack().Peek();
+  // Errors are already on the top of the stack.
+  if (arg.IsError()) {
+    return util::OkStatus();
+  }
+  CelValue result;
+  util::Status status = selector_.Select(arg, frame, &result);
+  if (util::IsOk(status)) {
+    frame->value_stack().PopAndPush(result);
+  }
+  return status;
+}
+
+// Returns true if CelValue::CreateMessage may convert messages of the type
+// to other values, e.g. wrappers or Struct.
+bool IsWellKnownType(const Descriptor* descriptor) {
+  return descriptor->file()->package() == "google.protobuf";
+}
+
+// SelectPathStep performs a chain of selects, e.g. a.b.c, as one step.
+// Singular submessages of the chain are accessed directly, without creating
+// CelValues for them; other values are processed by the selects one by one.
+class SelectPathStep : public ExpressionStepBase {
+ public:
+  SelectPathStep(std::vector<std::unique_ptr<FieldSelector>> selectors,
+                 const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), selectors_(std::move(selectors)) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  // Selectors of the chain, innermost first.
+  std::vector<std::unique_ptr<FieldSelector>> selectors_;
+};
+
+util::Status SelectPathStep::Evaluate(ExecutionFrame* frame) const {
+  CelValue value = frame->value_stack().Peek();
+  if (value.IsError()) {
+    return util::OkStatus();
+  }
+
+  // Paths of the selects are prefixes of the path of the last select, so
+  // none of them is unknown if that path is not.
+  const std::string& path = selectors_.back()->select_path();
+  bool unknown_path = !path.empty() &&
+                      frame->activation().has_unknown_paths() &&
+                      frame->activation().IsPathUnknown(path);
+
+  size_t index = 0;
+  if (value.IsMessage() && value.MessageOrDie() != nullptr && !unknown_path) {
+    const Message* msg = value.MessageOrDie();
+    for (; index + 1 < selectors_.size(); index++) {
+      const FieldDescriptor* field_desc =
+          selectors_[index]->field_cache()->FindField(
+              msg->GetDescriptor(), selectors_[index]->field());
+      if (field_desc == nullptr || field_desc->is_repeated() ||
+          field_desc->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE ||
+          IsWellKnownType(field_desc->message_type())) {
+        break;
+      }
+      msg = &msg->GetReflection()->GetMessage(*msg, field_desc);
+    }
+    if (index > 0) {
+      value = CelValue::CreateMessage(msg, frame->arena());
+    }
+  }
+
+  for (; index < selectors_.size(); index++) {
+    util::Status status = selectors_[index]->Select(value, frame, &value);
+    if (!util::IsOk(status)) {
+      return status;
+    }
+  }
+  frame->value_stack().PopAndPush(value);
+  return util::OkStatus();
+}
+
+// TypedSelectStep performs message field access for messages of the type
+// known at build time. The field and its reader are resolved at build time;
+// other values are processed by the generic SelectStep.
+class TypedSelectStep : public ExpressionStepBase {
+ public:
+  TypedSelectStep(const google::api::expr::v1alpha1::Expr::Select* select_expr,
+                  const google::api::expr::v1alpha1::Expr* expr,
+                  absl::string_view select_path, const Reflection* reflection,
+                  const FieldDescriptor* field_desc, SingleFieldReader reader)
+      : ExpressionStepBase(expr),
+        reflection_(reflection),
+        field_desc_(field_desc),
+        reader_(reader),
+        test_field_presence_(select_expr->test_only()),
+        has_select_path_(!select_path.empty()),
+        generic_step_(select_expr->field(), select_expr->test_only(), expr,
+                      select_path) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  // Reflection of the messages of the known type. Messages of the type with
+  // other implementations, e.g. dynamic messages, have other reflections.
+  const Reflection* reflection_;
+  const FieldDescriptor* field_desc_;
+  SingleFieldReader reader_;
+  bool test_field_presence_;
+  bool has_select_path_;
+  SelectStep generic_step_;
+};
+
+util::Status TypedSelectStep::Evaluate(ExecutionFrame* frame) const {
+  const CelValue& arg = frame->value_stack().Peek();
+  // Unknown paths are checked by the generic step.
+  if (arg.IsMessage() &&
+      !(has_select_path_ && frame->activation().has_unknown_paths())) {
+    const Message* msg = arg.MessageOrDie();
+    if (msg != nullptr && msg->GetReflection() == reflection_) {
+      CelValue result =
+          test_field_presence_
+              ? CelValue::CreateBool(reflection_->HasField(*msg, field_desc_))
+              : reader_(*msg, reflection_, field_desc_, frame->arena());
+      frame->value_stack().PopAndPush(result);
+      return util::OkStatus();
+    }
+  }
+  return generic_step_.Evaluate(frame);
+}
+
 }  // namespace
 
+const FieldDescriptor* FieldLookupCache::FindFieldSlow(
+    const Descriptor* descriptor, const std::string& name) {
+  const FieldDescriptor* field_desc = descriptor->FindFieldByName(name);
+  if (field_desc == nullptr) {
+    return nullptr;
+  }
+  for (int i = kEntries - 1; i > 0; i--) {
+    entries_[i].store(entries_[i - 1].load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+  }
+  entries_[0].store(field_desc, std::memory_order_relaxed);
+  return field_desc;
+}
+
 // Factory method for Select - based Execution step
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectStep(
     const google::api::expr::v1alpha1::Expr::Select* select_expr,
@@ -173,6 +329,47 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectStep(
   return std::move(step);
 }
 
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectPathStep(
+    absl::Span<const std::pair<const google::api::expr::v1alpha1::Expr::Select*,
+                               std::string>>
+        selects,
+    const google::api::expr::v1alpha1::Expr* expr) {
+  if (selects.empty()) {
+    return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                            "Empty select path");
+  }
+  std::vector<std::unique_ptr<FieldSelector>> selectors;
+  for (size_t i = 0; i < selects.size(); i++) {
+    const auto* select_expr = selects[i].first;
+    if (select_expr->test_only() && i + 1 < selects.size()) {
+      return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                              "Presence test in the middle of select path");
+    }
+    selectors.push_back(absl::make_unique<FieldSelector>(
+        select_expr->field(), select_expr->test_only(), selects[i].second));
+  }
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<SelectPathStep>(std::move(selectors), expr);
+  return std::move(step);
+}
+
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateTypedSelectStep(
+    const google::api::expr::v1alpha1::Expr::Select* select_expr,
+    const google::api::expr::v1alpha1::Expr* expr, absl::string_view select_path,
+    const google::protobuf::Message* prototype) {
+  const FieldDescriptor* field_desc =
+      prototype->GetDescriptor()->FindFieldByName(select_expr->field());
+  SingleFieldReader reader =
+      field_desc != nullptr ? GetSingleFieldReader(field_desc) : nullptr;
+  if (reader == nullptr) {
+    return CreateSelectStep(select_expr, expr, select_path);
+  }
+  std::unique_ptr<ExpressionStep> step = absl::make_unique<TypedSelectStep>(
+      select_expr, expr, select_path, prototype->GetReflection(), field_desc,
+      reader);
+  return std::move(step);
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
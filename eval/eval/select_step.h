@@ -1,15 +1,61 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_SELECT_STEP_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_EVAL_SELECT_STEP_H_
 
+#include <atomic>
+#include <string>
+#include <utility>
+
+#include "google/protobuf/descriptor.h"
 #include "eval/eval/evaluator_core.h"
 #include "eval/public/activation.h"
 #include "eval/public/cel_value.h"
+#include "absl/types/span.h"
 
 namespace google {
 namespace api {
 namespace expr {
 namespace runtime {
 
+// Inline cache of a select site: remembers the fields found for the last few
+// message types, so that the field name is not looked up again.
+// Safe for concurrent evaluations: each entry is a single atomic pointer to
+// the field descriptor, which identifies the message type it belongs to.
+// Racing updates may only cause cache misses.
+class FieldLookupCache {
+ public:
+  static constexpr int kEntries = 2;
+
+  FieldLookupCache() {
+    for (auto& entry : entries_) {
+      entry.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns the field of the message type with the name, or nullptr if there
+  // is no such field.
+  const google::protobuf::FieldDescriptor* FindField(
+      const google::protobuf::Descriptor* descriptor,
+      const std::string& name) {
+    for (const auto& entry : entries_) {
+      const google::protobuf::FieldDescriptor* field_desc =
+          entry.load(std::memory_order_relaxed);
+      if (field_desc != nullptr &&
+          field_desc->containing_type() == descriptor) {
+        return field_desc;
+      }
+    }
+    return FindFieldSlow(descriptor, name);
+  }
+
+ private:
+  // Looks up the field by name and caches it, evicting the least recently
+  // stored entry.
+  const google::protobuf::FieldDescriptor* FindFieldSlow(
+      const google::protobuf::Descriptor* descriptor, const std::string& name);
+
+  std::atomic<const google::protobuf::FieldDescriptor*> entries_[kEntries];
+};
+
 // Factory method for Select - based Execution step
 util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectStep(
     const google::api::expr::v1alpha1::Expr::Select* select_expr,
@@ -20,6 +66,26 @@ util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectStep(
     const google::api::expr::v1alpha1::Expr::Select* select_expr,
     const google::api::expr::v1alpha1::Expr* expr);
 
+// Factory method for the step performing a chain of selects, e.g. a.b.c,
+// given innermost first with their select paths (see CreateSelectStep).
+// Only the last select may be a presence test. expr is the outermost select.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateSelectPathStep(
+    absl::Span<const std::pair<const google::api::expr::v1alpha1::Expr::Select*,
+                               std::string>>
+        selects,
+    const google::api::expr::v1alpha1::Expr* expr);
+
+// Factory method for Select - based Execution step specialized for messages
+// of the type of the prototype, known at build time. The field is read from
+// messages with the reflection of the prototype without looking it up by
+// name; other values, including messages of the type with other
+// implementations, are processed by the generic step. The generic step is
+// returned for repeated and missing fields.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateTypedSelectStep(
+    const google::api::expr::v1alpha1::Expr::Select* select_expr,
+    const google::api::expr::v1alpha1::Expr* expr, absl::string_view select_path,
+    const google::protobuf::Message* prototype);
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
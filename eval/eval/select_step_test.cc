@@ -3,6 +3,7 @@
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/strings/str_cat.h"
 #include "eval/eval/container_backed_map_impl.h"
 #include "eval/eval/ident_step.h"
 #include "eval/testutil/test_message.pb.h"
@@ -392,6 +393,169 @@ TEST(SelectStepTest, MapSimpleInt32Test) {
 }
 
 // Test Select behavior, when expression to select from is an Error.
+TEST(SelectStepTest, FieldLookupCacheTest) {
+  const google::protobuf::Descriptor* message_desc = TestMessage::descriptor();
+  const google::protobuf::Descriptor* constant_desc =
+      google::api::expr::v1alpha1::Constant::descriptor();
+  FieldLookupCache cache;
+
+  // Fields of the message types seen at the select site are cached.
+  for (int i = 0; i < 2; i++) {
+    EXPECT_THAT(cache.FindField(message_desc, "int64_value"),
+                Eq(message_desc->FindFieldByName("int64_value")));
+    EXPECT_THAT(cache.FindField(constant_desc, "int64_value"),
+                Eq(constant_desc->FindFieldByName("int64_value")));
+  }
+
+  // Missing fields are not cached.
+  EXPECT_THAT(cache.FindField(Expr::descriptor(), "int64_value"),
+              Eq(nullptr));
+  EXPECT_THAT(cache.FindField(message_desc, "int64_value"),
+              Eq(message_desc->FindFieldByName("int64_value")));
+}
+
+TEST(SelectStepTest, SelectFromMessagesOfDifferentTypes) {
+  google::protobuf::Arena arena;
+  ExecutionPath path;
+  Expr dummy_expr;
+  auto select = dummy_expr.mutable_select_expr();
+  select->set_field("int64_value");
+  Expr* expr0 = select->mutable_operand();
+  auto ident = expr0->mutable_ident_expr();
+  ident->set_name("target");
+  auto step0_status = CreateIdentStep(ident, expr0);
+  auto step1_status = CreateSelectStep(select, &dummy_expr, "");
+  ASSERT_TRUE(util::IsOk(step0_status));
+  ASSERT_TRUE(util::IsOk(step1_status));
+  path.push_back(std::move(step0_status.ValueOrDie()));
+  path.push_back(std::move(step1_status.ValueOrDie()));
+  CelExpressionFlatImpl cel_expr(&dummy_expr, std::move(path));
+
+  TestMessage message;
+  message.set_int64_value(1);
+  google::api::expr::v1alpha1::Constant constant;
+  constant.set_int64_value(2);
+  for (int i = 0; i < 2; i++) {
+    for (const google::protobuf::Message* target :
+         {static_cast<const google::protobuf::Message*>(&message),
+          static_cast<const google::protobuf::Message*>(&constant)}) {
+      Activation activation;
+      activation.InsertValue("target",
+                             CelValue::CreateMessage(target, &arena));
+      auto status = cel_expr.Evaluate(activation, &arena);
+      ASSERT_TRUE(util::IsOk(status));
+      CelValue result = status.ValueOrDie();
+      ASSERT_TRUE(result.IsInt64());
+      EXPECT_EQ(result.Int64OrDie(), target == &message ? 1 : 2);
+    }
+  }
+}
+
+// Helper method. Creates pipeline containing the step for the chain of
+// selects of the fields from "target" and runs it.
+util::StatusOr<CelValue> RunSelectPath(const CelValue target,
+                                       std::vector<std::string> fields,
+                                       bool test, google::protobuf::Arena* arena,
+                                       const google::protobuf::FieldMask& unknown_paths) {
+  // Selects are nested outermost first.
+  Expr dummy_expr;
+  std::vector<std::pair<const Expr::Select*, std::string>> selects;
+  Expr* expr = &dummy_expr;
+  std::string path = "target";
+  for (size_t i = 0; i < fields.size(); i++) {
+    auto select = expr->mutable_select_expr();
+    select->set_field(fields[fields.size() - 1 - i]);
+    select->set_test_only(test && i == 0);
+    selects.emplace(selects.begin(), select, "");
+    expr = select->mutable_operand();
+  }
+  for (auto& select : selects) {
+    path = absl::StrCat(path, ".", select.first->field());
+    select.second = path;
+  }
+  auto ident = expr->mutable_ident_expr();
+  ident->set_name("target");
+
+  auto step0_status = CreateIdentStep(ident, expr);
+  auto step1_status = CreateSelectPathStep(selects, &dummy_expr);
+  if (!util::IsOk(step0_status)) {
+    return step0_status.status();
+  }
+  if (!util::IsOk(step1_status)) {
+    return step1_status.status();
+  }
+
+  ExecutionPath execution_path;
+  execution_path.push_back(std::move(step0_status.ValueOrDie()));
+  execution_path.push_back(std::move(step1_status.ValueOrDie()));
+  CelExpressionFlatImpl cel_expr(&dummy_expr, std::move(execution_path));
+  Activation activation;
+  activation.InsertValue("target", target);
+  activation.set_unknown_paths(unknown_paths);
+  return cel_expr.Evaluate(activation, arena);
+}
+
+TEST(SelectStepTest, SelectPathTest) {
+  TestMessage message;
+  message.mutable_message_value()->mutable_message_value()->set_int64_value(1);
+  (*message.mutable_message_value()->mutable_string_int32_map())["key"] = 2;
+  google::protobuf::Arena arena;
+  CelValue target = CelValue::CreateMessage(&message, &arena);
+  google::protobuf::FieldMask no_unknown_paths;
+
+  auto status = RunSelectPath(
+      target, {"message_value", "message_value", "int64_value"}, false,
+      &arena, no_unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsInt64());
+  EXPECT_EQ(status.ValueOrDie().Int64OrDie(), 1);
+
+  // Unset submessages have default values.
+  status = RunSelectPath(target,
+                         {"message_value", "message_value", "message_value",
+                          "int64_value"},
+                         false, &arena, no_unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsInt64());
+  EXPECT_EQ(status.ValueOrDie().Int64OrDie(), 0);
+
+  status = RunSelectPath(target, {"message_value", "message_value"}, true,
+                         &arena, no_unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsBool());
+  EXPECT_TRUE(status.ValueOrDie().BoolOrDie());
+
+  // Maps in the chain are processed by the selects one by one.
+  status = RunSelectPath(target, {"message_value", "string_int32_map", "key"},
+                         false, &arena, no_unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsInt64());
+  EXPECT_EQ(status.ValueOrDie().Int64OrDie(), 2);
+
+  // Errors in the chain are propagated.
+  status = RunSelectPath(target, {"message_value", "no_such_field", "key"},
+                         false, &arena, no_unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsError());
+  EXPECT_EQ(status.ValueOrDie().ErrorOrDie()->code(),
+            CelError::Code::CelError_Code_NO_SUCH_FIELD);
+
+  status = RunSelectPath(target, {"message_value", "int64_value", "key"},
+                         false, &arena, no_unknown_paths);
+  EXPECT_FALSE(util::IsOk(status));
+
+  // Unknown prefixes of the path are errors.
+  google::protobuf::FieldMask unknown_paths;
+  unknown_paths.add_paths("target.message_value");
+  status = RunSelectPath(
+      target, {"message_value", "message_value", "int64_value"}, false,
+      &arena, unknown_paths);
+  ASSERT_TRUE(util::IsOk(status));
+  ASSERT_TRUE(status.ValueOrDie().IsError());
+  EXPECT_THAT(status.ValueOrDie().ErrorOrDie()->message(),
+              testing::HasSubstr("target.message_value"));
+}
+
 TEST(SelectStepTest, CelErrorAsArgument) {
   ExecutionPath path;
 
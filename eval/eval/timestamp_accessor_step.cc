@@ -0,0 +1,61 @@
+#include "eval/eval/timestamp_accessor_step.h"
+
+#include "absl/memory/memory.h"
+#include "eval/eval/expression_step_base.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+class TimestampAccessorStep : public ExpressionStepBase {
+ public:
+  TimestampAccessorStep(const TimestampAccessorFunction* function,
+                        absl::TimeZone time_zone,
+                        const google::api::expr::v1alpha1::Expr* expr)
+      : ExpressionStepBase(expr), function_(function), time_zone_(time_zone) {}
+
+  util::Status Evaluate(ExecutionFrame* frame) const override;
+
+ private:
+  const TimestampAccessorFunction* function_;
+  absl::TimeZone time_zone_;
+};
+
+// Stack changes of TimestampAccessorStep.
+//
+// Stack size before: 2.
+// Stack size after: 1.
+util::Status TimestampAccessorStep::Evaluate(ExecutionFrame* frame) const {
+  const CelValue& timestamp = frame->value_stack().GetSpan(2)[0];
+  CelValue result;
+  if (timestamp.IsTimestamp()) {
+    result = function_->Extract(timestamp.AbslTimestampOrDie(), time_zone_);
+  } else if (timestamp.IsError()) {
+    result = timestamp;
+  } else {
+    // Same as the function step when no overload matches.
+    result = CreateErrorValue(frame->arena(), "No matching overloads found",
+                              CelError::Code::CelError_Code_UNKNOWN);
+  }
+  frame->value_stack().Pop(2);
+  frame->value_stack().Push(result);
+  return util::OkStatus();
+}
+
+}  // namespace
+
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateTimestampAccessorStep(
+    const TimestampAccessorFunction* function, absl::TimeZone time_zone,
+    const google::api::expr::v1alpha1::Expr* expr) {
+  std::unique_ptr<ExpressionStep> step =
+      absl::make_unique<TimestampAccessorStep>(function, time_zone, expr);
+  return std::move(step);
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,28 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_TIMESTAMP_ACCESSOR_STEP_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_TIMESTAMP_ACCESSOR_STEP_H_
+
+#include <memory>
+
+#include "absl/time/time.h"
+#include "eval/eval/evaluator_core.h"
+#include "eval/public/timestamp_accessor.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Factory method for the step of timestamp accessor calls with a constant
+// time zone, resolved in advance. Takes the timestamp and the time zone name
+// from the stack, as the function step does, but calls the accessor with the
+// resolved time zone.
+util::StatusOr<std::unique_ptr<ExpressionStep>> CreateTimestampAccessorStep(
+    const TimestampAccessorFunction* function, absl::TimeZone time_zone,
+    const google::api::expr::v1alpha1::Expr* expr);
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_TIMESTAMP_ACCESSOR_STEP_H_
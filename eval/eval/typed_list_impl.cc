@@ -0,0 +1,209 @@
+#include "eval/eval/typed_list_impl.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+// Calls op with the elements of the list, as a span of their stored type.
+template <class ReturnType, class Op>
+ReturnType VisitElements(const NativeList& list, const Op& op) {
+  switch (list.native_type()) {
+    case NativeType::kBool:
+      return op(list.elements<bool>());
+    case NativeType::kInt32:
+      return op(list.elements<int32_t>());
+    case NativeType::kInt64:
+      return op(list.elements<int64_t>());
+    case NativeType::kUint32:
+      return op(list.elements<uint32_t>());
+    case NativeType::kUint64:
+      return op(list.elements<uint64_t>());
+    case NativeType::kFloat:
+      return op(list.elements<float>());
+    case NativeType::kDouble:
+      return op(list.elements<double>());
+    case NativeType::kString:
+      return op(list.elements<absl::string_view>());
+  }
+  return ReturnType();
+}
+
+const NativeList* AsNativeList(const CelList& list) {
+  return dynamic_cast<const NativeList*>(&list);
+}
+
+// Compares the elements with the elements of the other list, which have the
+// same type and count.
+class EqualOp {
+ public:
+  explicit EqualOp(const NativeList& other) : other_(other) {}
+
+  template <class T>
+  bool operator()(absl::Span<const T> elements) const {
+    const T* data1 = elements.data();
+    const T* data2 = other_.elements<T>().data();
+    size_t size = elements.size();
+    size_t begin = 0;
+    for (; begin + kNativeBlockSize <= size; begin += kNativeBlockSize) {
+      bool equal = true;
+      for (size_t i = begin; i < begin + kNativeBlockSize; i++) {
+        equal &= data1[i] == data2[i];
+      }
+      if (!equal) return false;
+    }
+    bool equal = true;
+    for (size_t i = begin; i < size; i++) {
+      equal &= data1[i] == data2[i];
+    }
+    return equal;
+  }
+
+ private:
+  const NativeList& other_;
+};
+
+// Sums the elements in the type of their CelValues.
+class SumOp {
+ public:
+  template <class T>
+  absl::optional<CelValue> operator()(absl::Span<const T> elements) const {
+    return Sum(elements, typename NativeTraits<T>::CelType());
+  }
+
+ private:
+  template <class T>
+  static absl::optional<CelValue> Sum(absl::Span<const T> elements, int64_t) {
+    // Overflows wrap around in unsigned arithmetic.
+    uint64_t sum = 0;
+    for (T element : elements) {
+      sum += static_cast<uint64_t>(static_cast<int64_t>(element));
+    }
+    return CelValue::CreateInt64(static_cast<int64_t>(sum));
+  }
+
+  template <class T>
+  static absl::optional<CelValue> Sum(absl::Span<const T> elements, uint64_t) {
+    uint64_t sum = 0;
+    for (T element : elements) {
+      sum += element;
+    }
+    return CelValue::CreateUint64(sum);
+  }
+
+  // Doubles are summed in order, so that the result does not depend on the
+  // list implementation. The loop is not vectorized.
+  template <class T>
+  static absl::optional<CelValue> Sum(absl::Span<const T> elements, double) {
+    double sum = 0;
+    for (T element : elements) {
+      sum += element;
+    }
+    return CelValue::CreateDouble(sum);
+  }
+
+  template <class T, class CelType>
+  static absl::optional<CelValue> Sum(absl::Span<const T>, CelType) {
+    return absl::nullopt;
+  }
+};
+
+// Minimum or maximum of the elements in the type of their CelValues.
+template <bool kMax>
+class ExtremumOp {
+ public:
+  template <class T>
+  absl::optional<CelValue> operator()(absl::Span<const T> elements) const {
+    if (elements.empty()) {
+      return absl::nullopt;
+    }
+    return Extremum(elements, typename NativeTraits<T>::CelType());
+  }
+
+ private:
+  template <class T, class V>
+  static V Fold(absl::Span<const T> elements) {
+    V result = elements[0];
+    for (T element : elements) {
+      V value = element;
+      // Comparisons with NaN are false, so NaN is only kept as the first
+      // element.
+      if (kMax) {
+        result = result < value ? value : result;
+      } else {
+        result = value < result ? value : result;
+      }
+    }
+    return result;
+  }
+
+  template <class T>
+  static absl::optional<CelValue> Extremum(absl::Span<const T> elements,
+                                           int64_t) {
+    return CelValue::CreateInt64(Fold<T, int64_t>(elements));
+  }
+
+  template <class T>
+  static absl::optional<CelValue> Extremum(absl::Span<const T> elements,
+                                           uint64_t) {
+    return CelValue::CreateUint64(Fold<T, uint64_t>(elements));
+  }
+
+  template <class T>
+  static absl::optional<CelValue> Extremum(absl::Span<const T> elements,
+                                           double) {
+    return CelValue::CreateDouble(Fold<T, double>(elements));
+  }
+
+  template <class T, class CelType>
+  static absl::optional<CelValue> Extremum(absl::Span<const T>, CelType) {
+    return absl::nullopt;
+  }
+};
+
+}  // namespace
+
+absl::optional<bool> NativeListsEqual(const CelList& list1,
+                                      const CelList& list2) {
+  const NativeList* native1 = AsNativeList(list1);
+  const NativeList* native2 = AsNativeList(list2);
+  if (native1 == nullptr || native2 == nullptr ||
+      native1->native_type() != native2->native_type()) {
+    return absl::nullopt;
+  }
+  if (native1->size() != native2->size()) {
+    return false;
+  }
+  return VisitElements<bool>(*native1, EqualOp(*native2));
+}
+
+absl::optional<CelValue> NativeSum(const CelList& list) {
+  const NativeList* native = AsNativeList(list);
+  if (native == nullptr || native->empty()) {
+    return absl::nullopt;
+  }
+  return VisitElements<absl::optional<CelValue>>(*native, SumOp());
+}
+
+absl::optional<CelValue> NativeMin(const CelList& list) {
+  const NativeList* native = AsNativeList(list);
+  if (native == nullptr) {
+    return absl::nullopt;
+  }
+  return VisitElements<absl::optional<CelValue>>(*native, ExtremumOp<false>());
+}
+
+absl::optional<CelValue> NativeMax(const CelList& list) {
+  const NativeList* native = AsNativeList(list);
+  if (native == nullptr) {
+    return absl::nullopt;
+  }
+  return VisitElements<absl::optional<CelValue>>(*native, ExtremumOp<true>());
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,230 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_TYPED_LIST_IMPL_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_TYPED_LIST_IMPL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "eval/public/cel_value.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "absl/types/span.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Types of the elements stored by typed lists.
+enum class NativeType {
+  kBool,
+  kInt32,
+  kInt64,
+  kUint32,
+  kUint64,
+  kFloat,
+  kDouble,
+  kString,
+};
+
+// Mapping of the stored element types to the types of the CelValues of the
+// elements. 32 bit integers and floats are widened.
+template <class T>
+struct NativeTraits;
+
+template <>
+struct NativeTraits<bool> {
+  static constexpr NativeType kType = NativeType::kBool;
+  using CelType = bool;
+  static CelValue Create(bool value) { return CelValue::CreateBool(value); }
+};
+
+template <>
+struct NativeTraits<int32_t> {
+  static constexpr NativeType kType = NativeType::kInt32;
+  using CelType = int64_t;
+  static CelValue Create(int32_t value) { return CelValue::CreateInt64(value); }
+};
+
+template <>
+struct NativeTraits<int64_t> {
+  static constexpr NativeType kType = NativeType::kInt64;
+  using CelType = int64_t;
+  static CelValue Create(int64_t value) { return CelValue::CreateInt64(value); }
+};
+
+template <>
+struct NativeTraits<uint32_t> {
+  static constexpr NativeType kType = NativeType::kUint32;
+  using CelType = uint64_t;
+  static CelValue Create(uint32_t value) {
+    return CelValue::CreateUint64(value);
+  }
+};
+
+template <>
+struct NativeTraits<uint64_t> {
+  static constexpr NativeType kType = NativeType::kUint64;
+  using CelType = uint64_t;
+  static CelValue Create(uint64_t value) {
+    return CelValue::CreateUint64(value);
+  }
+};
+
+template <>
+struct NativeTraits<float> {
+  static constexpr NativeType kType = NativeType::kFloat;
+  using CelType = double;
+  static CelValue Create(float value) { return CelValue::CreateDouble(value); }
+};
+
+template <>
+struct NativeTraits<double> {
+  static constexpr NativeType kType = NativeType::kDouble;
+  using CelType = double;
+  static CelValue Create(double value) { return CelValue::CreateDouble(value); }
+};
+
+template <>
+struct NativeTraits<absl::string_view> {
+  static constexpr NativeType kType = NativeType::kString;
+  using CelType = CelValue::StringHolder;
+  static CelValue Create(absl::string_view value) {
+    return CelValue::CreateStringView(value);
+  }
+};
+
+// CelList of elements stored as native values in a contiguous array.
+// Functions may process the elements without creating CelValues, see the
+// kernels below.
+class NativeList : public CelList {
+ public:
+  // Type of the stored elements.
+  virtual NativeType native_type() const = 0;
+
+  // Stored elements. T is the C++ type of native_type().
+  template <class T>
+  absl::Span<const T> elements() const {
+    GOOGLE_DCHECK(native_type() == NativeTraits<T>::kType)
+        << "Wrong element type";
+    return absl::Span<const T>(static_cast<const T*>(data()), size());
+  }
+
+ protected:
+  virtual const void* data() const = 0;
+};
+
+// Kernels over the elements of native lists. The loops process blocks of
+// elements without early exits and branches, so that compilers vectorize
+// them.
+
+// Number of elements processed between early exit checks.
+constexpr size_t kNativeBlockSize = 64;
+
+// Returns whether an element is equal to the value.
+template <class T, class V>
+bool NativeContains(absl::Span<const T> elements, V value) {
+  size_t size = elements.size();
+  const T* data = elements.data();
+  size_t begin = 0;
+  for (; begin + kNativeBlockSize <= size; begin += kNativeBlockSize) {
+    bool found = false;
+    for (size_t i = begin; i < begin + kNativeBlockSize; i++) {
+      found |= static_cast<V>(data[i]) == value;
+    }
+    if (found) return true;
+  }
+  bool found = false;
+  for (size_t i = begin; i < size; i++) {
+    found |= static_cast<V>(data[i]) == value;
+  }
+  return found;
+}
+
+// CelList over native values, either owned by the list or by the caller,
+// e.g. a repeated field.
+template <class T>
+class TypedListImpl : public NativeList {
+ public:
+  using Traits = NativeTraits<T>;
+
+  // List of the elements owned by the caller, which must outlive the list
+  // and stay unmodified.
+  explicit TypedListImpl(absl::Span<const T> elements)
+      : elements_(elements) {}
+
+  // List owning the elements. Not available for bool elements, which
+  // std::vector does not store contiguously.
+  explicit TypedListImpl(std::vector<T>&& elements)
+      : owned_elements_(std::move(elements)),
+        elements_(owned_elements_) {}
+
+  // The span of the elements may reference owned_elements_.
+  TypedListImpl(const TypedListImpl&) = delete;
+  TypedListImpl& operator=(const TypedListImpl&) = delete;
+
+  int size() const override { return elements_.size(); }
+
+  CelValue operator[](int index) const override {
+    return Traits::Create(elements_[index]);
+  }
+
+  bool Contains(const CelValue& value) const override {
+    typename Traits::CelType cel_value;
+    if (!value.GetValue(&cel_value)) {
+      return false;
+    }
+    return NativeContains(elements_, Unwrap(cel_value));
+  }
+
+  bool ForEach(
+      absl::FunctionRef<bool(const CelValue& element)> visitor) const override {
+    for (const T& element : elements_) {
+      if (!visitor(Traits::Create(element))) return false;
+    }
+    return true;
+  }
+
+  NativeType native_type() const override { return Traits::kType; }
+
+ protected:
+  const void* data() const override { return elements_.data(); }
+
+ private:
+  template <class V>
+  static V Unwrap(V value) {
+    return value;
+  }
+
+  static absl::string_view Unwrap(CelValue::StringHolder value) {
+    return value.value();
+  }
+
+  std::vector<T> owned_elements_;
+  absl::Span<const T> elements_;
+};
+
+// Kernels of the builtin and extension functions for native lists. They
+// return nullopt if the lists are not native lists supported by the kernel,
+// for the callers to process the elements as CelValues.
+
+// Equality of lists: whether the lists have equal elements. Supported if
+// both lists store elements of the same type.
+absl::optional<bool> NativeListsEqual(const CelList& list1,
+                                      const CelList& list2);
+
+// Sum of the elements, with integer overflows wrapping around. Supported for
+// non-empty lists of numeric elements.
+absl::optional<CelValue> NativeSum(const CelList& list);
+
+// Minimum and maximum of the elements. Supported for non-empty lists of
+// numeric elements. NaN elements are skipped, unless the first element is
+// NaN.
+absl::optional<CelValue> NativeMin(const CelList& list);
+absl::optional<CelValue> NativeMax(const CelList& list);
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_TYPED_LIST_IMPL_H_
@@ -0,0 +1,194 @@
+#include "eval/eval/typed_list_impl.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/field_backed_list_impl.h"
+#include "eval/testutil/test_message.pb.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using testing::ElementsAre;
+using testing::Eq;
+using testing::IsNull;
+using testing::NotNull;
+
+std::vector<int64_t> Range(int64_t size) {
+  std::vector<int64_t> elements;
+  for (int64_t i = 0; i < size; i++) {
+    elements.push_back(i);
+  }
+  return elements;
+}
+
+TEST(TypedListImplTest, Elements) {
+  TypedListImpl<int64_t> list(Range(3));
+  EXPECT_THAT(list.size(), Eq(3));
+  EXPECT_THAT(list.native_type(), Eq(NativeType::kInt64));
+  EXPECT_THAT(list.elements<int64_t>(), ElementsAre(0, 1, 2));
+  ASSERT_TRUE(list[2].IsInt64());
+  EXPECT_THAT(list[2].Int64OrDie(), Eq(2));
+
+  std::vector<int64_t> visited;
+  EXPECT_FALSE(list.ForEach([&visited](const CelValue& element) {
+    visited.push_back(element.Int64OrDie());
+    return element.Int64OrDie() < 1;
+  }));
+  EXPECT_THAT(visited, ElementsAre(0, 1));
+}
+
+TEST(TypedListImplTest, WidenedElements) {
+  std::vector<int32_t> ints = {-1, 2};
+  TypedListImpl<int32_t> int_list(ints);
+  ASSERT_TRUE(int_list[0].IsInt64());
+  EXPECT_THAT(int_list[0].Int64OrDie(), Eq(-1));
+  EXPECT_TRUE(int_list.Contains(CelValue::CreateInt64(-1)));
+  // Values out of the range of the stored type are not truncated.
+  EXPECT_FALSE(int_list.Contains(
+      CelValue::CreateInt64((int64_t{1} << 32) + 2)));
+
+  std::vector<uint32_t> uints = {3};
+  TypedListImpl<uint32_t> uint_list(uints);
+  ASSERT_TRUE(uint_list[0].IsUint64());
+  EXPECT_TRUE(uint_list.Contains(CelValue::CreateUint64(3)));
+  EXPECT_FALSE(uint_list.Contains(CelValue::CreateInt64(3)));
+
+  std::vector<float> floats = {0.5f};
+  TypedListImpl<float> float_list(floats);
+  ASSERT_TRUE(float_list[0].IsDouble());
+  EXPECT_TRUE(float_list.Contains(CelValue::CreateDouble(0.5)));
+  EXPECT_FALSE(float_list.Contains(CelValue::CreateDouble(0.1)));
+}
+
+TEST(TypedListImplTest, Contains) {
+  // Elements in the last block and past the last block.
+  TypedListImpl<int64_t> list(Range(3 * kNativeBlockSize + 5));
+  EXPECT_TRUE(list.Contains(CelValue::CreateInt64(0)));
+  EXPECT_TRUE(list.Contains(CelValue::CreateInt64(3 * kNativeBlockSize - 1)));
+  EXPECT_TRUE(list.Contains(CelValue::CreateInt64(3 * kNativeBlockSize + 4)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateInt64(3 * kNativeBlockSize + 5)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateInt64(-1)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateUint64(1)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateDouble(1)));
+
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  TypedListImpl<double> doubles(std::vector<double>{nan, -0.0});
+  EXPECT_FALSE(doubles.Contains(CelValue::CreateDouble(nan)));
+  EXPECT_TRUE(doubles.Contains(CelValue::CreateDouble(0.0)));
+
+  bool bool_elements[] = {true};
+  TypedListImpl<bool> bools(bool_elements);
+  EXPECT_TRUE(bools.Contains(CelValue::CreateBool(true)));
+  EXPECT_FALSE(bools.Contains(CelValue::CreateBool(false)));
+}
+
+TEST(TypedListImplTest, Strings) {
+  std::vector<std::string> strings = {"a", "b"};
+  TypedListImpl<absl::string_view> list(
+      std::vector<absl::string_view>(strings.begin(), strings.end()));
+  ASSERT_TRUE(list[1].IsString());
+  EXPECT_THAT(list[1].StringOrDie().value(), Eq("b"));
+
+  std::string b = "b";
+  std::string c = "c";
+  EXPECT_TRUE(list.Contains(CelValue::CreateString(&b)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateString(&c)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateBytes(&b)));
+}
+
+TEST(TypedListImplTest, ListsEqual) {
+  TypedListImpl<int64_t> list(Range(2 * kNativeBlockSize));
+  TypedListImpl<int64_t> same(Range(2 * kNativeBlockSize));
+  std::vector<int64_t> elements = Range(2 * kNativeBlockSize);
+  elements.back() = -1;
+  TypedListImpl<int64_t> different(std::move(elements));
+  TypedListImpl<int64_t> shorter(Range(kNativeBlockSize));
+
+  EXPECT_THAT(NativeListsEqual(list, same), Eq(true));
+  EXPECT_THAT(NativeListsEqual(list, different), Eq(false));
+  EXPECT_THAT(NativeListsEqual(list, shorter), Eq(false));
+
+  // Lists of other element types or implementations are not supported.
+  TypedListImpl<int32_t> ints(std::vector<int32_t>{0, 1});
+  EXPECT_FALSE(NativeListsEqual(shorter, ints).has_value());
+  ContainerBackedListImpl cel_list(
+      {CelValue::CreateInt64(0), CelValue::CreateInt64(1)});
+  EXPECT_FALSE(NativeListsEqual(cel_list, cel_list).has_value());
+}
+
+TEST(TypedListImplTest, SumMinMax) {
+  TypedListImpl<int32_t> ints(std::vector<int32_t>{3, -7, 5});
+  EXPECT_THAT(NativeSum(ints)->Int64OrDie(), Eq(1));
+  EXPECT_THAT(NativeMin(ints)->Int64OrDie(), Eq(-7));
+  EXPECT_THAT(NativeMax(ints)->Int64OrDie(), Eq(5));
+
+  // Integer overflows wrap around.
+  int64_t max = std::numeric_limits<int64_t>::max();
+  TypedListImpl<int64_t> overflow(std::vector<int64_t>{max, 1});
+  EXPECT_THAT(NativeSum(overflow)->Int64OrDie(),
+              Eq(std::numeric_limits<int64_t>::min()));
+
+  TypedListImpl<uint64_t> uints(std::vector<uint64_t>{2, 4});
+  EXPECT_THAT(NativeSum(uints)->Uint64OrDie(), Eq(6));
+  EXPECT_THAT(NativeMax(uints)->Uint64OrDie(), Eq(4));
+
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  TypedListImpl<double> doubles(std::vector<double>{1.5, nan, -2.5});
+  EXPECT_THAT(NativeSum(doubles)->DoubleOrDie(), testing::IsNan());
+  EXPECT_THAT(NativeMin(doubles)->DoubleOrDie(), Eq(-2.5));
+  EXPECT_THAT(NativeMax(doubles)->DoubleOrDie(), Eq(1.5));
+
+  TypedListImpl<float> floats(std::vector<float>{0.5f, 0.25f});
+  EXPECT_THAT(NativeSum(floats)->DoubleOrDie(), Eq(0.75));
+
+  // Empty lists and non-numeric elements are not supported.
+  TypedListImpl<int64_t> empty(std::vector<int64_t>{});
+  EXPECT_FALSE(NativeSum(empty).has_value());
+  EXPECT_FALSE(NativeMin(empty).has_value());
+  bool bool_elements[] = {true};
+  TypedListImpl<bool> bools(bool_elements);
+  EXPECT_FALSE(NativeSum(bools).has_value());
+  EXPECT_FALSE(NativeMax(bools).has_value());
+}
+
+TEST(TypedListImplTest, FieldBackedList) {
+  TestMessage message;
+  message.add_int64_list(1);
+  message.add_int64_list(2);
+  message.add_string_list("a");
+  google::protobuf::Arena arena;
+
+  // Repeated scalar fields are exposed without copying.
+  const CelList* list = CreateFieldBackedList(
+      &message, message.GetDescriptor()->FindFieldByName("int64_list"),
+      &arena);
+  auto native_list = dynamic_cast<const NativeList*>(list);
+  ASSERT_THAT(native_list, NotNull());
+  EXPECT_THAT(native_list->elements<int64_t>().data(),
+              Eq(message.int64_list().data()));
+  EXPECT_TRUE(list->Contains(CelValue::CreateInt64(2)));
+
+  const CelList* string_list = CreateFieldBackedList(
+      &message, message.GetDescriptor()->FindFieldByName("string_list"),
+      &arena);
+  EXPECT_THAT(dynamic_cast<const NativeList*>(string_list), IsNull());
+  ASSERT_THAT(string_list->size(), Eq(1));
+  EXPECT_THAT((*string_list)[0].StringOrDie().value(), Eq("a"));
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
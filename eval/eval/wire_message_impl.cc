@@ -0,0 +1,558 @@
+#include "eval/eval/wire_message_impl.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/wire_format_lite.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/container_backed_map_impl.h"
+#include "eval/eval/typed_list_impl.h"
+#include "eval/proto/cel_error.pb.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::protobuf::Arena;
+using google::protobuf::Descriptor;
+using google::protobuf::DescriptorPool;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::MessageFactory;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// Map entries have two field tags
+// 1 - for key
+// 2 - for value
+constexpr int kKeyTag = 1;
+constexpr int kValueTag = 2;
+
+const uint8_t* Bytes(absl::string_view payload) {
+  return reinterpret_cast<const uint8_t*>(payload.data());
+}
+
+// Reads a value of a field of a scalar type other than string and bytes.
+bool ReadScalar(const FieldDescriptor* field_desc, CodedInputStream* input,
+                CelValue* result) {
+  uint32_t value32;
+  uint64_t value64;
+  switch (field_desc->type()) {
+    case FieldDescriptor::TYPE_BOOL:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateBool(value64 != 0);
+      return true;
+    case FieldDescriptor::TYPE_INT32:
+    case FieldDescriptor::TYPE_ENUM:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateInt64(static_cast<int32_t>(value64));
+      return true;
+    case FieldDescriptor::TYPE_INT64:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateInt64(static_cast<int64_t>(value64));
+      return true;
+    case FieldDescriptor::TYPE_UINT32:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateUint64(static_cast<uint32_t>(value64));
+      return true;
+    case FieldDescriptor::TYPE_UINT64:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateUint64(value64);
+      return true;
+    case FieldDescriptor::TYPE_SINT32:
+      if (!input->ReadVarint32(&value32)) return false;
+      *result = CelValue::CreateInt64(WireFormatLite::ZigZagDecode32(value32));
+      return true;
+    case FieldDescriptor::TYPE_SINT64:
+      if (!input->ReadVarint64(&value64)) return false;
+      *result = CelValue::CreateInt64(WireFormatLite::ZigZagDecode64(value64));
+      return true;
+    case FieldDescriptor::TYPE_FIXED32:
+      if (!input->ReadLittleEndian32(&value32)) return false;
+      *result = CelValue::CreateUint64(value32);
+      return true;
+    case FieldDescriptor::TYPE_FIXED64:
+      if (!input->ReadLittleEndian64(&value64)) return false;
+      *result = CelValue::CreateUint64(value64);
+      return true;
+    case FieldDescriptor::TYPE_SFIXED32:
+      if (!input->ReadLittleEndian32(&value32)) return false;
+      *result = CelValue::CreateInt64(static_cast<int32_t>(value32));
+      return true;
+    case FieldDescriptor::TYPE_SFIXED64:
+      if (!input->ReadLittleEndian64(&value64)) return false;
+      *result = CelValue::CreateInt64(static_cast<int64_t>(value64));
+      return true;
+    case FieldDescriptor::TYPE_FLOAT:
+      if (!input->ReadLittleEndian32(&value32)) return false;
+      *result = CelValue::CreateDouble(WireFormatLite::DecodeFloat(value32));
+      return true;
+    case FieldDescriptor::TYPE_DOUBLE:
+      if (!input->ReadLittleEndian64(&value64)) return false;
+      *result = CelValue::CreateDouble(WireFormatLite::DecodeDouble(value64));
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Value of a singular field that is not set.
+CelValue DefaultValue(const FieldDescriptor* field_desc) {
+  switch (field_desc->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return CelValue::CreateBool(field_desc->default_value_bool());
+    case FieldDescriptor::CPPTYPE_INT32:
+      return CelValue::CreateInt64(field_desc->default_value_int32());
+    case FieldDescriptor::CPPTYPE_INT64:
+      return CelValue::CreateInt64(field_desc->default_value_int64());
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return CelValue::CreateUint64(field_desc->default_value_uint32());
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return CelValue::CreateUint64(field_desc->default_value_uint64());
+    case FieldDescriptor::CPPTYPE_FLOAT:
+      return CelValue::CreateDouble(field_desc->default_value_float());
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return CelValue::CreateDouble(field_desc->default_value_double());
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return CelValue::CreateInt64(field_desc->default_value_enum()->number());
+    case FieldDescriptor::CPPTYPE_STRING:
+      if (field_desc->type() == FieldDescriptor::TYPE_BYTES) {
+        return CelValue::CreateBytes(&field_desc->default_value_string());
+      }
+      return CelValue::CreateString(&field_desc->default_value_string());
+    default:
+      return CelValue::CreateNull();
+  }
+}
+
+bool IsLengthDelimited(const FieldDescriptor* field_desc) {
+  return WireFormatLite::WireTypeForFieldType(
+             static_cast<WireFormatLite::FieldType>(field_desc->type())) ==
+         WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+}
+
+// Native list of the scalar values, of the element type T.
+template <class T>
+const CelList* CreateNativeList(const std::vector<CelValue>& values,
+                                Arena* arena) {
+  std::vector<T> elements;
+  elements.reserve(values.size());
+  for (const CelValue& value : values) {
+    T element = T();
+    value.GetValue(&element);
+    elements.push_back(element);
+  }
+  return Arena::Create<TypedListImpl<T>>(arena, std::move(elements));
+}
+
+// Identity of a map key among the keys of the same type.
+std::string KeyIdentity(const CelValue& key) {
+  switch (key.type()) {
+    case CelValue::Type::kString:
+      return std::string(key.StringOrDie().value());
+    case CelValue::Type::kInt64:
+      return absl::StrCat(key.Int64OrDie());
+    case CelValue::Type::kUint64:
+      return absl::StrCat(key.Uint64OrDie());
+    case CelValue::Type::kBool:
+      return key.BoolOrDie() ? "true" : "false";
+    default:
+      return std::string();
+  }
+}
+
+// Keeps the last entry of each key, as parsing the map does.
+std::vector<std::pair<CelValue, CelValue>> LastEntries(
+    const std::vector<std::pair<CelValue, CelValue>>& entries) {
+  absl::flat_hash_map<std::string, size_t> positions;
+  std::vector<std::pair<CelValue, CelValue>> last_entries;
+  for (const auto& entry : entries) {
+    auto result =
+        positions.emplace(KeyIdentity(entry.first), last_entries.size());
+    if (result.second) {
+      last_entries.push_back(entry);
+    } else {
+      last_entries[result.first->second].second = entry.second;
+    }
+  }
+  return last_entries;
+}
+
+}  // namespace
+
+WireMessageImpl::WireMessageImpl(absl::string_view serialized,
+                                 const Descriptor* descriptor, Arena* arena)
+    : serialized_(serialized),
+      descriptor_(descriptor),
+      arena_(arena),
+      ok_(false) {}
+
+bool WireMessageImpl::ScanFields() const {
+  // Offsets are stored in 32 bits, as protobuf limits messages to 2GB.
+  CodedInputStream input(Bytes(serialized_), serialized_.size());
+  while (input.CurrentPosition() < static_cast<int>(serialized_.size())) {
+    uint32_t tag = input.ReadTag();
+    int number = WireFormatLite::GetTagFieldNumber(tag);
+    if (number == 0) {
+      return false;
+    }
+    int wire_type = WireFormatLite::GetTagWireType(tag);
+    int offset = input.CurrentPosition();
+    switch (wire_type) {
+      case WireFormatLite::WIRETYPE_VARINT: {
+        uint64_t value;
+        if (!input.ReadVarint64(&value)) return false;
+        break;
+      }
+      case WireFormatLite::WIRETYPE_FIXED32:
+        if (!input.Skip(4)) return false;
+        break;
+      case WireFormatLite::WIRETYPE_FIXED64:
+        if (!input.Skip(8)) return false;
+        break;
+      case WireFormatLite::WIRETYPE_LENGTH_DELIMITED: {
+        uint32_t length;
+        if (!input.ReadVarint32(&length)) return false;
+        offset = input.CurrentPosition();
+        if (!input.Skip(length)) return false;
+        break;
+      }
+      case WireFormatLite::WIRETYPE_START_GROUP:
+        // Groups are not indexed.
+        if (!WireFormatLite::SkipField(&input, tag)) return false;
+        continue;
+      default:
+        return false;
+    }
+    index_.push_back({number, wire_type, static_cast<uint32_t>(offset),
+                      static_cast<uint32_t>(input.CurrentPosition() - offset)});
+  }
+  return true;
+}
+
+void WireMessageImpl::BuildIndex() const {
+  ok_ = ScanFields();
+  if (!ok_) {
+    index_.clear();
+  }
+  // Serializers write fields in the order of their numbers, so the index
+  // is usually sorted.
+  auto by_number = [](const FieldEntry& entry1, const FieldEntry& entry2) {
+    return entry1.number < entry2.number;
+  };
+  if (!std::is_sorted(index_.begin(), index_.end(), by_number)) {
+    std::stable_sort(index_.begin(), index_.end(), by_number);
+  }
+}
+
+bool WireMessageImpl::ok() const {
+  absl::call_once(index_once_, &WireMessageImpl::BuildIndex, this);
+  return ok_;
+}
+
+absl::Span<const WireMessageImpl::FieldEntry> WireMessageImpl::FindEntries(
+    int number) const {
+  auto range = std::equal_range(
+      index_.begin(), index_.end(), FieldEntry{number, 0, 0, 0},
+      [](const FieldEntry& entry1, const FieldEntry& entry2) {
+        return entry1.number < entry2.number;
+      });
+  return absl::Span<const FieldEntry>(
+      index_.data() + (range.first - index_.begin()),
+      range.second - range.first);
+}
+
+absl::optional<CelValue> WireMessageImpl::operator[](CelValue key) const {
+  if (!key.IsString()) {
+    return {};
+  }
+  const FieldDescriptor* field_desc =
+      descriptor_->FindFieldByName(std::string(key.StringOrDie().value()));
+  // Malformed messages have no fields present; lookups are errors.
+  if (field_desc == nullptr || (ok() && !HasField(field_desc))) {
+    return {};
+  }
+  return GetFieldValue(field_desc);
+}
+
+absl::optional<CelValue> WireMessageImpl::SelectField(CelValue key) const {
+  if (!key.IsString()) {
+    return {};
+  }
+  const FieldDescriptor* field_desc =
+      descriptor_->FindFieldByName(std::string(key.StringOrDie().value()));
+  if (field_desc == nullptr) {
+    return {};
+  }
+  return GetFieldValue(field_desc);
+}
+
+bool WireMessageImpl::Has(const CelValue& key) const {
+  if (!key.IsString()) {
+    return false;
+  }
+  const FieldDescriptor* field_desc =
+      descriptor_->FindFieldByName(std::string(key.StringOrDie().value()));
+  return field_desc != nullptr && HasField(field_desc);
+}
+
+int WireMessageImpl::size() const { return ListKeys()->size(); }
+
+const CelList* WireMessageImpl::ListKeys() const {
+  ok();
+  absl::MutexLock lock(&mutex_);
+  if (keys_ == nullptr) {
+    std::vector<CelValue> keys;
+    for (size_t i = 0; i < index_.size(); i++) {
+      if (i > 0 && index_[i].number == index_[i - 1].number) {
+        continue;
+      }
+      const FieldDescriptor* field_desc =
+          descriptor_->FindFieldByNumber(index_[i].number);
+      if (field_desc != nullptr) {
+        keys.push_back(CelValue::CreateString(&field_desc->name()));
+      }
+    }
+    keys_ = absl::make_unique<ContainerBackedListImpl>(std::move(keys));
+  }
+  return keys_.get();
+}
+
+bool WireMessageImpl::HasField(const FieldDescriptor* field_desc) const {
+  return ok() && !FindEntries(field_desc->number()).empty();
+}
+
+CelValue WireMessageImpl::GetFieldValue(
+    const FieldDescriptor* field_desc) const {
+  if (!ok()) {
+    return CreateErrorValue(
+        arena_, absl::StrCat("Malformed message ", descriptor_->full_name()),
+        CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  if (!field_desc->is_repeated() &&
+      field_desc->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+    return DecodeSingularField(field_desc);
+  }
+
+  // Aggregates are decoded once.
+  absl::MutexLock lock(&mutex_);
+  auto it = decoded_values_.find(field_desc->number());
+  if (it != decoded_values_.end()) {
+    return it->second;
+  }
+  CelValue value;
+  if (field_desc->is_map()) {
+    value = DecodeMapField(field_desc);
+  } else if (field_desc->is_repeated()) {
+    value = DecodeRepeatedField(field_desc);
+  } else {
+    value = DecodeSingularField(field_desc);
+  }
+  decoded_values_.emplace(field_desc->number(), value);
+  return value;
+}
+
+CelValue WireMessageImpl::DecodeSingularField(
+    const FieldDescriptor* field_desc) const {
+  absl::Span<const FieldEntry> entries = FindEntries(field_desc->number());
+  if (field_desc->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE) {
+    // Occurrences of submessages are merged, as by concatenation.
+    std::string* merged = nullptr;
+    absl::string_view serialized;
+    for (const FieldEntry& entry : entries) {
+      if (entry.wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+        continue;
+      }
+      if (serialized.empty()) {
+        serialized = Payload(entry);
+        continue;
+      }
+      if (merged == nullptr) {
+        merged = Arena::Create<std::string>(arena_, serialized);
+      }
+      absl::StrAppend(merged, Payload(entry));
+      serialized = *merged;
+    }
+    return CreateMessageValue(serialized, field_desc->message_type());
+  }
+
+  // The last occurrence of a scalar wins.
+  int wire_type = WireFormatLite::WireTypeForFieldType(
+      static_cast<WireFormatLite::FieldType>(field_desc->type()));
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    if (it->wire_type != wire_type) {
+      continue;
+    }
+    switch (field_desc->type()) {
+      case FieldDescriptor::TYPE_STRING:
+        return CelValue::CreateStringView(Payload(*it));
+      case FieldDescriptor::TYPE_BYTES:
+        return CelValue::CreateBytesView(Payload(*it));
+      default: {
+        absl::string_view payload = Payload(*it);
+        CodedInputStream input(Bytes(payload), payload.size());
+        CelValue value;
+        if (!ReadScalar(field_desc, &input, &value)) {
+          return DecodeError(field_desc);
+        }
+        return value;
+      }
+    }
+  }
+  return DefaultValue(field_desc);
+}
+
+CelValue WireMessageImpl::DecodeRepeatedField(
+    const FieldDescriptor* field_desc) const {
+  absl::Span<const FieldEntry> entries = FindEntries(field_desc->number());
+  std::vector<CelValue> values;
+  if (IsLengthDelimited(field_desc)) {
+    std::vector<absl::string_view> strings;
+    for (const FieldEntry& entry : entries) {
+      if (entry.wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+        continue;
+      }
+      switch (field_desc->type()) {
+        case FieldDescriptor::TYPE_STRING:
+          strings.push_back(Payload(entry));
+          break;
+        case FieldDescriptor::TYPE_BYTES:
+          values.push_back(CelValue::CreateBytesView(Payload(entry)));
+          break;
+        default:
+          values.push_back(
+              CreateMessageValue(Payload(entry), field_desc->message_type()));
+          break;
+      }
+    }
+    if (field_desc->type() == FieldDescriptor::TYPE_STRING) {
+      return CelValue::CreateList(
+          Arena::Create<TypedListImpl<absl::string_view>>(arena_,
+                                                          std::move(strings)));
+    }
+    return CelValue::CreateList(
+        Arena::Create<ContainerBackedListImpl>(arena_, std::move(values)));
+  }
+
+  // Scalars may be packed or not, in any occurrence.
+  int wire_type = WireFormatLite::WireTypeForFieldType(
+      static_cast<WireFormatLite::FieldType>(field_desc->type()));
+  for (const FieldEntry& entry : entries) {
+    absl::string_view payload = Payload(entry);
+    CodedInputStream input(Bytes(payload), payload.size());
+    if (entry.wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      while (input.BytesUntilLimit() > 0) {
+        CelValue value;
+        if (!ReadScalar(field_desc, &input, &value)) {
+          return DecodeError(field_desc);
+        }
+        values.push_back(value);
+      }
+    } else if (entry.wire_type == wire_type) {
+      CelValue value;
+      if (!ReadScalar(field_desc, &input, &value)) {
+        return DecodeError(field_desc);
+      }
+      values.push_back(value);
+    }
+  }
+  switch (field_desc->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_INT32:
+    case FieldDescriptor::CPPTYPE_INT64:
+    case FieldDescriptor::CPPTYPE_ENUM:
+      return CelValue::CreateList(CreateNativeList<int64_t>(values, arena_));
+    case FieldDescriptor::CPPTYPE_UINT32:
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return CelValue::CreateList(CreateNativeList<uint64_t>(values, arena_));
+    case FieldDescriptor::CPPTYPE_FLOAT:
+    case FieldDescriptor::CPPTYPE_DOUBLE:
+      return CelValue::CreateList(CreateNativeList<double>(values, arena_));
+    default:
+      return CelValue::CreateList(
+          Arena::Create<ContainerBackedListImpl>(arena_, std::move(values)));
+  }
+}
+
+CelValue WireMessageImpl::DecodeMapField(
+    const FieldDescriptor* field_desc) const {
+  const Descriptor* entry_descriptor = field_desc->message_type();
+  const FieldDescriptor* key_desc =
+      entry_descriptor->FindFieldByNumber(kKeyTag);
+  const FieldDescriptor* value_desc =
+      entry_descriptor->FindFieldByNumber(kValueTag);
+  std::vector<std::pair<CelValue, CelValue>> entries;
+  for (const FieldEntry& entry : FindEntries(field_desc->number())) {
+    if (entry.wire_type != WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      continue;
+    }
+    // Values of the entry reference the serialized message or the arena, not
+    // the entry.
+    WireMessageImpl map_entry(Payload(entry), entry_descriptor, arena_);
+    CelValue key = map_entry.GetFieldValue(key_desc);
+    if (key.IsError()) {
+      return key;
+    }
+    entries.emplace_back(key, map_entry.GetFieldValue(value_desc));
+  }
+
+  std::unique_ptr<CelMap> cel_map =
+      CreateContainerBackedMap(absl::MakeSpan(entries));
+  if (cel_map == nullptr) {
+    std::vector<std::pair<CelValue, CelValue>> last_entries =
+        LastEntries(entries);
+    cel_map = CreateContainerBackedMap(absl::MakeSpan(last_entries));
+  }
+  CelMap* result = cel_map.release();
+  arena_->Own(result);
+  return CelValue::CreateMap(result);
+}
+
+CelValue WireMessageImpl::CreateMessageValue(
+    absl::string_view serialized, const Descriptor* descriptor) const {
+  if (descriptor->file()->package() != "google.protobuf") {
+    return CelValue::CreateMap(
+        Arena::Create<WireMessageImpl>(arena_, serialized, descriptor, arena_));
+  }
+
+  // Well-known types are converted from the parsed messages.
+  const Descriptor* generated_descriptor =
+      DescriptorPool::generated_pool()->FindMessageTypeByName(
+          descriptor->full_name());
+  const Message* prototype =
+      generated_descriptor == nullptr
+          ? nullptr
+          : MessageFactory::generated_factory()->GetPrototype(
+                generated_descriptor);
+  if (prototype == nullptr) {
+    return CreateErrorValue(
+        arena_, absl::StrCat("No generated message ", descriptor->full_name()),
+        CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  Message* message = prototype->New(arena_);
+  if (!message->ParseFromArray(serialized.data(), serialized.size())) {
+    return CreateErrorValue(
+        arena_, absl::StrCat("Malformed message ", descriptor->full_name()),
+        CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  return CelValue::CreateMessage(message, arena_);
+}
+
+CelValue WireMessageImpl::DecodeError(
+    const FieldDescriptor* field_desc) const {
+  return CreateErrorValue(
+      arena_, absl::StrCat("Malformed field ", field_desc->full_name()),
+      CelError::Code::CelError_Code_INVALID_ARGUMENT);
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
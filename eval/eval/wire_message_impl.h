@@ -0,0 +1,130 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_EVAL_WIRE_MESSAGE_IMPL_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_EVAL_WIRE_MESSAGE_IMPL_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "google/protobuf/arena.h"
+#include "google/protobuf/descriptor.h"
+#include "eval/public/cel_value.h"
+#include "absl/base/call_once.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// CelMap over a protobuf message serialized in the wire format, for
+// evaluating expressions without parsing the message. Keys are the names
+// of the message fields present, and selects and has() tests behave as for
+// messages:
+//  - singular fields have their values, or the default values if not set,
+//  - submessages are WireMessageImpl maps, except for well-known types,
+//    which are parsed and converted as by CelValue::CreateMessage,
+//  - repeated fields are lists and map fields are maps,
+//  - has() tests the presence of the field in the wire format.
+// Lookups other than selects, e.g. the "in" operator, only find the fields
+// present. Names of fields not declared by the descriptor are not found.
+//
+// The message is scanned once, on the first access, to index the offsets of
+// the fields; field values are decoded when accessed. Submessages, lists and
+// maps are decoded once and cached. Strings and bytes reference the
+// serialized message, which must outlive the map and the values.
+// Fields of messages that can not be scanned, or fields that can not be
+// decoded, are errors, and are not present for has() tests. Groups are
+// skipped.
+//
+// Safe for concurrent lookups.
+class WireMessageImpl : public CelMap {
+ public:
+  // Values are allocated on the arena, which must not be null.
+  WireMessageImpl(absl::string_view serialized,
+                  const google::protobuf::Descriptor* descriptor,
+                  google::protobuf::Arena* arena);
+
+  // Value of the field if it is present.
+  absl::optional<CelValue> operator[](CelValue key) const override;
+
+  bool Has(const CelValue& key) const override;
+
+  // Value of the field, or its default value if it is not present.
+  absl::optional<CelValue> SelectField(CelValue key) const override;
+
+  // Number of declared fields present.
+  int size() const override;
+
+  // Names of the fields present, in the order of field numbers. Fields not
+  // declared by the descriptor are not listed.
+  const CelList* ListKeys() const override;
+
+  // Returns whether the message could be scanned.
+  bool ok() const;
+
+  const google::protobuf::Descriptor* descriptor() const { return descriptor_; }
+
+  // Value of the field of the message, see the class comment.
+  CelValue GetFieldValue(const google::protobuf::FieldDescriptor* field_desc) const;
+
+  // Returns whether the field is present.
+  bool HasField(const google::protobuf::FieldDescriptor* field_desc) const;
+
+ private:
+  // Occurrence of a field in the serialized message. For length-delimited
+  // fields the span covers the payload, for others the encoded value.
+  struct FieldEntry {
+    int number;
+    int wire_type;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // Appends the field occurrences to index_, returns false if the message
+  // is malformed.
+  bool ScanFields() const;
+  void BuildIndex() const;
+
+  // Occurrences of the field in the order of the serialized message.
+  absl::Span<const FieldEntry> FindEntries(int number) const;
+
+  absl::string_view Payload(const FieldEntry& entry) const {
+    return serialized_.substr(entry.offset, entry.size);
+  }
+
+  CelValue DecodeSingularField(
+      const google::protobuf::FieldDescriptor* field_desc) const;
+  CelValue DecodeRepeatedField(
+      const google::protobuf::FieldDescriptor* field_desc) const;
+  CelValue DecodeMapField(const google::protobuf::FieldDescriptor* field_desc) const;
+  CelValue CreateMessageValue(absl::string_view serialized,
+                              const google::protobuf::Descriptor* descriptor) const;
+  CelValue DecodeError(const google::protobuf::FieldDescriptor* field_desc) const;
+
+  absl::string_view serialized_;
+  const google::protobuf::Descriptor* descriptor_;
+  google::protobuf::Arena* arena_;
+
+  // Built by BuildIndex() on the first access.
+  mutable absl::once_flag index_once_;
+  // Field occurrences, ordered by field number and then by offset.
+  mutable std::vector<FieldEntry> index_;
+  mutable bool ok_;
+
+  mutable absl::Mutex mutex_;
+  // Built by ListKeys() on the first call.
+  mutable std::unique_ptr<CelList> keys_ GUARDED_BY(mutex_);
+  // Submessages, lists and maps decoded so far, by field number.
+  mutable absl::flat_hash_map<int, CelValue> decoded_values_
+      GUARDED_BY(mutex_);
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_EVAL_WIRE_MESSAGE_IMPL_H_
@@ -0,0 +1,256 @@
+#include "eval/eval/wire_message_impl.h"
+
+#include <string>
+
+#include "google/protobuf/duration.pb.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "eval/eval/typed_list_impl.h"
+#include "eval/testutil/test_message.pb.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::protobuf::Arena;
+using testing::Eq;
+using testing::NotNull;
+
+// Value of the field as selected by message.name.
+CelValue Field(const CelMap& message, std::string name) {
+  auto value = message.SelectField(CelValue::CreateString(&name));
+  EXPECT_TRUE(value.has_value()) << name;
+  return value.value_or(CelValue::CreateNull());
+}
+
+bool Has(const CelMap& message, std::string name) {
+  return message.Has(CelValue::CreateString(&name));
+}
+
+TEST(WireMessageImplTest, ScalarFields) {
+  TestMessage message;
+  message.set_int32_value(-1);
+  message.set_uint64_value(2);
+  message.set_double_value(0.5);
+  message.set_float_value(1.5f);
+  message.set_bool_value(true);
+  message.set_string_value("abc");
+  message.set_bytes_value("def");
+  message.set_enum_value(TestMessage::TEST_ENUM_2);
+  std::string serialized = message.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message.GetDescriptor(), &arena);
+  ASSERT_TRUE(wire_message.ok());
+  EXPECT_THAT(Field(wire_message, "int32_value").Int64OrDie(), Eq(-1));
+  EXPECT_THAT(Field(wire_message, "uint64_value").Uint64OrDie(), Eq(2));
+  EXPECT_THAT(Field(wire_message, "double_value").DoubleOrDie(), Eq(0.5));
+  EXPECT_THAT(Field(wire_message, "float_value").DoubleOrDie(), Eq(1.5));
+  EXPECT_TRUE(Field(wire_message, "bool_value").BoolOrDie());
+  EXPECT_THAT(Field(wire_message, "enum_value").Int64OrDie(),
+              Eq(TestMessage::TEST_ENUM_2));
+
+  // Strings reference the serialized message.
+  CelValue string_value = Field(wire_message, "string_value");
+  ASSERT_TRUE(string_value.IsString());
+  EXPECT_THAT(string_value.StringOrDie().value(), Eq("abc"));
+  EXPECT_TRUE(string_value.StringOrDie().value().data() >= serialized.data() &&
+              string_value.StringOrDie().value().data() <
+                  serialized.data() + serialized.size());
+  ASSERT_TRUE(Field(wire_message, "bytes_value").IsBytes());
+  EXPECT_THAT(Field(wire_message, "bytes_value").BytesOrDie().value(),
+              Eq("def"));
+
+  // Fields not set have default values and are not present.
+  EXPECT_THAT(Field(wire_message, "int64_value").Int64OrDie(), Eq(0));
+  EXPECT_TRUE(Has(wire_message, "int32_value"));
+  EXPECT_FALSE(Has(wire_message, "int64_value"));
+
+  // Lookups other than selects only find the fields present, as listed by
+  // ListKeys().
+  std::string int32_name = "int32_value";
+  std::string int64_name = "int64_value";
+  std::string list_name = "int64_list";
+  EXPECT_TRUE(wire_message[CelValue::CreateString(&int32_name)].has_value());
+  EXPECT_FALSE(wire_message[CelValue::CreateString(&int64_name)].has_value());
+  EXPECT_FALSE(wire_message[CelValue::CreateString(&list_name)].has_value());
+
+  // Fields not declared are not found.
+  std::string unknown = "unknown";
+  EXPECT_FALSE(wire_message[CelValue::CreateString(&unknown)].has_value());
+  EXPECT_FALSE(
+      wire_message.SelectField(CelValue::CreateString(&unknown)).has_value());
+  EXPECT_FALSE(wire_message[CelValue::CreateInt64(1)].has_value());
+
+  EXPECT_THAT(wire_message.size(), Eq(8));
+  EXPECT_THAT((*wire_message.ListKeys())[0].StringOrDie().value(),
+              Eq("int32_value"));
+}
+
+TEST(WireMessageImplTest, LastScalarWins) {
+  TestMessage message1;
+  message1.set_int64_value(1);
+  message1.set_string_value("a");
+  TestMessage message2;
+  message2.set_int64_value(2);
+  std::string serialized =
+      message1.SerializeAsString() + message2.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message1.GetDescriptor(), &arena);
+  EXPECT_THAT(Field(wire_message, "int64_value").Int64OrDie(), Eq(2));
+  EXPECT_THAT(Field(wire_message, "string_value").StringOrDie().value(),
+              Eq("a"));
+  EXPECT_THAT(wire_message.size(), Eq(2));
+}
+
+TEST(WireMessageImplTest, MessageFields) {
+  TestMessage message;
+  message.mutable_message_value()->set_int64_value(1);
+  message.mutable_message_value()->mutable_message_value()->set_string_value(
+      "nested");
+  message.mutable_duration_value()->set_seconds(2);
+  std::string serialized = message.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message.GetDescriptor(), &arena);
+  CelValue submessage = Field(wire_message, "message_value");
+  ASSERT_TRUE(submessage.IsMap());
+  EXPECT_THAT(Field(*submessage.MapOrDie(), "int64_value").Int64OrDie(),
+              Eq(1));
+  CelValue nested = Field(*submessage.MapOrDie(), "message_value");
+  ASSERT_TRUE(nested.IsMap());
+  EXPECT_THAT(Field(*nested.MapOrDie(), "string_value").StringOrDie().value(),
+              Eq("nested"));
+
+  // Submessages are decoded once.
+  EXPECT_THAT(Field(wire_message, "message_value").MapOrDie(),
+              Eq(submessage.MapOrDie()));
+
+  // Well-known types are converted.
+  CelValue duration = Field(wire_message, "duration_value");
+  ASSERT_TRUE(duration.IsDuration());
+  EXPECT_THAT(duration.AbslDurationOrDie(), Eq(absl::Seconds(2)));
+
+  // Submessages not set are empty.
+  EXPECT_FALSE(Has(wire_message, "timestamp_value"));
+  CelValue empty = Field(*nested.MapOrDie(), "message_value");
+  ASSERT_TRUE(empty.IsMap());
+  EXPECT_THAT(empty.MapOrDie()->size(), Eq(0));
+  EXPECT_THAT(Field(*empty.MapOrDie(), "int64_value").Int64OrDie(), Eq(0));
+}
+
+TEST(WireMessageImplTest, MergedMessageFields) {
+  TestMessage message1;
+  message1.mutable_message_value()->set_int64_value(1);
+  TestMessage message2;
+  message2.mutable_message_value()->set_string_value("a");
+  std::string serialized =
+      message1.SerializeAsString() + message2.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message1.GetDescriptor(), &arena);
+  const CelMap* submessage = Field(wire_message, "message_value").MapOrDie();
+  EXPECT_THAT(Field(*submessage, "int64_value").Int64OrDie(), Eq(1));
+  EXPECT_THAT(Field(*submessage, "string_value").StringOrDie().value(),
+              Eq("a"));
+}
+
+TEST(WireMessageImplTest, RepeatedFields) {
+  TestMessage message;
+  message.add_int64_list(1);
+  message.add_int64_list(-2);
+  message.add_float_list(0.5f);
+  message.add_bool_list(true);
+  message.add_string_list("a");
+  message.add_string_list("b");
+  message.add_message_list()->set_int64_value(3);
+  std::string serialized = message.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message.GetDescriptor(), &arena);
+  const CelList* int64_list = Field(wire_message, "int64_list").ListOrDie();
+  auto native_list = dynamic_cast<const NativeList*>(int64_list);
+  ASSERT_THAT(native_list, NotNull());
+  EXPECT_THAT(native_list->elements<int64_t>(), testing::ElementsAre(1, -2));
+  EXPECT_THAT((*Field(wire_message, "float_list").ListOrDie())[0].DoubleOrDie(),
+              Eq(0.5));
+  EXPECT_TRUE((*Field(wire_message, "bool_list").ListOrDie())[0].BoolOrDie());
+  const CelList* string_list = Field(wire_message, "string_list").ListOrDie();
+  ASSERT_THAT(string_list->size(), Eq(2));
+  EXPECT_THAT((*string_list)[1].StringOrDie().value(), Eq("b"));
+  const CelList* message_list = Field(wire_message, "message_list").ListOrDie();
+  ASSERT_THAT(message_list->size(), Eq(1));
+  EXPECT_THAT(Field(*(*message_list)[0].MapOrDie(), "int64_value").Int64OrDie(),
+              Eq(3));
+
+  EXPECT_TRUE(Has(wire_message, "int64_list"));
+  EXPECT_FALSE(Has(wire_message, "uint64_list"));
+  EXPECT_THAT(Field(wire_message, "uint64_list").ListOrDie()->size(), Eq(0));
+}
+
+TEST(WireMessageImplTest, UnpackedRepeatedFields) {
+  // Field 102 (int64_list) with the values 1 and 2 not packed, then packed 3.
+  std::string serialized("\xb0\x06\x01\xb0\x06\x02\xb2\x06\x01\x03", 10);
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, TestMessage::descriptor(), &arena);
+  const CelList* list = Field(wire_message, "int64_list").ListOrDie();
+  ASSERT_THAT(list->size(), Eq(3));
+  EXPECT_THAT((*list)[0].Int64OrDie(), Eq(1));
+  EXPECT_THAT((*list)[2].Int64OrDie(), Eq(3));
+}
+
+TEST(WireMessageImplTest, MapFields) {
+  TestMessage message;
+  (*message.mutable_string_int32_map())["a"] = 1;
+  (*message.mutable_string_int32_map())["b"] = 2;
+  (*message.mutable_int64_int32_map())[3] = 4;
+  std::string serialized = message.SerializeAsString();
+  TestMessage duplicate;
+  (*duplicate.mutable_string_int32_map())["a"] = 5;
+  serialized += duplicate.SerializeAsString();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message.GetDescriptor(), &arena);
+  const CelMap* string_map = Field(wire_message, "string_int32_map").MapOrDie();
+  EXPECT_THAT(string_map->size(), Eq(2));
+  EXPECT_THAT(Field(*string_map, "a").Int64OrDie(), Eq(5));
+  EXPECT_THAT(Field(*string_map, "b").Int64OrDie(), Eq(2));
+  const CelMap* int_map = Field(wire_message, "int64_int32_map").MapOrDie();
+  EXPECT_THAT((*int_map)[CelValue::CreateInt64(3)]->Int64OrDie(), Eq(4));
+}
+
+TEST(WireMessageImplTest, MalformedMessage) {
+  TestMessage message;
+  message.set_string_value("abc");
+  std::string serialized = message.SerializeAsString();
+  serialized.pop_back();
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, message.GetDescriptor(), &arena);
+  EXPECT_FALSE(wire_message.ok());
+  EXPECT_TRUE(Field(wire_message, "string_value").IsError());
+  EXPECT_FALSE(Has(wire_message, "string_value"));
+  EXPECT_THAT(wire_message.size(), Eq(0));
+}
+
+TEST(WireMessageImplTest, MalformedField) {
+  // Field 102 (int64_list) packed, with a truncated varint.
+  std::string serialized("\xb2\x06\x01\x80", 4);
+  Arena arena;
+
+  WireMessageImpl wire_message(serialized, TestMessage::descriptor(), &arena);
+  ASSERT_TRUE(wire_message.ok());
+  EXPECT_TRUE(Field(wire_message, "int64_list").IsError());
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -7,6 +7,19 @@ namespace runtime {
 
 absl::optional<CelValue> Activation::FindValue(absl::string_view name,
                                                google::protobuf::Arena* arena) const {
+  // Values bound to slots take precedence over name-based bindings, as they
+  // do for identifiers evaluated with the slot layout (see SlotActivation).
+  if (slot_names_ != nullptr) {
+    for (size_t i = 0; i < slot_names_->size(); i++) {
+      if ((*slot_names_)[i] == name) {
+        if (slot_values_[i].has_value()) {
+          return slot_values_[i];
+        }
+        break;
+      }
+    }
+  }
+
   auto entry = value_map_.find(std::string(name));
 
   // No entry found.
@@ -30,6 +43,23 @@ bool Activation::RemoveValueEntry(absl::string_view name) {
   return value_map_.erase(std::string(name));
 }
 
+SlotActivation::SlotActivation(const std::vector<std::string>* slot_names) {
+  slot_names_ = slot_names;
+  slot_values_.resize(slot_names->size());
+}
+
+bool SlotActivation::ClearSlotValue(int slot) {
+  bool bound = slot_values_[slot].has_value();
+  slot_values_[slot].reset();
+  return bound;
+}
+
+void SlotActivation::ClearSlotValues() {
+  for (auto& value : slot_values_) {
+    value.reset();
+  }
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
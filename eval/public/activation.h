@@ -55,7 +55,22 @@ class Activation {
                                                           unknown_paths_);
   }
 
+  // Check whether any unknown paths are set.
+  bool has_unknown_paths() const { return unknown_paths_.paths_size() > 0; }
+
+  // Provide values bound to variable slots, if slot_names is the slot layout
+  // this activation was created for (see SlotActivation).
+  // Returns nullptr otherwise.
+  const std::vector<absl::optional<CelValue>>* FindSlotValues(
+      const std::vector<std::string>* slot_names) const {
+    return (slot_names_ != nullptr && slot_names_ == slot_names)
+               ? &slot_values_
+               : nullptr;
+  }
+
  private:
+  friend class SlotActivation;
+
   class ValueEntry {
    public:
     explicit ValueEntry(std::unique_ptr<CelValueProducer> prod)
@@ -84,6 +99,41 @@ class Activation {
   std::map<std::string, ValueEntry> value_map_;
 
   google::protobuf::FieldMask unknown_paths_;
+
+  // Slot layout and values bound by SlotActivation.
+  // They are kept in the base class, so that evaluator can access them
+  // without virtual dispatch.
+  const std::vector<std::string>* slot_names_ = nullptr;
+  std::vector<absl::optional<CelValue>> slot_values_;
+};
+
+// SlotActivation binds values to variable slots assigned at build time.
+// slot_names is the slot layout of the expression, as provided by
+// CelExpression::variable_slots(); it must outlive the activation.
+// When the expression is evaluated, identifiers bound to slots are resolved
+// with a single array access instead of name lookup.
+// Values bound to slots are also visible through name-based lookup, so that
+// the activation can be used with other expressions as well.
+// Name-based bindings (InsertValue and InsertValueProducer) remain
+// available for variables without slots.
+// If a name has both bindings, the value bound to its slot is used, whether
+// the identifier is resolved by slot or by FindValue; the name-based binding
+// is used only while the slot is not bound.
+class SlotActivation : public Activation {
+ public:
+  explicit SlotActivation(const std::vector<std::string>* slot_names);
+
+  // Bind value to the slot.
+  // Checking that slot is in range is caller's responsibility.
+  void SetSlotValue(int slot, const CelValue& value) {
+    slot_values_[slot] = value;
+  }
+
+  // Remove value bound to the slot. Returns true if the slot was bound.
+  bool ClearSlotValue(int slot);
+
+  // Remove values bound to all slots.
+  void ClearSlotValues();
 };
 
 }  // namespace runtime
@@ -3,6 +3,10 @@
 #include "eval/eval/field_access.h"
 #include "eval/eval/field_backed_list_impl.h"
 #include "eval/eval/field_backed_map_impl.h"
+#include "eval/eval/wire_message_impl.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 
 namespace google {
 namespace api {
@@ -24,18 +28,54 @@ util::Status CreateValueFromField(const google::protobuf::Message* msg,
         arena, msg, field_desc, arena));
     return util::OkStatus();
   } else if (field_desc->is_repeated()) {
-    *result = CelValue::CreateList(google::protobuf::Arena::Create<FieldBackedListImpl>(
-        arena, msg, field_desc, arena));
+    *result =
+        CelValue::CreateList(CreateFieldBackedList(msg, field_desc, arena));
     return util::OkStatus();
   } else {
     return CreateValueFromSingleField(msg, field_desc, arena, result);
   }
 }
 
-}  // namespace
+// Produces the value of a field of a serialized message.
+class WireFieldProducer : public CelValueProducer {
+ public:
+  WireFieldProducer(const WireMessageImpl* message,
+                    const FieldDescriptor* field_desc)
+      : message_(message), field_desc_(field_desc) {}
 
-util::Status BindProtoToActivation(const Message* message, Arena* arena,
-                                     Activation* activation) {
+  CelValue Produce(Arena*) override {
+    return message_->GetFieldValue(field_desc_);
+  }
+
+ private:
+  const WireMessageImpl* message_;
+  const FieldDescriptor* field_desc_;
+};
+
+// Selects the fields to bind: all fields, or the fields that are the first
+// components of referenced paths.
+class FieldFilter {
+ public:
+  explicit FieldFilter(const google::protobuf::FieldMask* referenced_paths)
+      : all_fields_(referenced_paths == nullptr) {
+    if (referenced_paths != nullptr) {
+      for (const std::string& path : referenced_paths->paths()) {
+        names_.insert(absl::string_view(path).substr(0, path.find('.')));
+      }
+    }
+  }
+
+  bool Binds(const FieldDescriptor* field_desc) const {
+    return all_fields_ || names_.contains(field_desc->name());
+  }
+
+ private:
+  bool all_fields_;
+  absl::flat_hash_set<absl::string_view> names_;
+};
+
+util::Status BindFields(const Message* message, Arena* arena,
+                        Activation* activation, const FieldFilter& filter) {
   // TODO(issues/24): Improve the utilities to bind dynamic values as well.
   const Descriptor* desc = message->GetDescriptor();
   const google::protobuf::Reflection* reflection = message->GetReflection();
@@ -43,6 +83,10 @@ util::Status BindProtoToActivation(const Message* message, Arena* arena,
     CelValue value;
     const FieldDescriptor* field_desc = desc->field(i);
 
+    if (!filter.Binds(field_desc)) {
+      continue;
+    }
+
     if (!field_desc->is_repeated() &&
         !reflection->HasField(*message, field_desc)) {
       continue;
@@ -59,6 +103,67 @@ util::Status BindProtoToActivation(const Message* message, Arena* arena,
   return util::OkStatus();
 }
 
+util::Status BindWireFields(absl::string_view serialized,
+                            const Descriptor* descriptor, Arena* arena,
+                            Activation* activation, const FieldFilter& filter) {
+  // Values are allocated on the arena of the message, as producers may be
+  // called with the arenas of evaluations.
+  auto message =
+      Arena::Create<WireMessageImpl>(arena, serialized, descriptor, arena);
+  if (!message->ok()) {
+    return util::MakeStatus(
+        google::rpc::Code::INVALID_ARGUMENT,
+        absl::StrCat("Malformed message ", descriptor->full_name()));
+  }
+  for (int i = 0; i < descriptor->field_count(); i++) {
+    const FieldDescriptor* field_desc = descriptor->field(i);
+
+    if (!filter.Binds(field_desc)) {
+      continue;
+    }
+
+    if (!field_desc->is_repeated() && !message->HasField(field_desc)) {
+      continue;
+    }
+
+    activation->InsertValueProducer(
+        field_desc->name(),
+        absl::make_unique<WireFieldProducer>(message, field_desc));
+  }
+
+  return util::OkStatus();
+}
+
+}  // namespace
+
+util::Status BindProtoToActivation(const Message* message, Arena* arena,
+                                     Activation* activation) {
+  return BindFields(message, arena, activation, FieldFilter(nullptr));
+}
+
+util::Status BindProtoToActivation(
+    const Message* message, Arena* arena, Activation* activation,
+    const google::protobuf::FieldMask& referenced_paths) {
+  return BindFields(message, arena, activation,
+                    FieldFilter(&referenced_paths));
+}
+
+util::Status BindWireMessageToActivation(absl::string_view serialized,
+                                         const Descriptor* descriptor,
+                                         Arena* arena,
+                                         Activation* activation) {
+  return BindWireFields(serialized, descriptor, arena, activation,
+                        FieldFilter(nullptr));
+}
+
+util::Status BindWireMessageToActivation(
+    absl::string_view serialized, const Descriptor* descriptor, Arena* arena,
+    Activation* activation,
+    const google::protobuf::FieldMask& referenced_paths) {
+  return BindWireFields(serialized, descriptor, arena, activation,
+                        FieldFilter(&referenced_paths));
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
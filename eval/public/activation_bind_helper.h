@@ -1,7 +1,9 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_ACTIVATION_BIND_HELPER_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_ACTIVATION_BIND_HELPER_H_
 
+#include "google/protobuf/field_mask.pb.h"
 #include "eval/public/activation.h"
+#include "absl/strings/string_view.h"
 
 namespace google {
 namespace api {
@@ -35,6 +37,36 @@ util::Status BindProtoToActivation(const google::protobuf::Message* message,
                                      google::protobuf::Arena* arena,
                                      Activation* activation);
 
+// Variant of BindProtoToActivation binding only the fields referenced by an
+// expression: the first components of the paths found by
+// FindReferencedPaths().
+util::Status BindProtoToActivation(
+    const google::protobuf::Message* message, google::protobuf::Arena* arena,
+    Activation* activation,
+    const google::protobuf::FieldMask& referenced_paths);
+
+// Variant of BindProtoToActivation for a message serialized in the wire
+// format, of the type described by the descriptor. The message is not
+// parsed: fields are decoded on their first access by the evaluation, so
+// expressions referencing few fields of large messages skip decoding the
+// others. Submessages are bound as maps of their fields, see
+// WireMessageImpl: their type is map, the "in" operator and size() only see
+// the fields present, and selects of fields not declared are "Key not found
+// in map" errors. The serialized message must outlive the activation.
+// Returns INVALID_ARGUMENT if the message is malformed.
+util::Status BindWireMessageToActivation(
+    absl::string_view serialized,
+    const google::protobuf::Descriptor* descriptor,
+    google::protobuf::Arena* arena, Activation* activation);
+
+// Variant of BindWireMessageToActivation binding only the fields referenced
+// by an expression, see above.
+util::Status BindWireMessageToActivation(
+    absl::string_view serialized,
+    const google::protobuf::Descriptor* descriptor,
+    google::protobuf::Arena* arena, Activation* activation,
+    const google::protobuf::FieldMask& referenced_paths);
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
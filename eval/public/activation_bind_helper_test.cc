@@ -53,6 +53,75 @@ TEST(ActivationBindHelperTest, TestSingleInt32Bind) {
   EXPECT_EQ(value.Int64OrDie(), 42);
 }
 
+TEST(ActivationBindHelperTest, TestWireMessageBind) {
+  TestMessage message;
+  message.set_int32_value(42);
+  message.add_string_list("a");
+  message.mutable_message_value()->set_bool_value(true);
+  std::string serialized = message.SerializeAsString();
+
+  google::protobuf::Arena arena;
+
+  Activation activation;
+
+  ASSERT_TRUE(util::IsOk(BindWireMessageToActivation(
+      serialized, message.GetDescriptor(), &arena, &activation)));
+
+  auto result = activation.FindValue("int32_value", &arena);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->IsInt64());
+  EXPECT_EQ(result->Int64OrDie(), 42);
+
+  result = activation.FindValue("string_list", &arena);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->IsList());
+  EXPECT_EQ(result->ListOrDie()->size(), 1);
+
+  // Submessages are bound as maps of their fields.
+  result = activation.FindValue("message_value", &arena);
+  ASSERT_TRUE(result.has_value());
+  ASSERT_TRUE(result->IsMap());
+
+  // Singular fields not set are not bound, as by BindProtoToActivation.
+  EXPECT_FALSE(activation.FindValue("int64_value", &arena).has_value());
+
+  serialized.pop_back();
+  Activation malformed_activation;
+  EXPECT_FALSE(util::IsOk(BindWireMessageToActivation(
+      serialized, message.GetDescriptor(), &arena, &malformed_activation)));
+}
+
+TEST(ActivationBindHelperTest, TestReferencedFieldsBind) {
+  TestMessage message;
+  message.set_int32_value(42);
+  message.set_int64_value(1);
+  message.mutable_message_value()->set_bool_value(true);
+  message.add_int64_list(2);
+  std::string serialized = message.SerializeAsString();
+
+  google::protobuf::FieldMask referenced_paths;
+  referenced_paths.add_paths("int32_value");
+  referenced_paths.add_paths("message_value.bool_value");
+
+  google::protobuf::Arena arena;
+
+  Activation activation;
+  ASSERT_TRUE(util::IsOk(BindProtoToActivation(&message, &arena, &activation,
+                                               referenced_paths)));
+  Activation wire_activation;
+  ASSERT_TRUE(util::IsOk(
+      BindWireMessageToActivation(serialized, message.GetDescriptor(), &arena,
+                                  &wire_activation, referenced_paths)));
+
+  // Only the first components of the paths are bound.
+  for (const Activation* bound : {&activation, &wire_activation}) {
+    EXPECT_TRUE(bound->FindValue("int32_value", &arena).has_value());
+    EXPECT_TRUE(bound->FindValue("message_value", &arena).has_value());
+    EXPECT_FALSE(bound->FindValue("int64_value", &arena).has_value());
+    EXPECT_FALSE(bound->FindValue("int64_list", &arena).has_value());
+  }
+}
+
 }  // namespace
 
 }  // namespace runtime
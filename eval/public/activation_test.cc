@@ -85,6 +85,56 @@ TEST(ActivationTest, CheckValueProducerInsertFindAndRemove) {
   EXPECT_FALSE(activation.FindValue("value42", &arena));
 }
 
+TEST(ActivationTest, CheckSlotValueSetFindAndClear) {
+  const std::vector<std::string> slot_names = {"value42", "value43"};
+  SlotActivation activation(&slot_names);
+
+  Arena arena;
+
+  // Slot values are only provided for the slot layout of the activation.
+  const std::vector<std::string> other_slot_names = slot_names;
+  EXPECT_THAT(activation.FindSlotValues(&other_slot_names), Eq(nullptr));
+
+  auto slot_values = activation.FindSlotValues(&slot_names);
+  ASSERT_TRUE(slot_values != nullptr);
+  EXPECT_THAT(slot_values->size(), Eq(2));
+  EXPECT_FALSE((*slot_values)[0].has_value());
+
+  activation.SetSlotValue(0, CelValue::CreateInt64(42));
+  ASSERT_TRUE((*slot_values)[0].has_value());
+  EXPECT_THAT((*slot_values)[0].value().Int64OrDie(), Eq(42));
+
+  // Slot values are visible through name lookup.
+  auto value = activation.FindValue("value42", &arena);
+  ASSERT_TRUE(value.has_value());
+  EXPECT_THAT(value.value().Int64OrDie(), Eq(42));
+  EXPECT_FALSE(activation.FindValue("value43", &arena));
+
+  // Name-based bindings still work.
+  activation.InsertValue("value44", CelValue::CreateInt64(44));
+  EXPECT_TRUE(activation.FindValue("value44", &arena));
+
+  // Values bound to slots take precedence over name-based bindings.
+  activation.InsertValue("value42", CelValue::CreateInt64(-42));
+  value = activation.FindValue("value42", &arena);
+  ASSERT_TRUE(value.has_value());
+  EXPECT_THAT(value.value().Int64OrDie(), Eq(42));
+
+  EXPECT_FALSE(activation.ClearSlotValue(1));
+  EXPECT_TRUE(activation.ClearSlotValue(0));
+  value = activation.FindValue("value42", &arena);
+  ASSERT_TRUE(value.has_value());
+  EXPECT_THAT(value.value().Int64OrDie(), Eq(-42));
+  EXPECT_TRUE(activation.RemoveValueEntry("value42"));
+  EXPECT_FALSE(activation.FindValue("value42", &arena));
+
+  activation.SetSlotValue(0, CelValue::CreateInt64(42));
+  activation.SetSlotValue(1, CelValue::CreateInt64(43));
+  activation.ClearSlotValues();
+  EXPECT_FALSE(activation.FindValue("value42", &arena));
+  EXPECT_FALSE(activation.FindValue("value43", &arena));
+}
+
 }  // namespace
 
 }  // namespace runtime
@@ -3,12 +3,17 @@
 #include <functional>
 
 #include "google/protobuf/util/time_util.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/typed_list_impl.h"
 #include "eval/public/cel_builtins.h"
 #include "eval/public/cel_function_adapter.h"
-#include "re2/re2.h"
+#include "eval/public/list_membership.h"
+#include "eval/public/regex_match.h"
+#include "eval/public/timestamp_accessor.h"
+#include "internal/proto_util.h"
 #include "google/rpc/code.pb.h"
 
 namespace google {
@@ -16,13 +21,52 @@ namespace api {
 namespace expr {
 namespace runtime {
 
+using google::protobuf::Arena;
 using google::protobuf::Duration;
 using google::protobuf::Timestamp;
-using google::protobuf::Arena;
-using google::protobuf::util::TimeUtil;
 
 namespace {
 
+// Creates the value of a duration computed by a builtin function. Unless
+// held by value, the duration is copied to a message allocated in the arena.
+// The range is checked first: encoding reports errors with status objects,
+// which are too costly to create on each call.
+CelValue DurationValue(Arena* arena, absl::Duration value,
+                       const BuiltinFunctionOptions& options) {
+  if (options.inline_time_values) {
+    return CelValue::CreateDuration(value);
+  }
+  if (value < expr::internal::MakeGoogleApiDurationMin() ||
+      value > expr::internal::MakeGoogleApiDurationMax()) {
+    return CreateErrorValue(arena, "Duration out of range",
+                            CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  Duration* duration = Arena::CreateMessage<Duration>(arena);
+  int64_t seconds = absl::IDivDuration(value, absl::Seconds(1), &value);
+  duration->set_seconds(seconds);
+  duration->set_nanos(absl::ToInt64Nanoseconds(value));
+  return CelValue::CreateDuration(duration);
+}
+
+// Creates the value of a timestamp computed by a builtin function.
+CelValue TimestampValue(Arena* arena, absl::Time value,
+                        const BuiltinFunctionOptions& options) {
+  if (options.inline_time_values) {
+    return CelValue::CreateTimestamp(value);
+  }
+  if (value < expr::internal::MakeGoogleApiTimeMin() ||
+      value > expr::internal::MakeGoogleApiTimeMax()) {
+    return CreateErrorValue(arena, "Timestamp out of range",
+                            CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  Timestamp* timestamp = Arena::CreateMessage<Timestamp>(arena);
+  int64_t seconds = absl::ToUnixSeconds(value);
+  timestamp->set_seconds(seconds);
+  timestamp->set_nanos(
+      absl::ToInt64Nanoseconds(value - absl::FromUnixSeconds(seconds)));
+  return CelValue::CreateTimestamp(timestamp);
+}
+
 // Comparison template functions
 template <class Type>
 bool Inequal(Arena* arena, Type t1, Type t2) {
@@ -54,69 +98,6 @@ bool GreaterThanOrEqual(Arena* arena, Type t1, Type t2) {
   return LessThanOrEqual(arena, t2, t1);
 }
 
-// Duration comparison specializations
-template <>
-bool Inequal(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator!=(*t1, *t2);
-}
-
-template <>
-bool Equal(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator==(*t1, *t2);
-}
-
-template <>
-bool LessThan(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator<(*t1, *t2);
-}
-
-template <>
-bool LessThanOrEqual(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator<=(*t1, *t2);
-}
-
-template <>
-bool GreaterThan(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator>(*t1, *t2);
-}
-
-template <>
-bool GreaterThanOrEqual(Arena* arena, const Duration* t1, const Duration* t2) {
-  return operator>=(*t1, *t2);
-}
-
-// Timestamp comparison specializations
-template <>
-bool Inequal(Arena* arena, const Timestamp* t1, const Timestamp* t2) {
-  return operator!=(*t1, *t2);
-}
-
-template <>
-bool Equal(Arena* arena, const Timestamp* t1, const Timestamp* t2) {
-  return operator==(*t1, *t2);
-}
-
-template <>
-bool LessThan(Arena* arena, const Timestamp* t1, const Timestamp* t2) {
-  return operator<(*t1, *t2);
-}
-
-template <>
-bool LessThanOrEqual(Arena* arena, const Timestamp* t1, const Timestamp* t2) {
-  return operator<=(*t1, *t2);
-}
-
-template <>
-bool GreaterThan(Arena* arena, const Timestamp* t1, const Timestamp* t2) {
-  return operator>(*t1, *t2);
-}
-
-template <>
-bool GreaterThanOrEqual(Arena* arena, const Timestamp* t1,
-                        const Timestamp* t2) {
-  return operator>=(*t1, *t2);
-}
-
 // Helper method
 // Registers all comparison functions for template parameter type.
 template <class Type>
@@ -256,55 +237,6 @@ util::Status RegisterArithmeticFunctionsForType(
   return status;
 }
 
-template <class T>
-bool ValueEquals(const CelValue& value, T other);
-
-template <>
-bool ValueEquals(const CelValue& value, bool other) {
-  return value.IsBool() && (value.BoolOrDie() == other);
-}
-
-template <>
-bool ValueEquals(const CelValue& value, int64_t other) {
-  return value.IsInt64() && (value.Int64OrDie() == other);
-}
-
-template <>
-bool ValueEquals(const CelValue& value, uint64_t other) {
-  return value.IsUint64() && (value.Uint64OrDie() == other);
-}
-
-template <>
-bool ValueEquals(const CelValue& value, double other) {
-  return value.IsDouble() && (value.DoubleOrDie() == other);
-}
-
-template <>
-bool ValueEquals(const CelValue& value, CelValue::StringHolder other) {
-  return value.IsString() && (value.StringOrDie() == other);
-}
-
-template <>
-bool ValueEquals(const CelValue& value, CelValue::BytesHolder other) {
-  return value.IsBytes() && (value.BytesOrDie() == other);
-}
-
-// Template function implementing CEL in() function
-template <typename T>
-bool In(Arena* arena, T value, const CelList* list) {
-  int index_size = list->size();
-
-  for (int i = 0; i < index_size; i++) {
-    CelValue element = (*list)[i];
-
-    if (ValueEquals<T>(element, value)) {
-      return true;
-    }
-  }
-
-  return false;
-}
-
 // Concatenation for StringHolder type.
 CelValue::StringHolder ConcatString(Arena* arena, CelValue::StringHolder value1,
                                     CelValue::StringHolder value2) {
@@ -325,61 +257,100 @@ CelValue::BytesHolder ConcatBytes(Arena* arena, CelValue::BytesHolder value1,
 const CelList* ConcatList(Arena* arena, const CelList* value1,
                           const CelList* value2) {
   std::vector<CelValue> joined_values;
+  joined_values.reserve(value1->size() + value2->size());
 
-  int size1 = value1->size();
-  int size2 = value2->size();
-  joined_values.reserve(size1 + size2);
-
-  for (int i = 0; i < size1; i++) {
-    joined_values.push_back((*value1)[i]);
-  }
-  for (int i = 0; i < size2; i++) {
-    joined_values.push_back((*value2)[i]);
-  }
+  auto append = [&joined_values](const CelValue& value) {
+    joined_values.push_back(value);
+    return true;
+  };
+  value1->ForEach(append);
+  value2->ForEach(append);
 
   auto concatenated =
-      Arena::Create<ContainerBackedListImpl>(arena, joined_values);
+      Arena::Create<ContainerBackedListImpl>(arena, std::move(joined_values));
   return concatenated;
 }
 
-// Timestamp
-const util::Status FindTimeBreakdown(const Timestamp* timestamp,
-                                     absl::string_view tz,
-                                     absl::TimeZone::CivilInfo* breakdown) {
-  absl::Time instant;
-  instant = absl::FromUnixSeconds(timestamp->seconds());
-  instant += absl::Nanoseconds(timestamp->nanos());
-
-  absl::TimeZone time_zone;
-
-  if (!tz.empty()) {
-    bool found = absl::LoadTimeZone(std::string(tz), &time_zone);
-    if (!found) {
-      return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT, "Invalid timezone");
+CelValue ListEqual(Arena* arena, const CelList* list1, const CelList* list2);
+
+// Equality of list elements: a bool if the elements have the same type, or
+// an error otherwise. Maps and messages other than null are not compared.
+CelValue ElementEqual(Arena* arena, const CelValue& value1,
+                      const CelValue& value2) {
+  if (value1.IsError()) return value1;
+  if (value2.IsError()) return value2;
+  if (value1.type() == value2.type()) {
+    switch (value1.type()) {
+      case CelValue::Type::kBool:
+        return CelValue::CreateBool(value1.BoolOrDie() == value2.BoolOrDie());
+      case CelValue::Type::kInt64:
+        return CelValue::CreateBool(value1.Int64OrDie() ==
+                                    value2.Int64OrDie());
+      case CelValue::Type::kUint64:
+        return CelValue::CreateBool(value1.Uint64OrDie() ==
+                                    value2.Uint64OrDie());
+      case CelValue::Type::kDouble:
+        return CelValue::CreateBool(value1.DoubleOrDie() ==
+                                    value2.DoubleOrDie());
+      case CelValue::Type::kString:
+        return CelValue::CreateBool(value1.StringOrDie() ==
+                                    value2.StringOrDie());
+      case CelValue::Type::kBytes:
+        return CelValue::CreateBool(value1.BytesOrDie() == value2.BytesOrDie());
+      case CelValue::Type::kDuration:
+        return CelValue::CreateBool(value1.AbslDurationOrDie() ==
+                                    value2.AbslDurationOrDie());
+      case CelValue::Type::kTimestamp:
+        return CelValue::CreateBool(value1.AbslTimestampOrDie() ==
+                                    value2.AbslTimestampOrDie());
+      case CelValue::Type::kMessage:
+        if (value1.IsNull() && value2.IsNull()) {
+          return CelValue::CreateBool(true);
+        }
+        break;
+      case CelValue::Type::kList:
+        return ListEqual(arena, value1.ListOrDie(), value2.ListOrDie());
+      default:
+        break;
     }
   }
-
-  *breakdown = time_zone.At(instant);
-  return util::OkStatus();
+  return CreateErrorValue(arena, "no_matching_overload",
+                          CelError::Code::CelError_Code_NO_MATCHING_OVERLOAD);
 }
 
-CelValue GetTimeBreakdownPart(
-    Arena* arena, const Timestamp* timestamp, absl::string_view tz,
-    const std::function<CelValue(const absl::TimeZone::CivilInfo&)>&
-        extractor_func) {
-  absl::TimeZone::CivilInfo breakdown;
-  auto status = FindTimeBreakdown(timestamp, tz, &breakdown);
-
-  if (!util::IsOk(status)) {
-    return CreateErrorValue(arena, status.message(),
-                            CelError::Code::CelError_Code_UNKNOWN);
+// Equality for CelList type. Elements are compared in order until the
+// result is decided. Typed lists of the same element type are compared
+// without creating the element values.
+CelValue ListEqual(Arena* arena, const CelList* list1, const CelList* list2) {
+  absl::optional<bool> native_equal = NativeListsEqual(*list1, *list2);
+  if (native_equal.has_value()) {
+    return CelValue::CreateBool(*native_equal);
+  }
+  int size = list1->size();
+  if (size != list2->size()) {
+    return CelValue::CreateBool(false);
+  }
+  for (int i = 0; i < size; i++) {
+    CelValue equal = ElementEqual(arena, (*list1)[i], (*list2)[i]);
+    if (!equal.IsBool() || !equal.BoolOrDie()) {
+      return equal;
+    }
   }
+  return CelValue::CreateBool(true);
+}
 
-  return extractor_func(breakdown);
+CelValue ListInequal(Arena* arena, const CelList* list1,
+                     const CelList* list2) {
+  CelValue equal = ListEqual(arena, list1, list2);
+  if (!equal.IsBool()) {
+    return equal;
+  }
+  return CelValue::CreateBool(!equal.BoolOrDie());
 }
 
 CelValue CreateTimestampFromString(Arena* arena,
-                                   CelValue::StringHolder time_str) {
+                                   CelValue::StringHolder time_str,
+                                   const BuiltinFunctionOptions& options) {
   Timestamp ts;
   auto result =
       google::protobuf::util::TimeUtil::FromString(std::string(time_str.value()), &ts);
@@ -388,139 +359,95 @@ CelValue CreateTimestampFromString(Arena* arena,
                             CelError::Code::CelError_Code_INVALID_ARGUMENT);
   }
 
+  if (options.inline_time_values) {
+    return CelValue::CreateTimestamp(expr::internal::DecodeTime(ts));
+  }
   return CelValue::CreateTimestamp(
       Arena::Create<Timestamp>(arena, std::move(ts)));
 }
 
-CelValue GetFullYear(Arena* arena, const Timestamp* timestamp,
-                     absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.year());
-      });
+// Timestamp accessors, extracting values from the civil time.
+CelValue GetFullYear(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.year());
 }
 
-CelValue GetMonth(Arena* arena, const Timestamp* timestamp,
-                  absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.month() - 1);
-      });
+CelValue GetMonth(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.month() - 1);
 }
 
-CelValue GetDayOfYear(Arena* arena, const Timestamp* timestamp,
-                      absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(
-            absl::GetYearDay(absl::CivilDay(breakdown.cs)) - 1);
-      });
+CelValue GetDayOfYear(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(
+      absl::GetYearDay(absl::CivilDay(breakdown.cs)) - 1);
 }
 
-CelValue GetDayOfMonth(Arena* arena, const Timestamp* timestamp,
-                       absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.day() - 1);
-      });
+CelValue GetDayOfMonth(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.day() - 1);
 }
 
-CelValue GetDate(Arena* arena, const Timestamp* timestamp,
-                 absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.day());
-      });
+CelValue GetDate(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.day());
 }
 
-CelValue GetDayOfWeek(Arena* arena, const Timestamp* timestamp,
-                      absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        absl::Weekday weekday = absl::GetWeekday(absl::CivilDay(breakdown.cs));
-
-        // get day of week from the date in UTC, zero-based, zero for Sunday,
-        // based on GetDayOfWeek CEL function definition.
-        int weekday_num = static_cast<int>(weekday);
-        weekday_num = (weekday_num == 6) ? 0 : weekday_num + 1;
-        return CelValue::CreateInt64(weekday_num);
-      });
+CelValue GetDayOfWeek(const absl::TimeZone::CivilInfo& breakdown) {
+  absl::Weekday weekday = absl::GetWeekday(absl::CivilDay(breakdown.cs));
+
+  // get day of week from the date in UTC, zero-based, zero for Sunday,
+  // based on GetDayOfWeek CEL function definition.
+  int weekday_num = static_cast<int>(weekday);
+  weekday_num = (weekday_num == 6) ? 0 : weekday_num + 1;
+  return CelValue::CreateInt64(weekday_num);
 }
 
-CelValue GetHours(Arena* arena, const Timestamp* timestamp,
-                  absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.hour());
-      });
+CelValue GetHours(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.hour());
 }
 
-CelValue GetMinutes(Arena* arena, const Timestamp* timestamp,
-                    absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.minute());
-      });
+CelValue GetMinutes(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.minute());
 }
 
-CelValue GetSeconds(Arena* arena, const Timestamp* timestamp,
-                    absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(breakdown.cs.second());
-      });
+CelValue GetSeconds(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.second());
 }
 
-CelValue GetMilliseconds(Arena* arena, const Timestamp* timestamp,
-                         absl::string_view tz) {
-  return GetTimeBreakdownPart(
-      arena, timestamp, tz, [](const absl::TimeZone::CivilInfo& breakdown) {
-        return CelValue::CreateInt64(
-            absl::ToInt64Milliseconds(breakdown.subsecond));
-      });
+CelValue GetMilliseconds(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(absl::ToInt64Milliseconds(breakdown.subsecond));
 }
 
+// Parses durations such as "1h30m" or "2.5s". Durations that do not fit in
+// google.protobuf.Duration are rejected.
 CelValue CreateDurationFromString(Arena* arena,
-                                  CelValue::StringHolder time_str) {
-  Duration d;
-  auto result =
-      google::protobuf::util::TimeUtil::FromString(std::string(time_str.value()), &d);
-  if (!result) {
+                                  CelValue::StringHolder time_str,
+                                  const BuiltinFunctionOptions& options) {
+  absl::Duration d;
+  if (!absl::ParseDuration(std::string(time_str.value()), &d) ||
+      d < expr::internal::MakeGoogleApiDurationMin() ||
+      d > expr::internal::MakeGoogleApiDurationMax()) {
     return CreateErrorValue(arena, "String to Duration conversion failed",
                             CelError::Code::CelError_Code_INVALID_ARGUMENT);
   }
 
-  return CelValue::CreateDuration(Arena::Create<Duration>(arena, std::move(d)));
+  return DurationValue(arena, d, options);
 }
 
-CelValue GetHours(Arena* arena, const Duration* duration) {
-  return CelValue::CreateInt64(TimeUtil::DurationToHours(*duration));
+CelValue GetHours(Arena* arena, absl::Duration duration) {
+  return CelValue::CreateInt64(absl::ToInt64Hours(duration));
 }
 
-CelValue GetMinutes(Arena* arena, const Duration* duration) {
-  return CelValue::CreateInt64(TimeUtil::DurationToMinutes(*duration));
+CelValue GetMinutes(Arena* arena, absl::Duration duration) {
+  return CelValue::CreateInt64(absl::ToInt64Minutes(duration));
 }
 
-CelValue GetSeconds(Arena* arena, const Duration* duration) {
-  return CelValue::CreateInt64(TimeUtil::DurationToSeconds(*duration));
+CelValue GetSeconds(Arena* arena, absl::Duration duration) {
+  return CelValue::CreateInt64(absl::ToInt64Seconds(duration));
 }
 
-CelValue GetMilliseconds(Arena* arena, const Duration* duration) {
+CelValue GetMilliseconds(Arena* arena, absl::Duration duration) {
   int64_t millis_per_second = 1000L;
-  return CelValue::CreateInt64(TimeUtil::DurationToMilliseconds(*duration) %
+  return CelValue::CreateInt64(absl::ToInt64Milliseconds(duration) %
                                millis_per_second);
 }
 
-CelValue RegexMatches(Arena* arena, CelValue::StringHolder target,
-                      CelValue::StringHolder regex) {
-  RE2 re2(regex.value().data());
-  if (!re2.ok()) {
-    return CreateErrorValue(arena, "invalid_argument",
-                            CelError::INVALID_ARGUMENT);
-  }
-  return CelValue::CreateBool(RE2::FullMatch(target.value().data(), re2));
-}
-
 bool StringContains(Arena* arena, CelValue::StringHolder value,
                     CelValue::StringHolder substr) {
   return absl::StrContains(value.value(), substr.value());
@@ -566,9 +493,8 @@ util::Status RegisterMapIndexFunction(
                                      [](T v) { return absl::StrCat(v); });
 }
 
-}  // namespace
-
-util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
+util::Status RegisterBuiltinOverloads(CelFunctionRegistry* registry,
+                                      const BuiltinFunctionOptions& options) {
   // logical NOT
   util::Status status = FunctionAdapter<bool, bool>::CreateAndRegister(
       builtin::kNot, false,
@@ -604,10 +530,10 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
   status = RegisterComparisonFunctionsForType<CelValue::BytesHolder>(registry);
   if (!util::IsOk(status)) return status;
 
-  status = RegisterComparisonFunctionsForType<const Duration*>(registry);
+  status = RegisterComparisonFunctionsForType<absl::Duration>(registry);
   if (!util::IsOk(status)) return status;
 
-  status = RegisterComparisonFunctionsForType<const Timestamp*>(registry);
+  status = RegisterComparisonFunctionsForType<absl::Time>(registry);
   if (!util::IsOk(status)) return status;
 
   // Logical AND
@@ -787,73 +713,28 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
       builtin::kSize, false, list_size_func, registry);
   if (!util::IsOk(status)) return status;
 
-  // List in operator: @in
-  status = FunctionAdapter<bool, bool, const CelList*>::CreateAndRegister(
-      builtin::kIn, false, In<bool>, registry);
+  // List equality
+  status = FunctionAdapter<CelValue, const CelList*, const CelList*>::
+      CreateAndRegister(builtin::kEqual, false, ListEqual, registry);
   if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, int64_t, const CelList*>::CreateAndRegister(
-      builtin::kIn, false, In<int64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, uint64_t, const CelList*>::CreateAndRegister(
-      builtin::kIn, false, In<uint64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, double, const CelList*>::CreateAndRegister(
-      builtin::kIn, false, In<double>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::StringHolder, const CelList*>::
-      CreateAndRegister(builtin::kIn, false, In<CelValue::StringHolder>,
-                        registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::BytesHolder, const CelList*>::
-      CreateAndRegister(builtin::kIn, false, In<CelValue::BytesHolder>,
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  // List in operator: _in_ (deprecated)
-  // Bindings preserved for backward compatibility with stored expressions.
-  status = FunctionAdapter<bool, bool, const CelList*>::CreateAndRegister(
-      builtin::kInDeprecated, false, In<bool>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, int64_t, const CelList*>::CreateAndRegister(
-      builtin::kInDeprecated, false, In<int64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, uint64_t, const CelList*>::CreateAndRegister(
-      builtin::kInDeprecated, false, In<uint64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, double, const CelList*>::CreateAndRegister(
-      builtin::kInDeprecated, false, In<double>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::StringHolder, const CelList*>::
-      CreateAndRegister(builtin::kInDeprecated, false,
-                        In<CelValue::StringHolder>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::BytesHolder, const CelList*>::
-      CreateAndRegister(builtin::kInDeprecated, false,
-                        In<CelValue::BytesHolder>, registry);
+  status = FunctionAdapter<CelValue, const CelList*, const CelList*>::
+      CreateAndRegister(builtin::kInequal, false, ListInequal, registry);
   if (!util::IsOk(status)) return status;
 
-  // List in() function (deprecated)
-  // Bindings preserved for backward compatibility with stored expressions.
-  status = FunctionAdapter<bool, bool, const CelList*>::CreateAndRegister(
-      builtin::kInFunction, false, In<bool>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, int64_t, const CelList*>::CreateAndRegister(
-      builtin::kInFunction, false, In<int64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, uint64_t, const CelList*>::CreateAndRegister(
-      builtin::kInFunction, false, In<uint64_t>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, double, const CelList*>::CreateAndRegister(
-      builtin::kInFunction, false, In<double>, registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::StringHolder, const CelList*>::
-      CreateAndRegister(builtin::kInFunction, false, In<CelValue::StringHolder>,
-                        registry);
-  if (!util::IsOk(status)) return status;
-  status = FunctionAdapter<bool, CelValue::BytesHolder, const CelList*>::
-      CreateAndRegister(builtin::kInFunction, false, In<CelValue::BytesHolder>,
-                        registry);
-  if (!util::IsOk(status)) return status;
+  // List in operator: @in, _in_ and in() (deprecated).
+  // Deprecated bindings preserved for backward compatibility with stored
+  // expressions.
+  for (const char* name :
+       {builtin::kIn, builtin::kInDeprecated, builtin::kInFunction}) {
+    for (CelValue::Type type :
+         {CelValue::Type::kBool, CelValue::Type::kInt64,
+          CelValue::Type::kUint64, CelValue::Type::kDouble,
+          CelValue::Type::kString, CelValue::Type::kBytes}) {
+      status = registry->Register(
+          absl::make_unique<ListMembershipFunction>(name, type));
+      if (!util::IsOk(status)) return status;
+    }
+  }
 
   // Map Index
   status = RegisterMapIndexFunction<CelValue::StringHolder>(
@@ -976,71 +857,56 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
   if (!util::IsOk(status)) return status;
 
   // Special arithmetic operators for Timestamp and Duration
-  status = FunctionAdapter<CelValue, const Timestamp*, const Duration*>::
-      CreateAndRegister(builtin::kAdd, false,
-                        [](Arena* arena, const Timestamp* t1,
-                           const Duration* d2) -> CelValue {
-                          Timestamp* tmp =
-                              Arena::CreateMessage<Timestamp>(arena);
-                          tmp->CopyFrom(*t1 + *d2);
-                          return CelValue::CreateTimestamp(tmp);
-                        },
-                        registry);
+  status = FunctionAdapter<CelValue, absl::Time, absl::Duration>::
+      CreateAndRegister(
+          builtin::kAdd, false,
+          [options](Arena* arena, absl::Time t1, absl::Duration d2) {
+            return TimestampValue(arena, t1 + d2, options);
+          },
+          registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*, const Timestamp*>::
-      CreateAndRegister(builtin::kAdd, false,
-                        [](Arena* arena, const Duration* d2,
-                           const Timestamp* t1) -> CelValue {
-                          Timestamp* tmp =
-                              Arena::CreateMessage<Timestamp>(arena);
-                          tmp->CopyFrom(*t1 + *d2);
-                          return CelValue::CreateTimestamp(tmp);
-                        },
-                        registry);
+  status = FunctionAdapter<CelValue, absl::Duration, absl::Time>::
+      CreateAndRegister(
+          builtin::kAdd, false,
+          [options](Arena* arena, absl::Duration d2, absl::Time t1) {
+            return TimestampValue(arena, t1 + d2, options);
+          },
+          registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*, const Duration*>::
+  status = FunctionAdapter<CelValue, absl::Duration, absl::Duration>::
       CreateAndRegister(
           builtin::kAdd, false,
-          [](Arena* arena, const Duration* d1, const Duration* d2) -> CelValue {
-            Duration* tmp = Arena::CreateMessage<Duration>(arena);
-            tmp->CopyFrom(*d1 + *d2);
-            return CelValue::CreateDuration(tmp);
+          [options](Arena* arena, absl::Duration d1, absl::Duration d2) {
+            return DurationValue(arena, d1 + d2, options);
           },
           registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Timestamp*, const Duration*>::
-      CreateAndRegister(builtin::kSubtract, false,
-                        [](Arena* arena, const Timestamp* t1,
-                           const Duration* d2) -> CelValue {
-                          Timestamp* tmp =
-                              Arena::CreateMessage<Timestamp>(arena);
-                          tmp->CopyFrom(*t1 - *d2);
-                          return CelValue::CreateTimestamp(tmp);
-                        },
-                        registry);
+  status = FunctionAdapter<CelValue, absl::Time, absl::Duration>::
+      CreateAndRegister(
+          builtin::kSubtract, false,
+          [options](Arena* arena, absl::Time t1, absl::Duration d2) {
+            return TimestampValue(arena, t1 - d2, options);
+          },
+          registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Timestamp*, const Timestamp*>::
-      CreateAndRegister(builtin::kSubtract, false,
-                        [](Arena* arena, const Timestamp* t1,
-                           const Timestamp* t2) -> CelValue {
-                          Duration* tmp = Arena::CreateMessage<Duration>(arena);
-                          tmp->CopyFrom(*t1 - *t2);
-                          return CelValue::CreateDuration(tmp);
-                        },
-                        registry);
+  status = FunctionAdapter<CelValue, absl::Time, absl::Time>::
+      CreateAndRegister(
+          builtin::kSubtract, false,
+          [options](Arena* arena, absl::Time t1, absl::Time t2) {
+            return DurationValue(arena, t1 - t2, options);
+          },
+          registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*, const Duration*>::
+  status = FunctionAdapter<CelValue, absl::Duration, absl::Duration>::
       CreateAndRegister(
           builtin::kSubtract, false,
-          [](Arena* arena, const Duration* d1, const Duration* d2) -> CelValue {
-            Duration* tmp = Arena::CreateMessage<Duration>(arena);
-            tmp->CopyFrom(*d1 - *d2);
-            return CelValue::CreateDuration(tmp);
+          [options](Arena* arena, absl::Duration d1, absl::Duration d2) {
+            return DurationValue(arena, d1 - d2, options);
           },
           registry);
   if (!util::IsOk(status)) return status;
@@ -1068,19 +934,12 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
                                                          ConcatList, registry);
   if (!util::IsOk(status)) return status;
 
-  // Global matches function.
-  status = FunctionAdapter<
-      CelValue, CelValue::StringHolder,
-      CelValue::StringHolder>::CreateAndRegister(builtin::kRegexMatch, false,
-                                                 RegexMatches, registry);
-  if (!util::IsOk(status)) return status;
-
-  // Receiver-style matches function.
-  status = FunctionAdapter<
-      CelValue, CelValue::StringHolder,
-      CelValue::StringHolder>::CreateAndRegister(builtin::kRegexMatch, true,
-                                                 RegexMatches, registry);
-  if (!util::IsOk(status)) return status;
+  // Global and receiver-style matches functions.
+  for (bool receiver_style : {false, true}) {
+    status = registry->Register(absl::make_unique<RegexMatchFunction>(
+        receiver_style, RegexCache::Global()));
+    if (!util::IsOk(status)) return status;
+  }
 
   status =
       FunctionAdapter<bool, CelValue::StringHolder, CelValue::StringHolder>::
@@ -1131,187 +990,42 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
   //
   // timestamp() conversion from string..
   status = FunctionAdapter<CelValue, CelValue::StringHolder>::CreateAndRegister(
-      builtin::kTimestamp, false, CreateTimestampFromString, registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kFullYear, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetFullYear(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kFullYear, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetFullYear(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kMonth, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetMonth(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kMonth, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetMonth(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kDayOfYear, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetDayOfYear(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kDayOfYear, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetDayOfYear(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kDayOfMonth, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetDayOfMonth(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kDayOfMonth, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetDayOfMonth(arena, ts, "");
+      builtin::kTimestamp, false,
+      [options](Arena* arena, CelValue::StringHolder time_str) {
+        return CreateTimestampFromString(arena, time_str, options);
       },
       registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kDate, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetDate(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kDate, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetDate(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kDayOfWeek, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetDayOfWeek(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kDayOfWeek, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetDayOfWeek(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kHours, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetHours(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kHours, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetHours(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kMinutes, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetMinutes(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kMinutes, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetMinutes(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kSeconds, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetSeconds(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kSeconds, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetSeconds(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*, CelValue::StringHolder>::
-      CreateAndRegister(builtin::kMilliseconds, true,
-                        [](Arena* arena, const Timestamp* ts,
-                           CelValue::StringHolder tz) -> CelValue {
-                          return GetMilliseconds(arena, ts, tz.value());
-                        },
-                        registry);
-  if (!util::IsOk(status)) return status;
-
-  status = FunctionAdapter<CelValue, const Timestamp*>::CreateAndRegister(
-      builtin::kMilliseconds, true,
-      [](Arena* arena, const Timestamp* ts) -> CelValue {
-        return GetMilliseconds(arena, ts, "");
-      },
-      registry);
-  if (!util::IsOk(status)) return status;
+  // Timestamp accessors, with and without the time zone argument.
+  const std::vector<
+      std::pair<const char*, TimestampAccessorFunction::Extractor>>
+      accessors = {
+          {builtin::kFullYear, GetFullYear},
+          {builtin::kMonth, GetMonth},
+          {builtin::kDayOfYear, GetDayOfYear},
+          {builtin::kDayOfMonth, GetDayOfMonth},
+          {builtin::kDate, GetDate},
+          {builtin::kDayOfWeek, GetDayOfWeek},
+          {builtin::kHours, GetHours},
+          {builtin::kMinutes, GetMinutes},
+          {builtin::kSeconds, GetSeconds},
+          {builtin::kMilliseconds, GetMilliseconds},
+      };
+  for (const auto& accessor : accessors) {
+    for (bool with_time_zone : {true, false}) {
+      status = registry->Register(absl::make_unique<TimestampAccessorFunction>(
+          accessor.first, with_time_zone, accessor.second));
+      if (!util::IsOk(status)) return status;
+    }
+  }
 
   // type conversion to int
   // TODO(issues/26): To return errors on loss of precision
   // (overflow/underflow) by returning StatusOr<RawType>.
-  status = FunctionAdapter<int64_t, const Timestamp*>::CreateAndRegister(
+  status = FunctionAdapter<int64_t, absl::Time>::CreateAndRegister(
       builtin::kInt, false,
-      [](Arena* arena, const Timestamp* t) {
-        return TimeUtil::TimestampToSeconds(*t);
-      },
+      [](Arena* arena, absl::Time t) { return absl::ToUnixSeconds(t); },
       registry);
   if (!util::IsOk(status)) return status;
 
@@ -1334,36 +1048,40 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
 
   // duration() conversion from string..
   status = FunctionAdapter<CelValue, CelValue::StringHolder>::CreateAndRegister(
-      builtin::kDuration, false, CreateDurationFromString, registry);
+      builtin::kDuration, false,
+      [options](Arena* arena, CelValue::StringHolder time_str) {
+        return CreateDurationFromString(arena, time_str, options);
+      },
+      registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*>::CreateAndRegister(
+  status = FunctionAdapter<CelValue, absl::Duration>::CreateAndRegister(
       builtin::kHours, true,
-      [](Arena* arena, const Duration* d) -> CelValue {
+      [](Arena* arena, absl::Duration d) -> CelValue {
         return GetHours(arena, d);
       },
       registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*>::CreateAndRegister(
+  status = FunctionAdapter<CelValue, absl::Duration>::CreateAndRegister(
       builtin::kMinutes, true,
-      [](Arena* arena, const Duration* d) -> CelValue {
+      [](Arena* arena, absl::Duration d) -> CelValue {
         return GetMinutes(arena, d);
       },
       registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*>::CreateAndRegister(
+  status = FunctionAdapter<CelValue, absl::Duration>::CreateAndRegister(
       builtin::kSeconds, true,
-      [](Arena* arena, const Duration* d) -> CelValue {
+      [](Arena* arena, absl::Duration d) -> CelValue {
         return GetSeconds(arena, d);
       },
       registry);
   if (!util::IsOk(status)) return status;
 
-  status = FunctionAdapter<CelValue, const Duration*>::CreateAndRegister(
+  status = FunctionAdapter<CelValue, absl::Duration>::CreateAndRegister(
       builtin::kMilliseconds, true,
-      [](Arena* arena, const Duration* d) -> CelValue {
+      [](Arena* arena, absl::Duration d) -> CelValue {
         return GetMilliseconds(arena, d);
       },
       registry);
@@ -1418,6 +1136,22 @@ util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
   return util::OkStatus();
 }
 
+}  // namespace
+
+util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry) {
+  return RegisterBuiltinFunctions(registry, BuiltinFunctionOptions());
+}
+
+util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry,
+                                      const BuiltinFunctionOptions& options) {
+  // Builtin functions have no side effects.
+  bool register_pure = registry->register_pure();
+  registry->set_register_pure(true);
+  util::Status status = RegisterBuiltinOverloads(registry, options);
+  registry->set_register_pure(register_pure);
+  return status;
+}
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
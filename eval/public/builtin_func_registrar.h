@@ -8,8 +8,22 @@ namespace api {
 namespace expr {
 namespace runtime {
 
+// Options of the builtin functions.
+struct BuiltinFunctionOptions {
+  // Durations and timestamps computed by the builtin functions (arithmetic,
+  // duration() and timestamp() conversions) are held by value in CelValue,
+  // instead of referencing messages allocated in the arena. This saves an
+  // allocation per result, but CelValue::DurationOrDie() and TimestampOrDie()
+  // fail on these values: callers use AbslDurationOrDie() and
+  // AbslTimestampOrDie() instead.
+  bool inline_time_values = false;
+};
+
 util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry);
 
+util::Status RegisterBuiltinFunctions(CelFunctionRegistry* registry,
+                                      const BuiltinFunctionOptions& options);
+
 }  // namespace runtime
 }  // namespace expr
 }  // namespace api
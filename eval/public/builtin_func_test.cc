@@ -4,6 +4,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/strings/str_cat.h"
+#include "eval/eval/typed_list_impl.h"
 #include "eval/public/activation.h"
 #include "eval/public/cel_builtins.h"
 #include "eval/public/cel_expr_builder_factory.h"
@@ -65,7 +66,8 @@ class BuiltinsTest : public ::testing::Test {
         CreateCelExpressionBuilder();
 
     // Builtin registration.
-    ASSERT_TRUE(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+    ASSERT_TRUE(util::IsOk(
+        RegisterBuiltinFunctions(builder->GetRegistry(), options_)));
 
     // Create CelExpression from AST (Expr object).
     auto cel_expression_status = builder->CreateExpression(&expr, &source_info);
@@ -281,6 +283,9 @@ class BuiltinsTest : public ::testing::Test {
   // Function registry object
   CelFunctionRegistry registry_;
 
+  // Options of the builtin functions registered by PerformRun.
+  BuiltinFunctionOptions options_;
+
   // Arena
   Arena arena_;
 };
@@ -421,6 +426,63 @@ TEST_F(BuiltinsTest, TestTimestampDurationArithmeticalOperation) {
   ASSERT_EQ(result_value.DurationOrDie()->nanos(), d0.nanos());
 }
 
+// Durations and timestamps computed by builtins are held by value, when
+// requested.
+TEST_F(BuiltinsTest, TestInlineTimeValues) {
+  options_.inline_time_values = true;
+  CelValue result_value;
+
+  Timestamp ts0, ts1;
+  ts0.set_seconds(100);
+  ts1.set_seconds(10);
+  ASSERT_NO_FATAL_FAILURE(PerformRun(builtin::kSubtract, {},
+                                     {CelValue::CreateTimestamp(&ts0),
+                                      CelValue::CreateTimestamp(&ts1)},
+                                     &result_value));
+  ASSERT_TRUE(result_value.IsDuration());
+  EXPECT_FALSE(result_value.HasTimeMessage());
+  EXPECT_EQ(result_value.AbslDurationOrDie(), absl::Seconds(90));
+
+  ASSERT_NO_FATAL_FAILURE(
+      PerformRun(builtin::kAdd, {},
+                 {CelValue::CreateTimestamp(&ts1),
+                  CelValue::CreateDuration(absl::Seconds(90))},
+                 &result_value));
+  ASSERT_TRUE(result_value.IsTimestamp());
+  EXPECT_FALSE(result_value.HasTimeMessage());
+  EXPECT_EQ(result_value.AbslTimestampOrDie(), absl::FromUnixSeconds(100));
+
+  // Messages are created by default.
+  options_.inline_time_values = false;
+  ASSERT_NO_FATAL_FAILURE(
+      PerformRun(builtin::kAdd, {},
+                 {CelValue::CreateTimestamp(&ts1),
+                  CelValue::CreateDuration(absl::Seconds(90))},
+                 &result_value));
+  ASSERT_TRUE(result_value.IsTimestamp());
+  EXPECT_EQ(result_value.TimestampOrDie()->seconds(), 100);
+
+  // Negative durations are encoded with non-positive nanos.
+  ASSERT_NO_FATAL_FAILURE(PerformRun(
+      builtin::kSubtract, {},
+      {CelValue::CreateDuration(absl::Seconds(1)),
+       CelValue::CreateDuration(absl::Seconds(2) + absl::Nanoseconds(5))},
+      &result_value));
+  ASSERT_TRUE(result_value.IsDuration());
+  EXPECT_EQ(result_value.DurationOrDie()->seconds(), -1);
+  EXPECT_EQ(result_value.DurationOrDie()->nanos(), -5);
+
+  // Values out of the range of the messages are errors.
+  Timestamp max_ts;
+  max_ts.set_seconds(253402300799);
+  ASSERT_NO_FATAL_FAILURE(
+      PerformRun(builtin::kAdd, {},
+                 {CelValue::CreateTimestamp(&max_ts),
+                  CelValue::CreateDuration(absl::Seconds(1))},
+                 &result_value));
+  EXPECT_TRUE(result_value.IsError());
+}
+
 // Test functions for Duration
 TEST_F(BuiltinsTest, TestDurationFunctions) {
   Duration ref;
@@ -1144,6 +1206,41 @@ TEST_F(BuiltinsTest, TestConcatList) {
   }
 }
 
+TEST_F(BuiltinsTest, TestListEqual) {
+  std::string a = "a";
+  TypedListImpl<int64_t> typed_list(std::vector<int64_t>{1, 2});
+  TypedListImpl<int64_t> other_typed_list(std::vector<int64_t>{1, 3});
+  FakeList list({CelValue::CreateInt64(1), CelValue::CreateInt64(2)});
+  FakeList nested_list({CelValue::CreateList(&list), CelValue::CreateNull()});
+  FakeList other_nested_list(
+      {CelValue::CreateList(&typed_list), CelValue::CreateNull()});
+  FakeList mixed_list({CelValue::CreateInt64(1), CelValue::CreateString(&a)});
+
+  TestComparison(builtin::kEqual, CelValue::CreateList(&typed_list),
+                 CelValue::CreateList(&list), true);
+  TestComparison(builtin::kEqual, CelValue::CreateList(&typed_list),
+                 CelValue::CreateList(&other_typed_list), false);
+  TestComparison(builtin::kInequal, CelValue::CreateList(&typed_list),
+                 CelValue::CreateList(&other_typed_list), true);
+  TestComparison(builtin::kEqual, CelValue::CreateList(&nested_list),
+                 CelValue::CreateList(&other_nested_list), true);
+  // Lists of different sizes are not equal.
+  FakeList longer_list({CelValue::CreateInt64(1), CelValue::CreateInt64(2),
+                        CelValue::CreateInt64(3)});
+  TestComparison(builtin::kEqual, CelValue::CreateList(&list),
+                 CelValue::CreateList(&longer_list), false);
+
+  // Elements of different types are not compared.
+  CelValue result_value;
+  ASSERT_NO_FATAL_FAILURE(PerformRun(
+      builtin::kEqual, {},
+      {CelValue::CreateList(&list), CelValue::CreateList(&mixed_list)},
+      &result_value));
+  ASSERT_TRUE(result_value.IsError());
+  EXPECT_EQ(result_value.ErrorOrDie()->code(),
+            CelError::Code::CelError_Code_NO_MATCHING_OVERLOAD);
+}
+
 TEST_F(BuiltinsTest, MatchesTrue) {
   std::string target = "haystack";
   std::string regex = "hay\\w{2}ack";
@@ -0,0 +1,32 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_EXECUTOR_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_EXECUTOR_H_
+
+#include <functional>
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// CelExecutor runs tasks of parallel expression evaluation. It is supplied by
+// the caller, typically on top of a thread pool shared with other work.
+// Evaluation waits for the scheduled tasks to complete, while running one of
+// them on the calling thread.
+class CelExecutor {
+ public:
+  virtual ~CelExecutor() {}
+
+  // Schedules the task to run, possibly concurrently with other tasks.
+  virtual void Schedule(std::function<void()> task) = 0;
+
+  // Number of tasks that can run concurrently. Work is split into chunks
+  // according to it.
+  virtual int concurrency() const = 0;
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_EXECUTOR_H_
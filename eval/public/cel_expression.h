@@ -2,10 +2,14 @@
 #define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_EXPRESSION_H_
 
 #include <functional>
+#include <memory>
 
+#include "google/protobuf/field_mask.pb.h"
 #include "eval/public/activation.h"
 #include "eval/public/cel_function.h"
 #include "eval/public/cel_value.h"
+#include "absl/memory/memory.h"
+#include "google/api/expr/v1alpha1/checked.pb.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
 
 namespace google {
@@ -23,6 +27,28 @@ namespace runtime {
 using CelEvaluationListener = std::function<util::Status(
     const google::api::expr::v1alpha1::Expr*, const CelValue&, google::protobuf::Arena*)>;
 
+// Evaluation state that can be reused across evaluations of an expression.
+// Holds internal buffers (e.g. the value stack), so that repeated
+// evaluations do not need to allocate them.
+// State is created by CelExpression::InitializeState and may only be used
+// with the expression that created it, by one evaluation at a time.
+class CelEvaluationState {
+ public:
+  virtual ~CelEvaluationState() {}
+};
+
+// Evaluation state created by the default CelExpression::InitializeState,
+// for expressions that have no buffers to reuse. Holds only the arena.
+class CelArenaEvaluationState : public CelEvaluationState {
+ public:
+  explicit CelArenaEvaluationState(google::protobuf::Arena* arena) : arena_(arena) {}
+
+  google::protobuf::Arena* arena() const { return arena_; }
+
+ private:
+  google::protobuf::Arena* arena_;
+};
+
 // Base interface for expression evaluating objects.
 class CelExpression {
  public:
@@ -39,6 +65,70 @@ class CelExpression {
   virtual util::StatusOr<CelValue> Trace(
       const Activation& activation, google::protobuf::Arena* arena,
       CelEvaluationListener callback) const = 0;
+
+  // Creates evaluation state that can be passed to Evaluate and Trace.
+  // arena parameter specifies Arena object where output results and
+  // internal data will be allocated by evaluations using the state.
+  // By default, the state only holds the arena.
+  virtual std::unique_ptr<CelEvaluationState> InitializeState(
+      google::protobuf::Arena* arena) const {
+    return absl::make_unique<CelArenaEvaluationState>(arena);
+  }
+
+  // Evaluates expression and returns value, reusing buffers held by state.
+  // The state is reset at the start of the evaluation.
+  // Values produced by the previous evaluation remain valid as long as
+  // the arena of the state is alive.
+  // By default, forwards to Evaluate with the arena of the state created by
+  // the default InitializeState. Returns INVALID_ARGUMENT for other states.
+  virtual util::StatusOr<CelValue> Evaluate(const Activation& activation,
+                                            CelEvaluationState* state) const {
+    auto arena_state = dynamic_cast<CelArenaEvaluationState*>(state);
+    if (arena_state == nullptr) {
+      return InvalidStateError();
+    }
+    return Evaluate(activation, arena_state->arena());
+  }
+
+  // Trace evaluates expression calling the callback on each sub-tree,
+  // reusing buffers held by state.
+  // By default, forwards to Trace with the arena of the state created by
+  // the default InitializeState. Returns INVALID_ARGUMENT for other states.
+  virtual util::StatusOr<CelValue> Trace(
+      const Activation& activation, CelEvaluationState* state,
+      CelEvaluationListener callback) const {
+    auto arena_state = dynamic_cast<CelArenaEvaluationState*>(state);
+    if (arena_state == nullptr) {
+      return InvalidStateError();
+    }
+    return Trace(activation, arena_state->arena(), std::move(callback));
+  }
+
+  // Returns names of free variables referenced by the expression.
+  // Position of the name in the list is the slot assigned to the variable
+  // at build time. Values can be bound to the slots with SlotActivation
+  // created for this list.
+  virtual const std::vector<std::string>& variable_slots() const {
+    static const std::vector<std::string>* kNoSlots =
+        new std::vector<std::string>();
+    return *kNoSlots;
+  }
+
+  // Returns the paths of the variables and fields referenced by the
+  // expression, see FindReferencedPaths(), or nullptr if the builder did not
+  // find them. Callers may bind or decode only these fields.
+  virtual const google::protobuf::FieldMask* referenced_paths() const {
+    return nullptr;
+  }
+
+ protected:
+  // Error of evaluations with a state not created by InitializeState of the
+  // expression.
+  static util::Status InvalidStateError() {
+    return util::MakeStatus(
+        google::rpc::Code::INVALID_ARGUMENT,
+        "Evaluation state was created by another expression");
+  }
 };
 
 // Base class for Expression Builder implementations
@@ -58,6 +148,16 @@ class CelExpressionBuilder {
       const google::api::expr::v1alpha1::Expr* expr,
       const google::api::expr::v1alpha1::SourceInfo* source_info) const = 0;
 
+  // Creates CelExpression object from type-checked AST.
+  // Implementations may use the types and references inferred by the checker
+  // to resolve function overloads at build time. By default, the checked
+  // expression is treated as unchecked one.
+  virtual util::StatusOr<std::unique_ptr<CelExpression>> CreateExpression(
+      const google::api::expr::v1alpha1::CheckedExpr* checked_expr) const {
+    return CreateExpression(&checked_expr->expr(),
+                            &checked_expr->source_info());
+  }
+
   // CelFunction registry. Extension function should be registered with it
   // prior to expression creation.
   CelFunctionRegistry* GetRegistry() const { return registry_.get(); }
@@ -5,6 +5,55 @@ namespace api {
 namespace expr {
 namespace runtime {
 
+namespace {
+
+static_assert(static_cast<int>(CelValue::Type::kAny) <
+                  (1 << CelFunction::kTypeBits),
+              "CelValue types do not fit into packed argument types");
+
+constexpr int kArityShift = 56;
+constexpr uint64_t kTypeMask = (1 << CelFunction::kTypeBits) - 1;
+
+// Packs argument types, zeroing out kAny types. Sets the bits of kAny types
+// in *any_mask.
+uint64_t PackDescriptorTypes(const std::vector<CelValue::Type>& types,
+                             uint64_t* any_mask) {
+  uint64_t packed_types = static_cast<uint64_t>(types.size()) << kArityShift;
+  *any_mask = 0;
+  for (size_t i = 0; i < types.size(); i++) {
+    int shift = i * CelFunction::kTypeBits;
+    if (types[i] == CelValue::Type::kAny) {
+      *any_mask |= kTypeMask << shift;
+    } else {
+      packed_types |= static_cast<uint64_t>(types[i]) << shift;
+    }
+  }
+  return packed_types;
+}
+
+}  // namespace
+
+CelFunction::CelFunction(const Descriptor& descriptor)
+    : descriptor_(descriptor) {
+  if (descriptor_.types.size() <= kMaxPackedArguments) {
+    packed_types_ = PackDescriptorTypes(descriptor_.types, &any_mask_);
+  } else {
+    // Packed types of arguments never have all bits set.
+    packed_types_ = ~uint64_t{0};
+    any_mask_ = 0;
+  }
+}
+
+uint64_t CelFunction::PackTypes(absl::Span<const CelValue> arguments) {
+  uint64_t packed_types = static_cast<uint64_t>(arguments.size())
+                          << kArityShift;
+  for (size_t i = 0; i < arguments.size(); i++) {
+    packed_types |= static_cast<uint64_t>(arguments[i].type())
+                    << (i * kTypeBits);
+  }
+  return packed_types;
+}
+
 bool CelFunction::MatchArguments(absl::Span<const CelValue> arguments) const {
   int types_size = descriptor().types.size();
 
@@ -12,6 +61,10 @@ bool CelFunction::MatchArguments(absl::Span<const CelValue> arguments) const {
     return false;
   }
 
+  if (types_size <= kMaxPackedArguments) {
+    return MatchPackedTypes(PackTypes(arguments));
+  }
+
   for (int i = 0; i < types_size; i++) {
     const auto& value = arguments[i];
     CelValue::Type arg_type = descriptor().types[i];
@@ -26,17 +79,28 @@ bool CelFunction::MatchArguments(absl::Span<const CelValue> arguments) const {
 util::Status CelFunctionRegistry::Register(
     std::unique_ptr<CelFunction> function) {
   const CelFunction::Descriptor& descriptor = function->descriptor();
+  int arity = descriptor.types.size();
 
-  if (!FindOverloads(descriptor.name, descriptor.receiver_style,
-                     descriptor.types)
-           .empty()) {
+  auto overloads =
+      functions_.find(OverloadKeyView(descriptor.name,
+                                      descriptor.receiver_style, arity));
+  if (overloads == functions_.end()) {
+    overloads =
+        functions_
+            .emplace(OverloadKey{descriptor.name, descriptor.receiver_style,
+                                 arity},
+                     Overloads())
+            .first;
+  } else if (!FindOverloads(descriptor.name, descriptor.receiver_style,
+                            descriptor.types)
+                  .empty()) {
     return util::MakeStatus(
         google::rpc::Code::ALREADY_EXISTS,
         "CelFunction with specified parameters already registered");
   }
 
-  auto& overloads = functions_[descriptor.name];
-  overloads.push_back(std::move(function));
+  function->pure_ = register_pure_;
+  overloads->second.push_back(std::move(function));
   return util::OkStatus();
 }
 
@@ -47,21 +111,27 @@ std::vector<const CelFunction*> CelFunctionRegistry::FindOverloads(
 
   int types_size = types.size();
 
-  auto overloads = functions_.find(std::string(name));
+  auto overloads =
+      functions_.find(OverloadKeyView(name, receiver_style, types_size));
   if (overloads == functions_.end()) {
     return matched_funcs;
   }
 
-  for (const auto& func_ptr : overloads->second) {
-    const CelFunction::Descriptor& other_desc = func_ptr->descriptor();
-    if (other_desc.receiver_style != receiver_style) {
-      continue;
-    }
-
-    if (other_desc.types.size() != types_size) {
-      continue;
+  if (types_size <= CelFunction::kMaxPackedArguments) {
+    // Types match if they are equal where neither of them is kAny.
+    uint64_t any_mask;
+    uint64_t packed_types = PackDescriptorTypes(types, &any_mask);
+    for (const auto& func_ptr : overloads->second) {
+      if (((packed_types ^ func_ptr->packed_types_) &
+           ~(any_mask | func_ptr->any_mask_)) == 0) {
+        matched_funcs.push_back(func_ptr.get());
+      }
     }
+    return matched_funcs;
+  }
 
+  for (const auto& func_ptr : overloads->second) {
+    const CelFunction::Descriptor& other_desc = func_ptr->descriptor();
     bool arg_match = true;
     for (int i = 0; i < types_size; i++) {
       CelValue::Type type0 = types[i];
@@ -87,12 +157,10 @@ CelFunctionRegistry::ListFunctions() const {
       descriptor_map;
 
   for (const auto& entry : functions_) {
-    std::vector<const CelFunction::Descriptor*> descriptors;
-    descriptors.reserve(entry.second.size());
+    auto& descriptors = descriptor_map[entry.first.name];
     for (const auto& func : entry.second) {
       descriptors.push_back(&func->descriptor());
     }
-    descriptor_map[entry.first] = std::move(descriptors);
   }
 
   return descriptor_map;
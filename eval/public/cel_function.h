@@ -1,7 +1,11 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_FUNCTION_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_FUNCTION_H_
 
+#include <tuple>
+
 #include "absl/container/node_hash_map.h"
+#include "absl/hash/hash.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "eval/public/cel_value.h"
 
@@ -32,9 +36,15 @@ class CelFunction {
     std::vector<CelValue::Type> types;
   };
 
+  // Argument types of functions with up to kMaxPackedArguments arguments
+  // are packed into a single word: kTypeBits bits per argument, with the
+  // number of arguments in the top byte. Matching arguments against such
+  // signature is then a single comparison.
+  static constexpr int kTypeBits = 4;
+  static constexpr int kMaxPackedArguments = 14;
+
   // Build CelFunction from descriptor
-  explicit CelFunction(const Descriptor& descriptor)
-      : descriptor_(descriptor) {}
+  explicit CelFunction(const Descriptor& descriptor);
 
   // Non-copyable
   CelFunction(const CelFunction& other) = delete;
@@ -61,11 +71,33 @@ class CelFunction {
   // Method is called during runtime.
   bool MatchArguments(absl::Span<const CelValue> arguments) const;
 
+  // Determines whether instance of CelFunction is applicable to arguments
+  // with the packed types (see PackTypes). Never matches arguments of
+  // functions with more than kMaxPackedArguments arguments.
+  bool MatchPackedTypes(uint64_t packed_types) const {
+    return (packed_types & ~any_mask_) == packed_types_;
+  }
+
+  // Packs types of the arguments. Must not be called with more than
+  // kMaxPackedArguments arguments.
+  static uint64_t PackTypes(absl::Span<const CelValue> arguments);
+
   // CelFunction descriptor
   const Descriptor& descriptor() const { return descriptor_; }
 
+  // Whether the function was registered as pure, see
+  // CelFunctionRegistry::set_register_pure.
+  bool pure() const { return pure_; }
+
  private:
+  friend class CelFunctionRegistry;
+
   Descriptor descriptor_;
+  bool pure_ = false;
+  // Packed descriptor types, with kAny types zeroed out.
+  uint64_t packed_types_;
+  // Bits of packed types that are not compared, as the type is kAny.
+  uint64_t any_mask_;
 };
 
 // CelFunctionRegistry class allows to register builtin or custom
@@ -73,8 +105,20 @@ class CelFunction {
 // CelExpression objects from Expr ASTs.
 class CelFunctionRegistry {
  public:
+  CelFunctionRegistry() : register_pure_(false) {}
+
   ~CelFunctionRegistry() {}
 
+  // set_register_pure marks the functions registered from now on as pure:
+  // they have no side effects, their results depend only on their
+  // arguments, and they can be called concurrently. Builders may evaluate
+  // calls to pure functions with constant arguments at build time, or
+  // evaluate calls from comprehensions in parallel.
+  // Builtin functions are registered as pure by RegisterBuiltinFunctions.
+  // By default functions are not registered as pure.
+  void set_register_pure(bool enabled) { register_pure_ = enabled; }
+  bool register_pure() const { return register_pure_; }
+
   // Register CelFunction object. Object ownership is
   // passed to registry.
   // Function registration should be performed prior to
@@ -97,9 +141,47 @@ class CelFunctionRegistry {
   ListFunctions() const;
 
  private:
+  // Overloads are indexed by name, receiver style and number of arguments.
+  // Lookups use OverloadKeyView, so that no string is built for them.
+  struct OverloadKey {
+    std::string name;
+    bool receiver_style;
+    int arity;
+  };
+
+  struct OverloadKeyView {
+    OverloadKeyView(absl::string_view name, bool receiver_style, int arity)
+        : name(name), receiver_style(receiver_style), arity(arity) {}
+    OverloadKeyView(const OverloadKey& key)  // NOLINT: implicit conversion
+        : name(key.name), receiver_style(key.receiver_style), arity(key.arity) {}
+
+    absl::string_view name;
+    bool receiver_style;
+    int arity;
+  };
+
+  struct OverloadKeyHash {
+    using is_transparent = void;
+    size_t operator()(OverloadKeyView key) const {
+      return absl::Hash<std::tuple<absl::string_view, bool, int>>()(
+          std::make_tuple(key.name, key.receiver_style, key.arity));
+    }
+  };
+
+  struct OverloadKeyEq {
+    using is_transparent = void;
+    bool operator()(OverloadKeyView key1, OverloadKeyView key2) const {
+      return key1.name == key2.name &&
+             key1.receiver_style == key2.receiver_style &&
+             key1.arity == key2.arity;
+    }
+  };
+
   using Overloads = std::vector<std::unique_ptr<CelFunction>>;
 
-  absl::node_hash_map<std::string, Overloads> functions_;
+  absl::node_hash_map<OverloadKey, Overloads, OverloadKeyHash, OverloadKeyEq>
+      functions_;
+  bool register_pure_;
 };
 
 }  // namespace runtime
@@ -12,6 +12,17 @@ absl::optional<CelValue::Type> TypeCodeMatch<CelValue>() {
   return CelValue::Type::kAny;
 }
 
+template <>
+absl::optional<CelValue::Type>
+TypeCodeMatch<const google::protobuf::Duration*>() {
+  return CelValue::Type::kDuration;
+}
+
+template <>
+absl::optional<CelValue::Type>
+TypeCodeMatch<const google::protobuf::Timestamp*>() {
+  return CelValue::Type::kTimestamp;
+}
 
 }  // namespace internal
 
@@ -1,14 +1,19 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_FUNCTION_ADAPTER_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_FUNCTION_ADAPTER_H_
 #include <functional>
+#include <tuple>
 
 #include "google/protobuf/duration.pb.h"
 #include "google/protobuf/timestamp.pb.h"
+#include "absl/base/attributes.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "absl/utility/utility.h"
 #include "eval/proto/cel_error.pb.h"
 #include "eval/public/cel_function.h"
 #include "google/rpc/status.pb.h"
 #include "eval/public/cel_status_or.h"
+#include "internal/proto_util.h"
 
 namespace google {
 namespace api {
@@ -36,6 +41,15 @@ absl::optional<CelValue::Type> TypeCodeMatch() {
 template <>
 absl::optional<CelValue::Type> TypeCodeMatch<CelValue>();
 
+// Durations and timestamps are passed either as absl values or as messages.
+template <>
+absl::optional<CelValue::Type>
+TypeCodeMatch<const google::protobuf::Duration*>();
+
+template <>
+absl::optional<CelValue::Type>
+TypeCodeMatch<const google::protobuf::Timestamp*>();
+
 template <int N>
 bool AddType(CelFunction::Descriptor* descriptor) {
   return true;
@@ -119,33 +133,6 @@ class FunctionAdapter : public CelFunction {
     return registry->Register(std::move(status.ValueOrDie()));
   }
 
-  util::Status RunWrap(std::function<ReturnType()> func,
-                       const absl::Span<const CelValue> argset,
-                       ::google::protobuf::Arena* arena, CelValue* result,
-                       int arg_index) const {
-    return CreateReturnValue(func(), arena, result);
-  }
-
-  template <typename Arg, typename... Args>
-  util::Status RunWrap(std::function<ReturnType(Arg, Args...)> func,
-                       const absl::Span<const CelValue> argset,
-                       ::google::protobuf::Arena* arena, CelValue* result,
-                       int arg_index) const {
-    Arg argument;
-    if (!ConvertFromValue(argset[arg_index], &argument)) {
-      return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
-                          "Type conversion failed");
-    }
-
-    std::function<ReturnType(Args...)> wrapped_func =
-        [func, argument](Args... args) -> ReturnType {
-      return func(argument, args...);
-    };
-
-    return RunWrap(std::move(wrapped_func), argset, arena, result,
-                   arg_index + 1);
-  }
-
   util::Status Evaluate(absl::Span<const CelValue> arguments,
                           CelValue* result,
                           ::google::protobuf::Arena* arena) const override {
@@ -154,29 +141,81 @@ class FunctionAdapter : public CelFunction {
                           "Argument number mismatch");
     }
 
-    const auto* handler = &handler_;
-    // Replace witj bind_front(std::cref(handler_), arena), when it is
-    // available.
-    std::function<ReturnType(Arguments...)> wrapped_handler =
-        [handler, arena](Arguments... args) -> ReturnType {
-      return (*handler)(arena, args...);
-    };
-
-    return RunWrap(std::move(wrapped_handler), arguments, arena, result, 0);
+    return RunWrap(arguments, arena, result,
+                   absl::index_sequence_for<Arguments...>());
   }
 
  private:
+  // Converts arguments to native types and invokes the handler directly,
+  // so that the call does not allocate. argset is unused by handlers without
+  // arguments.
+  template <size_t... Is>
+  util::Status RunWrap(
+      ABSL_ATTRIBUTE_UNUSED absl::Span<const CelValue> argset,
+      ::google::protobuf::Arena* arena, CelValue* result,
+      absl::index_sequence<Is...>) const {
+    std::tuple<Arguments...> native_args;
+    bool converted[] = {
+        true,
+        ConvertFromValue(argset[Is], arena, &std::get<Is>(native_args))...};
+    for (bool arg_converted : converted) {
+      if (!arg_converted) {
+        return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                            "Type conversion failed");
+      }
+    }
+
+    return CreateReturnValue(handler_(arena, std::get<Is>(native_args)...),
+                             arena, result);
+  }
+
   template <class ArgType>
-  static bool ConvertFromValue(CelValue value, ArgType* result) {
+  static bool ConvertFromValue(CelValue value, ::google::protobuf::Arena* arena,
+                               ArgType* result) {
     return value.GetValue(result);
   }
 
   // Special conversion - from CelValue to CelValue - plain copy
-  static bool ConvertFromValue(CelValue value, CelValue* result) {
+  static bool ConvertFromValue(CelValue value, ::google::protobuf::Arena* arena,
+                               CelValue* result) {
     *result = std::move(value);
     return true;
   }
 
+  // Durations and timestamps held by value are copied to messages allocated
+  // in the arena. Values out of the range of the messages fail conversion.
+  static bool ConvertFromValue(CelValue value, ::google::protobuf::Arena* arena,
+                               const ::google::protobuf::Duration** result) {
+    if (!value.IsDuration()) {
+      return false;
+    }
+    if (value.HasTimeMessage()) {
+      *result = value.DurationOrDie();
+      return true;
+    }
+    auto duration =
+        ::google::protobuf::Arena::CreateMessage<::google::protobuf::Duration>(arena);
+    *result = duration;
+    return util::IsOk(
+        expr::internal::EncodeDuration(value.AbslDurationOrDie(), duration));
+  }
+
+  static bool ConvertFromValue(CelValue value, ::google::protobuf::Arena* arena,
+                               const ::google::protobuf::Timestamp** result) {
+    if (!value.IsTimestamp()) {
+      return false;
+    }
+    if (value.HasTimeMessage()) {
+      *result = value.TimestampOrDie();
+      return true;
+    }
+    auto timestamp =
+        ::google::protobuf::Arena::CreateMessage<::google::protobuf::Timestamp>(arena);
+    *result = timestamp;
+    return util::IsOk(
+        expr::internal::EncodeTime(value.AbslTimestampOrDie(), timestamp));
+  }
+
   // CreateReturnValue method wraps evaluation result with CelValue.
   static util::Status CreateReturnValue(bool value, ::google::protobuf::Arena* arena,
                                         CelValue* result) {
@@ -216,6 +255,42 @@ class FunctionAdapter : public CelFunction {
     return util::OkStatus();
   }
 
+  static util::Status CreateReturnValue(absl::Duration value,
+                                        ::google::protobuf::Arena* arena,
+                                        CelValue* result) {
+    *result = CelValue::CreateDuration(value);
+    return util::OkStatus();
+  }
+
+  static util::Status CreateReturnValue(absl::Time value,
+                                        ::google::protobuf::Arena* arena,
+                                        CelValue* result) {
+    *result = CelValue::CreateTimestamp(value);
+    return util::OkStatus();
+  }
+
+  static util::Status CreateReturnValue(const ::google::protobuf::Duration* value,
+                                        ::google::protobuf::Arena* arena,
+                                        CelValue* result) {
+    if (value == nullptr) {
+      return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                          "Null Duration pointer returned");
+    }
+    *result = CelValue::CreateDuration(value);
+    return util::OkStatus();
+  }
+
+  static util::Status CreateReturnValue(const ::google::protobuf::Timestamp* value,
+                                        ::google::protobuf::Arena* arena,
+                                        CelValue* result) {
+    if (value == nullptr) {
+      return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                          "Null Timestamp pointer returned");
+    }
+    *result = CelValue::CreateTimestamp(value);
+    return util::OkStatus();
+  }
+
   static util::Status CreateReturnValue(const ::google::protobuf::Message* value,
                                         ::google::protobuf::Arena* arena,
                                         CelValue* result) {
@@ -165,6 +165,53 @@ TEST(CelFunctionAdapterTest, TestTypeDeductionForCelValueBasicTypes) {
   ASSERT_EQ(descriptor.types[pos++], CelValue::Type::kError);
 }
 
+TEST(CelFunctionAdapterTest, TestTypeDeductionForAbslTimeTypes) {
+  auto func = [](google::protobuf::Arena* arena, absl::Duration,
+                 absl::Time) -> bool { return false; };
+
+  auto func_status =
+      FunctionAdapter<bool, absl::Duration, absl::Time>::Create("dummy_func",
+                                                                false, func);
+
+  ASSERT_TRUE(util::IsOk(func_status));
+
+  auto descriptor = func_status.ValueOrDie()->descriptor();
+  ASSERT_EQ(descriptor.types.size(), 2);
+  ASSERT_EQ(descriptor.types[0], CelValue::Type::kDuration);
+  ASSERT_EQ(descriptor.types[1], CelValue::Type::kTimestamp);
+}
+
+// Durations held by value are passed to handlers taking messages as copies
+// allocated in the arena.
+TEST(CelFunctionAdapterTest, TestDurationMessageArgument) {
+  auto func = [](google::protobuf::Arena* arena,
+                 const google::protobuf::Duration* duration) -> int64_t {
+    return duration->seconds();
+  };
+
+  auto func_status =
+      FunctionAdapter<int64_t, const google::protobuf::Duration*>::Create(
+          "seconds", false, func);
+  ASSERT_TRUE(util::IsOk(func_status));
+  auto cel_func = std::move(func_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  CelValue result;
+  std::vector<CelValue> args = {CelValue::CreateDuration(absl::Seconds(5))};
+  ASSERT_TRUE(util::IsOk(cel_func->Evaluate(args, &result, &arena)));
+  EXPECT_EQ(result.Int64OrDie(), 5);
+
+  google::protobuf::Duration message;
+  message.set_seconds(7);
+  args = {CelValue::CreateDuration(&message)};
+  ASSERT_TRUE(util::IsOk(cel_func->Evaluate(args, &result, &arena)));
+  EXPECT_EQ(result.Int64OrDie(), 7);
+
+  // Out of the range of google.protobuf.Duration.
+  args = {CelValue::CreateDuration(absl::InfiniteDuration())};
+  EXPECT_FALSE(util::IsOk(cel_func->Evaluate(args, &result, &arena)));
+}
+
 }  // namespace
 
 }  // namespace runtime
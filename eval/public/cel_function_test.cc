@@ -0,0 +1,142 @@
+#include "eval/public/cel_function.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using testing::ElementsAre;
+using testing::Eq;
+using testing::IsEmpty;
+using testing::UnorderedElementsAre;
+
+class NullFunction : public CelFunction {
+ public:
+  explicit NullFunction(const Descriptor& descriptor)
+      : CelFunction(descriptor) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    *result = CelValue::CreateNull();
+    return util::OkStatus();
+  }
+};
+
+TEST(CelFunctionTest, MatchArguments) {
+  NullFunction function(
+      {"f", false, {CelValue::Type::kInt64, CelValue::Type::kAny}});
+
+  std::string str = "a";
+  std::vector<CelValue> args = {CelValue::CreateInt64(1),
+                                CelValue::CreateString(&str)};
+  EXPECT_TRUE(function.MatchArguments(args));
+  EXPECT_TRUE(function.MatchPackedTypes(CelFunction::PackTypes(args)));
+
+  args = {CelValue::CreateString(&str), CelValue::CreateInt64(1)};
+  EXPECT_FALSE(function.MatchArguments(args));
+  EXPECT_FALSE(function.MatchPackedTypes(CelFunction::PackTypes(args)));
+
+  // Number of arguments must match.
+  args = {CelValue::CreateInt64(1)};
+  EXPECT_FALSE(function.MatchArguments(args));
+  EXPECT_FALSE(function.MatchPackedTypes(CelFunction::PackTypes(args)));
+}
+
+TEST(CelFunctionTest, MatchArgumentsOfManyArgumentFunction) {
+  int arity = CelFunction::kMaxPackedArguments + 2;
+  std::vector<CelValue::Type> types(arity, CelValue::Type::kInt64);
+  types.back() = CelValue::Type::kAny;
+  NullFunction function({"f", false, types});
+
+  std::vector<CelValue> args(arity, CelValue::CreateInt64(1));
+  args.back() = CelValue::CreateBool(true);
+  EXPECT_TRUE(function.MatchArguments(args));
+
+  args.front() = CelValue::CreateBool(true);
+  EXPECT_FALSE(function.MatchArguments(args));
+}
+
+TEST(CelFunctionRegistryTest, FindOverloads) {
+  CelFunctionRegistry registry;
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kInt64}}))));
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kString}}))));
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", true, {CelValue::Type::kInt64}}))));
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{
+          "f", false, {CelValue::Type::kAny, CelValue::Type::kInt64}}))));
+
+  auto overloads = registry.FindOverloads("f", false, {CelValue::Type::kAny});
+  ASSERT_THAT(overloads.size(), Eq(2));
+
+  overloads = registry.FindOverloads("f", false, {CelValue::Type::kString});
+  ASSERT_THAT(overloads.size(), Eq(1));
+  EXPECT_THAT(overloads[0]->descriptor().types,
+              ElementsAre(CelValue::Type::kString));
+
+  overloads = registry.FindOverloads("f", true, {CelValue::Type::kAny});
+  ASSERT_THAT(overloads.size(), Eq(1));
+  EXPECT_TRUE(overloads[0]->descriptor().receiver_style);
+
+  overloads = registry.FindOverloads(
+      "f", false, {CelValue::Type::kBool, CelValue::Type::kInt64});
+  ASSERT_THAT(overloads.size(), Eq(1));
+
+  EXPECT_THAT(registry.FindOverloads("f", false, {CelValue::Type::kBool}),
+              IsEmpty());
+  EXPECT_THAT(registry.FindOverloads("g", false, {CelValue::Type::kAny}),
+              IsEmpty());
+
+  auto functions = registry.ListFunctions();
+  ASSERT_THAT(functions.size(), Eq(1));
+  EXPECT_THAT(functions["f"].size(), Eq(4));
+}
+
+TEST(CelFunctionRegistryTest, RegisterOverlappingOverload) {
+  CelFunctionRegistry registry;
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kInt64}}))));
+
+  // Overload accepting any type overlaps with the existing one.
+  EXPECT_FALSE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kAny}}))));
+  EXPECT_FALSE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kInt64}}))));
+
+  // Overloads with different receiver style or arity do not overlap.
+  EXPECT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", true, {CelValue::Type::kAny}}))));
+  EXPECT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{
+          "f", false, {CelValue::Type::kAny, CelValue::Type::kAny}}))));
+}
+
+TEST(CelFunctionRegistryTest, RegisterPure) {
+  CelFunctionRegistry registry;
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kInt64}}))));
+  registry.set_register_pure(true);
+  ASSERT_TRUE(util::IsOk(registry.Register(absl::make_unique<NullFunction>(
+      CelFunction::Descriptor{"f", false, {CelValue::Type::kString}}))));
+
+  auto impure = registry.FindOverloads("f", false, {CelValue::Type::kInt64});
+  ASSERT_THAT(impure.size(), Eq(1));
+  EXPECT_FALSE(impure[0]->pure());
+  auto pure = registry.FindOverloads("f", false, {CelValue::Type::kString});
+  ASSERT_THAT(pure.size(), Eq(1));
+  EXPECT_TRUE(pure[0]->pure());
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -26,7 +26,7 @@ inline google::rpc::Status OkStatus() {
   return ok;
 }
 
-inline bool IsOk(google::rpc::Status status) {
+inline bool IsOk(const google::rpc::Status& status) {
   return status.code() == google::rpc::Code::OK;
 }
 
@@ -80,6 +80,18 @@ class DynamicMap : public CelMap {
 
   const CelList* ListKeys() const override { return &key_list_; }
 
+  bool ForEach(absl::FunctionRef<bool(const CelValue& key,
+                                      const CelValue& value)>
+                   visitor) const override {
+    for (const auto& field : values_->fields()) {
+      if (!visitor(CelValue::CreateString(&field.first),
+                   ValueFromMessage(&field.second, arena_))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
  private:
   // List of keys in Struct.fields map.
   // It utilizes lazy initialization, to avoid performance penalties.
@@ -100,6 +112,11 @@ class DynamicMap : public CelMap {
       return values_->fields_size();
     }
 
+    absl::optional<absl::Span<const CelValue>> AsSpan() const override {
+      CheckInit();
+      return absl::MakeConstSpan(keys_);
+    }
+
    private:
     void CheckInit() const {
       absl::MutexLock lock(&mutex_);
@@ -373,6 +390,81 @@ std::string CelValue::TypeName(Type value_type) {
   }
 }
 
+namespace {
+
+// Equality of the in operator, for values of the types it compares.
+bool InEquals(const CelValue& element, const CelValue& value) {
+  if (element.type() != value.type()) {
+    return false;
+  }
+  switch (value.type()) {
+    case CelValue::Type::kBool:
+      return element.BoolOrDie() == value.BoolOrDie();
+    case CelValue::Type::kInt64:
+      return element.Int64OrDie() == value.Int64OrDie();
+    case CelValue::Type::kUint64:
+      return element.Uint64OrDie() == value.Uint64OrDie();
+    case CelValue::Type::kDouble:
+      return element.DoubleOrDie() == value.DoubleOrDie();
+    case CelValue::Type::kString:
+      return element.StringOrDie() == value.StringOrDie();
+    case CelValue::Type::kBytes:
+      return element.BytesOrDie() == value.BytesOrDie();
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+bool CelList::Contains(const CelValue& value) const {
+  switch (value.type()) {
+    case CelValue::Type::kBool:
+    case CelValue::Type::kInt64:
+    case CelValue::Type::kUint64:
+    case CelValue::Type::kDouble:
+    case CelValue::Type::kString:
+    case CelValue::Type::kBytes:
+      break;
+    default:
+      return false;
+  }
+  auto span = AsSpan();
+  if (span.has_value()) {
+    for (const CelValue& element : *span) {
+      if (InEquals(element, value)) return true;
+    }
+    return false;
+  }
+  return !ForEach(
+      [&value](const CelValue& element) { return !InEquals(element, value); });
+}
+
+bool CelList::ForEach(
+    absl::FunctionRef<bool(const CelValue& element)> visitor) const {
+  auto span = AsSpan();
+  if (span.has_value()) {
+    for (const CelValue& element : *span) {
+      if (!visitor(element)) return false;
+    }
+    return true;
+  }
+  int list_size = size();
+  for (int i = 0; i < list_size; i++) {
+    if (!visitor((*this)[i])) return false;
+  }
+  return true;
+}
+
+bool CelMap::ForEach(
+    absl::FunctionRef<bool(const CelValue& key, const CelValue& value)>
+        visitor) const {
+  return ListKeys()->ForEach([this, &visitor](const CelValue& key) {
+    absl::optional<CelValue> value = (*this)[key];
+    return !value.has_value() || visitor(key, *value);
+  });
+}
+
 CelValue CreateErrorValue(Arena* arena, absl::string_view message,
                           CelError::Code error_code, int position) {
   CelError* error = Arena::CreateMessage<CelError>(arena);
@@ -19,10 +19,16 @@
 //    const MyMessage * msg = google::protobuf::Arena::CreateMessage<MyMessage>(arena);
 //    CelValue value = CelValue::CreateMessage(msg, &arena);
 
+#include <cstdint>
+#include <limits>
+
 #include "google/protobuf/duration.pb.h"
 #include "google/protobuf/timestamp.pb.h"
+#include "absl/functional/function_ref.h"
 #include "absl/strings/string_view.h"
+#include "absl/time/time.h"
 #include "absl/types/optional.h"
+#include "absl/types/span.h"
 #include "eval/proto/cel_error.pb.h"
 #include "eval/public/cel_value_internal.h"
 #include "eval/public/cel_status_or.h"
@@ -82,6 +88,8 @@ class CelValue {
     }
 
    private:
+    friend class CelValue;
+
     explicit StringHolderBase(absl::string_view other) : value_(other) {}
     absl::string_view value_;
   };
@@ -93,18 +101,17 @@ class CelValue {
   using BytesHolder = StringHolderBase<1>;
 
  private:
-  using ValueHolder =
-      internal::ValueHolder<bool, int64_t, uint64_t, double, StringHolder,
-                            BytesHolder, const google::protobuf::Message *,
-                            const google::protobuf::Duration *,
-                            const google::protobuf::Timestamp *,
-                            const CelList *, const CelMap *, const CelError *>;
+  using Types =
+      internal::TypeList<bool, int64_t, uint64_t, double, StringHolder,
+                         BytesHolder, const google::protobuf::Message *,
+                         absl::Duration, absl::Time, const CelList *,
+                         const CelMap *, const CelError *>;
 
  public:
   // Metafunction providing positions corresponding to specific
   // types. If type is not supported, compile-time error will occur.
   template <class T>
-  using IndexOf = ValueHolder::IndexOf<T>;
+  using IndexOf = Types::IndexOf<T>;
 
   // Enum for types supported.
   enum class Type {
@@ -115,8 +122,8 @@ class CelValue {
     kString = IndexOf<StringHolder>::value,
     kBytes = IndexOf<BytesHolder>::value,
     kMessage = IndexOf<const google::protobuf::Message *>::value,
-    kDuration = IndexOf<const google::protobuf::Duration *>::value,
-    kTimestamp = IndexOf<const google::protobuf::Timestamp *>::value,
+    kDuration = IndexOf<absl::Duration>::value,
+    kTimestamp = IndexOf<absl::Time>::value,
     kList = IndexOf<const CelList *>::value,
     kMap = IndexOf<const CelMap *>::value,
     kError = IndexOf<const CelError *>::value,
@@ -128,7 +135,7 @@ class CelValue {
   CelValue() : CelValue(static_cast<const google::protobuf::Message *>(nullptr)) {}
 
   // Returns Type that describes the type of value stored.
-  Type type() const { return Type(value_.index()); }
+  Type type() const { return static_cast<Type>(tag_); }
 
   // We will use factory methods instead of public constructors
   // The reason for this is the high risk of implicit type conversions
@@ -146,16 +153,32 @@ class CelValue {
 
   static CelValue CreateDouble(double value) { return CelValue(value); }
 
-  static CelValue CreateString(StringHolder holder) { return CelValue(holder); }
+  static CelValue CreateString(StringHolder holder) {
+    return CelValue(Type::kString, holder.value());
+  }
 
   static CelValue CreateString(const std::string *str) {
-    return CelValue(StringHolder(str));
+    return CelValue(Type::kString, *str);
   }
 
-  static CelValue CreateBytes(BytesHolder holder) { return CelValue(holder); }
+  // Creates a string value referencing the characters, which must outlive
+  // the value.
+  static CelValue CreateStringView(absl::string_view value) {
+    return CelValue(Type::kString, value);
+  }
+
+  static CelValue CreateBytes(BytesHolder holder) {
+    return CelValue(Type::kBytes, holder.value());
+  }
 
   static CelValue CreateBytes(const std::string *str) {
-    return CelValue(BytesHolder(str));
+    return CelValue(Type::kBytes, *str);
+  }
+
+  // Creates a bytes value referencing the bytes, which must outlive the
+  // value.
+  static CelValue CreateBytesView(absl::string_view value) {
+    return CelValue(Type::kBytes, value);
   }
 
   // CreateMessage creates CelValue from google::protobuf::Message.
@@ -164,27 +187,40 @@ class CelValue {
   static CelValue CreateMessage(const google::protobuf::Message *value,
                                 google::protobuf::Arena *arena);
 
+  // Durations and timestamps are either held by value, or reference a
+  // message, which must outlive the value. Only the latter are returned by
+  // DurationOrDie() and TimestampOrDie().
+  static CelValue CreateDuration(absl::Duration value) {
+    return CelValue(Type::kDuration, value);
+  }
+
   static CelValue CreateDuration(const google::protobuf::Duration *value) {
-    return CelValue(value);
+    CheckNullPointer(value, Type::kDuration);
+    return CelValue(Type::kDuration, value, kMessageNanos);
+  }
+
+  static CelValue CreateTimestamp(absl::Time value) {
+    return CelValue(Type::kTimestamp, value - absl::UnixEpoch());
   }
 
   static CelValue CreateTimestamp(const google::protobuf::Timestamp *value) {
-    return CelValue(value);
+    CheckNullPointer(value, Type::kTimestamp);
+    return CelValue(Type::kTimestamp, value, kMessageNanos);
   }
 
   static CelValue CreateList(const CelList *value) {
     CheckNullPointer(value, Type::kList);
-    return CelValue(value);
+    return CelValue(Type::kList, value);
   }
 
   static CelValue CreateMap(const CelMap *value) {
     CheckNullPointer(value, Type::kMap);
-    return CelValue(value);
+    return CelValue(Type::kMap, value);
   }
 
   static CelValue CreateError(const CelError *value) {
     CheckNullPointer(value, Type::kError);
-    return CelValue(value);
+    return CelValue(Type::kError, value);
   }
 
   // Methods for accessing values of specific type
@@ -194,103 +230,168 @@ class CelValue {
 
   // Returns stored boolean value.
   // Fails if stored value type is not boolean.
-  bool BoolOrDie() const { return GetValueOrDie<bool>(Type::kBool); }
+  bool BoolOrDie() const {
+    CheckType(Type::kBool);
+    return value_.bool_value;
+  }
 
   // Returns stored int64_t value.
   // Fails if stored value type is not int64_t.
-  int64_t Int64OrDie() const { return GetValueOrDie<int64_t>(Type::kInt64); }
+  int64_t Int64OrDie() const {
+    CheckType(Type::kInt64);
+    return value_.int64_value;
+  }
 
   // Returns stored uint64_t value.
   // Fails if stored value type is not uint64_t.
-  uint64_t Uint64OrDie() const { return GetValueOrDie<uint64_t>(Type::kUint64); }
+  uint64_t Uint64OrDie() const {
+    CheckType(Type::kUint64);
+    return value_.uint64_value;
+  }
 
   // Returns stored double value.
   // Fails if stored value type is not double.
-  double DoubleOrDie() const { return GetValueOrDie<double>(Type::kDouble); }
+  double DoubleOrDie() const {
+    CheckType(Type::kDouble);
+    return value_.double_value;
+  }
 
   // Returns stored const string * value.
   // Fails if stored value type is not const string *.
   StringHolder StringOrDie() const {
-    return GetValueOrDie<StringHolder>(Type::kString);
+    CheckType(Type::kString);
+    return StringHolder(GetStringView());
   }
 
   BytesHolder BytesOrDie() const {
-    return GetValueOrDie<BytesHolder>(Type::kBytes);
+    CheckType(Type::kBytes);
+    return BytesHolder(GetStringView());
   }
 
   // Returns stored const Message * value.
   // Fails if stored value type is not const Message *.
   const google::protobuf::Message *MessageOrDie() const {
-    return GetValueOrDie<const google::protobuf::Message *>(Type::kMessage);
+    CheckType(Type::kMessage);
+    return static_cast<const google::protobuf::Message *>(value_.pointer);
   }
 
   // Returns stored const Duration * value.
-  // Fails if stored value type is not const Duration *.
+  // Fails if stored value type is not const Duration *, i.e. the duration is
+  // held by value. AbslDurationOrDie() accepts both.
   const google::protobuf::Duration *DurationOrDie() const {
-    return GetValueOrDie<const google::protobuf::Duration *>(Type::kDuration);
+    CheckType(Type::kDuration);
+    CheckTimeMessage();
+    return static_cast<const google::protobuf::Duration *>(value_.pointer);
   }
 
   // Returns stored const Timestamp * value.
-  // Fails if stored value type is not const Timestamp *.
+  // Fails if stored value type is not const Timestamp *, i.e. the timestamp
+  // is held by value. AbslTimestampOrDie() accepts both.
   const google::protobuf::Timestamp *TimestampOrDie() const {
-    return GetValueOrDie<const google::protobuf::Timestamp *>(Type::kTimestamp);
+    CheckType(Type::kTimestamp);
+    CheckTimeMessage();
+    return static_cast<const google::protobuf::Timestamp *>(value_.pointer);
+  }
+
+  // Returns stored duration value.
+  // Fails if stored value type is not duration.
+  absl::Duration AbslDurationOrDie() const {
+    CheckType(Type::kDuration);
+    return GetDuration();
+  }
+
+  // Returns stored timestamp value.
+  // Fails if stored value type is not timestamp.
+  absl::Time AbslTimestampOrDie() const {
+    CheckType(Type::kTimestamp);
+    return absl::UnixEpoch() + GetDuration();
   }
 
   // Returns stored const CelList * value.
   // Fails if stored value type is not const CelList *.
   const CelList *ListOrDie() const {
-    return GetValueOrDie<const CelList *>(Type::kList);
+    CheckType(Type::kList);
+    return static_cast<const CelList *>(value_.pointer);
   }
 
   // Returns stored const CelMap * value.
   // Fails if stored value type is not const CelMap *.
   const CelMap *MapOrDie() const {
-    return GetValueOrDie<const CelMap *>(Type::kMap);
+    CheckType(Type::kMap);
+    return static_cast<const CelMap *>(value_.pointer);
   }
 
   // Returns stored const CelError * value.
   // Fails if stored value type is not const CelError *.
   const CelError *ErrorOrDie() const {
-    return GetValueOrDie<const CelError *>(Type::kError);
+    CheckType(Type::kError);
+    return static_cast<const CelError *>(value_.pointer);
   }
 
   const bool IsNull() const {
-    return value_.template Visit<bool>(NullCheckOp());
+    return type() == Type::kMessage && value_.pointer == nullptr;
   }
 
-  const bool IsBool() const { return value_.is<bool>(); }
+  const bool IsBool() const { return type() == Type::kBool; }
 
-  const bool IsInt64() const { return value_.is<int64_t>(); }
+  const bool IsInt64() const { return type() == Type::kInt64; }
 
-  const bool IsUint64() const { return value_.is<uint64_t>(); }
+  const bool IsUint64() const { return type() == Type::kUint64; }
 
-  const bool IsDouble() const { return value_.is<double>(); }
+  const bool IsDouble() const { return type() == Type::kDouble; }
 
-  const bool IsString() const { return value_.is<StringHolder>(); }
+  const bool IsString() const { return type() == Type::kString; }
 
-  const bool IsBytes() const { return value_.is<BytesHolder>(); }
+  const bool IsBytes() const { return type() == Type::kBytes; }
 
-  const bool IsMessage() const { return value_.is<const google::protobuf::Message *>(); }
+  const bool IsMessage() const { return type() == Type::kMessage; }
 
-  const bool IsDuration() const {
-    return value_.is<const google::protobuf::Duration *>();
-  }
+  const bool IsDuration() const { return type() == Type::kDuration; }
 
-  const bool IsTimestamp() const {
-    return value_.is<const google::protobuf::Timestamp *>();
+  const bool IsTimestamp() const { return type() == Type::kTimestamp; }
+
+  // Returns true if the duration or timestamp references a message.
+  const bool HasTimeMessage() const {
+    return (IsDuration() || IsTimestamp()) && aux_ == kMessageNanos;
   }
 
-  const bool IsList() const { return value_.is<const CelList *>(); }
+  const bool IsList() const { return type() == Type::kList; }
 
-  const bool IsMap() const { return value_.is<const CelMap *>(); }
+  const bool IsMap() const { return type() == Type::kMap; }
 
-  const bool IsError() const { return value_.is<const CelError *>(); }
+  const bool IsError() const { return type() == Type::kError; }
 
   // Invokes op() with the active value, and returns the result.
   // All overloads of op() must have the same return type.
   template <class ReturnType, class Op>
   ReturnType Visit(Op &&op) const {
-    return value_.template Visit<ReturnType>(op);
+    switch (type()) {
+      case Type::kBool:
+        return op(value_.bool_value);
+      case Type::kInt64:
+        return op(value_.int64_value);
+      case Type::kUint64:
+        return op(value_.uint64_value);
+      case Type::kDouble:
+        return op(value_.double_value);
+      case Type::kString:
+        return op(StringHolder(GetStringView()));
+      case Type::kBytes:
+        return op(BytesHolder(GetStringView()));
+      case Type::kDuration:
+        return op(GetDuration());
+      case Type::kTimestamp:
+        return op(absl::UnixEpoch() + GetDuration());
+      case Type::kList:
+        return op(static_cast<const CelList *>(value_.pointer));
+      case Type::kMap:
+        return op(static_cast<const CelMap *>(value_.pointer));
+      case Type::kError:
+        return op(static_cast<const CelError *>(value_.pointer));
+      case Type::kMessage:
+      default:
+        return op(static_cast<const google::protobuf::Message *>(value_.pointer));
+    }
   }
 
   // Template-style getter.
@@ -300,11 +401,50 @@ class CelValue {
     return this->template Visit<bool>(AssignerOp<Arg>(value));
   }
 
+  // Durations and timestamps are assigned as messages only if they
+  // reference one.
+  bool GetValue(const google::protobuf::Duration **value) const {
+    if (!IsDuration() || !HasTimeMessage()) return false;
+    *value = DurationOrDie();
+    return true;
+  }
+
+  bool GetValue(const google::protobuf::Timestamp **value) const {
+    if (!IsTimestamp() || !HasTimeMessage()) return false;
+    *value = TimestampOrDie();
+    return true;
+  }
+
   // Provides type names for internal logging.
   static std::string TypeName(Type value_type);
 
  private:
-  ValueHolder value_;
+  // Values are packed in 16 bytes: an 8-byte word, holding the scalar
+  // value, the pointer or the seconds of a duration; a 4-byte auxiliary
+  // word, holding the size of a string or the nanoseconds of a duration; and
+  // the one-byte type tag. Timestamps are held as durations since the Unix
+  // epoch. Durations and timestamps referencing messages hold the pointer,
+  // marked by the auxiliary word.
+  union Word {
+    bool bool_value;
+    int64_t int64_value;
+    uint64_t uint64_value;
+    double double_value;
+    const char *string_data;
+    const void *pointer;
+  };
+
+  // Value of the auxiliary word of infinite durations, out of the range of
+  // nanoseconds of finite ones.
+  static constexpr uint32_t kInfiniteDurationNanos = 1000000000;
+
+  // Value of the auxiliary word of durations and timestamps referencing
+  // messages.
+  static constexpr uint32_t kMessageNanos = 1000000001;
+
+  Word value_;
+  uint32_t aux_;
+  uint8_t tag_;
 
   template <typename T>
   struct AssignerOp {
@@ -323,27 +463,89 @@ class CelValue {
     T *value;
   };
 
-  struct NullCheckOp {
-    template <typename T>
-    bool operator()(const T &t) const {
-      return false;
-    }
+  explicit CelValue(bool value) : aux_(0), tag_(uint8_t(Type::kBool)) {
+    value_.int64_value = 0;
+    value_.bool_value = value;
+  }
 
-    bool operator()(const google::protobuf::Message *arg) const { return arg == nullptr; }
+  explicit CelValue(int64_t value) : aux_(0), tag_(uint8_t(Type::kInt64)) {
+    value_.int64_value = value;
+  }
 
-    bool operator()(const google::protobuf::Timestamp *arg) const {
-      return arg == nullptr;
+  explicit CelValue(uint64_t value) : aux_(0), tag_(uint8_t(Type::kUint64)) {
+    value_.uint64_value = value;
+  }
+
+  explicit CelValue(double value) : aux_(0), tag_(uint8_t(Type::kDouble)) {
+    value_.double_value = value;
+  }
+
+  explicit CelValue(const google::protobuf::Message *value)
+      : CelValue(Type::kMessage, value) {}
+
+  CelValue(Type type, const void *value) : aux_(0), tag_(uint8_t(type)) {
+    value_.pointer = value;
+  }
+
+  CelValue(Type type, const void *value, uint32_t aux)
+      : aux_(aux), tag_(uint8_t(type)) {
+    value_.pointer = value;
+  }
+
+  CelValue(Type type, absl::string_view value) : tag_(uint8_t(type)) {
+    CheckStringSize(value.size());
+    value_.string_data = value.data();
+    aux_ = static_cast<uint32_t>(value.size());
+  }
+
+  // Durations are split into whole seconds and nanoseconds of the same sign.
+  CelValue(Type type, absl::Duration value) : tag_(uint8_t(type)) {
+    if (value == absl::InfiniteDuration() ||
+        value == -absl::InfiniteDuration()) {
+      value_.int64_value = value < absl::ZeroDuration() ? -1 : 1;
+      aux_ = kInfiniteDurationNanos;
+      return;
     }
+    int64_t seconds = absl::ToInt64Seconds(value);
+    value_.int64_value = seconds;
+    aux_ = static_cast<uint32_t>(static_cast<int32_t>(
+        absl::ToInt64Nanoseconds(value - absl::Seconds(seconds))));
+  }
+
+  absl::string_view GetStringView() const {
+    return absl::string_view(value_.string_data, aux_);
+  }
 
-    bool operator()(const google::protobuf::Duration *arg) const {
-      return arg == nullptr;
+  absl::Duration GetDuration() const {
+    if (aux_ == kMessageNanos) {
+      return type() == Type::kDuration
+                 ? DecodeMessage(static_cast<const google::protobuf::Duration *>(
+                       value_.pointer))
+                 : DecodeMessage(static_cast<const google::protobuf::Timestamp *>(
+                       value_.pointer));
     }
-  };
+    if (aux_ == kInfiniteDurationNanos) {
+      return value_.int64_value < 0 ? -absl::InfiniteDuration()
+                                    : absl::InfiniteDuration();
+    }
+    return absl::Seconds(value_.int64_value) +
+           absl::Nanoseconds(static_cast<int32_t>(aux_));
+  }
 
-  // Constructs CelValue wrapping value supplied as argument.
-  // Value type T should be supported by specification of ValueHolder.
-  template <class T>
-  explicit CelValue(T value) : value_(value) {}
+  // Returns the duration of a Duration message, or the time since the Unix
+  // epoch of a Timestamp one.
+  template <class MessageType>
+  static absl::Duration DecodeMessage(const MessageType *message) {
+    return absl::Seconds(message->seconds()) +
+           absl::Nanoseconds(message->nanos());
+  }
+
+  void CheckTimeMessage() const {
+    if (aux_ != kMessageNanos) {
+      GOOGLE_LOG(FATAL) << TypeName(type())  // Crash ok
+                 << " is held by value, it has no message";  // Crash ok
+    }
+  }
 
   // Null pointer checker for pointer-based types.
   static void CheckNullPointer(const void *ptr, Type type) {
@@ -352,16 +554,20 @@ class CelValue {
     }
   }
 
-  // Gets value of type specified
-  template <class T>
-  T GetValueOrDie(Type requested_type) const {
-    auto value_ptr = value_.get<T>();
-    if (value_ptr == nullptr) {
+  // Strings are limited to 4GB by the size of the auxiliary word.
+  static void CheckStringSize(size_t size) {
+    if (size > std::numeric_limits<uint32_t>::max()) {
+      GOOGLE_LOG(FATAL) << "String of " << size << " bytes is too long";  // Crash ok
+    }
+  }
+
+  // Checks the type of the value.
+  void CheckType(Type requested_type) const {
+    if (type() != requested_type) {
       GOOGLE_LOG(FATAL) << "Type mismatch"                            // Crash ok
                  << ": expected " << TypeName(requested_type)  // Crash ok
                  << ", encountered " << TypeName(type());      // Crash ok
     }
-    return *value_ptr;
   }
 };
 
@@ -375,6 +581,27 @@ class CelList {
   // Default empty check. Can be overridden in subclass for performance.
   virtual bool empty() const { return size() == 0; }
 
+  // Membership check of the in operator: returns true if the list has an
+  // element of the same type as the value, and equal to it. Only bool,
+  // numeric, string and bytes values are compared.
+  // Default implementation scans the list, subclasses may index elements.
+  virtual bool Contains(const CelValue &value) const;
+
+  // Contiguous storage of the elements, for lists that have one. Callers
+  // may iterate the span instead of making a virtual call per element.
+  // The span is valid as long as the list is not modified.
+  // Default implementation has no contiguous storage.
+  virtual absl::optional<absl::Span<const CelValue>> AsSpan() const {
+    return absl::nullopt;
+  }
+
+  // Calls the visitor with the elements in order, until it returns false.
+  // Returns false if the iteration was stopped by the visitor.
+  // Default implementation iterates the span if there is one, and accesses
+  // the elements by index otherwise.
+  virtual bool ForEach(
+      absl::FunctionRef<bool(const CelValue &element)> visitor) const;
+
   virtual ~CelList() {}
 };
 
@@ -387,6 +614,20 @@ class CelMap {
   // int64_t,uint64,string.
   virtual absl::optional<CelValue> operator[](CelValue key) const = 0;
 
+  // Presence test of the key, performed by has() macro. Default
+  // implementation looks the value of the key up.
+  virtual bool Has(const CelValue &key) const {
+    return (*this)[key].has_value();
+  }
+
+  // Lookup performed by select expressions, map.key. Maps representing
+  // messages, e.g. WireMessageImpl, return the default values of fields not
+  // present, as selects of message fields do. Default implementation looks
+  // the value of the key up.
+  virtual absl::optional<CelValue> SelectField(CelValue key) const {
+    return (*this)[key];
+  }
+
   // Map size
   virtual int size() const = 0;
   // Default empty check. Can be overridden in subclass for performance.
@@ -396,6 +637,14 @@ class CelMap {
   // ownership is passed.
   virtual const CelList *ListKeys() const = 0;
 
+  // Calls the visitor with the keys and values of the entries, in the order
+  // of ListKeys(), until it returns false. Returns false if the iteration was
+  // stopped by the visitor.
+  // Default implementation looks the value of each key up.
+  virtual bool ForEach(
+      absl::FunctionRef<bool(const CelValue &key, const CelValue &value)>
+          visitor) const;
+
   virtual ~CelMap() {}
 };
 
@@ -17,7 +17,7 @@
 #ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_VALUE_INTERNAL_H_
 #define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_CEL_VALUE_INTERNAL_H_
 
-#include "absl/types/variant.h"
+#include <type_traits>
 
 namespace google {
 namespace api {
@@ -48,36 +48,12 @@ template <int N, class Type, class TypeToTest>
 struct TypeIndexer<N, 1, Type, TypeToTest>
     : public IndexDef<N, std::is_same<Type, TypeToTest>::value> {};
 
-// ValueHolder class wraps absl::variant, adding IndexOf metafunction to it.
+// TypeList provides IndexOf metafunction, finding the index of a type in the
+// list.
 template <class... Args>
-class ValueHolder {
- public:
-  template <class T>
-  explicit ValueHolder(T t) : value_(t) {}
-
-  // Metafunction to find the index of a type in a type list.
+struct TypeList {
   template <class T>
   using IndexOf = TypeIndexer<0, sizeof...(Args), T, Args...>;
-
-  template <class T>
-  const T *get() const {
-    return absl::get_if<T>(&value_);
-  }
-
-  template <class T>
-  bool is() const {
-    return absl::holds_alternative<T>(value_);
-  }
-
-  int index() const { return value_.index(); }
-
-  template <class ReturnType, class Op>
-  ReturnType Visit(Op &&op) const {
-    return absl::visit(std::forward<Op>(op), value_);
-  }
-
- private:
-  absl::variant<Args...> value_;
 };
 
 }  // namespace internal
@@ -239,6 +239,17 @@ TEST(CelValueTest, TestDuration) {
   //  CelValue value = CelValue::CreateString("test");
   EXPECT_TRUE(value.IsDuration());
   EXPECT_THAT(*value.DurationOrDie(), testutil::EqualsProto(msg_duration));
+  EXPECT_THAT(value.AbslDurationOrDie(),
+              Eq(absl::Seconds(2) + absl::Nanoseconds(3)));
+  EXPECT_THAT(value_duration2.DurationOrDie(), Eq(&msg_duration));
+
+  // Durations may be held by value.
+  CelValue value_duration3 = CelValue::CreateDuration(absl::Minutes(-5));
+  EXPECT_TRUE(value_duration3.IsDuration());
+  EXPECT_FALSE(value_duration3.IsNull());
+  EXPECT_FALSE(value_duration3.HasTimeMessage());
+  EXPECT_TRUE(value.HasTimeMessage());
+  EXPECT_THAT(value_duration3.AbslDurationOrDie(), Eq(absl::Minutes(-5)));
 }
 
 // This test verifies CelValue support of Timestamp type.
@@ -258,6 +269,43 @@ TEST(CelValueTest, TestTimestamp) {
   //  CelValue value = CelValue::CreateString("test");
   EXPECT_TRUE(value.IsTimestamp());
   EXPECT_THAT(*value.TimestampOrDie(), testutil::EqualsProto(msg_timestamp));
+  EXPECT_THAT(value.AbslTimestampOrDie(),
+              Eq(absl::FromUnixSeconds(2) + absl::Nanoseconds(3)));
+  EXPECT_THAT(value_timestamp2.TimestampOrDie(), Eq(&msg_timestamp));
+
+  // Timestamps may be held by value.
+  CelValue value_timestamp3 = CelValue::CreateTimestamp(absl::UnixEpoch());
+  EXPECT_TRUE(value_timestamp3.IsTimestamp());
+  EXPECT_FALSE(value_timestamp3.IsNull());
+  EXPECT_FALSE(value_timestamp3.HasTimeMessage());
+  EXPECT_TRUE(value.HasTimeMessage());
+  EXPECT_THAT(value_timestamp3.AbslTimestampOrDie(), Eq(absl::UnixEpoch()));
+}
+
+// Values are packed in 16 bytes.
+TEST(CelValueTest, TestSize) { EXPECT_THAT(sizeof(CelValue), Eq(16)); }
+
+// This test verifies that packed durations and timestamps keep their value.
+TEST(CelValueTest, TestDurationAndTimestampRange) {
+  const std::vector<absl::Duration> durations = {
+      absl::ZeroDuration(),
+      absl::Nanoseconds(1),
+      -absl::Nanoseconds(1),
+      absl::Seconds(-2) - absl::Nanoseconds(999999999),
+      absl::Seconds(315576000000) + absl::Nanoseconds(999999999),
+      absl::Seconds(std::numeric_limits<int64_t>::max()),
+      absl::Seconds(std::numeric_limits<int64_t>::min()),
+      absl::InfiniteDuration(),
+      -absl::InfiniteDuration(),
+  };
+  for (absl::Duration duration : durations) {
+    SCOPED_TRACE(absl::FormatDuration(duration));
+    EXPECT_THAT(CelValue::CreateDuration(duration).AbslDurationOrDie(),
+                Eq(duration));
+    absl::Time time = absl::UnixEpoch() + duration;
+    EXPECT_THAT(CelValue::CreateTimestamp(time).AbslTimestampOrDie(),
+                Eq(time));
+  }
 }
 
 // This test verifies CelValue support of List type.
@@ -290,6 +338,46 @@ TEST(CelValueTest, TestMap) {
   EXPECT_THAT(CountTypeMatch(value), Eq(1));
 }
 
+// List without contiguous storage, of the integers in [0, size).
+class RangeList : public CelList {
+ public:
+  explicit RangeList(int size) : size_(size) {}
+
+  int size() const override { return size_; }
+
+  CelValue operator[](int index) const override {
+    return CelValue::CreateInt64(index);
+  }
+
+ private:
+  int size_;
+};
+
+TEST(CelValueTest, TestListForEach) {
+  RangeList list(5);
+  EXPECT_FALSE(list.AsSpan().has_value());
+
+  std::vector<int64_t> visited;
+  EXPECT_TRUE(list.ForEach([&visited](const CelValue& element) {
+    visited.push_back(element.Int64OrDie());
+    return true;
+  }));
+  EXPECT_THAT(visited, testing::ElementsAre(0, 1, 2, 3, 4));
+
+  // The iteration stops when the visitor returns false.
+  visited.clear();
+  EXPECT_FALSE(list.ForEach([&visited](const CelValue& element) {
+    visited.push_back(element.Int64OrDie());
+    return element.Int64OrDie() < 2;
+  }));
+  EXPECT_THAT(visited, testing::ElementsAre(0, 1, 2));
+
+  EXPECT_TRUE(list.Contains(CelValue::CreateInt64(4)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateInt64(5)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateUint64(4)));
+  EXPECT_FALSE(list.Contains(CelValue::CreateNull()));
+}
+
 // Dynamic Values test
 //
 
@@ -385,6 +473,15 @@ TEST(CelValueTest, TestValueFieldStruct) {
   }
 
   EXPECT_THAT(result_keys, UnorderedPointwise(Eq(), kFields));
+
+  // Entries are visited in the order of the key list.
+  std::vector<std::string> visited_keys;
+  EXPECT_TRUE(cel_map->ForEach([&](const CelValue& key, const CelValue& value) {
+    visited_keys.push_back(std::string(key.StringOrDie().value()));
+    EXPECT_THAT(value.type(), Eq((*cel_map)[key]->type()));
+    return true;
+  }));
+  EXPECT_THAT(visited_keys, testing::ElementsAreArray(result_keys));
 }
 
 TEST(CelValueTest, TestListFieldStruct) {
@@ -1,11 +1,159 @@
 #include "eval/public/extension_func_registrar.h"
 
+#include "absl/strings/str_cat.h"
+#include "eval/eval/typed_list_impl.h"
+#include "eval/public/cel_function_adapter.h"
+
 namespace google {
 namespace api {
 namespace expr {
 namespace runtime {
 
+namespace {
+
+using google::protobuf::Arena;
+
+// Folds the elements of the list into the result with op, if they all have
+// the type V.
+template <class V, class Op>
+bool FoldElements(const CelList* list, V* result, Op op) {
+  bool ok = true;
+  list->ForEach([&](const CelValue& element) {
+    V value{};
+    ok = element.GetValue(&value);
+    if (ok) {
+      *result = op(*result, value);
+    }
+    return ok;
+  });
+  return ok;
+}
+
+CelValue NotNumericError(Arena* arena, absl::string_view function) {
+  return CreateErrorValue(
+      arena, absl::StrCat(function, ": want list of int, uint or double"),
+      CelError::Code::CelError_Code_NO_MATCHING_OVERLOAD);
+}
+
+// Sum of the elements of a list of numbers of the same type. Integer
+// overflows wrap around, the sum of an empty list is int 0.
+CelValue ListSum(Arena* arena, const CelList* list) {
+  absl::optional<CelValue> native_sum = NativeSum(*list);
+  if (native_sum.has_value()) {
+    return *native_sum;
+  }
+  if (list->empty()) {
+    return CelValue::CreateInt64(0);
+  }
+  switch ((*list)[0].type()) {
+    case CelValue::Type::kInt64: {
+      int64_t sum = 0;
+      if (FoldElements(list, &sum, [](int64_t sum, int64_t value) {
+            return static_cast<int64_t>(static_cast<uint64_t>(sum) +
+                                        static_cast<uint64_t>(value));
+          })) {
+        return CelValue::CreateInt64(sum);
+      }
+      break;
+    }
+    case CelValue::Type::kUint64: {
+      uint64_t sum = 0;
+      if (FoldElements(list, &sum, [](uint64_t sum, uint64_t value) {
+            return sum + value;
+          })) {
+        return CelValue::CreateUint64(sum);
+      }
+      break;
+    }
+    case CelValue::Type::kDouble: {
+      double sum = 0;
+      if (FoldElements(list, &sum,
+                       [](double sum, double value) { return sum + value; })) {
+        return CelValue::CreateDouble(sum);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return NotNumericError(arena, "sum");
+}
+
+// Minimum or maximum of the elements of a list of numbers of the same type,
+// starting from the first element.
+template <class V, bool kMax>
+bool FoldExtremum(const CelList* list, V* result) {
+  if (!(*list)[0].GetValue(result)) {
+    return false;
+  }
+  // Comparisons with NaN are false, so NaN is only kept as the first element.
+  return FoldElements(list, result, [](V result, V value) -> V {
+    if (kMax) {
+      return result < value ? value : result;
+    }
+    return value < result ? value : result;
+  });
+}
+
+template <bool kMax>
+CelValue ListExtremum(Arena* arena, const CelList* list) {
+  absl::string_view function = kMax ? "max" : "min";
+  absl::optional<CelValue> native_result =
+      kMax ? NativeMax(*list) : NativeMin(*list);
+  if (native_result.has_value()) {
+    return *native_result;
+  }
+  if (list->empty()) {
+    return CreateErrorValue(arena, absl::StrCat(function, ": empty list"),
+                            CelError::Code::CelError_Code_INVALID_ARGUMENT);
+  }
+  switch ((*list)[0].type()) {
+    case CelValue::Type::kInt64: {
+      int64_t result = 0;
+      if (FoldExtremum<int64_t, kMax>(list, &result)) {
+        return CelValue::CreateInt64(result);
+      }
+      break;
+    }
+    case CelValue::Type::kUint64: {
+      uint64_t result = 0;
+      if (FoldExtremum<uint64_t, kMax>(list, &result)) {
+        return CelValue::CreateUint64(result);
+      }
+      break;
+    }
+    case CelValue::Type::kDouble: {
+      double result = 0;
+      if (FoldExtremum<double, kMax>(list, &result)) {
+        return CelValue::CreateDouble(result);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return NotNumericError(arena, function);
+}
+
+}  // namespace
+
 util::Status RegisterExtensionFunctions(CelFunctionRegistry* registry) {
+  // Aggregates of lists of numbers: sum(), min() and max(), in the global
+  // and the receiver style. Typed lists are processed by vectorized kernels.
+  for (bool receiver_style : {false, true}) {
+    util::Status status =
+        FunctionAdapter<CelValue, const CelList*>::CreateAndRegister(
+            "sum", receiver_style, ListSum, registry);
+    if (!util::IsOk(status)) return status;
+
+    status = FunctionAdapter<CelValue, const CelList*>::CreateAndRegister(
+        "min", receiver_style, ListExtremum<false>, registry);
+    if (!util::IsOk(status)) return status;
+
+    status = FunctionAdapter<CelValue, const CelList*>::CreateAndRegister(
+        "max", receiver_style, ListExtremum<true>, registry);
+    if (!util::IsOk(status)) return status;
+  }
   return util::OkStatus();
 }
 
@@ -5,6 +5,8 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/strings/str_cat.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/typed_list_impl.h"
 
 namespace google {
 namespace api {
@@ -96,6 +98,20 @@ class ExtensionTest : public ::testing::Test {
     ASSERT_TRUE(util::IsOk(status));
   }
 
+  // Helper method to test sum(), min() and max() in both call styles.
+  void PerformListAggregate(Arena* arena, absl::string_view name,
+                            const CelList* list, CelValue* result) {
+    for (bool receiver_style : {false, true}) {
+      auto functions =
+          registry_.FindOverloads(name, receiver_style, {CelValue::Type::kList});
+      ASSERT_EQ(functions.size(), 1);
+
+      std::vector<CelValue> args = {CelValue::CreateList(list)};
+      auto status = functions[0]->Evaluate(args, result, arena);
+      ASSERT_TRUE(util::IsOk(status));
+    }
+  }
+
   // Function registry object
   CelFunctionRegistry registry_;
 };
@@ -199,6 +215,11 @@ TEST_F(ExtensionTest, TestDurationFromString) {
   ASSERT_EQ(d->seconds(), 15L);
   ASSERT_EQ(d->nanos(), 110000000L);
 
+  // Valid duration - with several units.
+  EXPECT_NO_FATAL_FAILURE(PerformDurationConversion(&arena, "1h30m", &result));
+  ASSERT_TRUE(result.IsDuration());
+  ASSERT_EQ(result.AbslDurationOrDie(), absl::Minutes(90));
+
   // Invalid duration - empty string.
   EXPECT_NO_FATAL_FAILURE(PerformDurationConversion(&arena, "", &result));
   ASSERT_TRUE(result.IsError());
@@ -208,6 +229,67 @@ TEST_F(ExtensionTest, TestDurationFromString) {
   // Invalid duration.
   EXPECT_NO_FATAL_FAILURE(PerformDurationConversion(&arena, "100", &result));
   ASSERT_TRUE(result.IsError());
+
+  // Invalid duration - out of the google.protobuf.Duration range.
+  EXPECT_NO_FATAL_FAILURE(PerformDurationConversion(&arena, "inf", &result));
+  ASSERT_TRUE(result.IsError());
+}
+
+TEST_F(ExtensionTest, TestListAggregates) {
+  Arena arena;
+  CelValue result;
+
+  // Typed lists and lists of CelValues give the same results.
+  TypedListImpl<int64_t> typed_list(std::vector<int64_t>{3, -7, 5});
+  ContainerBackedListImpl list({CelValue::CreateInt64(3),
+                                CelValue::CreateInt64(-7),
+                                CelValue::CreateInt64(5)});
+  for (const CelList* cel_list : {static_cast<const CelList*>(&typed_list),
+                                  static_cast<const CelList*>(&list)}) {
+    EXPECT_NO_FATAL_FAILURE(
+        PerformListAggregate(&arena, "sum", cel_list, &result));
+    ASSERT_TRUE(result.IsInt64());
+    EXPECT_EQ(result.Int64OrDie(), 1);
+
+    EXPECT_NO_FATAL_FAILURE(
+        PerformListAggregate(&arena, "min", cel_list, &result));
+    ASSERT_TRUE(result.IsInt64());
+    EXPECT_EQ(result.Int64OrDie(), -7);
+
+    EXPECT_NO_FATAL_FAILURE(
+        PerformListAggregate(&arena, "max", cel_list, &result));
+    ASSERT_TRUE(result.IsInt64());
+    EXPECT_EQ(result.Int64OrDie(), 5);
+  }
+
+  ContainerBackedListImpl doubles(
+      {CelValue::CreateDouble(0.5), CelValue::CreateDouble(0.25)});
+  EXPECT_NO_FATAL_FAILURE(PerformListAggregate(&arena, "sum", &doubles, &result));
+  ASSERT_TRUE(result.IsDouble());
+  EXPECT_EQ(result.DoubleOrDie(), 0.75);
+
+  // The sum of an empty list is 0, while min() and max() fail.
+  ContainerBackedListImpl empty({});
+  EXPECT_NO_FATAL_FAILURE(PerformListAggregate(&arena, "sum", &empty, &result));
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_EQ(result.Int64OrDie(), 0);
+  EXPECT_NO_FATAL_FAILURE(PerformListAggregate(&arena, "min", &empty, &result));
+  ASSERT_TRUE(result.IsError());
+  EXPECT_EQ(result.ErrorOrDie()->code(),
+            CelError::Code::CelError_Code_INVALID_ARGUMENT);
+
+  // Elements must be numbers of the same type.
+  ContainerBackedListImpl mixed(
+      {CelValue::CreateInt64(1), CelValue::CreateDouble(2)});
+  EXPECT_NO_FATAL_FAILURE(PerformListAggregate(&arena, "max", &mixed, &result));
+  ASSERT_TRUE(result.IsError());
+  EXPECT_EQ(result.ErrorOrDie()->code(),
+            CelError::Code::CelError_Code_NO_MATCHING_OVERLOAD);
+  bool bools[] = {true};
+  TypedListImpl<bool> bool_list(bools);
+  EXPECT_NO_FATAL_FAILURE(
+      PerformListAggregate(&arena, "sum", &bool_list, &result));
+  ASSERT_TRUE(result.IsError());
 }
 
 }  // namespace
@@ -0,0 +1,27 @@
+#include "eval/public/list_membership.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+ListMembershipFunction::ListMembershipFunction(const std::string& name,
+                                               CelValue::Type value_type)
+    : CelFunction({name, false, {value_type, CelValue::Type::kList}}) {}
+
+util::Status ListMembershipFunction::Evaluate(
+    absl::Span<const CelValue> arguments, CelValue* result,
+    google::protobuf::Arena* arena) const {
+  if (arguments.size() != 2 || !arguments[1].IsList()) {
+    return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                            "in: want (value, list) arguments");
+  }
+  *result = CelValue::CreateBool(
+      arguments[1].ListOrDie()->Contains(arguments[0]));
+  return util::OkStatus();
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
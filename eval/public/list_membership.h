@@ -0,0 +1,31 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_LIST_MEMBERSHIP_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_LIST_MEMBERSHIP_H_
+
+#include <string>
+
+#include "eval/public/cel_function.h"
+#include "eval/public/cel_value.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Implementation of the builtin in operator (and its deprecated names) for
+// values of the type and lists, based on CelList::Contains. Expression
+// builders may replace it with a lookup in an index built in advance if the
+// list is a constant.
+class ListMembershipFunction : public CelFunction {
+ public:
+  ListMembershipFunction(const std::string& name, CelValue::Type value_type);
+
+  util::Status Evaluate(absl::Span<const CelValue> arguments, CelValue* result,
+                        google::protobuf::Arena* arena) const override;
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_LIST_MEMBERSHIP_H_
@@ -0,0 +1,233 @@
+#include "eval/public/referenced_paths.h"
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "google/protobuf/util/field_mask_util.h"
+#include "eval/public/ast_traverse.h"
+#include "eval/public/ast_visitor_base.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/types/optional.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::api::expr::v1alpha1::Expr;
+using google::api::expr::v1alpha1::SourceInfo;
+using google::protobuf::Descriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::FieldMask;
+using google::protobuf::util::FieldMaskUtil;
+
+// Collects the referenced paths. Subexpressions denoting paths, i.e. free
+// variables and selects from them, are recorded in paths_ and extended by
+// the selects of their parents. Other parents reference the paths.
+class ReferencedPathsVisitor : public AstVisitorBase {
+ public:
+  void PostVisitIdent(const Expr::Ident* ident_expr, const Expr* expr,
+                      const SourcePosition*) override {
+    for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
+      if (it->first == ident_expr->name()) {
+        // Comprehension variables denote the elements of the range.
+        if (it->second.has_value()) {
+          paths_[expr] = *it->second;
+        }
+        return;
+      }
+    }
+    paths_[expr] = ident_expr->name();
+  }
+
+  void PostVisitSelect(const Expr::Select* select_expr, const Expr* expr,
+                       const SourcePosition*) override {
+    absl::optional<std::string> operand_path =
+        TakePath(&select_expr->operand());
+    if (!operand_path.has_value()) {
+      return;
+    }
+    std::string path = absl::StrCat(*operand_path, ".", select_expr->field());
+    if (select_expr->test_only()) {
+      // has() tests reference the presence of the field.
+      referenced_.insert(std::move(path));
+    } else {
+      paths_[expr] = std::move(path);
+    }
+  }
+
+  void PostVisitCall(const Expr::Call* call_expr, const Expr*,
+                     const SourcePosition*) override {
+    if (call_expr->has_target()) {
+      Reference(&call_expr->target());
+    }
+    for (const Expr& arg : call_expr->args()) {
+      Reference(&arg);
+    }
+  }
+
+  void PostVisitArg(int arg_num, const Expr* expr,
+                    const SourcePosition*) override {
+    // Comprehension variables are in scope of the loop condition, the loop
+    // step and the result, visited after the accumulator initializer.
+    if (!expr->has_comprehension_expr() || arg_num != ACCU_INIT) {
+      return;
+    }
+    const Expr::Comprehension& comprehension = expr->comprehension_expr();
+    absl::optional<std::string> range_path;
+    auto it = paths_.find(&comprehension.iter_range());
+    if (it != paths_.end()) {
+      range_path = it->second;
+    }
+    scopes_.emplace_back(comprehension.accu_var(), absl::nullopt);
+    scopes_.emplace_back(comprehension.iter_var(), std::move(range_path));
+  }
+
+  void PostVisitComprehension(const Expr::Comprehension* comprehension_expr,
+                              const Expr*, const SourcePosition*) override {
+    scopes_.pop_back();
+    scopes_.pop_back();
+    absl::optional<std::string> range_path =
+        TakePath(&comprehension_expr->iter_range());
+    // The range is referenced as a whole, unless fields of its elements
+    // are, e.g. if the loop only counts the elements.
+    if (range_path.has_value() && !IsReferenced(*range_path)) {
+      referenced_.insert(*range_path);
+    }
+    Reference(&comprehension_expr->accu_init());
+    Reference(&comprehension_expr->loop_condition());
+    Reference(&comprehension_expr->loop_step());
+    Reference(&comprehension_expr->result());
+  }
+
+  void PostVisitCreateList(const Expr::CreateList* list_expr, const Expr*,
+                           const SourcePosition*) override {
+    for (const Expr& element : list_expr->elements()) {
+      Reference(&element);
+    }
+  }
+
+  void PostVisitCreateStruct(const Expr::CreateStruct* struct_expr,
+                             const Expr*, const SourcePosition*) override {
+    for (const auto& entry : struct_expr->entries()) {
+      if (entry.has_map_key()) {
+        Reference(&entry.map_key());
+      }
+      Reference(&entry.value());
+    }
+  }
+
+  // Returns the referenced paths, including the path of the root.
+  FieldMask ReferencedPaths(const Expr* root) {
+    Reference(root);
+    FieldMask paths;
+    for (const std::string& path : referenced_) {
+      paths.add_paths(path);
+    }
+    return paths;
+  }
+
+ private:
+  absl::optional<std::string> TakePath(const Expr* expr) {
+    auto it = paths_.find(expr);
+    if (it == paths_.end()) {
+      return absl::nullopt;
+    }
+    std::string path = std::move(it->second);
+    paths_.erase(it);
+    return path;
+  }
+
+  // References the path of the subexpression as a whole, if it denotes one.
+  void Reference(const Expr* expr) {
+    absl::optional<std::string> path = TakePath(expr);
+    if (path.has_value()) {
+      referenced_.insert(std::move(*path));
+    }
+  }
+
+  // Returns whether the path or one of its subpaths is referenced.
+  bool IsReferenced(const std::string& path) const {
+    if (referenced_.count(path) > 0) {
+      return true;
+    }
+    std::string prefix = absl::StrCat(path, ".");
+    auto it = referenced_.lower_bound(prefix);
+    return it != referenced_.end() && absl::StartsWith(*it, prefix);
+  }
+
+  // Paths denoted by the subexpressions not yet used by their parents.
+  std::unordered_map<const Expr*, std::string> paths_;
+  // Comprehension variables in scope, with the paths of the ranges of the
+  // iteration variables.
+  std::vector<std::pair<std::string, absl::optional<std::string>>> scopes_;
+  std::set<std::string> referenced_;
+};
+
+// Appends the path to the mask, truncated at the first field that is not a
+// singular message field.
+void AddMessagePath(absl::string_view path, const Descriptor* descriptor,
+                    FieldMask* mask) {
+  std::string message_path;
+  for (absl::string_view name : absl::StrSplit(path, '.')) {
+    const FieldDescriptor* field_desc =
+        descriptor->FindFieldByName(std::string(name));
+    if (field_desc == nullptr) {
+      break;
+    }
+    absl::StrAppend(&message_path, message_path.empty() ? "" : ".", name);
+    if (field_desc->is_repeated() ||
+        field_desc->cpp_type() != FieldDescriptor::CPPTYPE_MESSAGE) {
+      break;
+    }
+    descriptor = field_desc->message_type();
+  }
+  if (!message_path.empty()) {
+    mask->add_paths(message_path);
+  }
+}
+
+}  // namespace
+
+FieldMask FindReferencedPaths(const Expr& expr) {
+  ReferencedPathsVisitor visitor;
+  SourceInfo source_info;
+  AstTraverse(&expr, &source_info, &visitor);
+  FieldMask paths;
+  FieldMaskUtil::ToCanonicalForm(visitor.ReferencedPaths(&expr), &paths);
+  return paths;
+}
+
+FieldMask FindMessageFieldMask(const FieldMask& referenced_paths,
+                               absl::string_view variable,
+                               const Descriptor* descriptor) {
+  FieldMask mask;
+  std::string prefix = variable.empty() ? "" : absl::StrCat(variable, ".");
+  for (const std::string& path : referenced_paths.paths()) {
+    if (!variable.empty() && path == variable) {
+      for (int i = 0; i < descriptor->field_count(); i++) {
+        mask.add_paths(descriptor->field(i)->name());
+      }
+      continue;
+    }
+    if (absl::StartsWith(path, prefix)) {
+      AddMessagePath(absl::string_view(path).substr(prefix.size()), descriptor,
+                     &mask);
+    }
+  }
+  FieldMask canonical_mask;
+  FieldMaskUtil::ToCanonicalForm(mask, &canonical_mask);
+  return canonical_mask;
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,48 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REFERENCED_PATHS_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REFERENCED_PATHS_H_
+
+#include "google/api/expr/v1alpha1/syntax.pb.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/field_mask.pb.h"
+#include "absl/strings/string_view.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Returns the paths of the variables and fields the expression references,
+// in the canonical form of field masks: sorted, and without the paths
+// covered by others. A path is the name of a free variable followed by the
+// fields selected from its value, e.g. for the expression
+//   request.user.name == "admin" && has(request.auth.token)
+// the paths are "request.auth.token" and "request.user.name".
+//
+// Selects on comprehension variables iterating over fields extend the paths
+// of the fields: 'request.items.all(i, i.price > 0)' references
+// "request.items.price". Values used other than by selects, e.g. as
+// function arguments, are referenced as a whole.
+google::protobuf::FieldMask FindReferencedPaths(
+    const google::api::expr::v1alpha1::Expr& expr);
+
+// Converts the referenced paths into a field mask of the message bound to
+// the variable, for pruning the message with FieldMaskUtil::TrimMessage or
+// skipping the decoding of the fields not referenced. If variable is empty,
+// the message is the namespace of the variables, as bound by
+// BindProtoToActivation.
+//
+// Paths are truncated at fields that are repeated or not messages, as field
+// masks do not select fields of their elements. A reference to the whole
+// message yields all its fields, and names of fields not declared by the
+// descriptor are dropped. The mask is empty if the message is not
+// referenced.
+google::protobuf::FieldMask FindMessageFieldMask(
+    const google::protobuf::FieldMask& referenced_paths,
+    absl::string_view variable, const google::protobuf::Descriptor* descriptor);
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REFERENCED_PATHS_H_
@@ -0,0 +1,314 @@
+#include "eval/public/referenced_paths.h"
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "eval/testutil/test_message.pb.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::api::expr::v1alpha1::Expr;
+using google::protobuf::FieldMask;
+using testing::ElementsAre;
+using testing::IsEmpty;
+
+std::vector<std::string> Paths(const FieldMask& mask) {
+  return std::vector<std::string>(mask.paths().begin(), mask.paths().end());
+}
+
+std::vector<std::string> ReferencedPaths(const std::string& expr_text) {
+  Expr expr;
+  EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+  return Paths(FindReferencedPaths(expr));
+}
+
+TEST(ReferencedPathsTest, Selects) {
+  // request.user.name == "admin" && request.user.id > 0
+  EXPECT_THAT(ReferencedPaths(R"(
+    call_expr {
+      function: "_&&_"
+      args {
+        call_expr {
+          function: "_==_"
+          args {
+            select_expr {
+              operand {
+                select_expr {
+                  operand { ident_expr { name: "request" } }
+                  field: "user"
+                }
+              }
+              field: "name"
+            }
+          }
+          args { const_expr { string_value: "admin" } }
+        }
+      }
+      args {
+        call_expr {
+          function: "_>_"
+          args {
+            select_expr {
+              operand {
+                select_expr {
+                  operand { ident_expr { name: "request" } }
+                  field: "user"
+                }
+              }
+              field: "id"
+            }
+          }
+          args { const_expr { int64_value: 0 } }
+        }
+      }
+    })"),
+              ElementsAre("request.user.id", "request.user.name"));
+}
+
+TEST(ReferencedPathsTest, WholeValues) {
+  // size(request.items) + x
+  EXPECT_THAT(ReferencedPaths(R"(
+    call_expr {
+      function: "_+_"
+      args {
+        call_expr {
+          function: "size"
+          args {
+            select_expr {
+              operand { ident_expr { name: "request" } }
+              field: "items"
+            }
+          }
+        }
+      }
+      args { ident_expr { name: "x" } }
+    })"),
+              ElementsAre("request.items", "x"));
+
+  // A path covers its subpaths: request.user == request.user.name
+  EXPECT_THAT(ReferencedPaths(R"(
+    call_expr {
+      function: "_==_"
+      args {
+        select_expr {
+          operand { ident_expr { name: "request" } }
+          field: "user"
+        }
+      }
+      args {
+        select_expr {
+          operand {
+            select_expr {
+              operand { ident_expr { name: "request" } }
+              field: "user"
+            }
+          }
+          field: "name"
+        }
+      }
+    })"),
+              ElementsAre("request.user"));
+
+  // The root is referenced.
+  EXPECT_THAT(ReferencedPaths(R"(
+    select_expr {
+      operand { ident_expr { name: "request" } }
+      field: "user"
+    })"),
+              ElementsAre("request.user"));
+  EXPECT_THAT(ReferencedPaths("const_expr { int64_value: 1 }"), IsEmpty());
+}
+
+TEST(ReferencedPathsTest, HasTest) {
+  // has(request.auth.token)
+  EXPECT_THAT(ReferencedPaths(R"(
+    select_expr {
+      operand {
+        select_expr {
+          operand { ident_expr { name: "request" } }
+          field: "auth"
+        }
+      }
+      field: "token"
+      test_only: true
+    })"),
+              ElementsAre("request.auth.token"));
+}
+
+TEST(ReferencedPathsTest, Comprehensions) {
+  // request.items.all(i, i.price > 0)
+  EXPECT_THAT(ReferencedPaths(R"(
+    comprehension_expr {
+      iter_var: "i"
+      iter_range {
+        select_expr {
+          operand { ident_expr { name: "request" } }
+          field: "items"
+        }
+      }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: true } }
+      loop_condition { ident_expr { name: "__result__" } }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_>_"
+              args {
+                select_expr {
+                  operand { ident_expr { name: "i" } }
+                  field: "price"
+                }
+              }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })"),
+              ElementsAre("request.items.price"));
+
+  // Elements used as a whole, and ranges whose elements are not used:
+  // request.items.exists(i, i == x) || request.tags.all(t, true)
+  EXPECT_THAT(ReferencedPaths(R"(
+    call_expr {
+      function: "_||_"
+      args {
+        comprehension_expr {
+          iter_var: "i"
+          iter_range {
+            select_expr {
+              operand { ident_expr { name: "request" } }
+              field: "items"
+            }
+          }
+          accu_var: "__result__"
+          accu_init { const_expr { bool_value: false } }
+          loop_condition { const_expr { bool_value: true } }
+          loop_step {
+            call_expr {
+              function: "_||_"
+              args { ident_expr { name: "__result__" } }
+              args {
+                call_expr {
+                  function: "_==_"
+                  args { ident_expr { name: "i" } }
+                  args { ident_expr { name: "x" } }
+                }
+              }
+            }
+          }
+          result { ident_expr { name: "__result__" } }
+        }
+      }
+      args {
+        comprehension_expr {
+          iter_var: "t"
+          iter_range {
+            select_expr {
+              operand { ident_expr { name: "request" } }
+              field: "tags"
+            }
+          }
+          accu_var: "__result__"
+          accu_init { const_expr { bool_value: true } }
+          loop_condition { const_expr { bool_value: true } }
+          loop_step { const_expr { bool_value: true } }
+          result { ident_expr { name: "__result__" } }
+        }
+      }
+    })"),
+              ElementsAre("request.items", "request.tags", "x"));
+}
+
+TEST(ReferencedPathsTest, ComprehensionVariablesShadowVariables) {
+  // [1].map(request, request.user) + [request.id]
+  EXPECT_THAT(ReferencedPaths(R"(
+    call_expr {
+      function: "_+_"
+      args {
+        comprehension_expr {
+          iter_var: "request"
+          iter_range { list_expr { elements { const_expr { int64_value: 1 } } } }
+          accu_var: "__result__"
+          accu_init { list_expr {} }
+          loop_condition { const_expr { bool_value: true } }
+          loop_step {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args {
+                list_expr {
+                  elements {
+                    select_expr {
+                      operand { ident_expr { name: "request" } }
+                      field: "user"
+                    }
+                  }
+                }
+              }
+            }
+          }
+          result { ident_expr { name: "__result__" } }
+        }
+      }
+      args {
+        list_expr {
+          elements {
+            select_expr {
+              operand { ident_expr { name: "request" } }
+              field: "id"
+            }
+          }
+        }
+      }
+    })"),
+              ElementsAre("request.id"));
+}
+
+TEST(ReferencedPathsTest, MessageFieldMask) {
+  FieldMask paths;
+  paths.add_paths("message.message_value.int64_value");
+  paths.add_paths("message.message_list.int64_value");
+  paths.add_paths("message.string_int32_map.key");
+  paths.add_paths("message.int64_value.unknown");
+  paths.add_paths("message.unknown");
+  paths.add_paths("other");
+
+  EXPECT_THAT(Paths(FindMessageFieldMask(paths, "message",
+                                         TestMessage::descriptor())),
+              ElementsAre("int64_value", "message_list",
+                          "message_value.int64_value", "string_int32_map"));
+  EXPECT_THAT(
+      Paths(FindMessageFieldMask(paths, "other", TestMessage::descriptor())),
+      testing::Contains("message_value"));
+  EXPECT_THAT(
+      Paths(FindMessageFieldMask(paths, "none", TestMessage::descriptor())),
+      IsEmpty());
+
+  // Paths relative to the message bound as the namespace of the variables.
+  FieldMask namespace_paths;
+  namespace_paths.add_paths("message_value.bool_value");
+  namespace_paths.add_paths("int32_value");
+  EXPECT_THAT(Paths(FindMessageFieldMask(namespace_paths, "",
+                                         TestMessage::descriptor())),
+              ElementsAre("int32_value", "message_value.bool_value"));
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,94 @@
+#include "eval/public/regex_match.h"
+
+#include "eval/public/cel_builtins.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+// Maximum number of patterns in the global cache.
+constexpr size_t kGlobalCacheSize = 256;
+
+}  // namespace
+
+std::shared_ptr<const RE2> RegexCache::Get(absl::string_view pattern) {
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = index_.find(pattern);
+    if (it != index_.end()) {
+      entries_.splice(entries_.begin(), entries_, it->second);
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second->second;
+    }
+  }
+
+  // Patterns are compiled outside of the lock, so that lookups of other
+  // patterns are not blocked. Concurrent misses of the same pattern may
+  // compile it more than once.
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  auto re2 = std::make_shared<const RE2>(
+      re2::StringPiece(pattern.data(), pattern.size()), RE2::Quiet);
+  if (max_size_ == 0) {
+    return re2;
+  }
+
+  absl::MutexLock lock(&mutex_);
+  auto it = index_.find(pattern);
+  if (it != index_.end()) {
+    return it->second->second;
+  }
+  if (entries_.size() >= max_size_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.emplace_front(std::string(pattern), re2);
+  index_.emplace(entries_.front().first, entries_.begin());
+  return re2;
+}
+
+size_t RegexCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return entries_.size();
+}
+
+RegexCache* RegexCache::Global() {
+  static RegexCache* cache = new RegexCache(kGlobalCacheSize);
+  return cache;
+}
+
+CelValue RegexMatchResult(google::protobuf::Arena* arena,
+                          absl::string_view target, const RE2& re2) {
+  if (!re2.ok()) {
+    return CreateErrorValue(arena, "invalid_argument",
+                            CelError::INVALID_ARGUMENT);
+  }
+  return CelValue::CreateBool(
+      RE2::FullMatch(re2::StringPiece(target.data(), target.size()), re2));
+}
+
+RegexMatchFunction::RegexMatchFunction(bool receiver_style, RegexCache* cache)
+    : CelFunction({builtin::kRegexMatch,
+                   receiver_style,
+                   {CelValue::Type::kString, CelValue::Type::kString}}),
+      cache_(cache) {}
+
+util::Status RegexMatchFunction::Evaluate(absl::Span<const CelValue> arguments,
+                                          CelValue* result,
+                                          google::protobuf::Arena* arena) const {
+  if (arguments.size() != 2 || !arguments[0].IsString() ||
+      !arguments[1].IsString()) {
+    return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                            "matches: want (string, string) arguments");
+  }
+  auto re2 = cache_->Get(arguments[1].StringOrDie().value());
+  *result = RegexMatchResult(arena, arguments[0].StringOrDie().value(), *re2);
+  return util::OkStatus();
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
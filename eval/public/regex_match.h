@@ -0,0 +1,84 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REGEX_MATCH_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REGEX_MATCH_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <string>
+
+#include "absl/container/node_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "eval/public/cel_function.h"
+#include "eval/public/cel_value.h"
+#include "re2/re2.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// RegexCache keeps compiled regular expressions for patterns that are only
+// known at evaluation time, so that they are not compiled on every call.
+// It holds at most max_size patterns, evicting the least recently used one.
+// Thread-safe.
+class RegexCache {
+ public:
+  explicit RegexCache(size_t max_size)
+      : max_size_(max_size), hits_(0), misses_(0) {}
+
+  // Returns the compiled pattern, compiling it on a cache miss. Invalid
+  // patterns are cached too, the caller checks RE2::ok(). The returned
+  // regex stays valid after it is evicted from the cache.
+  std::shared_ptr<const RE2> Get(absl::string_view pattern);
+
+  // Number of lookups that found a compiled pattern.
+  int64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+  // Number of lookups that compiled the pattern.
+  int64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  // Number of cached patterns.
+  size_t size() const;
+
+  // Cache used by the builtin matches() function.
+  static RegexCache* Global();
+
+ private:
+  using Entry = std::pair<std::string, std::shared_ptr<const RE2>>;
+
+  const size_t max_size_;
+  mutable absl::Mutex mutex_;
+  // Entries from the most to the least recently used. Keys of the index
+  // point into the patterns of the entries.
+  std::list<Entry> entries_;
+  absl::node_hash_map<absl::string_view, std::list<Entry>::iterator> index_;
+  std::atomic<int64_t> hits_;
+  std::atomic<int64_t> misses_;
+};
+
+// Returns the result of matches() for the target and the compiled pattern:
+// a bool, or an error if the pattern is invalid.
+CelValue RegexMatchResult(google::protobuf::Arena* arena,
+                          absl::string_view target, const RE2& re2);
+
+// Implementation of the builtin matches(string, string) function, which
+// looks patterns up in the cache. Expression builders may replace it with
+// a regex compiled at build time if the pattern is a constant.
+class RegexMatchFunction : public CelFunction {
+ public:
+  RegexMatchFunction(bool receiver_style, RegexCache* cache);
+
+  util::Status Evaluate(absl::Span<const CelValue> arguments, CelValue* result,
+                        google::protobuf::Arena* arena) const override;
+
+ private:
+  RegexCache* cache_;
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_REGEX_MATCH_H_
@@ -0,0 +1,122 @@
+#include "eval/public/regex_match.h"
+
+#include <thread>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using testing::Eq;
+
+TEST(RegexCacheTest, CountsHitsAndMisses) {
+  RegexCache cache(2);
+
+  auto re2 = cache.Get("a+");
+  ASSERT_TRUE(re2->ok());
+  EXPECT_TRUE(RE2::FullMatch("aaa", *re2));
+  EXPECT_THAT(cache.misses(), Eq(1));
+  EXPECT_THAT(cache.hits(), Eq(0));
+
+  EXPECT_THAT(cache.Get("a+"), Eq(re2));
+  EXPECT_THAT(cache.misses(), Eq(1));
+  EXPECT_THAT(cache.hits(), Eq(1));
+  EXPECT_THAT(cache.size(), Eq(1));
+}
+
+TEST(RegexCacheTest, EvictsLeastRecentlyUsed) {
+  RegexCache cache(2);
+
+  auto a = cache.Get("a");
+  cache.Get("b");
+  // "a" is used more recently than "b".
+  cache.Get("a");
+  cache.Get("c");
+  EXPECT_THAT(cache.size(), Eq(2));
+  EXPECT_THAT(cache.misses(), Eq(3));
+
+  cache.Get("a");
+  EXPECT_THAT(cache.misses(), Eq(3));
+  cache.Get("b");
+  EXPECT_THAT(cache.misses(), Eq(4));
+
+  // Evicted regexes stay valid.
+  EXPECT_TRUE(RE2::FullMatch("a", *a));
+}
+
+TEST(RegexCacheTest, PatternIsNotNullTerminated) {
+  RegexCache cache(2);
+  absl::string_view patterns = "abc";
+
+  auto re2 = cache.Get(patterns.substr(0, 2));
+  EXPECT_TRUE(RE2::FullMatch("ab", *re2));
+  EXPECT_FALSE(RE2::FullMatch("abc", *re2));
+}
+
+TEST(RegexCacheTest, CachesInvalidPattern) {
+  RegexCache cache(2);
+
+  EXPECT_FALSE(cache.Get("(")->ok());
+  EXPECT_FALSE(cache.Get("(")->ok());
+  EXPECT_THAT(cache.misses(), Eq(1));
+}
+
+TEST(RegexCacheTest, ConcurrentLookups) {
+  RegexCache cache(4);
+  const std::vector<std::string> patterns = {"a", "b", "c", "d", "e", "f"};
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&cache, &patterns, i]() {
+      for (int j = 0; j < 1000; j++) {
+        const std::string& pattern = patterns[(i + j) % patterns.size()];
+        EXPECT_TRUE(RE2::FullMatch(pattern, *cache.Get(pattern)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(cache.hits() + cache.misses(), Eq(4000));
+  EXPECT_THAT(cache.size(), Eq(4));
+}
+
+TEST(RegexMatchFunctionTest, Evaluate) {
+  RegexCache cache(2);
+  RegexMatchFunction function(false, &cache);
+  google::protobuf::Arena arena;
+  std::string target = "aaab";
+  std::string pattern = "a+b";
+  std::string invalid_pattern = "(";
+
+  CelValue result;
+  ASSERT_TRUE(util::IsOk(function.Evaluate(
+      {CelValue::CreateString(&target), CelValue::CreateString(&pattern)},
+      &result, &arena)));
+  ASSERT_TRUE(result.IsBool());
+  EXPECT_TRUE(result.BoolOrDie());
+
+  ASSERT_TRUE(util::IsOk(function.Evaluate(
+      {CelValue::CreateString(&pattern), CelValue::CreateString(&target)},
+      &result, &arena)));
+  ASSERT_TRUE(result.IsBool());
+  EXPECT_FALSE(result.BoolOrDie());
+
+  ASSERT_TRUE(util::IsOk(function.Evaluate(
+      {CelValue::CreateString(&target),
+       CelValue::CreateString(&invalid_pattern)},
+      &result, &arena)));
+  EXPECT_TRUE(result.IsError());
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
@@ -0,0 +1,117 @@
+#include "eval/public/timestamp_accessor.h"
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "absl/synchronization/mutex.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+// Parses UTC offset in the [+-]HH:MM format.
+bool ParseUtcOffset(absl::string_view name, absl::TimeZone* time_zone) {
+  if (name.size() != 6 || (name[0] != '+' && name[0] != '-') ||
+      name[3] != ':') {
+    return false;
+  }
+  for (int i : {1, 2, 4, 5}) {
+    if (!absl::ascii_isdigit(name[i])) {
+      return false;
+    }
+  }
+  int hours = (name[1] - '0') * 10 + (name[2] - '0');
+  int minutes = (name[4] - '0') * 10 + (name[5] - '0');
+  if (hours > 23 || minutes > 59) {
+    return false;
+  }
+  int seconds = (hours * 60 + minutes) * 60;
+  *time_zone = absl::FixedTimeZone(name[0] == '-' ? -seconds : seconds);
+  return true;
+}
+
+// Valid time zones by name. Invalid names are not cached, so that the cache
+// size is bounded by the number of time zones.
+class TimeZoneCache {
+ public:
+  bool Find(absl::string_view name, absl::TimeZone* time_zone) {
+    {
+      absl::ReaderMutexLock lock(&mutex_);
+      auto it = time_zones_.find(name);
+      if (it != time_zones_.end()) {
+        *time_zone = it->second;
+        return true;
+      }
+    }
+
+    if (!ParseUtcOffset(name, time_zone) &&
+        !absl::LoadTimeZone(std::string(name), time_zone)) {
+      return false;
+    }
+    absl::MutexLock lock(&mutex_);
+    time_zones_.emplace(name, *time_zone);
+    return true;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, absl::TimeZone> time_zones_;
+};
+
+}  // namespace
+
+bool FindTimeZone(absl::string_view name, absl::TimeZone* time_zone) {
+  if (name.empty()) {
+    *time_zone = absl::UTCTimeZone();
+    return true;
+  }
+  static TimeZoneCache* cache = new TimeZoneCache();
+  return cache->Find(name, time_zone);
+}
+
+TimestampAccessorFunction::TimestampAccessorFunction(const std::string& name,
+                                                     bool with_time_zone,
+                                                     Extractor extractor)
+    : CelFunction({name, true,
+                   with_time_zone
+                       ? std::vector<CelValue::Type>{CelValue::Type::kTimestamp,
+                                                     CelValue::Type::kString}
+                       : std::vector<CelValue::Type>{
+                             CelValue::Type::kTimestamp}}),
+      extractor_(extractor) {}
+
+util::Status TimestampAccessorFunction::Evaluate(
+    absl::Span<const CelValue> arguments, CelValue* result,
+    google::protobuf::Arena* arena) const {
+  if (arguments.size() != descriptor().types.size() ||
+      !arguments[0].IsTimestamp() ||
+      (arguments.size() == 2 && !arguments[1].IsString())) {
+    return util::MakeStatus(google::rpc::Code::INVALID_ARGUMENT,
+                            "Timestamp accessor: unexpected arguments");
+  }
+
+  absl::TimeZone time_zone;
+  absl::string_view name =
+      arguments.size() == 2 ? arguments[1].StringOrDie().value() : "";
+  if (!FindTimeZone(name, &time_zone)) {
+    *result = CreateErrorValue(arena, "Invalid timezone",
+                               CelError::Code::CelError_Code_UNKNOWN);
+    return util::OkStatus();
+  }
+  *result = Extract(arguments[0].AbslTimestampOrDie(), time_zone);
+  return util::OkStatus();
+}
+
+CelValue TimestampAccessorFunction::Extract(
+    absl::Time timestamp, const absl::TimeZone& time_zone) const {
+  return extractor_(time_zone.At(timestamp));
+}
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
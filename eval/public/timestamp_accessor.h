@@ -0,0 +1,47 @@
+#ifndef THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_TIMESTAMP_ACCESSOR_H_
+#define THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_TIMESTAMP_ACCESSOR_H_
+
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "eval/public/cel_function.h"
+#include "eval/public/cel_value.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+// Finds the time zone by its IANA name (e.g. "America/New_York") or UTC
+// offset ("+05:30"). The empty name stands for UTC. Returns false if the
+// time zone is not valid.
+// Time zones are loaded once per process, and kept in a thread-safe cache.
+bool FindTimeZone(absl::string_view name, absl::TimeZone* time_zone);
+
+// Implementation of the builtin timestamp accessors, e.g. getHours(), with
+// or without the time zone argument. Expression builders may resolve a
+// constant time zone argument in advance, and call Extract() directly.
+class TimestampAccessorFunction : public CelFunction {
+ public:
+  // Extracts the value of the accessor from the civil time.
+  using Extractor = CelValue (*)(const absl::TimeZone::CivilInfo& breakdown);
+
+  TimestampAccessorFunction(const std::string& name, bool with_time_zone,
+                            Extractor extractor);
+
+  util::Status Evaluate(absl::Span<const CelValue> arguments, CelValue* result,
+                        google::protobuf::Arena* arena) const override;
+
+  // Returns the value of the accessor for the timestamp in the time zone.
+  CelValue Extract(absl::Time timestamp,
+                   const absl::TimeZone& time_zone) const;
+
+ private:
+  Extractor extractor_;
+};
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
+
+#endif  // THIRD_PARTY_CEL_CPP_EVAL_PUBLIC_TIMESTAMP_ACCESSOR_H_
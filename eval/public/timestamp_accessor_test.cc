@@ -0,0 +1,104 @@
+#include "eval/public/timestamp_accessor.h"
+
+#include "google/protobuf/arena.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace google {
+namespace api {
+namespace expr {
+namespace runtime {
+
+namespace {
+
+using google::protobuf::Arena;
+using google::protobuf::Timestamp;
+using testing::Eq;
+
+CelValue GetHours(const absl::TimeZone::CivilInfo& breakdown) {
+  return CelValue::CreateInt64(breakdown.cs.hour());
+}
+
+TEST(FindTimeZoneTest, EmptyNameIsUtc) {
+  absl::TimeZone time_zone = absl::FixedTimeZone(3600);
+  ASSERT_TRUE(FindTimeZone("", &time_zone));
+  EXPECT_THAT(time_zone, Eq(absl::UTCTimeZone()));
+}
+
+TEST(FindTimeZoneTest, FindsNamedTimeZones) {
+  absl::TimeZone time_zone;
+  ASSERT_TRUE(FindTimeZone("America/New_York", &time_zone));
+  EXPECT_THAT(time_zone.name(), Eq("America/New_York"));
+
+  // Found in the cache the second time.
+  absl::TimeZone cached;
+  ASSERT_TRUE(FindTimeZone("America/New_York", &cached));
+  EXPECT_THAT(cached, Eq(time_zone));
+}
+
+TEST(FindTimeZoneTest, FindsUtcOffsets) {
+  absl::TimeZone time_zone;
+  ASSERT_TRUE(FindTimeZone("+05:30", &time_zone));
+  EXPECT_THAT(time_zone, Eq(absl::FixedTimeZone(5 * 3600 + 30 * 60)));
+
+  ASSERT_TRUE(FindTimeZone("-08:00", &time_zone));
+  EXPECT_THAT(time_zone, Eq(absl::FixedTimeZone(-8 * 3600)));
+}
+
+TEST(FindTimeZoneTest, RejectsInvalidNames) {
+  absl::TimeZone time_zone;
+  EXPECT_FALSE(FindTimeZone("Nowhere/Nope", &time_zone));
+  EXPECT_FALSE(FindTimeZone("+25:00", &time_zone));
+  EXPECT_FALSE(FindTimeZone("+05:60", &time_zone));
+  EXPECT_FALSE(FindTimeZone("05:30", &time_zone));
+  EXPECT_FALSE(FindTimeZone("+5:30", &time_zone));
+}
+
+TEST(TimestampAccessorFunctionTest, Evaluate) {
+  Arena arena;
+  Timestamp timestamp;
+  // 2020-01-01T12:00:00Z
+  timestamp.set_seconds(1577880000);
+
+  std::string offset = "+05:30";
+  std::string named = "America/New_York";
+  std::string invalid = "Nowhere/Nope";
+  TimestampAccessorFunction utc_hours("getHours", false, GetHours);
+  CelValue result;
+  CelValue args[] = {CelValue::CreateTimestamp(&timestamp),
+                     CelValue::CreateString(&offset)};
+  ASSERT_TRUE(util::IsOk(utc_hours.Evaluate(absl::MakeSpan(args, 1), &result,
+                                            &arena)));
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(12));
+
+  TimestampAccessorFunction hours("getHours", true, GetHours);
+  ASSERT_TRUE(util::IsOk(hours.Evaluate(args, &result, &arena)));
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(17));
+
+  args[1] = CelValue::CreateString(&named);
+  ASSERT_TRUE(util::IsOk(hours.Evaluate(args, &result, &arena)));
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(7));
+
+  args[1] = CelValue::CreateString(&invalid);
+  ASSERT_TRUE(util::IsOk(hours.Evaluate(args, &result, &arena)));
+  ASSERT_TRUE(result.IsError());
+  EXPECT_THAT(result.ErrorOrDie()->message(), Eq("Invalid timezone"));
+}
+
+TEST(TimestampAccessorFunctionTest, Extract) {
+  TimestampAccessorFunction hours("getHours", true, GetHours);
+  CelValue result = hours.Extract(absl::FromUnixSeconds(1577880000),
+                                  absl::FixedTimeZone(-8 * 3600));
+  ASSERT_TRUE(result.IsInt64());
+  EXPECT_THAT(result.Int64OrDie(), Eq(4));
+}
+
+}  // namespace
+
+}  // namespace runtime
+}  // namespace expr
+}  // namespace api
+}  // namespace google
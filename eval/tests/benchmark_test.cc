@@ -1,13 +1,47 @@
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <new>
+#include <thread>
+
 #include "benchmark/benchmark.h"
+#include "google/protobuf/text_format.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include "eval/compiler/flat_expr_builder.h"
+#include "eval/eval/container_backed_list_impl.h"
+#include "eval/eval/wire_message_impl.h"
 #include "eval/public/activation.h"
+#include "eval/public/activation_bind_helper.h"
 #include "eval/public/builtin_func_registrar.h"
+#include "eval/public/cel_executor.h"
 #include "eval/public/cel_expr_builder_factory.h"
 #include "eval/public/cel_expression.h"
 #include "eval/public/cel_value.h"
+#include "eval/testutil/test_message.pb.h"
 #include "google/api/expr/v1alpha1/syntax.pb.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+
+// Number of heap allocations made by the process.
+// Maintained by the replacement of global operator new below, so that
+// benchmarks can verify that evaluation does not allocate.
+static std::atomic<int64_t> heap_allocation_count(0);
+
+void* operator new(size_t size) {
+  heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
 
 namespace google {
 namespace api {
@@ -19,48 +53,1418 @@ namespace {
 using google::api::expr::v1alpha1::Expr;
 using google::api::expr::v1alpha1::SourceInfo;
 
+// Builds cel expression:
+// '1 + 1 + 1 .... +1'
+std::unique_ptr<CelExpression> BuildConstSum(CelExpressionBuilder* builder,
+                                             Expr* root_expr, int len) {
+  Expr* cur_expr = root_expr;
+
+  for (int i = 0; i < len; i++) {
+    Expr::Call* call = cur_expr->mutable_call_expr();
+    call->set_function("_+_");
+    call->add_args()->mutable_const_expr()->set_int64_value(1);
+    cur_expr = call->add_args();
+  }
+
+  cur_expr->mutable_const_expr()->set_int64_value(1);
+
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(root_expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  return std::move(cel_expr_status.ValueOrDie());
+}
+
 // Benchmark test
 // Evaluates cel expression:
 // '1 + 1 + 1 .... +1'
 static void BM_Eval(benchmark::State& state) {
+  // Folding would reduce the expression to a single constant.
+  FlatExprBuilder builder;
+  builder.set_constant_folding(false);
+  auto reg_status = RegisterBuiltinFunctions(builder.GetRegistry());
+  GOOGLE_CHECK(util::IsOk(reg_status));
+
+  int len = state.range(0);
+
+  Expr root_expr;
+  auto cel_expr = BuildConstSum(&builder, &root_expr, len);
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsInt64());
+    GOOGLE_CHECK(result.Int64OrDie() == len + 1);
+  }
+}
+
+BENCHMARK(BM_Eval)->Range(1, 32768);
+
+// Benchmark test
+// Evaluates cel expression:
+// '1 + 1 + 1 .... +1'
+// reusing evaluation state across iterations.
+// Reports heap allocations per evaluation, which are expected to be zero.
+static void BM_EvalReusedState(benchmark::State& state) {
+  FlatExprBuilder builder;
+  builder.set_constant_folding(false);
+  auto reg_status = RegisterBuiltinFunctions(builder.GetRegistry());
+  GOOGLE_CHECK(util::IsOk(reg_status));
+
+  int len = state.range(0);
+
+  Expr root_expr;
+  auto cel_expr = BuildConstSum(&builder, &root_expr, len);
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  auto eval_state = cel_expr->InitializeState(&arena);
+
+  // Warm up, so that only the steady state is measured.
+  GOOGLE_CHECK(util::IsOk(
+      cel_expr->Evaluate(activation, eval_state.get()).status()));
+
+  int64_t allocations = 0;
+  for (auto _ : state) {
+    int64_t allocations_before = heap_allocation_count.load();
+    auto eval_result = cel_expr->Evaluate(activation, eval_state.get());
+    allocations += heap_allocation_count.load() - allocations_before;
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsInt64());
+    GOOGLE_CHECK(result.Int64OrDie() == len + 1);
+  }
+  GOOGLE_CHECK(allocations == 0) << allocations << " heap allocations";
+  state.counters["allocs_per_eval"] = benchmark::Counter(
+      allocations, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_EvalReusedState)->Range(1, 32768);
+
+// Benchmark test
+// Evaluates cel expression:
+// '1 + 1 + 1 .... +1'
+// with the instruction engine.
+static void BM_EvalInstructionEngine(benchmark::State& state) {
+  FlatExprBuilder builder;
+  builder.set_instruction_engine(true);
+  builder.set_constant_folding(false);
+  auto reg_status = RegisterBuiltinFunctions(builder.GetRegistry());
+  GOOGLE_CHECK(util::IsOk(reg_status));
+
+  int len = state.range(0);
+
+  Expr root_expr;
+  auto cel_expr = BuildConstSum(&builder, &root_expr, len);
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsInt64());
+    GOOGLE_CHECK(result.Int64OrDie() == len + 1);
+  }
+}
+
+BENCHMARK(BM_EvalInstructionEngine)->Range(1, 32768);
+
+// Builds cel expression:
+// 'msg.int64_value + msg.message_value.int64_value + ...'
+// with len terms alternating between the two selects.
+std::unique_ptr<CelExpression> BuildSelectSum(CelExpressionBuilder* builder,
+                                              Expr* root_expr, int len) {
+  Expr* cur_expr = root_expr;
+  for (int i = len - 1; i >= 0; i--) {
+    Expr* select_expr = cur_expr;
+    if (i > 0) {
+      Expr::Call* call = cur_expr->mutable_call_expr();
+      call->set_function("_+_");
+      cur_expr = call->add_args();
+      select_expr = call->add_args();
+    }
+    auto select = select_expr->mutable_select_expr();
+    select->set_field("int64_value");
+    Expr* operand = select->mutable_operand();
+    if (i % 2 == 1) {
+      auto inner_select = operand->mutable_select_expr();
+      inner_select->set_field("message_value");
+      operand = inner_select->mutable_operand();
+    }
+    operand->mutable_ident_expr()->set_name("msg");
+  }
+
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(root_expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  return std::move(cel_expr_status.ValueOrDie());
+}
+
+// Evaluates select-heavy expression built by BuildSelectSum.
+void RunSelectSum(benchmark::State& state, bool instruction_engine) {
+  FlatExprBuilder builder;
+  builder.set_instruction_engine(instruction_engine);
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+
+  int len = state.range(0);
+  Expr root_expr;
+  auto cel_expr = BuildSelectSum(&builder, &root_expr, len);
+
+  google::protobuf::Arena arena;
+  TestMessage message;
+  message.set_int64_value(1);
+  message.mutable_message_value()->set_int64_value(1);
+
+  Activation activation;
+  activation.InsertValue("msg", CelValue::CreateMessage(&message, &arena));
+
+  for (auto _ : state) {
+    google::protobuf::Arena eval_arena;
+    auto eval_result = cel_expr->Evaluate(activation, &eval_arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().Int64OrDie() == len);
+  }
+}
+
+// Benchmark test
+// Evaluates cel expression:
+// 'msg.int64_value + msg.message_value.int64_value + ...'
+static void BM_SelectSum(benchmark::State& state) {
+  RunSelectSum(state, false);
+}
+
+BENCHMARK(BM_SelectSum)->Range(1, 512);
+
+// Benchmark test
+// Evaluates cel expression:
+// 'msg.int64_value + msg.message_value.int64_value + ...'
+// with the instruction engine.
+static void BM_SelectSumInstructionEngine(benchmark::State& state) {
+  RunSelectSum(state, true);
+}
+
+BENCHMARK(BM_SelectSumInstructionEngine)->Range(1, 512);
+
+// Builds cel expression:
+// 'list.all(x, x > 0)'
+std::unique_ptr<CelExpression> BuildListAll(CelExpressionBuilder* builder,
+                                            Expr* expr) {
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { ident_expr { name: "list" } }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: true } }
+      loop_condition {
+        call_expr {
+          function: "@not_strictly_false"
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_>_"
+              args { ident_expr { name: "x" } }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })",
+                                                         expr));
+
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+
+  return std::move(cel_expr_status.ValueOrDie());
+}
+
+// Benchmark test
+// Evaluates cel expression:
+// 'list.all(x, x > 0)'
+// over the list of positive integers, so every element is visited.
+// Reports per-element throughput of comprehension loop.
+static void BM_Comprehension(benchmark::State& state) {
   auto builder = CreateCelExpressionBuilder();
   auto reg_status = RegisterBuiltinFunctions(builder->GetRegistry());
   GOOGLE_CHECK(util::IsOk(reg_status));
 
+  Expr expr;
+  auto cel_expr = BuildListAll(builder.get(), &expr);
+
   int len = state.range(0);
+  std::vector<CelValue> elements;
+  elements.reserve(len);
+  for (int i = 0; i < len; i++) {
+    elements.push_back(CelValue::CreateInt64(i + 1));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
 
-  Expr root_expr;
-  Expr* cur_expr = &root_expr;
+  Activation activation;
+  activation.InsertValue("list", CelValue::CreateList(&cel_list));
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsBool());
+    GOOGLE_CHECK(result.BoolOrDie());
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
+
+BENCHMARK(BM_Comprehension)->Range(1, 32768);
+
+// Benchmark test
+// Evaluates cel expression:
+// 'list.all(x, x > 0)'
+// reusing evaluation state across iterations.
+// Reports heap allocations per evaluation, which are expected to be zero.
+static void BM_ComprehensionReusedState(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  auto reg_status = RegisterBuiltinFunctions(builder->GetRegistry());
+  GOOGLE_CHECK(util::IsOk(reg_status));
+
+  Expr expr;
+  auto cel_expr = BuildListAll(builder.get(), &expr);
+
+  int len = state.range(0);
+  std::vector<CelValue> elements;
+  elements.reserve(len);
+  for (int i = 0; i < len; i++) {
+    elements.push_back(CelValue::CreateInt64(i + 1));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
+
+  Activation activation;
+  activation.InsertValue("list", CelValue::CreateList(&cel_list));
+
+  google::protobuf::Arena arena;
+  auto eval_state = cel_expr->InitializeState(&arena);
+
+  // Warm up, so that only the steady state is measured.
+  GOOGLE_CHECK(util::IsOk(
+      cel_expr->Evaluate(activation, eval_state.get()).status()));
+
+  int64_t allocations = 0;
+  for (auto _ : state) {
+    int64_t allocations_before = heap_allocation_count.load();
+    auto eval_result = cel_expr->Evaluate(activation, eval_state.get());
+    allocations += heap_allocation_count.load() - allocations_before;
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsBool());
+    GOOGLE_CHECK(result.BoolOrDie());
+  }
+  GOOGLE_CHECK(allocations == 0) << allocations << " heap allocations";
+  state.counters["allocs_per_eval"] = benchmark::Counter(
+      allocations, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * len);
+}
+
+BENCHMARK(BM_ComprehensionReusedState)->Range(1, 32768);
+
+// Builds cel expression:
+// 'list.map(x, x + 1)'
+std::unique_ptr<CelExpression> BuildListMap(CelExpressionBuilder* builder,
+                                            Expr* expr) {
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { ident_expr { name: "list" } }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_+_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            list_expr {
+              elements {
+                call_expr {
+                  function: "_+_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 1 } }
+                }
+              }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })",
+                                                         expr));
+
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+
+  return std::move(cel_expr_status.ValueOrDie());
+}
+
+// Benchmark test
+// Evaluates cel expression:
+// 'list.map(x, x + 1)'
+// Reports per-element throughput, which is expected to be independent of
+// the list size.
+static void BM_ComprehensionMap(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  auto reg_status = RegisterBuiltinFunctions(builder->GetRegistry());
+  GOOGLE_CHECK(util::IsOk(reg_status));
+
+  Expr expr;
+  auto cel_expr = BuildListMap(builder.get(), &expr);
+
+  int len = state.range(0);
+  std::vector<CelValue> elements;
+  elements.reserve(len);
+  for (int i = 0; i < len; i++) {
+    elements.push_back(CelValue::CreateInt64(i));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
+
+  Activation activation;
+  activation.InsertValue("list", CelValue::CreateList(&cel_list));
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+
+    CelValue result = eval_result.ValueOrDie();
+    GOOGLE_CHECK(result.IsList());
+    GOOGLE_CHECK(result.ListOrDie()->size() == len);
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
+
+BENCHMARK(BM_ComprehensionMap)->Arg(1000)->Arg(10000)->Arg(100000);
+
+// Benchmark test
+// Evaluates cel expression:
+// 'message.string_int32_map.all(k, k != "")'
+// over a map field with state.range(0) entries.
+static void BM_MessageMapComprehension(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    comprehension_expr {
+      iter_var: "k"
+      iter_range {
+        select_expr {
+          operand { ident_expr { name: "message" } }
+          field: "string_int32_map"
+        }
+      }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: true } }
+      loop_condition { ident_expr { name: "__result__" } }
+      loop_step {
+        call_expr {
+          function: "_&&_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_!=_"
+              args { ident_expr { name: "k" } }
+              args { const_expr { string_value: "" } }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })",
+                                                         &expr));
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  int len = state.range(0);
+  TestMessage message;
+  for (int i = 0; i < len; i++) {
+    (*message.mutable_string_int32_map())[absl::StrCat("key", i)] = i;
+  }
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
+
+BENCHMARK(BM_MessageMapComprehension)->Arg(10)->Arg(100)->Arg(1000);
+
+// Benchmark test
+// Evaluates cel expression 'list + list' for a list of state.range(0)
+// elements.
+static void BM_ListConcat(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  Expr expr;
+  auto call = expr.mutable_call_expr();
+  call->set_function("_+_");
+  call->add_args()->mutable_ident_expr()->set_name("list");
+  call->add_args()->mutable_ident_expr()->set_name("list");
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  int len = state.range(0);
+  std::vector<CelValue> elements;
+  for (int i = 0; i < len; i++) {
+    elements.push_back(CelValue::CreateInt64(i));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
+  Activation activation;
+  activation.InsertValue("list", CelValue::CreateList(&cel_list));
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().ListOrDie()->size() == 2 * len);
+  }
+  state.SetItemsProcessed(state.iterations() * 2 * len);
+}
+
+BENCHMARK(BM_ListConcat)->Arg(10)->Arg(1000);
+
+// Benchmark test
+// Evaluates cel expression '-1 in message.int64_list' for a repeated field of
+// state.range(0) elements.
+static void BM_InRepeatedField(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  Expr expr;
+  auto call = expr.mutable_call_expr();
+  call->set_function("@in");
+  call->add_args()->mutable_const_expr()->set_int64_value(-1);
+  auto select = call->add_args()->mutable_select_expr();
+  select->mutable_operand()->mutable_ident_expr()->set_name("message");
+  select->set_field("int64_list");
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  int len = state.range(0);
+  TestMessage message;
+  for (int i = 0; i < len; i++) {
+    message.add_int64_list(i);
+  }
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(!eval_result.ValueOrDie().BoolOrDie());
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
 
+BENCHMARK(BM_InRepeatedField)->Arg(10)->Arg(1000);
+
+// Benchmark test
+// Evaluates cel expression 'message.message_value. ... .int64_value' with
+// state.range(0) selects. The type of message is declared with the builder
+// if state.range(1) is 1.
+static void BM_SelectChain(benchmark::State& state) {
+  FlatExprBuilder builder;
+  if (state.range(1) == 1) {
+    builder.DeclareVariableType("message", TestMessage::descriptor());
+  }
+
+  int depth = state.range(0);
+  Expr expr;
+  Expr* operand = &expr;
+  TestMessage message;
+  TestMessage* leaf = &message;
+  for (int i = 0; i < depth; i++) {
+    auto select = operand->mutable_select_expr();
+    select->set_field(i == 0 ? "int64_value" : "message_value");
+    operand = select->mutable_operand();
+    if (i > 0) {
+      leaf = leaf->mutable_message_value();
+    }
+  }
+  operand->mutable_ident_expr()->set_name("message");
+  leaf->set_int64_value(1);
+  SourceInfo source_info;
+  auto cel_expr_status = builder.CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  google::protobuf::Arena arena;
+  Activation activation;
+  activation.InsertValue("message", CelValue::CreateMessage(&message, &arena));
+  for (auto _ : state) {
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().Int64OrDie() == 1);
+  }
+  state.SetItemsProcessed(state.iterations() * depth);
+}
+
+BENCHMARK(BM_SelectChain)->ArgsProduct({benchmark::CreateDenseRange(1, 8, 1),
+                                        {0, 1}});
+
+// Benchmark test
+// Evaluates cel expressions over a message received serialized, with
+// state.range(0) elements in message.message_list:
+//  range(1) == 0: 'message.int64_value == 1', selecting a scalar,
+//  range(1) == 1: 'message.message_list.all(m, m.int64_value >= 0)',
+//                 selecting a field of every element.
+// With range(2) == 0 the message is parsed and then evaluated, with
+// range(2) == 1 it is evaluated as a WireMessageImpl, which decodes the
+// fields selected only.
+static void BM_WireMessage(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  Expr expr;
+  if (state.range(1) == 0) {
+    GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+      call_expr {
+        function: "_==_"
+        args {
+          select_expr {
+            operand { ident_expr { name: "message" } }
+            field: "int64_value"
+          }
+        }
+        args { const_expr { int64_value: 1 } }
+      })",
+                                                           &expr));
+  } else {
+    GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+      comprehension_expr {
+        iter_var: "m"
+        iter_range {
+          select_expr {
+            operand { ident_expr { name: "message" } }
+            field: "message_list"
+          }
+        }
+        accu_var: "__result__"
+        accu_init { const_expr { bool_value: true } }
+        loop_condition { ident_expr { name: "__result__" } }
+        loop_step {
+          call_expr {
+            function: "_&&_"
+            args { ident_expr { name: "__result__" } }
+            args {
+              call_expr {
+                function: "_>=_"
+                args {
+                  select_expr {
+                    operand { ident_expr { name: "m" } }
+                    field: "int64_value"
+                  }
+                }
+                args { const_expr { int64_value: 0 } }
+              }
+            }
+          }
+        }
+        result { ident_expr { name: "__result__" } }
+      })",
+                                                           &expr));
+  }
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  int len = state.range(0);
+  TestMessage message;
+  message.set_int64_value(1);
+  for (int i = 0; i < len; i++) {
+    TestMessage* element = message.add_message_list();
+    element->set_int64_value(i);
+    element->set_string_value(std::string(32, 'a'));
+    element->add_int64_list(i);
+  }
+  std::string serialized = message.SerializeAsString();
+  bool lazy = state.range(2) == 1;
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    if (lazy) {
+      auto wire_message = google::protobuf::Arena::Create<WireMessageImpl>(
+          &arena, serialized, TestMessage::descriptor(), &arena);
+      activation.InsertValue("message", CelValue::CreateMap(wire_message));
+    } else {
+      auto parsed = google::protobuf::Arena::CreateMessage<TestMessage>(&arena);
+      GOOGLE_CHECK(parsed->ParseFromString(serialized));
+      activation.InsertValue("message", CelValue::CreateMessage(parsed, &arena));
+    }
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+  state.SetBytesProcessed(state.iterations() * serialized.size());
+}
+
+BENCHMARK(BM_WireMessage)->ArgsProduct({{10, 100, 1000}, {0, 1}, {0, 1}});
+
+// Benchmark test
+// Binds the fields of a message as variables and evaluates
+// 'int64_value == 1'. With range(0) == 1 only the fields referenced by the
+// expression are bound, with range(1) == 1 the message is bound serialized.
+static void BM_ReferencedFieldsBind(benchmark::State& state) {
+  FlatExprBuilder builder;
+  builder.set_referenced_paths(true);
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+
+  Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_==_"
+      args { ident_expr { name: "int64_value" } }
+      args { const_expr { int64_value: 1 } }
+    })",
+                                                         &expr));
+  SourceInfo source_info;
+  auto cel_expr_status = builder.CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+  const google::protobuf::FieldMask* referenced_paths =
+      cel_expr->referenced_paths();
+  GOOGLE_CHECK(referenced_paths != nullptr);
+
+  TestMessage message;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    int32_value: 1 int64_value: 1 uint32_value: 1 uint64_value: 1
+    float_value: 1 double_value: 1 string_value: "a" bytes_value: "a"
+    bool_value: true enum_value: TEST_ENUM_1
+    message_value { int64_value: 1 }
+    duration_value { seconds: 1 } timestamp_value { seconds: 1 }
+    int32_list: [1, 2] int64_list: [1, 2] uint32_list: [1, 2]
+    uint64_list: [1, 2] float_list: [1, 2] double_list: [1, 2]
+    string_list: ["a", "b"] bytes_list: ["a", "b"] bool_list: [true]
+    enum_list: [TEST_ENUM_1] message_list { int64_value: 1 }
+    int64_int32_map { key: 1 value: 1 }
+    uint64_int32_map { key: 1 value: 1 }
+    string_int32_map { key: "a" value: 1 })",
+                                                         &message));
+  std::string serialized = message.SerializeAsString();
+  bool referenced = state.range(0) == 1;
+  bool wire = state.range(1) == 1;
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    Activation activation;
+    util::Status status;
+    if (wire) {
+      status = referenced
+                   ? BindWireMessageToActivation(
+                         serialized, TestMessage::descriptor(), &arena,
+                         &activation, *referenced_paths)
+                   : BindWireMessageToActivation(serialized,
+                                                 TestMessage::descriptor(),
+                                                 &arena, &activation);
+    } else {
+      status = referenced ? BindProtoToActivation(&message, &arena,
+                                                  &activation,
+                                                  *referenced_paths)
+                          : BindProtoToActivation(&message, &arena,
+                                                  &activation);
+    }
+    GOOGLE_CHECK(util::IsOk(status));
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+}
+
+BENCHMARK(BM_ReferencedFieldsBind)->ArgsProduct({{0, 1}, {0, 1}});
+
+// Executor on a fixed number of threads.
+class ThreadPoolExecutor : public CelExecutor {
+ public:
+  explicit ThreadPoolExecutor(int num_threads) {
+    for (int i = 0; i < num_threads; i++) {
+      threads_.emplace_back([this]() { Run(); });
+    }
+  }
+
+  ~ThreadPoolExecutor() override {
+    {
+      absl::MutexLock lock(&mutex_);
+      done_ = true;
+    }
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void Schedule(std::function<void()> task) override {
+    absl::MutexLock lock(&mutex_);
+    tasks_.push_back(std::move(task));
+  }
+
+  int concurrency() const override { return threads_.size(); }
+
+ private:
+  void Run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(
+            +[](ThreadPoolExecutor* pool) {
+              return pool->done_ || !pool->tasks_.empty();
+            },
+            this));
+        if (tasks_.empty()) {
+          return;
+        }
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  absl::Mutex mutex_;
+  std::deque<std::function<void()>> tasks_;
+  bool done_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// Evaluates the comprehension over the list of state.range(0) ints, in
+// parallel on state.range(1) threads, or sequentially if it is 0.
+void RunParallelComprehension(benchmark::State& state,
+                              const std::string& expr_text) {
+  int len = state.range(0);
+  int num_threads = state.range(1);
+  ThreadPoolExecutor executor(num_threads);
+
+  FlatExprBuilder builder;
+  if (num_threads > 0) {
+    builder.set_parallel_comprehensions(&executor, 1000);
+  }
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+  Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(expr_text, &expr));
+  SourceInfo source_info;
+  auto cel_expr_status = builder.CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  std::vector<CelValue> elements;
+  elements.reserve(len);
+  for (int i = 0; i < len; i++) {
+    elements.push_back(CelValue::CreateInt64(i));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
+
+  Activation activation;
+  activation.InsertValue("list", CelValue::CreateList(&cel_list));
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(!eval_result.ValueOrDie().IsError());
+  }
+  state.SetItemsProcessed(state.iterations() * len);
+}
+
+// Benchmark test
+// Evaluates cel expression:
+// 'list.exists(x, x * x < 0)'
+// which visits all elements of the list.
+static void BM_ParallelExists(benchmark::State& state) {
+  RunParallelComprehension(state, R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { ident_expr { name: "list" } }
+      accu_var: "__result__"
+      accu_init { const_expr { bool_value: false } }
+      loop_condition {
+        call_expr {
+          function: "@not_strictly_false"
+          args {
+            call_expr {
+              function: "!_"
+              args { ident_expr { name: "__result__" } }
+            }
+          }
+        }
+      }
+      loop_step {
+        call_expr {
+          function: "_||_"
+          args { ident_expr { name: "__result__" } }
+          args {
+            call_expr {
+              function: "_<_"
+              args {
+                call_expr {
+                  function: "_*_"
+                  args { ident_expr { name: "x" } }
+                  args { ident_expr { name: "x" } }
+                }
+              }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })");
+}
+
+BENCHMARK(BM_ParallelExists)
+    ->ArgsProduct({{100000, 1000000}, {0, 1, 2, 4, 8, 16}})
+    ->UseRealTime();
+
+// Benchmark test
+// Evaluates cel expression:
+// 'list.filter(x, x % 3 == 0)'
+static void BM_ParallelFilter(benchmark::State& state) {
+  RunParallelComprehension(state, R"(
+    comprehension_expr {
+      iter_var: "x"
+      iter_range { ident_expr { name: "list" } }
+      accu_var: "__result__"
+      accu_init { list_expr {} }
+      loop_condition { const_expr { bool_value: true } }
+      loop_step {
+        call_expr {
+          function: "_?_:_"
+          args {
+            call_expr {
+              function: "_==_"
+              args {
+                call_expr {
+                  function: "_%_"
+                  args { ident_expr { name: "x" } }
+                  args { const_expr { int64_value: 3 } }
+                }
+              }
+              args { const_expr { int64_value: 0 } }
+            }
+          }
+          args {
+            call_expr {
+              function: "_+_"
+              args { ident_expr { name: "__result__" } }
+              args { list_expr { elements { ident_expr { name: "x" } } } }
+            }
+          }
+          args { ident_expr { name: "__result__" } }
+        }
+      }
+      result { ident_expr { name: "__result__" } }
+    })");
+}
+
+BENCHMARK(BM_ParallelFilter)
+    ->ArgsProduct({{100000, 1000000}, {0, 1, 2, 4, 8, 16}})
+    ->UseRealTime();
+
+// Evaluates cel expression 'target.matches(pattern)', with the pattern
+// given by the constant, or bound to the variable 'pattern' if constant is
+// false.
+void RunRegexMatch(benchmark::State& state, bool constant) {
+  const std::string pattern = "[a-z]+\\.[a-z]+@example\\.(com|org)";
+  const std::string target = "john.doe@example.org";
+
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+  Expr expr;
+  auto call = expr.mutable_call_expr();
+  call->set_function("matches");
+  call->mutable_target()->mutable_ident_expr()->set_name("target");
+  if (constant) {
+    call->add_args()->mutable_const_expr()->set_string_value(pattern);
+  } else {
+    call->add_args()->mutable_ident_expr()->set_name("pattern");
+  }
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  Activation activation;
+  activation.InsertValue("target", CelValue::CreateString(&target));
+  activation.InsertValue("pattern", CelValue::CreateString(&pattern));
+
+  google::protobuf::Arena arena;
+  for (auto _ : state) {
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+}
+
+// Benchmark test
+// Evaluates cel expression 'target.matches("<pattern>")'.
+static void BM_RegexMatchConstantPattern(benchmark::State& state) {
+  RunRegexMatch(state, true);
+}
+
+BENCHMARK(BM_RegexMatchConstantPattern);
+
+// Benchmark test
+// Evaluates cel expression 'target.matches(pattern)'.
+static void BM_RegexMatchDynamicPattern(benchmark::State& state) {
+  RunRegexMatch(state, false);
+}
+
+BENCHMARK(BM_RegexMatchDynamicPattern);
+
+// Evaluates cel expression 'user in [...]' with a list of state.range(0)
+// strings, given by a literal, or bound to the variable 'users' if constant
+// is false. The user is the last element of the list.
+void RunInList(benchmark::State& state, bool constant) {
+  int len = state.range(0);
+  std::vector<std::string> users;
   for (int i = 0; i < len; i++) {
+    users.push_back(absl::StrCat("user", i));
+  }
+
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+  Expr expr;
+  auto call = expr.mutable_call_expr();
+  call->set_function("@in");
+  call->add_args()->mutable_ident_expr()->set_name("user");
+  if (constant) {
+    auto list = call->add_args()->mutable_list_expr();
+    for (const auto& user : users) {
+      list->add_elements()->mutable_const_expr()->set_string_value(user);
+    }
+  } else {
+    call->add_args()->mutable_ident_expr()->set_name("users");
+  }
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  std::vector<CelValue> elements;
+  for (const auto& user : users) {
+    elements.push_back(CelValue::CreateString(&user));
+  }
+  ContainerBackedListImpl cel_list(std::move(elements));
+  Activation activation;
+  activation.InsertValue("user", CelValue::CreateString(&users.back()));
+  activation.InsertValue("users", CelValue::CreateList(&cel_list));
+
+  google::protobuf::Arena arena;
+  for (auto _ : state) {
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+}
+
+// Benchmark test
+// Evaluates cel expression 'user in ["user0", "user1", ...]'.
+static void BM_InConstantList(benchmark::State& state) {
+  RunInList(state, true);
+}
+
+BENCHMARK(BM_InConstantList)->Arg(10)->Arg(100)->Arg(5000);
+
+// Benchmark test
+// Evaluates cel expression 'user in users'.
+static void BM_InDynamicList(benchmark::State& state) {
+  RunInList(state, false);
+}
+
+BENCHMARK(BM_InDynamicList)->Arg(10)->Arg(100)->Arg(5000);
+
+// Benchmark test
+// Evaluates cel expression 'time.getHours(tz)' in the time zone
+// kTimeZones[state.range(0)], given by a literal if state.range(1) is 1, or
+// bound to the variable 'tz' otherwise.
+static void BM_TimestampAccessor(benchmark::State& state) {
+  static const char* const kTimeZones[] = {"UTC", "+05:30",
+                                           "America/New_York"};
+  const std::string time_zone = kTimeZones[state.range(0)];
+  bool constant = state.range(1) != 0;
+
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+  Expr expr;
+  auto call = expr.mutable_call_expr();
+  call->set_function("getHours");
+  call->mutable_target()->mutable_ident_expr()->set_name("time");
+  if (constant) {
+    call->add_args()->mutable_const_expr()->set_string_value(time_zone);
+  } else {
+    call->add_args()->mutable_ident_expr()->set_name("tz");
+  }
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  google::protobuf::Timestamp time;
+  time.set_seconds(1577880000);
+  Activation activation;
+  activation.InsertValue("time", CelValue::CreateTimestamp(&time));
+  activation.InsertValue("tz", CelValue::CreateString(&time_zone));
+
+  google::protobuf::Arena arena;
+  for (auto _ : state) {
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().IsInt64());
+  }
+}
+
+BENCHMARK(BM_TimestampAccessor)->ArgsProduct({{0, 1, 2}, {0, 1}});
+
+// Builds cel expression:
+// 'v0 + v1 + ... + v<len-1>'
+std::unique_ptr<CelExpression> BuildVariableSum(CelExpressionBuilder* builder,
+                                                Expr* root_expr, int len) {
+  Expr* cur_expr = root_expr;
+  for (int i = len - 1; i > 0; i--) {
     Expr::Call* call = cur_expr->mutable_call_expr();
     call->set_function("_+_");
-    call->add_args()->mutable_const_expr()->set_int64_value(1);
     cur_expr = call->add_args();
+    call->add_args()->mutable_ident_expr()->set_name(absl::StrCat("v", i));
   }
+  cur_expr->mutable_ident_expr()->set_name("v0");
 
-  cur_expr->mutable_const_expr()->set_int64_value(1);
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(root_expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  return std::move(cel_expr_status.ValueOrDie());
+}
+
+// Benchmark test
+// Evaluates cel expression 'v0 + v1 + ... + v<len-1>' with variables bound
+// by name.
+static void BM_NameActivation(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  int len = state.range(0);
+  Expr root_expr;
+  auto cel_expr = BuildVariableSum(builder.get(), &root_expr, len);
+
+  Activation activation;
+  for (int i = 0; i < len; i++) {
+    activation.InsertValue(absl::StrCat("v", i), CelValue::CreateInt64(1));
+  }
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().Int64OrDie() == len);
+  }
+}
+
+BENCHMARK(BM_NameActivation)->Range(1, 512);
+
+// Benchmark test
+// Evaluates cel expression 'v0 + v1 + ... + v<len-1>' with variables bound
+// to slots.
+static void BM_SlotActivation(benchmark::State& state) {
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+
+  int len = state.range(0);
+  Expr root_expr;
+  auto cel_expr = BuildVariableSum(builder.get(), &root_expr, len);
+
+  SlotActivation activation(&cel_expr->variable_slots());
+  for (int i = 0; i < cel_expr->variable_slots().size(); i++) {
+    activation.SetSlotValue(i, CelValue::CreateInt64(1));
+  }
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().Int64OrDie() == len);
+  }
+}
+
+BENCHMARK(BM_SlotActivation)->Range(1, 512);
+
+// Benchmark test
+// Evaluates cel expression 'v0 + v1 + ... + v63' concurrently from multiple
+// threads. The expression, and the caches of its call sites, are shared by
+// all threads.
+static void BM_EvalSharedExpression(benchmark::State& state) {
+  static constexpr int kLen = 64;
+  static const CelExpression* cel_expr = [] {
+    // Builder owns the functions and is kept for the lifetime of the
+    // expression.
+    auto builder = new FlatExprBuilder();
+    GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry())));
+    auto root_expr = new Expr();
+    return BuildVariableSum(builder, root_expr, kLen).release();
+  }();
+
+  Activation activation;
+  for (int i = 0; i < kLen; i++) {
+    activation.InsertValue(absl::StrCat("v", i), CelValue::CreateInt64(1));
+  }
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().Int64OrDie() == kLen);
+  }
+}
+
+BENCHMARK(BM_EvalSharedExpression)->ThreadRange(1, 8)->UseRealTime();
+
+// Builds cel expression of an access policy with constant subexpressions:
+// 'size <= 10 * 1024 * 1024 && role in ["admin", "editor", "owner"] &&
+//  ttl < duration("86400s") && time > timestamp("2020-01-01T00:00:00Z")'
+std::unique_ptr<CelExpression> BuildPolicy(CelExpressionBuilder* builder,
+                                           Expr* expr) {
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_&&_"
+      args {
+        call_expr {
+          function: "_&&_"
+          args {
+            call_expr {
+              function: "_<=_"
+              args { ident_expr { name: "size" } }
+              args {
+                call_expr {
+                  function: "_*_"
+                  args {
+                    call_expr {
+                      function: "_*_"
+                      args { const_expr { int64_value: 10 } }
+                      args { const_expr { int64_value: 1024 } }
+                    }
+                  }
+                  args { const_expr { int64_value: 1024 } }
+                }
+              }
+            }
+          }
+          args {
+            call_expr {
+              function: "@in"
+              args { ident_expr { name: "role" } }
+              args {
+                list_expr {
+                  elements { const_expr { string_value: "admin" } }
+                  elements { const_expr { string_value: "editor" } }
+                  elements { const_expr { string_value: "owner" } }
+                }
+              }
+            }
+          }
+        }
+      }
+      args {
+        call_expr {
+          function: "_&&_"
+          args {
+            call_expr {
+              function: "_<_"
+              args { ident_expr { name: "ttl" } }
+              args {
+                call_expr {
+                  function: "duration"
+                  args { const_expr { string_value: "86400s" } }
+                }
+              }
+            }
+          }
+          args {
+            call_expr {
+              function: "_>_"
+              args { ident_expr { name: "time" } }
+              args {
+                call_expr {
+                  function: "timestamp"
+                  args { const_expr { string_value: "2020-01-01T00:00:00Z" } }
+                }
+              }
+            }
+          }
+        }
+      }
+    })",
+                                                         expr));
 
   SourceInfo source_info;
-  auto cel_expr_status = builder->CreateExpression(&root_expr, &source_info);
+  auto cel_expr_status = builder->CreateExpression(expr, &source_info);
   GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  return std::move(cel_expr_status.ValueOrDie());
+}
 
-  std::unique_ptr<CelExpression> cel_expr =
-      std::move(cel_expr_status.ValueOrDie());
+// Evaluates the policy built by BuildPolicy for a request it allows.
+void RunPolicy(benchmark::State& state, bool constant_folding) {
+  FlatExprBuilder builder;
+  builder.set_constant_folding(constant_folding);
+  GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+
+  Expr expr;
+  auto cel_expr = BuildPolicy(&builder, &expr);
+
+  const std::string role = "editor";
+  google::protobuf::Duration ttl;
+  ttl.set_seconds(3600);
+  google::protobuf::Timestamp time;
+  time.set_seconds(1600000000);
+
+  Activation activation;
+  activation.InsertValue("size", CelValue::CreateInt64(4096));
+  activation.InsertValue("role", CelValue::CreateString(&role));
+  activation.InsertValue("ttl", CelValue::CreateDuration(&ttl));
+  activation.InsertValue("time", CelValue::CreateTimestamp(&time));
 
   for (auto _ : state) {
     google::protobuf::Arena arena;
-    Activation activation;
     auto eval_result = cel_expr->Evaluate(activation, &arena);
     GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
+  }
+}
 
-    CelValue result = eval_result.ValueOrDie();
-    GOOGLE_CHECK(result.IsInt64());
-    GOOGLE_CHECK(result.Int64OrDie() == len + 1);
+// Benchmark test
+// Evaluates access policy with constant subexpressions folded at build time.
+static void BM_Policy(benchmark::State& state) { RunPolicy(state, true); }
+
+BENCHMARK(BM_Policy);
+
+// Benchmark test
+// Evaluates access policy with constant subexpressions evaluated every time.
+static void BM_PolicyNoConstantFolding(benchmark::State& state) {
+  RunPolicy(state, false);
+}
+
+BENCHMARK(BM_PolicyNoConstantFolding);
+
+// Benchmark test
+// Evaluates cel expression 'now - time < window', the time window check of
+// a request. The argument selects durations held by value, instead of
+// messages allocated in the arena.
+static void BM_TimeWindow(benchmark::State& state) {
+  BuiltinFunctionOptions options;
+  options.inline_time_values = state.range(0) == 1;
+  auto builder = CreateCelExpressionBuilder();
+  GOOGLE_CHECK(
+      util::IsOk(RegisterBuiltinFunctions(builder->GetRegistry(), options)));
+  Expr expr;
+  GOOGLE_CHECK(google::protobuf::TextFormat::ParseFromString(R"(
+    call_expr {
+      function: "_<_"
+      args {
+        call_expr {
+          function: "_-_"
+          args { ident_expr { name: "now" } }
+          args { ident_expr { name: "time" } }
+        }
+      }
+      args { ident_expr { name: "window" } }
+    })",
+                                                         &expr));
+  SourceInfo source_info;
+  auto cel_expr_status = builder->CreateExpression(&expr, &source_info);
+  GOOGLE_CHECK(util::IsOk(cel_expr_status.status()));
+  auto cel_expr = std::move(cel_expr_status.ValueOrDie());
+
+  google::protobuf::Timestamp now;
+  now.set_seconds(1600000060);
+  google::protobuf::Timestamp time;
+  time.set_seconds(1600000000);
+  google::protobuf::Duration window;
+  window.set_seconds(300);
+
+  Activation activation;
+  activation.InsertValue("now", CelValue::CreateTimestamp(&now));
+  activation.InsertValue("time", CelValue::CreateTimestamp(&time));
+  activation.InsertValue("window", CelValue::CreateDuration(&window));
+
+  for (auto _ : state) {
+    google::protobuf::Arena arena;
+    auto eval_result = cel_expr->Evaluate(activation, &arena);
+    GOOGLE_CHECK(util::IsOk(eval_result.status()));
+    GOOGLE_CHECK(eval_result.ValueOrDie().BoolOrDie());
   }
 }
 
-BENCHMARK(BM_Eval)->Range(1, 32768);
+BENCHMARK(BM_TimeWindow)->Arg(0)->Arg(1);
+
+// Extension function returning its first argument.
+class IdentityFunction : public CelFunction {
+ public:
+  explicit IdentityFunction(const Descriptor& descriptor)
+      : CelFunction(descriptor) {}
+
+  util::Status Evaluate(absl::Span<const CelValue> args, CelValue* result,
+                        google::protobuf::Arena* arena) const override {
+    *result = args[0];
+    return util::OkStatus();
+  }
+};
+
+// Benchmark test
+// Creates a builder with the builtin functions and len extension functions,
+// each with overloads for int, string and double arguments.
+static void BM_RegisterFunctions(benchmark::State& state) {
+  int len = state.range(0);
+  std::vector<std::string> names;
+  for (int i = 0; i < len; i++) {
+    names.push_back(absl::StrCat("ext.function", i));
+  }
+
+  for (auto _ : state) {
+    FlatExprBuilder builder;
+    GOOGLE_CHECK(util::IsOk(RegisterBuiltinFunctions(builder.GetRegistry())));
+    for (const auto& name : names) {
+      for (auto type : {CelValue::Type::kInt64, CelValue::Type::kString,
+                        CelValue::Type::kDouble}) {
+        GOOGLE_CHECK(util::IsOk(
+            builder.GetRegistry()->Register(absl::make_unique<IdentityFunction>(
+                CelFunction::Descriptor{name, false, {type, type}}))));
+      }
+    }
+  }
+}
+
+BENCHMARK(BM_RegisterFunctions)->Range(1, 2048);
 
 }  // namespace
 